@@ -0,0 +1,352 @@
+///////////////////////////////////////////////////////////////////////////////
+// BoundingVolumeHierarchy.cpp
+// ===========================
+// cull scene objects against the view frustum with a bounding box tree
+//
+//  Every object is bounded by a world-space box.  The boxes are sorted
+//  into a binary tree once, so a frame rejects or accepts whole groups
+//  of objects with a single test instead of testing each one.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// most objects a leaf holds before it is split
+	const int LEAF_OBJECTS = 4;
+	// deepest traversal, far more than a balanced tree needs
+	const int MAX_DEPTH = 64;
+	// frustum planes, each bit of a plane mask stands for one
+	const int PLANE_COUNT = 6;
+	const int ALL_PLANES = (1 << PLANE_COUNT) - 1;
+
+	// result of testing a box against the frustum
+	enum CLASSIFICATION
+	{
+		OUTSIDE,
+		INTERSECTING,
+		INSIDE
+	};
+
+	/***********************************************************
+	 *  Merge()
+	 *
+	 *  Get the box around two boxes.
+	 ***********************************************************/
+	BoundingVolumeHierarchy::AABB Merge(const BoundingVolumeHierarchy::AABB& a, const BoundingVolumeHierarchy::AABB& b)
+	{
+		BoundingVolumeHierarchy::AABB merged;
+		merged.minimum = glm::min(a.minimum, b.minimum);
+		merged.maximum = glm::max(a.maximum, b.maximum);
+
+		return(merged);
+	}
+
+	/***********************************************************
+	 *  ExtractPlanes()
+	 *
+	 *  Get the six frustum planes of a view-projection matrix
+	 *  as (normal, distance), with the normals pointing into
+	 *  the frustum.  Each plane is the last row of the matrix
+	 *  plus or minus one of the other rows.
+	 ***********************************************************/
+	void ExtractPlanes(const glm::mat4& m, glm::vec4 planes[PLANE_COUNT])
+	{
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++)
+		{
+			rows[row] = glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+		}
+
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[3] + rows[2];
+		planes[5] = rows[3] - rows[2];
+	}
+
+	/***********************************************************
+	 *  Classify()
+	 *
+	 *  Test a box against the planes still set in planeMask.
+	 *  Planes the box is fully inside of are cleared from the
+	 *  mask, so the children of the box skip them.
+	 ***********************************************************/
+	CLASSIFICATION Classify(const BoundingVolumeHierarchy::AABB& box, const glm::vec4 planes[PLANE_COUNT], int& planeMask)
+	{
+		glm::vec3 center = (box.minimum + box.maximum) * 0.5f;
+		glm::vec3 extent = (box.maximum - box.minimum) * 0.5f;
+
+		for (int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			if ((planeMask & (1 << plane)) == 0)
+			{
+				continue;
+			}
+
+			const glm::vec4& p = planes[plane];
+			float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+			float radius = std::fabs(p.x) * extent.x + std::fabs(p.y) * extent.y + std::fabs(p.z) * extent.z;
+
+			if (distance + radius < 0.0f)
+			{
+				return(OUTSIDE);
+			}
+			if (distance - radius >= 0.0f)
+			{
+				planeMask &= ~(1 << plane);
+			}
+		}
+
+		return((planeMask == 0) ? INSIDE : INTERSECTING);
+	}
+}
+
+/***********************************************************
+ *  BoundingVolumeHierarchy()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+/***********************************************************
+ *  TransformBounds()
+ *
+ *  This method is used for getting the world-space box
+ *  around a local box.  The center is transformed, and the
+ *  extent along each world axis is the absolute value of
+ *  the rotation and scale times the local extent.
+ ***********************************************************/
+BoundingVolumeHierarchy::AABB BoundingVolumeHierarchy::TransformBounds(
+	const float localMinimum[3], const float localMaximum[3], const float worldMatrix[16])
+{
+	float center[3];
+	float extent[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis] = (localMinimum[axis] + localMaximum[axis]) * 0.5f;
+		extent[axis] = (localMaximum[axis] - localMinimum[axis]) * 0.5f;
+	}
+
+	AABB bounds;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float worldCenter = worldMatrix[12 + axis];
+		float worldExtent = 0.0f;
+		for (int column = 0; column < 3; column++)
+		{
+			worldCenter += worldMatrix[column * 4 + axis] * center[column];
+			worldExtent += std::fabs(worldMatrix[column * 4 + axis]) * extent[column];
+		}
+		bounds.minimum[axis] = worldCenter - worldExtent;
+		bounds.maximum[axis] = worldCenter + worldExtent;
+	}
+
+	return(bounds);
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the tree top-down,
+ *  splitting each node at the median object center along
+ *  the longest axis of the centers.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Build(const std::vector<AABB>& objectBounds)
+{
+	m_nodes.clear();
+	m_objectIndices.resize(objectBounds.size());
+	for (size_t i = 0; i < objectBounds.size(); i++)
+	{
+		m_objectIndices[i] = static_cast<int>(i);
+	}
+
+	if (objectBounds.empty() == false)
+	{
+		m_nodes.reserve(objectBounds.size() / LEAF_OBJECTS * 2 + 1);
+		BuildNode(objectBounds, 0, static_cast<int>(objectBounds.size()));
+	}
+
+	m_leafBounds.resize(objectBounds.size());
+	for (size_t i = 0; i < m_objectIndices.size(); i++)
+	{
+		m_leafBounds[i] = objectBounds[m_objectIndices[i]];
+	}
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used for adding the node over a range of
+ *  objects and, when the range is large, its two children.
+ ***********************************************************/
+int BoundingVolumeHierarchy::BuildNode(const std::vector<AABB>& objectBounds, int first, int count)
+{
+	int nodeIndex = static_cast<int>(m_nodes.size());
+	m_nodes.push_back(BVH_NODE());
+
+	AABB bounds = objectBounds[m_objectIndices[first]];
+	glm::vec3 centerMinimum = (bounds.minimum + bounds.maximum) * 0.5f;
+	glm::vec3 centerMaximum = centerMinimum;
+	for (int i = first + 1; i < first + count; i++)
+	{
+		const AABB& object = objectBounds[m_objectIndices[i]];
+		glm::vec3 center = (object.minimum + object.maximum) * 0.5f;
+		bounds = Merge(bounds, object);
+		centerMinimum = glm::min(centerMinimum, center);
+		centerMaximum = glm::max(centerMaximum, center);
+	}
+	m_nodes[nodeIndex].bounds = bounds;
+
+	if (count <= LEAF_OBJECTS)
+	{
+		m_nodes[nodeIndex].first = first;
+		m_nodes[nodeIndex].count = count;
+		return(nodeIndex);
+	}
+
+	glm::vec3 spread = centerMaximum - centerMinimum;
+	int axis = 0;
+	if (spread.y > spread[axis])
+	{
+		axis = 1;
+	}
+	if (spread.z > spread[axis])
+	{
+		axis = 2;
+	}
+
+	int half = count / 2;
+	std::nth_element(m_objectIndices.begin() + first, m_objectIndices.begin() + first + half,
+		m_objectIndices.begin() + first + count,
+		[&objectBounds, axis](int a, int b) {
+			return (objectBounds[a].minimum[axis] + objectBounds[a].maximum[axis]) <
+				(objectBounds[b].minimum[axis] + objectBounds[b].maximum[axis]);
+		});
+
+	BuildNode(objectBounds, first, half);
+	int right = BuildNode(objectBounds, first + half, count - half);
+	m_nodes[nodeIndex].first = right;
+	m_nodes[nodeIndex].count = 0;
+
+	return(nodeIndex);
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used for updating the boxes after the
+ *  objects moved.  Children always come after their parent,
+ *  so a backwards pass sees the children first.  The tree
+ *  shape is kept, which stays efficient while the objects
+ *  do not move far.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Refit(const std::vector<AABB>& objectBounds)
+{
+	for (int nodeIndex = static_cast<int>(m_nodes.size()) - 1; nodeIndex >= 0; nodeIndex--)
+	{
+		BVH_NODE& node = m_nodes[nodeIndex];
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				m_leafBounds[i] = objectBounds[m_objectIndices[i]];
+			}
+			node.bounds = m_leafBounds[node.first];
+			for (int i = node.first + 1; i < node.first + node.count; i++)
+			{
+				node.bounds = Merge(node.bounds, m_leafBounds[i]);
+			}
+		}
+		else
+		{
+			node.bounds = Merge(m_nodes[nodeIndex + 1].bounds, m_nodes[node.first].bounds);
+		}
+	}
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for finding the objects inside the
+ *  frustum.  A node outside any plane is skipped with all
+ *  of its objects, and a node inside every plane adds its
+ *  objects without testing them.  Only the objects of
+ *  leaves that cross a plane are tested one by one.
+ ***********************************************************/
+void BoundingVolumeHierarchy::Cull(const glm::mat4& viewProjection, std::vector<int>& visibleObjects, CULL_STATS& stats) const
+{
+	visibleObjects.clear();
+	stats.nodesTested = 0;
+	stats.objectsTested = 0;
+	stats.objectsCulled = 0;
+	stats.objectsVisible = 0;
+	if (m_nodes.empty() == true)
+	{
+		return;
+	}
+
+	glm::vec4 planes[PLANE_COUNT];
+	ExtractPlanes(viewProjection, planes);
+
+	// node and plane mask pairs still to visit
+	int stackNodes[MAX_DEPTH];
+	int stackMasks[MAX_DEPTH];
+	int stackSize = 0;
+	stackNodes[stackSize] = 0;
+	stackMasks[stackSize] = ALL_PLANES;
+	stackSize++;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		int nodeIndex = stackNodes[stackSize];
+		int planeMask = stackMasks[stackSize];
+		const BVH_NODE& node = m_nodes[nodeIndex];
+
+		stats.nodesTested++;
+		CLASSIFICATION classification = Classify(node.bounds, planes, planeMask);
+		if (classification == OUTSIDE)
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			stackNodes[stackSize] = node.first;
+			stackMasks[stackSize] = planeMask;
+			stackSize++;
+			stackNodes[stackSize] = nodeIndex + 1;
+			stackMasks[stackSize] = planeMask;
+			stackSize++;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			// a single object in a leaf has the leaf's box
+			if ((classification == INSIDE) || (node.count == 1))
+			{
+				visibleObjects.push_back(m_objectIndices[i]);
+				continue;
+			}
+
+			int objectMask = planeMask;
+			stats.objectsTested++;
+			if (Classify(m_leafBounds[i], planes, objectMask) != OUTSIDE)
+			{
+				visibleObjects.push_back(m_objectIndices[i]);
+			}
+		}
+	}
+
+	stats.objectsVisible = static_cast<int>(visibleObjects.size());
+	stats.objectsCulled = static_cast<int>(m_objectIndices.size()) - stats.objectsVisible;
+}
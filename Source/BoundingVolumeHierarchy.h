@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// BoundingVolumeHierarchy.h
+// =========================
+// cull scene objects against the view frustum with a bounding box tree
+//
+//  Every object is bounded by a world-space box.  The boxes are sorted
+//  into a binary tree once, so a frame rejects or accepts whole groups
+//  of objects with a single test instead of testing each one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  BoundingVolumeHierarchy
+ *
+ *  This class builds a tree of axis-aligned boxes over a
+ *  list of object bounds and finds the objects inside the
+ *  frustum of a view-projection matrix.  When the objects
+ *  move, Refit() updates the boxes without rebuilding.
+ ***********************************************************/
+class BoundingVolumeHierarchy
+{
+public:
+	struct AABB
+	{
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+	};
+
+	// work done by the last Cull() call
+	struct CULL_STATS
+	{
+		int nodesTested;
+		int objectsTested;
+		int objectsCulled;
+		int objectsVisible;
+	};
+
+	// constructor
+	BoundingVolumeHierarchy();
+
+	// world-space box around a local box moved by a column-major matrix
+	static AABB TransformBounds(const float localMinimum[3], const float localMaximum[3], const float worldMatrix[16]);
+
+	// build the tree over the passed in object bounds
+	void Build(const std::vector<AABB>& objectBounds);
+	// update the node boxes for new bounds of the same objects
+	void Refit(const std::vector<AABB>& objectBounds);
+	// collect the indices of the objects inside the frustum
+	void Cull(const glm::mat4& viewProjection, std::vector<int>& visibleObjects, CULL_STATS& stats) const;
+
+	int GetNodeCount() const { return static_cast<int>(m_nodes.size()); }
+
+private:
+	struct BVH_NODE
+	{
+		AABB bounds;
+		// leaf: first entry in m_objectIndices
+		// interior: index of the right child, the left child
+		// directly follows its parent
+		int first;
+		// objects in a leaf, 0 for an interior node
+		int count;
+	};
+
+	// add the node over objects [first, first + count) of
+	// m_objectIndices, returns its index
+	int BuildNode(const std::vector<AABB>& objectBounds, int first, int count);
+
+	// nodes in depth-first order, the root first
+	std::vector<BVH_NODE> m_nodes;
+	// object indices, each leaf owns a contiguous range
+	std::vector<int> m_objectIndices;
+	// object bounds in the order of m_objectIndices, so the
+	// objects of a leaf are tested from adjacent memory
+	std::vector<AABB> m_leafBounds;
+};
@@ -0,0 +1,222 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameBenchmark.cpp
+// ==================
+// collect CPU and GPU frame timings and report them as JSON
+//
+//  Used by the --bench driver in MainCode.cpp to measure the cost of
+//  SceneManager::RenderScene along a fixed camera path.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameBenchmark.h"
+#include "JsonText.h"
+
+#include <algorithm>
+#include <cmath>
+
+/***********************************************************
+ *  FrameBenchmark()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameBenchmark::FrameBenchmark(int frameCount)
+{
+	m_cpuFrameTimes.assign(frameCount, 0.0);
+	m_gpuFrameTimes.assign(frameCount, 0.0);
+	m_currentFrame = 0;
+
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		glGenQueries(1, &m_queries[i].ID);
+		m_queries[i].frameIndex = -1;
+		m_queries[i].bPending = false;
+	}
+}
+
+/***********************************************************
+ *  ~FrameBenchmark()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameBenchmark::~FrameBenchmark()
+{
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		glDeleteQueries(1, &m_queries[i].ID);
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the CPU timer and the
+ *  GPU timer query for the next frame.  If the query slot
+ *  is still holding a result from an older frame, that
+ *  result is read back first.
+ ***********************************************************/
+void FrameBenchmark::BeginFrame()
+{
+	TIMER_QUERY& query = m_queries[m_currentFrame % QUERY_RING_SIZE];
+	if (query.bPending == true)
+	{
+		ResolveQuery(query);
+	}
+
+	m_frameStart = std::chrono::high_resolution_clock::now();
+
+	query.frameIndex = m_currentFrame;
+	glBeginQuery(GL_TIME_ELAPSED, query.ID);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for stopping the CPU timer and the
+ *  GPU timer query for the current frame.
+ ***********************************************************/
+void FrameBenchmark::EndFrame()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	m_queries[m_currentFrame % QUERY_RING_SIZE].bPending = true;
+
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::high_resolution_clock::now() - m_frameStart;
+	m_cpuFrameTimes[m_currentFrame] = elapsed.count();
+
+	m_currentFrame++;
+}
+
+/***********************************************************
+ *  SetCounter()
+ *
+ *  This method is used for recording a named value for the
+ *  frame being measured.  Call it between BeginFrame() and
+ *  EndFrame(); frames that never set a counter report 0.
+ ***********************************************************/
+void FrameBenchmark::SetCounter(const char* name, double value)
+{
+	size_t index = 0;
+	while ((index < m_counters.size()) && (m_counters[index].name.compare(name) != 0))
+	{
+		index++;
+	}
+
+	if (index == m_counters.size())
+	{
+		FRAME_COUNTER counter;
+		counter.name = name;
+		counter.samples.assign(m_cpuFrameTimes.size(), 0.0);
+		m_counters.push_back(counter);
+	}
+
+	if (m_currentFrame < static_cast<int>(m_counters[index].samples.size()))
+	{
+		m_counters[index].samples[m_currentFrame] = value;
+	}
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for reading back every timer query
+ *  that has not been resolved yet.
+ ***********************************************************/
+void FrameBenchmark::Finish()
+{
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		if (m_queries[i].bPending == true)
+		{
+			ResolveQuery(m_queries[i]);
+		}
+	}
+}
+
+/***********************************************************
+ *  ResolveQuery()
+ *
+ *  This method is used for reading the elapsed GPU time of
+ *  a timer query into the frame it was recorded for.
+ ***********************************************************/
+void FrameBenchmark::ResolveQuery(TIMER_QUERY& query)
+{
+	GLuint64 elapsedNanoseconds = 0;
+
+	// blocks only if the GPU is more than QUERY_RING_SIZE frames behind
+	glGetQueryObjectui64v(query.ID, GL_QUERY_RESULT, &elapsedNanoseconds);
+	m_gpuFrameTimes[query.frameIndex] = elapsedNanoseconds / 1000000.0;
+	query.bPending = false;
+}
+
+/***********************************************************
+ *  ComputeStats()
+ *
+ *  This method is used for computing the minimum, median,
+ *  99th percentile and mean of the passed in samples.
+ ***********************************************************/
+FrameBenchmark::FRAME_STATS FrameBenchmark::ComputeStats(std::vector<double> samples)
+{
+	FRAME_STATS stats = { 0.0, 0.0, 0.0, 0.0 };
+
+	if (samples.size() == 0)
+	{
+		return(stats);
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	// nearest-rank percentiles
+	size_t p99Index = static_cast<size_t>(std::ceil(0.99 * samples.size())) - 1;
+
+	stats.minimum = samples.front();
+	stats.median = samples[(samples.size() - 1) / 2];
+	stats.p99 = samples[p99Index];
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		stats.mean += samples[i];
+	}
+	stats.mean /= samples.size();
+
+	return(stats);
+}
+
+/***********************************************************
+ *  WriteStats()
+ *
+ *  This method is used for writing one statistics block
+ *  as a named JSON object member.
+ ***********************************************************/
+void FrameBenchmark::WriteStats(std::ostream& output, const char* name, const FRAME_STATS& stats)
+{
+	output << "  \"" << EscapeJson(name) << "\": { "
+		<< "\"min\": " << stats.minimum << ", "
+		<< "\"median\": " << stats.median << ", "
+		<< "\"p99\": " << stats.p99 << ", "
+		<< "\"mean\": " << stats.mean << " }";
+}
+
+/***********************************************************
+ *  WriteReport()
+ *
+ *  This method is used for writing the benchmark results
+ *  as a JSON object to the passed in stream.
+ ***********************************************************/
+void FrameBenchmark::WriteReport(std::ostream& output, bool bHeadless) const
+{
+	std::vector<double> cpuTimes(m_cpuFrameTimes.begin(), m_cpuFrameTimes.begin() + m_currentFrame);
+	std::vector<double> gpuTimes(m_gpuFrameTimes.begin(), m_gpuFrameTimes.begin() + m_currentFrame);
+
+	output << "{" << std::endl;
+	output << "  \"frames\": " << m_currentFrame << "," << std::endl;
+	output << "  \"headless\": " << (bHeadless ? "true" : "false") << "," << std::endl;
+	output << "  \"renderer\": \"" << EscapeJson(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) << "\"," << std::endl;
+	WriteStats(output, "cpu_ms", ComputeStats(cpuTimes));
+	output << "," << std::endl;
+	WriteStats(output, "gpu_ms", ComputeStats(gpuTimes));
+	for (size_t i = 0; i < m_counters.size(); i++)
+	{
+		std::vector<double> samples(m_counters[i].samples.begin(), m_counters[i].samples.begin() + m_currentFrame);
+		output << "," << std::endl;
+		WriteStats(output, m_counters[i].name.c_str(), ComputeStats(samples));
+	}
+	output << std::endl << "}" << std::endl;
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameBenchmark.h
+// ================
+// collect CPU and GPU frame timings and report them as JSON
+//
+//  Used by the --bench driver in MainCode.cpp to measure the cost of
+//  SceneManager::RenderScene along a fixed camera path.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FrameBenchmark
+ *
+ *  This class records the CPU submission time of each frame
+ *  and the GPU execution time reported by GL timer queries.
+ *  Timer queries are kept in a small ring so that reading a
+ *  result never waits on the frame that was just submitted.
+ ***********************************************************/
+class FrameBenchmark
+{
+public:
+	// constructor
+	FrameBenchmark(int frameCount);
+	// destructor
+	~FrameBenchmark();
+
+	// mark the start and end of one measured frame
+	void BeginFrame();
+	void EndFrame();
+
+	// record a named per-frame value, such as a draw or bind
+	// count, for the frame being measured
+	void SetCounter(const char* name, double value);
+
+	// wait for all outstanding GPU timings to be resolved
+	void Finish();
+
+	// write the collected statistics as a JSON object
+	void WriteReport(std::ostream& output, bool bHeadless) const;
+
+private:
+	// number of timer queries kept in flight
+	static const int QUERY_RING_SIZE = 4;
+
+	struct TIMER_QUERY
+	{
+		GLuint ID;
+		int frameIndex;
+		bool bPending;
+	};
+
+	// summary statistics in milliseconds
+	struct FRAME_STATS
+	{
+		double minimum;
+		double median;
+		double p99;
+		double mean;
+	};
+
+	// per-frame values of one named counter
+	struct FRAME_COUNTER
+	{
+		std::string name;
+		std::vector<double> samples;
+	};
+
+	// resolve the result of a pending timer query
+	void ResolveQuery(TIMER_QUERY& query);
+	// compute the summary statistics for a set of samples
+	static FRAME_STATS ComputeStats(std::vector<double> samples);
+	// write one named statistics block
+	static void WriteStats(std::ostream& output, const char* name, const FRAME_STATS& stats);
+
+	// CPU frame times in milliseconds, one per frame
+	std::vector<double> m_cpuFrameTimes;
+	// GPU frame times in milliseconds, one per frame
+	std::vector<double> m_gpuFrameTimes;
+	// named counters in the order they were first set
+	std::vector<FRAME_COUNTER> m_counters;
+	// ring of timer queries
+	TIMER_QUERY m_queries[QUERY_RING_SIZE];
+	// index of the frame currently being recorded
+	int m_currentFrame;
+	// start time of the frame currently being recorded
+	std::chrono::high_resolution_clock::time_point m_frameStart;
+};
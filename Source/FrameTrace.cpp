@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameTrace.cpp
+// ==============
+// record timed spans per thread and write them as a Chrome trace
+//
+//  The written file opens in chrome://tracing or the Perfetto UI, with
+//  one row per thread, so work on the main thread and the render thread
+//  can be seen overlapping frame by frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameTrace.h"
+#include "JsonText.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+/***********************************************************
+ *  Scope()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameTrace::Scope::Scope(FrameTrace* pTrace, const char* name, int frameIndex)
+{
+	m_pTrace = pTrace;
+	m_name = name;
+	m_frameIndex = frameIndex;
+	if (m_pTrace != NULL)
+	{
+		m_start = CLOCK::now();
+	}
+}
+
+/***********************************************************
+ *  ~Scope()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameTrace::Scope::~Scope()
+{
+	if (m_pTrace != NULL)
+	{
+		m_pTrace->AddEvent(m_name, m_frameIndex, m_start, CLOCK::now());
+	}
+}
+
+/***********************************************************
+ *  FrameTrace()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameTrace::FrameTrace()
+{
+	m_origin = CLOCK::now();
+}
+
+/***********************************************************
+ *  FindThread()
+ *
+ *  This method is used for finding the row of the calling
+ *  thread, adding an unnamed one the first time the thread
+ *  records anything.
+ ***********************************************************/
+int FrameTrace::FindThread()
+{
+	std::thread::id ID = std::this_thread::get_id();
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		if (m_threads[i].ID == ID)
+		{
+			return(static_cast<int>(i));
+		}
+	}
+
+	TRACE_THREAD thread;
+	thread.ID = ID;
+	thread.name = "thread " + std::to_string(m_threads.size());
+	m_threads.push_back(thread);
+	return(static_cast<int>(m_threads.size()) - 1);
+}
+
+/***********************************************************
+ *  SetThreadName()
+ *
+ *  This method is used for naming the row of the calling
+ *  thread.
+ ***********************************************************/
+void FrameTrace::SetThreadName(const char* name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_threads[FindThread()].name = name;
+}
+
+/***********************************************************
+ *  AddEvent()
+ *
+ *  This method is used for recording one span on the row
+ *  of the calling thread.
+ ***********************************************************/
+void FrameTrace::AddEvent(const char* name, int frameIndex, CLOCK::time_point start, CLOCK::time_point end)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	TRACE_EVENT event;
+	event.name = name;
+	event.frameIndex = frameIndex;
+	event.threadIndex = FindThread();
+	event.start = start;
+	event.end = end;
+	m_events.push_back(event);
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for writing the thread names and
+ *  the events in the Chrome trace event format, times in
+ *  microseconds since the trace was created.  Spans of one
+ *  frame share the frame number in their arguments.
+ ***********************************************************/
+bool FrameTrace::Write(const char* filename)
+{
+	std::ofstream output(filename);
+	if (!output)
+	{
+		std::cout << "Could not write the trace to " << filename << std::endl;
+		return(false);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// long runs reach seconds, keep the microseconds exact
+	output << std::fixed << std::setprecision(3);
+	output << "{\"traceEvents\": [" << std::endl;
+	bool bFirst = true;
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		output << (bFirst ? "" : ",\n")
+			<< "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i
+			<< ", \"args\": {\"name\": \"" << EscapeJson(m_threads[i].name.c_str()) << "\"}}";
+		bFirst = false;
+	}
+	for (size_t i = 0; i < m_events.size(); i++)
+	{
+		const TRACE_EVENT& event = m_events[i];
+		double start = std::chrono::duration<double, std::micro>(event.start - m_origin).count();
+		double duration = std::chrono::duration<double, std::micro>(event.end - event.start).count();
+		output << (bFirst ? "" : ",\n")
+			<< "{\"name\": \"" << EscapeJson(event.name) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.threadIndex
+			<< ", \"ts\": " << start << ", \"dur\": " << duration
+			<< ", \"args\": {\"frame\": " << event.frameIndex << "}}";
+		bFirst = false;
+	}
+	output << std::endl << "], \"displayTimeUnit\": \"ms\"}" << std::endl;
+
+	std::cout << "INFO: Trace of " << m_events.size() << " events written to " << filename << std::endl;
+	return(true);
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameTrace.h
+// ============
+// record timed spans per thread and write them as a Chrome trace
+//
+//  The written file opens in chrome://tracing or the Perfetto UI, with
+//  one row per thread, so work on the main thread and the render thread
+//  can be seen overlapping frame by frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FrameTrace
+ *
+ *  This class collects complete events, a name, a frame
+ *  number, a start and a duration, from any thread.  Each
+ *  event takes the lock once, which is cheap at the few
+ *  events a frame records.
+ ***********************************************************/
+class FrameTrace
+{
+public:
+	typedef std::chrono::steady_clock CLOCK;
+
+	/***********************************************************
+	 *  Scope
+	 *
+	 *  This class records the span from its construction to
+	 *  its destruction.  A null trace records nothing, so
+	 *  scopes can stay in place when tracing is off.
+	 ***********************************************************/
+	class Scope
+	{
+	public:
+		Scope(FrameTrace* pTrace, const char* name, int frameIndex);
+		~Scope();
+
+	private:
+		FrameTrace* m_pTrace;
+		const char* m_name;
+		int m_frameIndex;
+		CLOCK::time_point m_start;
+	};
+
+	// constructor
+	FrameTrace();
+
+	// name the calling thread's row in the trace
+	void SetThreadName(const char* name);
+	// record one span of the calling thread, the name must
+	// outlive the trace
+	void AddEvent(const char* name, int frameIndex, CLOCK::time_point start, CLOCK::time_point end);
+
+	// write the events as Chrome trace JSON
+	bool Write(const char* filename);
+
+private:
+	struct TRACE_EVENT
+	{
+		const char* name;
+		int frameIndex;
+		int threadIndex;
+		CLOCK::time_point start;
+		CLOCK::time_point end;
+	};
+
+	struct TRACE_THREAD
+	{
+		std::thread::id ID;
+		std::string name;
+	};
+
+	// index of the calling thread, added on first use, with
+	// the lock held
+	int FindThread();
+
+	// trace times are relative to the construction
+	CLOCK::time_point m_origin;
+	std::vector<TRACE_EVENT> m_events;
+	std::vector<TRACE_THREAD> m_threads;
+	// guards the events and threads
+	std::mutex m_mutex;
+};
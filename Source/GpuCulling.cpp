@@ -0,0 +1,231 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuCulling.cpp
+// ==============
+// cull objects against the view frustum in a compute shader
+//
+//  Every object of the frame is tested on the GPU, and the survivors are
+//  written as indirect draw commands straight into the command buffer of
+//  the multi-draw path, so culling costs the CPU nothing per object.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuCulling.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+// declaration of global variables
+namespace
+{
+	// invocations per work group, must match local_size_x
+	const int WORK_GROUP_SIZE = 64;
+	// objects and batches the buffers start with room for
+	const int INITIAL_OBJECT_CAPACITY = 1024;
+	const int INITIAL_BATCH_CAPACITY = 16;
+}
+
+// the objects are uploaded as-is, so the size must match std430
+static_assert(sizeof(GpuCulling::CULL_OBJECT) == 64, "CULL_OBJECT does not match the std430 CullObject layout");
+
+/***********************************************************
+ *  GpuCulling()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuCulling::GpuCulling()
+{
+	m_program = 0;
+	m_viewProjectionLocation = -1;
+	m_objectCountLocation = -1;
+	m_objectBuffer = 0;
+	m_objectCapacity = 0;
+	m_counterBuffer = 0;
+	m_batchCapacity = 0;
+	for (int i = 0; i < READBACK_FRAMES; i++)
+	{
+		m_readbackBuffers[i] = 0;
+		m_readbackObjectCounts[i] = 0;
+	}
+	m_frame = 0;
+	m_culledCount = -1;
+	m_visibleIndexCount = -1;
+}
+
+/***********************************************************
+ *  ~GpuCulling()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuCulling::~GpuCulling()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking that the context has
+ *  compute shaders and shader storage buffers, both part
+ *  of GL 4.3.  Mesa's software rasterizer has both.
+ ***********************************************************/
+bool GpuCulling::IsSupported()
+{
+	if (GLEW_VERSION_4_3)
+	{
+		return(true);
+	}
+
+	return(GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for taking the culling compute
+ *  program from the program cache and creating the
+ *  buffers.  Errors are printed and leave the object
+ *  unusable.
+ ***********************************************************/
+bool GpuCulling::Create(ProgramCache& programCache, const char* shaderFilename)
+{
+	Destroy();
+
+	const ProgramCache::SHADER_STAGE stage = { GL_COMPUTE_SHADER, shaderFilename };
+	m_program = programCache.Finish(&stage, 1);
+	if (m_program == 0)
+	{
+		return(false);
+	}
+
+	m_viewProjectionLocation = glGetUniformLocation(m_program, "viewProjection");
+	m_objectCountLocation = glGetUniformLocation(m_program, "objectCount");
+
+	glGenBuffers(1, &m_objectBuffer);
+	glGenBuffers(1, &m_counterBuffer);
+	glGenBuffers(READBACK_FRAMES, m_readbackBuffers);
+	for (int i = 0; i < READBACK_FRAMES; i++)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_readbackBuffers[i]);
+		glBufferData(GL_COPY_WRITE_BUFFER, GetBatchCountOffset(0), NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the program and buffers.
+ ***********************************************************/
+void GpuCulling::Destroy()
+{
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+	}
+	m_program = 0;
+
+	if (m_objectBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_objectBuffer);
+		glDeleteBuffers(1, &m_counterBuffer);
+		glDeleteBuffers(READBACK_FRAMES, m_readbackBuffers);
+	}
+	m_objectBuffer = 0;
+	m_objectCapacity = 0;
+	m_counterBuffer = 0;
+	m_batchCapacity = 0;
+	for (int i = 0; i < READBACK_FRAMES; i++)
+	{
+		m_readbackBuffers[i] = 0;
+		m_readbackObjectCounts[i] = 0;
+	}
+	m_frame = 0;
+	m_culledCount = -1;
+	m_visibleIndexCount = -1;
+}
+
+/***********************************************************
+ *  GetBatchCountOffset()
+ *
+ *  This method is used for getting the byte offset of a
+ *  batch's visible count in the counter buffer.  The frame
+ *  totals of objects and indices come first.
+ ***********************************************************/
+GLintptr GpuCulling::GetBatchCountOffset(int batch)
+{
+	return(static_cast<GLintptr>(sizeof(GLuint) * (2 + batch)));
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for uploading the objects, clearing
+ *  the counters and dispatching one invocation per object.
+ *  The barrier makes the commands and counters visible to
+ *  the indirect draws that follow.  The frame totals are
+ *  copied aside and the copy from READBACK_FRAMES - 1
+ *  frames ago is read, which the GPU has long finished.
+ *  The draw program is passed in rather than queried, so
+ *  no state is read back from the driver every frame.
+ ***********************************************************/
+void GpuCulling::Cull(const glm::mat4& viewProjection, const std::vector<CULL_OBJECT>& objects,
+	int batchCount, GLuint commandBuffer, GLuint drawProgram)
+{
+	if ((m_program == 0) || (objects.empty() == true))
+	{
+		return;
+	}
+	int objectCount = static_cast<int>(objects.size());
+
+	if ((objectCount > m_objectCapacity) || (m_objectCapacity == 0))
+	{
+		// grow by half again to limit reallocation
+		m_objectCapacity = (objectCount > INITIAL_OBJECT_CAPACITY) ? objectCount + objectCount / 2 : INITIAL_OBJECT_CAPACITY;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CULL_OBJECT) * m_objectCapacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CULL_OBJECT) * objectCount, &objects[0]);
+
+	if ((batchCount > m_batchCapacity) || (m_batchCapacity == 0))
+	{
+		m_batchCapacity = (batchCount > INITIAL_BATCH_CAPACITY) ? batchCount * 2 : INITIAL_BATCH_CAPACITY;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, GetBatchCountOffset(m_batchCapacity), NULL, GL_DYNAMIC_DRAW);
+	}
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+	glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, GetBatchCountOffset(batchCount),
+		GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glUseProgram(m_program);
+	glUniformMatrix4fv(m_viewProjectionLocation, 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniform1ui(m_objectCountLocation, static_cast<GLuint>(objectCount));
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_counterBuffer);
+	glDispatchCompute(static_cast<GLuint>((objectCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE), 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	glUseProgram(drawProgram);
+
+	// keep the frame totals for a later frame to read
+	int slot = m_frame % READBACK_FRAMES;
+	glBindBuffer(GL_COPY_READ_BUFFER, m_counterBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_readbackBuffers[slot]);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GetBatchCountOffset(0));
+	m_readbackObjectCounts[slot] = objectCount;
+	m_frame++;
+
+	if (m_frame >= READBACK_FRAMES)
+	{
+		int oldest = m_frame % READBACK_FRAMES;
+		GLuint totals[2] = { 0, 0 };
+		glBindBuffer(GL_COPY_READ_BUFFER, m_readbackBuffers[oldest]);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(totals), totals);
+		m_culledCount = m_readbackObjectCounts[oldest] - static_cast<int>(totals[0]);
+		m_visibleIndexCount = static_cast<int>(totals[1]);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuCulling.h
+// ============
+// cull objects against the view frustum in a compute shader
+//
+//  Every object of the frame is tested on the GPU, and the survivors are
+//  written as indirect draw commands straight into the command buffer of
+//  the multi-draw path, so culling costs the CPU nothing per object.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ProgramCache.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  GpuCulling
+ *
+ *  This class owns the compute program and the buffers of
+ *  GPU frustum culling.  Objects are grouped into batches
+ *  that each own a range of the command buffer.  Visible
+ *  objects of a batch are packed to the front of its range
+ *  and counted, so the count can limit the draw; objects
+ *  with a fixed command keep their place instead, for
+ *  batches whose draw order matters.  The visible count is
+ *  read back a few frames late so the CPU never waits.
+ ***********************************************************/
+class GpuCulling
+{
+public:
+	// command an object writes when it has no fixed one
+	static const uint32_t NEXT_FREE_COMMAND = 0xFFFFFFFFu;
+
+	// one object as the compute shader reads it (std430)
+	struct CULL_OBJECT
+	{
+		float boundsMinimum[4];
+		float boundsMaximum[4];
+		// draw range of the object's mesh and detail level
+		GLuint indexCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		// batch whose counter the object adds to
+		GLuint batch;
+		// first command of the batch in the command buffer
+		GLuint commandBase;
+		// command within the batch, or NEXT_FREE_COMMAND
+		GLuint fixedCommand;
+		GLuint padding[2];
+	};
+
+	// constructor
+	GpuCulling();
+	// destructor
+	~GpuCulling();
+
+	// true when the context has compute shaders and storage buffers
+	static bool IsSupported();
+
+	// take the culling program from the program cache
+	bool Create(ProgramCache& programCache, const char* shaderFilename);
+	// free the program and buffers
+	void Destroy();
+
+	// cull the objects and write the visible ones into the
+	// command buffer, which must hold one command per object
+	// and be cleared to zero; the draw program is bound again
+	// afterwards
+	void Cull(const glm::mat4& viewProjection, const std::vector<CULL_OBJECT>& objects,
+		int batchCount, GLuint commandBuffer, GLuint drawProgram);
+
+	// buffer holding the visible count of each batch, at
+	// GetBatchCountOffset(), for use as an indirect parameter buffer
+	GLuint GetCounterBuffer() const { return m_counterBuffer; }
+	static GLintptr GetBatchCountOffset(int batch);
+
+	// objects culled, and indices of the objects kept, by the
+	// Cull() call READBACK_FRAMES - 1 frames ago, -1 until the
+	// first result arrives
+	int GetCulledCount() const { return m_culledCount; }
+	int GetVisibleIndexCount() const { return m_visibleIndexCount; }
+
+private:
+	// readback buffers in the ring; the counter a frame copies
+	// is read READBACK_FRAMES - 1 frames later
+	enum
+	{
+		READBACK_FRAMES = 3
+	};
+
+	GLuint m_program;
+	GLint m_viewProjectionLocation;
+	GLint m_objectCountLocation;
+	// objects of the frame
+	GLuint m_objectBuffer;
+	int m_objectCapacity;
+	// visible counts, the frame totals then one per batch
+	GLuint m_counterBuffer;
+	int m_batchCapacity;
+	// copies of the frame totals, read once the GPU is past them
+	GLuint m_readbackBuffers[READBACK_FRAMES];
+	int m_readbackObjectCounts[READBACK_FRAMES];
+	int m_frame;
+	int m_culledCount;
+	int m_visibleIndexCount;
+};
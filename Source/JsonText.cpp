@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+// JsonText.cpp
+// ============
+// escape text written into the JSON reports
+//
+//  The benchmark report and the frame trace are written as JSON by
+//  hand.  Names and driver strings are escaped before they are placed
+//  between quotes, so quotes, backslashes and control characters in
+//  them cannot break the file.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JsonText.h"
+
+#include <cstdio>
+
+/***********************************************************
+ *  EscapeJson()
+ *
+ *  This function is used for escaping text to be written
+ *  between the quotes of a JSON string.  Quotes and
+ *  backslashes get a backslash, control characters become
+ *  \u escapes, and every other byte is copied as-is.
+ ***********************************************************/
+std::string EscapeJson(const char* text)
+{
+	std::string escaped;
+	if (text == NULL)
+	{
+		return(escaped);
+	}
+
+	for (const char* pChar = text; *pChar != '\0'; pChar++)
+	{
+		unsigned char character = static_cast<unsigned char>(*pChar);
+		if ((character == '"') || (character == '\\'))
+		{
+			escaped += '\\';
+			escaped += *pChar;
+		}
+		else if (character < 0x20)
+		{
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", character);
+			escaped += code;
+		}
+		else
+		{
+			escaped += *pChar;
+		}
+	}
+
+	return(escaped);
+}
@@ -0,0 +1,17 @@
+///////////////////////////////////////////////////////////////////////////////
+// JsonText.h
+// ==========
+// escape text written into the JSON reports
+//
+//  The benchmark report and the frame trace are written as JSON by
+//  hand.  Names and driver strings are escaped before they are placed
+//  between quotes, so quotes, backslashes and control characters in
+//  them cannot break the file.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+
+// the text as the inside of a JSON string, empty for NULL
+std::string EscapeJson(const char* text);
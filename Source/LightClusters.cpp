@@ -0,0 +1,354 @@
+///////////////////////////////////////////////////////////////////////////////
+// LightClusters.cpp
+// =================
+// bin point lights into view-space clusters for forward shading
+//
+//  The view frustum is cut into a grid of tiles on screen and slices in
+//  depth.  Each frame every point light is added to the clusters its
+//  sphere touches, so a fragment only shades the lights of its cluster
+//  instead of every light in the scene.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	const char* g_PointLightsName = "pointLights";
+	const char* g_ClusterGridName = "clusterGrid";
+	const char* g_ClusterLightIndicesName = "clusterLightIndices";
+	const char* g_PointLightCountName = "pointLightCount";
+	const char* g_ClusterTileSizeName = "clusterTileSize";
+	const char* g_ClusterSliceName = "clusterSliceScaleBias";
+
+	// texels of one light in the light buffer texture
+	const int LIGHT_TEXELS = 2;
+	// closest depth the slices start at, for projections
+	// whose near plane is at or behind the camera
+	const float MINIMUM_NEAR_DEPTH = 0.01f;
+
+	/***********************************************************
+	 *  ProjectToScreen()
+	 *
+	 *  Get the normalized device x and y of a view-space point.
+	 ***********************************************************/
+	glm::vec2 ProjectToScreen(const glm::mat4& projection, const glm::vec3& point)
+	{
+		glm::vec4 clip = projection * glm::vec4(point, 1.0f);
+		return(glm::vec2(clip.x / clip.w, clip.y / clip.w));
+	}
+}
+
+/***********************************************************
+ *  LightClusters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusters::LightClusters()
+{
+	m_sliceScale = 0.0f;
+	m_sliceBias = 0.0f;
+	m_tileSize = glm::vec2(1.0f, 1.0f);
+	m_lightBuffer = 0;
+	m_gridBuffer = 0;
+	m_indexBuffer = 0;
+	m_lightTexture = 0;
+	m_gridTexture = 0;
+	m_indexTexture = 0;
+}
+
+/***********************************************************
+ *  ~LightClusters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusters::~LightClusters()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the three buffers and
+ *  the buffer textures the shader reads them through.
+ ***********************************************************/
+void LightClusters::Create()
+{
+	Destroy();
+
+	glGenBuffers(1, &m_lightBuffer);
+	glGenBuffers(1, &m_gridBuffer);
+	glGenBuffers(1, &m_indexBuffer);
+	glGenTextures(1, &m_lightTexture);
+	glGenTextures(1, &m_gridTexture);
+	glGenTextures(1, &m_indexTexture);
+
+	// the grid has a fixed size, the other buffers start with
+	// room for one entry so their textures are never empty
+	GLuint emptyEntry[4] = { 0, 0, 0, 0 };
+	glBindBuffer(GL_TEXTURE_BUFFER, m_lightBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * 4 * LIGHT_TEXELS, emptyEntry, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_gridBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint) * 2 * CLUSTER_COUNT, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint), emptyEntry, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_lightBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, m_gridTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_gridBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, m_indexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_indexBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the buffers and buffer
+ *  textures.
+ ***********************************************************/
+void LightClusters::Destroy()
+{
+	if (m_lightBuffer != 0)
+	{
+		glDeleteTextures(1, &m_lightTexture);
+		glDeleteTextures(1, &m_gridTexture);
+		glDeleteTextures(1, &m_indexTexture);
+		glDeleteBuffers(1, &m_lightBuffer);
+		glDeleteBuffers(1, &m_gridBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+	m_lightBuffer = 0;
+	m_gridBuffer = 0;
+	m_indexBuffer = 0;
+	m_lightTexture = 0;
+	m_gridTexture = 0;
+	m_indexTexture = 0;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for replacing the point lights and
+ *  uploading them, two texels per light: the position and
+ *  range, then the color and intensity.
+ ***********************************************************/
+void LightClusters::SetLights(const std::vector<POINT_LIGHT>& lights)
+{
+	m_lights = lights;
+	if ((m_lightBuffer == 0) || (m_lights.empty() == true))
+	{
+		return;
+	}
+
+	std::vector<glm::vec4> texels(m_lights.size() * LIGHT_TEXELS);
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		texels[i * LIGHT_TEXELS] = glm::vec4(m_lights[i].position, m_lights[i].range);
+		texels[i * LIGHT_TEXELS + 1] = glm::vec4(m_lights[i].color, m_lights[i].intensity);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_lightBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * texels.size(), &texels[0], GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetSlice()
+ *
+ *  This method is used for getting the depth slice of a
+ *  view-space distance in front of the camera.
+ ***********************************************************/
+int LightClusters::GetSlice(const BINNED_LIGHTS& binned, float depth)
+{
+	int slice = static_cast<int>(std::floor(std::log(std::max(depth, binned.nearDepth)) * binned.sliceScale + binned.sliceBias));
+	return(std::min(std::max(slice, 0), SLICES - 1));
+}
+
+/***********************************************************
+ *  GetSliceStart()
+ *
+ *  This method is used for getting the distance in front
+ *  of the camera where a depth slice starts.
+ ***********************************************************/
+float LightClusters::GetSliceStart(const BINNED_LIGHTS& binned, int slice)
+{
+	return(binned.nearDepth * std::pow(binned.farDepth / binned.nearDepth, static_cast<float>(slice) / SLICES));
+}
+
+/***********************************************************
+ *  Bin()
+ *
+ *  This method is used for binning the lights for a view.
+ *  For every depth slice a light's sphere reaches, the box
+ *  around the sphere, cut to the slice, is projected to
+ *  find the tiles it covers.  The cluster and light pairs
+ *  are then sorted by cluster with a counting sort into
+ *  the index list, and each cluster records where its
+ *  lights start and how many there are.  Only the lights
+ *  and the binned data are touched, so frames can be
+ *  binned on another thread while one is drawn.
+ ***********************************************************/
+void LightClusters::Bin(const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight,
+	BINNED_LIGHTS& binned) const
+{
+	binned.clusterCounts.resize(CLUSTER_COUNT);
+	binned.clusterGrid.resize(CLUSTER_COUNT * 2);
+
+	// near and far planes from the projection, which is an
+	// orthographic one when its last row is (0, 0, 0, 1)
+	if (projection[3][3] == 0.0f)
+	{
+		binned.nearDepth = projection[3][2] / (projection[2][2] - 1.0f);
+		binned.farDepth = projection[3][2] / (projection[2][2] + 1.0f);
+	}
+	else
+	{
+		binned.nearDepth = (projection[3][2] + 1.0f) / projection[2][2];
+		binned.farDepth = (projection[3][2] - 1.0f) / projection[2][2];
+	}
+	binned.nearDepth = std::max(binned.nearDepth, MINIMUM_NEAR_DEPTH);
+	binned.farDepth = std::max(binned.farDepth, binned.nearDepth * 2.0f);
+	binned.sliceScale = SLICES / std::log(binned.farDepth / binned.nearDepth);
+	binned.sliceBias = -SLICES * std::log(binned.nearDepth) / std::log(binned.farDepth / binned.nearDepth);
+	binned.tileSize = glm::vec2(static_cast<float>(viewportWidth) / TILES_X, static_cast<float>(viewportHeight) / TILES_Y);
+
+	binned.pairClusters.clear();
+	binned.pairLights.clear();
+	for (size_t light = 0; light < m_lights.size(); light++)
+	{
+		glm::vec3 center = glm::vec3(view * glm::vec4(m_lights[light].position, 1.0f));
+		float range = m_lights[light].range;
+
+		// the camera looks down -z, depth is the distance in front
+		float depth = -center.z;
+		if ((depth + range < binned.nearDepth) || (depth - range > binned.farDepth))
+		{
+			continue;
+		}
+		float nearest = std::max(depth - range, binned.nearDepth);
+		float farthest = std::min(depth + range, binned.farDepth);
+
+		int lastSlice = GetSlice(binned, farthest);
+		for (int slice = GetSlice(binned, nearest); slice <= lastSlice; slice++)
+		{
+			float sliceNear = std::max(GetSliceStart(binned, slice), nearest);
+			float sliceFar = std::min(GetSliceStart(binned, slice + 1), farthest);
+
+			glm::vec2 screenMinimum = glm::vec2(1.0f, 1.0f);
+			glm::vec2 screenMaximum = glm::vec2(-1.0f, -1.0f);
+			for (int corner = 0; corner < 8; corner++)
+			{
+				glm::vec3 point = glm::vec3(
+					center.x + (((corner & 1) != 0) ? range : -range),
+					center.y + (((corner & 2) != 0) ? range : -range),
+					-(((corner & 4) != 0) ? sliceFar : sliceNear));
+				glm::vec2 screen = ProjectToScreen(projection, point);
+				screenMinimum = glm::min(screenMinimum, screen);
+				screenMaximum = glm::max(screenMaximum, screen);
+			}
+			if ((screenMinimum.x > 1.0f) || (screenMinimum.y > 1.0f) ||
+				(screenMaximum.x < -1.0f) || (screenMaximum.y < -1.0f))
+			{
+				continue;
+			}
+
+			// normalized device coordinates to tiles
+			int firstX = std::max(static_cast<int>(std::floor((screenMinimum.x + 1.0f) * 0.5f * TILES_X)), 0);
+			int lastX = std::min(static_cast<int>(std::floor((screenMaximum.x + 1.0f) * 0.5f * TILES_X)), TILES_X - 1);
+			int firstY = std::max(static_cast<int>(std::floor((screenMinimum.y + 1.0f) * 0.5f * TILES_Y)), 0);
+			int lastY = std::min(static_cast<int>(std::floor((screenMaximum.y + 1.0f) * 0.5f * TILES_Y)), TILES_Y - 1);
+			for (int y = firstY; y <= lastY; y++)
+			{
+				for (int x = firstX; x <= lastX; x++)
+				{
+					binned.pairClusters.push_back(static_cast<GLuint>((slice * TILES_Y + y) * TILES_X + x));
+					binned.pairLights.push_back(static_cast<GLuint>(light));
+				}
+			}
+		}
+	}
+
+	// counting sort of the pairs by cluster
+	std::fill(binned.clusterCounts.begin(), binned.clusterCounts.end(), 0);
+	for (size_t i = 0; i < binned.pairClusters.size(); i++)
+	{
+		binned.clusterCounts[binned.pairClusters[i]]++;
+	}
+	GLuint first = 0;
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		binned.clusterGrid[cluster * 2] = first;
+		binned.clusterGrid[cluster * 2 + 1] = binned.clusterCounts[cluster];
+		first += binned.clusterCounts[cluster];
+		// reused as the next free index of the cluster
+		binned.clusterCounts[cluster] = binned.clusterGrid[cluster * 2];
+	}
+	binned.lightIndices.resize(std::max<size_t>(binned.pairClusters.size(), 1));
+	for (size_t i = 0; i < binned.pairClusters.size(); i++)
+	{
+		binned.lightIndices[binned.clusterCounts[binned.pairClusters[i]]++] = binned.pairLights[i];
+	}
+	if (binned.pairClusters.empty() == true)
+	{
+		binned.lightIndices.clear();
+	}
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for writing binned clusters into
+ *  the grid and index buffers and keeping the tile size
+ *  and slice mapping Bind() hands the shader.
+ ***********************************************************/
+void LightClusters::Upload(const BINNED_LIGHTS& binned)
+{
+	if ((m_gridBuffer == 0) || (binned.clusterGrid.empty() == true))
+	{
+		return;
+	}
+	m_sliceScale = binned.sliceScale;
+	m_sliceBias = binned.sliceBias;
+	m_tileSize = binned.tileSize;
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_gridBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint) * binned.clusterGrid.size(), &binned.clusterGrid[0], GL_STREAM_DRAW);
+	if (binned.lightIndices.empty() == false)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(GLuint) * binned.lightIndices.size(), &binned.lightIndices[0], GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the buffer textures to
+ *  their reserved units and setting the uniforms the
+ *  fragment shader finds its cluster with.
+ ***********************************************************/
+void LightClusters::Bind(SceneUniforms& uniforms)
+{
+	glActiveTexture(GL_TEXTURE0 + LIGHT_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightTexture);
+	glActiveTexture(GL_TEXTURE0 + GRID_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_gridTexture);
+	glActiveTexture(GL_TEXTURE0 + INDEX_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_indexTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(uniforms.GetUniformLocation(g_PointLightsName), LIGHT_UNIT);
+	glUniform1i(uniforms.GetUniformLocation(g_ClusterGridName), GRID_UNIT);
+	glUniform1i(uniforms.GetUniformLocation(g_ClusterLightIndicesName), INDEX_UNIT);
+	glUniform1i(uniforms.GetUniformLocation(g_PointLightCountName), static_cast<int>(m_lights.size()));
+	glUniform2f(uniforms.GetUniformLocation(g_ClusterTileSizeName), m_tileSize.x, m_tileSize.y);
+	glUniform2f(uniforms.GetUniformLocation(g_ClusterSliceName), m_sliceScale, m_sliceBias);
+}
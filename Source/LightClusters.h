@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// LightClusters.h
+// ===============
+// bin point lights into view-space clusters for forward shading
+//
+//  The view frustum is cut into a grid of tiles on screen and slices in
+//  depth.  Each frame every point light is added to the clusters its
+//  sphere touches, so a fragment only shades the lights of its cluster
+//  instead of every light in the scene.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneUniforms.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  LightClusters
+ *
+ *  This class bins the point lights on the CPU and hands
+ *  the shader three buffer textures: the lights, one
+ *  (first, count) entry per cluster, and the light indices
+ *  of all clusters back to back.  Depth slices grow
+ *  exponentially, so near and far clusters cover a similar
+ *  share of the screen.  Binning makes no GL calls, so it
+ *  can run on another thread than the upload.
+ ***********************************************************/
+class LightClusters
+{
+public:
+	// clusters across, down and in depth
+	static const int TILES_X = 16;
+	static const int TILES_Y = 9;
+	static const int SLICES = 24;
+	static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+	struct POINT_LIGHT
+	{
+		glm::vec3 position;
+		// distance at which the light fades out completely
+		float range;
+		glm::vec3 color;
+		float intensity;
+	};
+
+	// lights binned for one view, with the scratch the binning
+	// reuses from frame to frame
+	struct BINNED_LIGHTS
+	{
+		// (first, count) of each cluster and the light indices
+		// of all clusters back to back
+		std::vector<GLuint> clusterGrid;
+		std::vector<GLuint> lightIndices;
+		// depth range the slices cover
+		float nearDepth;
+		float farDepth;
+		// slice = log(depth) * sliceScale + sliceBias
+		float sliceScale;
+		float sliceBias;
+		// size of a tile in pixels
+		glm::vec2 tileSize;
+		// cluster and light pairs before sorting, and the
+		// light count of each cluster
+		std::vector<GLuint> pairClusters;
+		std::vector<GLuint> pairLights;
+		std::vector<GLuint> clusterCounts;
+	};
+
+	// constructor
+	LightClusters();
+	// destructor
+	~LightClusters();
+
+	// create the buffers and buffer textures
+	void Create();
+	// free the buffers and buffer textures
+	void Destroy();
+
+	// replace the lights, in world space
+	void SetLights(const std::vector<POINT_LIGHT>& lights);
+	int GetLightCount() const { return static_cast<int>(m_lights.size()); }
+
+	// bin the lights for a view without GL calls; the lights
+	// must not change while this runs
+	void Bin(const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight,
+		BINNED_LIGHTS& binned) const;
+	// upload binned clusters for Bind()
+	void Upload(const BINNED_LIGHTS& binned);
+	// bind the buffer textures and set the cluster uniforms
+	void Bind(SceneUniforms& uniforms);
+
+	// texture units of the buffer textures
+	static const int LIGHT_UNIT = 12;
+	static const int GRID_UNIT = 13;
+	static const int INDEX_UNIT = 14;
+
+private:
+	// slice of a view-space depth, clamped to the grid
+	static int GetSlice(const BINNED_LIGHTS& binned, float depth);
+	// view-space depth where a slice starts
+	static float GetSliceStart(const BINNED_LIGHTS& binned, int slice);
+
+	// lights in world space
+	std::vector<POINT_LIGHT> m_lights;
+
+	// slice = log(depth) * m_sliceScale + m_sliceBias, and the
+	// size of a tile in pixels, of the last Upload()
+	float m_sliceScale;
+	float m_sliceBias;
+	glm::vec2 m_tileSize;
+
+	// buffers and the buffer textures reading them
+	GLuint m_lightBuffer;
+	GLuint m_gridBuffer;
+	GLuint m_indexBuffer;
+	GLuint m_lightTexture;
+	GLuint m_gridTexture;
+	GLuint m_indexTexture;
+};
@@ -8,7 +8,12 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <iostream>         // error handling and output
+#include <fstream>          // benchmark report output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // command line parsing
+#include <sstream>          // window title statistics
+#include <mutex>            // counters shared with the render thread
+#include <chrono>           // startup time
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -22,6 +27,14 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ProgramCache.h"
+#include "SceneUniforms.h"
+#include "FrameBenchmark.h"
+#include "FrameTrace.h"
+#include "RenderThread.h"
+#include "UtilizationMeter.h"
+#include "SceneFile.h"
+#include "TransformBatch.h"
 
 // Namespace for declaring global variables
 namespace
@@ -36,16 +49,133 @@ namespace
 
 	// scene manager object for managing the 3D scene prepare and render
 	SceneManager* g_SceneManager = nullptr;
-	// shader manager object for dynamic interaction with the shader code
+	// shader manager object from the course utilities; it owns no
+	// program since the scene program comes from g_ProgramCache and
+	// the uniforms go through g_SceneUniforms, and it is only kept
+	// for the SceneManager and ViewManager constructors
 	ShaderManager* g_ShaderManager = nullptr;
+	// builds the shader programs from the binary cache or the sources
+	ProgramCache* g_ProgramCache = nullptr;
+	// program the scene is drawn with
+	GLuint g_sceneProgram = 0;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// uniform buffers written by the scene manager and the frame snapshots
+	SceneUniforms* g_SceneUniforms = nullptr;
+	// thread that owns the GL context while frames are rendered,
+	// null when rendering on the main thread
+	RenderThread* g_RenderThread = nullptr;
+	// snapshot the frames are prepared in without the render thread
+	RenderThread::FRAME_SNAPSHOT g_Snapshot;
+	// benchmark recording the rendered frames, null when not benchmarking
+	FrameBenchmark* g_FrameBenchmark = nullptr;
+	// trace of the main and render threads, null when not tracing
+	FrameTrace* g_FrameTrace = nullptr;
+	// CPU and GPU use of the window loop, null in the benchmarks
+	UtilizationMeter* g_UtilizationMeter = nullptr;
+	// counters of the last rendered frame, for the window title
+	SceneManager::RENDER_COUNTERS g_TitleCounters = SceneManager::RENDER_COUNTERS();
+	std::mutex g_TitleCountersMutex;
+
+	// render into an offscreen framebuffer without a visible window
+	bool g_bHeadless = false;
+	// number of frames to render for the benchmark, 0 when not benchmarking
+	int g_benchmarkFrames = 0;
+	// number of frames of material and texture lookups to time, 0 when not benchmarking
+	int g_lookupBenchmarkFrames = 0;
+	// number of random transforms to compose, 0 when not benchmarking
+	int g_transformBenchmarkCount = 0;
+	// optional file for the benchmark report, stdout when not set
+	const char* g_benchmarkOutput = nullptr;
+	// bake the compressed texture cache and exit
+	bool g_bBakeTextures = false;
+	// load textures without the compressed texture cache
+	bool g_bNoTextureCache = false;
+	// draw in scene file order instead of sorting by state
+	bool g_bNoDrawSort = false;
+	// issue one draw call per object instead of instanced batches
+	bool g_bNoInstancing = false;
+	// issue one instanced call per batch instead of multi-draw indirect
+	bool g_bNoMultiDraw = false;
+	// draw every object instead of only those inside the view
+	bool g_bNoCulling = false;
+	// cull in a compute shader instead of on the CPU
+	bool g_bGpuCulling = false;
+	// draw every object with its finest detail level
+	bool g_bNoLevelsOfDetail = false;
+	// draw every object on its own instead of baking the static
+	// ones into batches
+	bool g_bNoStaticBatching = false;
+	// vertex shader that inverts the model matrix per vertex,
+	// to compare against the precomputed normal matrices
+	bool g_bReferenceShader = false;
+	// compile every shader program instead of loading the binaries
+	// saved by an earlier run
+	bool g_bNoProgramCache = false;
+	// when main() started, to report the time to the first frame
+	std::chrono::steady_clock::time_point g_startupTime;
+	// segments around the sphere, 0 keeps the default
+	int g_sphereDetail = 0;
+	// store packed normals and half-float texture coordinates
+	bool g_bPackedVertices = false;
+	// lay down the opaque depth before shading
+	bool g_bDepthPrepass = false;
+	// show the fragments per pixel instead of the shaded scene
+	bool g_bOverdrawView = false;
+	// draw the transparent objects with weighted blended
+	// order-independent transparency
+	bool g_bWeightedBlend = false;
+	// light without the shadow atlas
+	bool g_bNoShadows = false;
+	// shadow filter taps across, odd
+	int g_shadowKernelSize = 3;
+	// render on the main thread between the input polls
+	bool g_bNoRenderThread = false;
+	// optional file for the Chrome trace of the frames
+	const char* g_traceOutput = nullptr;
+	// only draw when the view changed, waiting for events otherwise
+	bool g_bOnDemand = false;
+	// longest time between two frames of the on-demand loop, 0
+	// to wait for events alone
+	double g_idleRefreshSeconds = 1.0;
+	// scene file to draw, text or compiled
+	const char* g_sceneFile = "scenes/desk.scene";
+	// text scene to compile and the compiled file to write
+	const char* g_compileSceneInput = nullptr;
+	const char* g_compileSceneOutput = nullptr;
+	// stress objects to add to the scene file and the file to write
+	int g_generateSceneObjects = 0;
+	const char* g_generateSceneOutput = nullptr;
+	// point lights to add to the generated scene
+	int g_generateSceneLights = 0;
+	// transparent objects to add to the generated scene
+	int g_generateSceneGlass = 0;
+	// frames rendered before the benchmark starts recording
+	const int BENCHMARK_WARMUP_FRAMES = 5;
+	// frames rendered when headless mode is requested without --bench
+	const int DEFAULT_BENCHMARK_FRAMES = 300;
+	// seconds between refreshes of the statistics in the window title
+	const double TITLE_UPDATE_SECONDS = 0.5;
+	// longest the main thread waits for the render thread before it
+	// polls the input again
+	const double INPUT_POLL_SECONDS = 0.004;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
+bool ParseCommandLine(int argc, char* argv[]);
 bool InitializeGLFW();
 bool InitializeGLEW();
+void CaptureFrame(int frameIndex);
+void SubmitFrame(int frameIndex);
+void RenderSnapshot(const RenderThread::FRAME_SNAPSHOT& snapshot);
+void RenderFrame(const SceneManager::PREPARED_FRAME& prepared);
+void RunWindowLoop();
+void UpdateWindowTitle();
+bool RunBenchmark();
+bool RunLookupBenchmark();
+bool RunTransformBenchmark();
+bool ConvertSceneFile();
 
 
 /***********************************************************
@@ -56,6 +186,32 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	g_startupTime = std::chrono::steady_clock::now();
+
+	// if the command line is malformed, then terminate the application
+	if (ParseCommandLine(argc, argv) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// the offline texture bake needs no window or GL context
+	if (g_bBakeTextures == true)
+	{
+		return(SceneManager::BakeSceneTextures(g_sceneFile) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// neither does compiling or generating a scene file
+	if ((g_compileSceneOutput != nullptr) || (g_generateSceneOutput != nullptr))
+	{
+		return(ConvertSceneFile() ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// the transform benchmark only runs CPU code
+	if (g_transformBenchmarkCount > 0)
+	{
+		return(RunTransformBenchmark() ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -68,8 +224,20 @@ int main(int argc, char* argv[])
 	g_ViewManager = new ViewManager(
 		g_ShaderManager);
 
-	// try to create the main display window
-	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	// try to create the main display window, or an invisible
+	// context-only window when rendering headless
+	if (g_bHeadless == true)
+	{
+		g_Window = g_ViewManager->CreateOffscreenWindow(WINDOW_TITLE);
+	}
+	else
+	{
+		g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	}
+	if (g_Window == nullptr)
+	{
+		return(EXIT_FAILURE);
+	}
 	// print the version to the console
 	std::cout << std::endl << "Version: " << SW_VERSION << std::endl;
 
@@ -79,39 +247,108 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"shaders/vertexShader.glsl",
-		"shaders/fragmentShader.glsl");
-	g_ShaderManager->use();
-
-	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
-	g_SceneManager->PrepareScene();
+	// headless frames are rendered into an offscreen framebuffer
+	if ((g_bHeadless == true) &&
+		(g_ViewManager->CreateOffscreenFramebuffer() == false))
+	{
+		return(EXIT_FAILURE);
+	}
 
-	// loop will keep running until the application is closed 
-	// or until an error has occurred
-	while (!glfwWindowShouldClose(g_Window))
+	// load the shader program saved by an earlier run, or compile
+	// it from the external GLSL files; the programs of the
+	// optional passes are started by PrepareScene()
+	g_ProgramCache = new ProgramCache();
+	g_ProgramCache->SetUseBinaries(!g_bNoProgramCache);
+	g_ProgramCache->EnableParallelCompile();
+	const ProgramCache::SHADER_STAGE sceneStages[] =
+	{
+		{ GL_VERTEX_SHADER, g_bReferenceShader ? "shaders/vertexShaderReference.glsl" : "shaders/vertexShader.glsl" },
+		{ GL_FRAGMENT_SHADER, "shaders/fragmentShader.glsl" }
+	};
+	g_sceneProgram = g_ProgramCache->Finish(sceneStages, 2);
+	if (g_sceneProgram == 0)
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		return(EXIT_FAILURE);
+	}
+	glUseProgram(g_sceneProgram);
 
-		// Clear the frame and z buffers
-		glClearColor(0.15f, 0.15f, 0.150f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// create the uniform buffers for the camera, lights and
+	// materials and attach them to the loaded shader program
+	GLint programID = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &programID);
+	g_SceneUniforms = new SceneUniforms();
+	if (g_SceneUniforms->Create(programID) == false)
+	{
+		return(EXIT_FAILURE);
+	}
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+	// denser spheres make the per-vertex cost measurable
+	if (g_sphereDetail > 0)
+	{
+		PrimitiveMeshes::SetSphereDetail(g_sphereDetail, g_sphereDetail / 2);
+	}
+	PrimitiveMeshes::SetPackedVertices(g_bPackedVertices);
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+	// try to create a new scene manager object and prepare the 3D scene
+	g_SceneManager = new SceneManager(g_ShaderManager, g_SceneUniforms, g_ProgramCache);
+	g_SceneManager->SetUseTextureCache(!g_bNoTextureCache);
+	g_SceneManager->SetSortDraws(!g_bNoDrawSort);
+	g_SceneManager->SetUseInstancing(!g_bNoInstancing);
+	g_SceneManager->SetUseMultiDraw(!g_bNoMultiDraw);
+	g_SceneManager->SetFrustumCulling(!g_bNoCulling);
+	g_SceneManager->SetGpuCulling(g_bGpuCulling);
+	g_SceneManager->SetLevelsOfDetail(!g_bNoLevelsOfDetail);
+	g_SceneManager->SetStaticBatching(!g_bNoStaticBatching);
+	g_SceneManager->SetDepthPrepass(g_bDepthPrepass);
+	g_SceneManager->SetOverdrawView(g_bOverdrawView);
+	g_SceneManager->SetWeightedBlend(g_bWeightedBlend);
+	g_SceneManager->SetShadows(!g_bNoShadows);
+	g_SceneManager->SetShadowKernelSize(g_shadowKernelSize);
+	if (g_SceneManager->LoadScene(g_sceneFile) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+	g_SceneManager->PrepareScene();
 
+	if (g_traceOutput != nullptr)
+	{
+		g_FrameTrace = new FrameTrace();
+		g_FrameTrace->SetThreadName("main");
+	}
+	if (g_bNoRenderThread == false)
+	{
+		g_RenderThread = new RenderThread();
+	}
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+	// a benchmark whose report cannot be written fails the run
+	bool bSucceeded = true;
+	if (g_lookupBenchmarkFrames > 0)
+	{
+		// time the per-frame state lookups without rendering
+		bSucceeded = RunLookupBenchmark();
+	}
+	else if (g_benchmarkFrames > 0)
+	{
+		// render the fixed camera path and report the frame times
+		bSucceeded = RunBenchmark();
+	}
+	else
+	{
+		// loop will keep running until the application is closed 
+		// or until an error has occurred
+		RunWindowLoop();
+	}
 
-		// query the latest GLFW events
-		glfwPollEvents();
+	if (NULL != g_RenderThread)
+	{
+		delete g_RenderThread;
+		g_RenderThread = NULL;
+	}
+	if (NULL != g_FrameTrace)
+	{
+		g_FrameTrace->Write(g_traceOutput);
+		delete g_FrameTrace;
+		g_FrameTrace = NULL;
 	}
 
 	// clear the allocated manager objects from memory
@@ -120,19 +357,757 @@ int main(int argc, char* argv[])
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
+	if (NULL != g_ProgramCache)
+	{
+		delete g_ProgramCache;
+		g_ProgramCache = NULL;
+	}
+	if (0 != g_sceneProgram)
+	{
+		glDeleteProgram(g_sceneProgram);
+		g_sceneProgram = 0;
+	}
 	if (NULL != g_ViewManager)
 	{
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_SceneUniforms)
+	{
+		delete g_SceneUniforms;
+		g_SceneUniforms = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
+	// Terminates the program
+	exit(bSucceeded ? EXIT_SUCCESS : EXIT_FAILURE); 
+}
+
+/***********************************************************
+ *	ParseCommandLine()
+ *
+ *  This function is used to read the command line options.
+ *    --headless        render offscreen without a window
+ *    --bench N         render N frames along a fixed camera
+ *                      path and report the frame times
+ *    --bench-lookups N time N frames of material and
+ *                      texture lookups by tag and by handle
+ *    --bench-transforms N  time composing N model matrices
+ *                      with glm and the batch kernels
+ *    --bench-out FILE  write the benchmark report to FILE
+ *    --bake-textures   bake the compressed texture cache
+ *                      and exit
+ *    --no-texture-cache  load uncompressed textures
+ *    --no-draw-sort    draw in scene file order
+ *    --no-instancing   one draw call per object
+ *    --no-multi-draw   one instanced call per batch instead
+ *                      of multi-draw indirect
+ *    --no-culling      draw objects outside the view too
+ *    --gpu-culling     cull in a compute shader that writes
+ *                      the multi-draw commands
+ *    --no-lod          draw every object with its finest
+ *                      detail level
+ *    --no-static-batching  draw the objects that never move
+ *                      one by one instead of from batches
+ *                      baked into world space
+ *    --depth-prepass   draw the opaque depth first, then
+ *                      shade with an equal depth test
+ *    --overdraw        show how many fragments each pixel
+ *                      draws, brighter is more
+ *    --oit             blend transparent objects with
+ *                      weighted blended order-independent
+ *                      transparency instead of sorting
+ *    --no-shadows      light without the shadow atlas
+ *    --shadow-pcf N    filter shadows with N x N taps
+ *    --no-render-thread  render on the main thread between
+ *                      the input polls
+ *    --trace FILE      write a Chrome trace of the main and
+ *                      render threads to FILE
+ *    --on-demand       only draw when the camera or the
+ *                      window changed
+ *    --idle-refresh S  draw at least every S seconds in the
+ *                      on-demand loop, 0 for never
+ *    --reference-shader  invert the model matrix per vertex
+ *                      instead of using the normal matrices
+ *                      computed on the CPU
+ *    --no-program-cache  compile the shader programs
+ *                      instead of loading the binaries
+ *                      saved by an earlier run
+ *    --packed-vertices store normals in 10 bits per axis
+ *                      and texture coordinates as half
+ *                      floats
+ *    --sphere-detail N draw spheres with N segments around
+ *                      and N / 2 rings
+ *    --scene FILE      draw the text or compiled scene FILE
+ *    --compile-scene IN OUT  compile the text scene IN
+ *                      into OUT and exit
+ *    --generate-scene N OUT  add N stress objects to the
+ *                      scene and write it to OUT, text or
+ *                      compiled by extension, and exit
+ *    --generate-lights N  also add N point lights to the
+ *                      generated scene
+ *    --generate-glass N  also add N overlapping transparent
+ *                      objects to the generated scene
+ ***********************************************************/
+bool ParseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			g_bHeadless = true;
+		}
+		else if ((strcmp(argv[i], "--bench") == 0) && (i + 1 < argc))
+		{
+			g_benchmarkFrames = atoi(argv[++i]);
+			if (g_benchmarkFrames <= 0)
+			{
+				std::cerr << "--bench expects a positive frame count" << std::endl;
+				return false;
+			}
+		}
+		else if ((strcmp(argv[i], "--bench-lookups") == 0) && (i + 1 < argc))
+		{
+			g_lookupBenchmarkFrames = atoi(argv[++i]);
+			if (g_lookupBenchmarkFrames <= 0)
+			{
+				std::cerr << "--bench-lookups expects a positive frame count" << std::endl;
+				return false;
+			}
+		}
+		else if ((strcmp(argv[i], "--bench-transforms") == 0) && (i + 1 < argc))
+		{
+			g_transformBenchmarkCount = atoi(argv[++i]);
+			if (g_transformBenchmarkCount <= 0)
+			{
+				std::cerr << "--bench-transforms expects a positive transform count" << std::endl;
+				return false;
+			}
+		}
+		else if ((strcmp(argv[i], "--bench-out") == 0) && (i + 1 < argc))
+		{
+			g_benchmarkOutput = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bake-textures") == 0)
+		{
+			g_bBakeTextures = true;
+		}
+		else if (strcmp(argv[i], "--no-texture-cache") == 0)
+		{
+			g_bNoTextureCache = true;
+		}
+		else if (strcmp(argv[i], "--no-draw-sort") == 0)
+		{
+			g_bNoDrawSort = true;
+		}
+		else if (strcmp(argv[i], "--no-instancing") == 0)
+		{
+			g_bNoInstancing = true;
+		}
+		else if (strcmp(argv[i], "--no-multi-draw") == 0)
+		{
+			g_bNoMultiDraw = true;
+		}
+		else if (strcmp(argv[i], "--no-culling") == 0)
+		{
+			g_bNoCulling = true;
+		}
+		else if (strcmp(argv[i], "--gpu-culling") == 0)
+		{
+			g_bGpuCulling = true;
+		}
+		else if (strcmp(argv[i], "--no-lod") == 0)
+		{
+			g_bNoLevelsOfDetail = true;
+		}
+		else if (strcmp(argv[i], "--no-static-batching") == 0)
+		{
+			g_bNoStaticBatching = true;
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			g_bDepthPrepass = true;
+		}
+		else if (strcmp(argv[i], "--overdraw") == 0)
+		{
+			g_bOverdrawView = true;
+		}
+		else if (strcmp(argv[i], "--oit") == 0)
+		{
+			g_bWeightedBlend = true;
+		}
+		else if (strcmp(argv[i], "--no-shadows") == 0)
+		{
+			g_bNoShadows = true;
+		}
+		else if ((strcmp(argv[i], "--shadow-pcf") == 0) && (i + 1 < argc))
+		{
+			g_shadowKernelSize = atoi(argv[++i]);
+			if (g_shadowKernelSize <= 0)
+			{
+				std::cerr << "--shadow-pcf expects a positive kernel size" << std::endl;
+				return false;
+			}
+		}
+		else if (strcmp(argv[i], "--no-render-thread") == 0)
+		{
+			g_bNoRenderThread = true;
+		}
+		else if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc))
+		{
+			g_traceOutput = argv[++i];
+		}
+		else if (strcmp(argv[i], "--on-demand") == 0)
+		{
+			g_bOnDemand = true;
+		}
+		else if ((strcmp(argv[i], "--idle-refresh") == 0) && (i + 1 < argc))
+		{
+			g_idleRefreshSeconds = atof(argv[++i]);
+			if (g_idleRefreshSeconds < 0.0)
+			{
+				std::cerr << "--idle-refresh expects a time of 0 seconds or more" << std::endl;
+				return false;
+			}
+		}
+		else if (strcmp(argv[i], "--reference-shader") == 0)
+		{
+			g_bReferenceShader = true;
+		}
+		else if (strcmp(argv[i], "--no-program-cache") == 0)
+		{
+			g_bNoProgramCache = true;
+		}
+		else if (strcmp(argv[i], "--packed-vertices") == 0)
+		{
+			g_bPackedVertices = true;
+		}
+		else if ((strcmp(argv[i], "--sphere-detail") == 0) && (i + 1 < argc))
+		{
+			g_sphereDetail = atoi(argv[++i]);
+			if (g_sphereDetail < 4)
+			{
+				std::cerr << "--sphere-detail expects at least 4 segments" << std::endl;
+				return false;
+			}
+		}
+		else if ((strcmp(argv[i], "--scene") == 0) && (i + 1 < argc))
+		{
+			g_sceneFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--compile-scene") == 0) && (i + 2 < argc))
+		{
+			g_compileSceneInput = argv[++i];
+			g_compileSceneOutput = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--generate-scene") == 0) && (i + 2 < argc))
+		{
+			g_generateSceneObjects = atoi(argv[++i]);
+			g_generateSceneOutput = argv[++i];
+			if (g_generateSceneObjects <= 0)
+			{
+				std::cerr << "--generate-scene expects a positive object count" << std::endl;
+				return false;
+			}
+		}
+		else if ((strcmp(argv[i], "--generate-lights") == 0) && (i + 1 < argc))
+		{
+			g_generateSceneLights = atoi(argv[++i]);
+			if (g_generateSceneLights <= 0)
+			{
+				std::cerr << "--generate-lights expects a positive light count" << std::endl;
+				return false;
+			}
+		}
+		else if ((strcmp(argv[i], "--generate-glass") == 0) && (i + 1 < argc))
+		{
+			g_generateSceneGlass = atoi(argv[++i]);
+			if (g_generateSceneGlass <= 0)
+			{
+				std::cerr << "--generate-glass expects a positive object count" << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			std::cerr << "Unknown or incomplete option: " << argv[i] << std::endl;
+			std::cerr << "Usage: " << argv[0] << " [--headless] [--bench N] [--bench-lookups N] [--bench-transforms N]"
+				<< " [--bench-out FILE]"
+				<< " [--bake-textures] [--no-texture-cache] [--no-draw-sort] [--no-instancing] [--no-culling]"
+				<< " [--no-multi-draw] [--gpu-culling] [--no-lod] [--no-static-batching] [--depth-prepass] [--overdraw] [--oit]"
+				<< " [--no-shadows] [--shadow-pcf N] [--no-render-thread] [--trace FILE]"
+				<< " [--on-demand] [--idle-refresh S]"
+				<< " [--reference-shader] [--no-program-cache] [--packed-vertices] [--sphere-detail N]"
+				<< " [--scene FILE] [--compile-scene IN OUT] [--generate-scene N OUT]"
+				<< " [--generate-lights N] [--generate-glass N]" << std::endl;
+			return false;
+		}
+	}
+
+	// a headless run has nothing to show, so it always benchmarks
+	if ((g_bHeadless == true) && (g_benchmarkFrames == 0) && (g_lookupBenchmarkFrames == 0))
+	{
+		g_benchmarkFrames = DEFAULT_BENCHMARK_FRAMES;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *	CaptureFrame()
+ *
+ *  This function is used to poll the input and move the
+ *  camera.  It runs on the main thread and makes no GL
+ *  calls.
+ ***********************************************************/
+void CaptureFrame(int frameIndex)
+{
+	FrameTrace::Scope scope(g_FrameTrace, "input and camera", frameIndex);
+
+	// query the latest GLFW events
+	glfwPollEvents();
+
+	// convert from 3D object space to 2D view
+	g_ViewManager->PrepareSceneView();
+}
+
+/***********************************************************
+ *	SubmitFrame()
+ *
+ *  This function is used to fill a snapshot with the
+ *  camera and the culled, sorted scene of the frame, then
+ *  hand it to the render thread, or render it right away
+ *  without one.  The preparation runs on the main thread,
+ *  so it overlaps the render thread drawing the frames
+ *  before it.
+ ***********************************************************/
+void SubmitFrame(int frameIndex)
+{
+	RenderThread::FRAME_SNAPSHOT& snapshot = (g_RenderThread != nullptr) ? g_RenderThread->AcquireSlot() : g_Snapshot;
+	snapshot.frameIndex = frameIndex;
+	snapshot.view = g_ViewManager->GetView();
+	snapshot.projection = g_ViewManager->GetProjection();
+	snapshot.viewPosition = g_ViewManager->GetViewPosition();
+	{
+		FrameTrace::Scope scope(g_FrameTrace, "cull and sort", frameIndex);
+		g_SceneManager->PrepareFrame(snapshot.view, snapshot.projection, snapshot.viewPosition, snapshot.prepared);
+	}
+
+	if (g_RenderThread != nullptr)
+	{
+		g_RenderThread->Submit();
+	}
+	else
+	{
+		RenderSnapshot(snapshot);
+	}
+}
+
+/***********************************************************
+ *	RenderSnapshot()
+ *
+ *  This function is used to render and present one frame
+ *  on the thread that owns the GL context.  The counters
+ *  are copied for the window title and, once the warm-up
+ *  is over, recorded by the benchmark.  The time to the
+ *  first frame is printed with the share spent building
+ *  shader programs, to compare a cold start, which
+ *  compiles them, with a warm one, which loads the
+ *  binaries.
+ ***********************************************************/
+void RenderSnapshot(const RenderThread::FRAME_SNAPSHOT& snapshot)
+{
+	bool bMeasured = ((g_FrameBenchmark != nullptr) && (snapshot.frameIndex >= BENCHMARK_WARMUP_FRAMES));
+	{
+		FrameTrace::Scope scope(g_FrameTrace, "render", snapshot.frameIndex);
+		if (bMeasured == true)
+		{
+			g_FrameBenchmark->BeginFrame();
+		}
+		if (g_UtilizationMeter != nullptr)
+		{
+			g_UtilizationMeter->BeginFrame();
+		}
+
+		// the view and projection matrices and the camera position
+		// (used for lighting) in a single write of the camera block
+		g_SceneUniforms->SetCamera(snapshot.view, snapshot.projection, snapshot.viewPosition);
+		RenderFrame(snapshot.prepared);
+
+		if (g_UtilizationMeter != nullptr)
+		{
+			g_UtilizationMeter->EndFrame();
+		}
+		const SceneManager::RENDER_COUNTERS& counters = g_SceneManager->GetRenderCounters();
+		{
+			std::lock_guard<std::mutex> lock(g_TitleCountersMutex);
+			g_TitleCounters = counters;
+		}
+		if (bMeasured == true)
+		{
+			// state changes made and skipped by this frame
+			g_FrameBenchmark->SetCounter("draws", counters.draws);
+			g_FrameBenchmark->SetCounter("draw_calls", counters.drawCalls);
+			g_FrameBenchmark->SetCounter("material_binds", counters.materialBinds);
+			g_FrameBenchmark->SetCounter("material_binds_avoided", counters.materialBindsAvoided);
+			g_FrameBenchmark->SetCounter("texture_binds", counters.textureBinds);
+			g_FrameBenchmark->SetCounter("texture_binds_avoided", counters.textureBindsAvoided);
+			g_FrameBenchmark->SetCounter("mesh_binds", counters.meshBinds);
+			g_FrameBenchmark->SetCounter("mesh_binds_avoided", counters.meshBindsAvoided);
+			g_FrameBenchmark->SetCounter("cull_nodes_tested", counters.cullNodesTested);
+			g_FrameBenchmark->SetCounter("cull_objects_tested", counters.cullObjectsTested);
+			g_FrameBenchmark->SetCounter("objects_culled", counters.objectsCulled);
+			g_FrameBenchmark->SetCounter("indices", counters.indicesSubmitted);
+			g_FrameBenchmark->SetCounter("cluster_light_references", counters.clusterLightReferences);
+			g_FrameBenchmark->SetCounter("depth_prepass_samples", counters.depthPrepassSamples);
+			g_FrameBenchmark->SetCounter("shaded_samples", counters.shadedSamples);
+			g_FrameBenchmark->SetCounter("shadow_map_updates", counters.shadowMapUpdates);
+			g_FrameBenchmark->SetCounter("static_batches", counters.staticBatches);
+			g_FrameBenchmark->EndFrame();
+		}
+	}
+
+	FrameTrace::Scope scope(g_FrameTrace, "present", snapshot.frameIndex);
+	if (g_bHeadless == true)
+	{
+		// nothing is presented, but the commands still must be submitted
+		glFlush();
+	}
+	else
+	{
+		// Flips the the back buffer with the front buffer every frame.
+		glfwSwapBuffers(g_Window);
+	}
+
+	if (snapshot.frameIndex == 0)
+	{
+		std::chrono::duration<double, std::milli> startup = std::chrono::steady_clock::now() - g_startupTime;
+		const ProgramCache::CACHE_STATS& stats = g_ProgramCache->GetStats();
+		std::cout << "INFO: First frame presented after " << startup.count() << " ms; shader programs took "
+			<< stats.milliseconds << " ms, " << stats.programsLoaded << " loaded from the binary cache, "
+			<< stats.programsCompiled << " compiled ("
+			<< ((stats.programsCompiled == 0) ? "warm" : "cold") << " start)" << std::endl;
+	}
+}
+
+/***********************************************************
+ *	RenderFrame()
+ *
+ *  This function is used to clear the render target and
+ *  draw one prepared frame of the 3D scene.
+ ***********************************************************/
+void RenderFrame(const SceneManager::PREPARED_FRAME& prepared)
+{
+	// Enable z-depth
+	glEnable(GL_DEPTH_TEST);
+
+	// Clear the frame and z buffers, the overdraw view adds
+	// up from black
+	if (g_bOverdrawView == true)
+	{
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	else
+	{
+		glClearColor(0.15f, 0.15f, 0.150f, 1.0f);
+	}
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// refresh the 3D scene
+	g_SceneManager->RenderScene(prepared);
+}
+
+/***********************************************************
+ *	RunWindowLoop()
+ *
+ *  This function is used to run the window until it is
+ *  closed.  With the render thread, the main thread only
+ *  waits for a free snapshot slot a few milliseconds at a
+ *  time, so the input stays polled while a frame is slow,
+ *  and a snapshot still waiting is replaced by a newer one.
+ *
+ *  The on-demand loop skips frames the view manager has not
+ *  asked for and sleeps in glfwWaitEvents() until the next
+ *  event or idle refresh.  The CPU and GPU utilization of
+ *  either loop is shown in the title and printed at exit.
+ ***********************************************************/
+void RunWindowLoop()
+{
+	UtilizationMeter utilizationMeter;
+	g_UtilizationMeter = &utilizationMeter;
+
+	if (g_RenderThread != nullptr)
+	{
+		g_RenderThread->Start(g_Window, RenderSnapshot, g_FrameTrace);
+	}
+
+	int frameIndex = 0;
+	double lastRedraw = glfwGetTime();
+	while (!glfwWindowShouldClose(g_Window))
+	{
+		if (g_RenderThread != nullptr)
+		{
+			FrameTrace::Scope scope(g_FrameTrace, "wait for slot", frameIndex);
+			g_RenderThread->WaitForFreeSlot(INPUT_POLL_SECONDS);
+		}
+		CaptureFrame(frameIndex);
+
+		double now = glfwGetTime();
+		bool bRedraw = (g_ViewManager->TakeRedrawRequest() == true);
+		if ((g_bOnDemand == false) ||
+			((g_idleRefreshSeconds > 0.0) && (now - lastRedraw >= g_idleRefreshSeconds)))
+		{
+			bRedraw = true;
+		}
+
+		if (bRedraw == true)
+		{
+			SubmitFrame(frameIndex);
+			lastRedraw = now;
+			frameIndex++;
+		}
+		else
+		{
+			FrameTrace::Scope scope(g_FrameTrace, "wait for events", frameIndex);
+			if (g_idleRefreshSeconds > 0.0)
+			{
+				glfwWaitEventsTimeout(lastRedraw + g_idleRefreshSeconds - now);
+			}
+			else
+			{
+				glfwWaitEvents();
+			}
+		}
+		UpdateWindowTitle();
+	}
+
+	if (g_RenderThread != nullptr)
+	{
+		g_RenderThread->Stop();
+	}
+
+	UtilizationMeter::UTILIZATION utilization = utilizationMeter.GetTotal();
+	std::cout << "INFO: " << (g_bOnDemand ? "On-demand" : "Continuous") << " redraw drew "
+		<< frameIndex << " frames in " << utilization.seconds << " s, CPU "
+		<< utilization.cpuPercent << "% of a core, GPU " << utilization.gpuPercent << "% busy" << std::endl;
+	g_UtilizationMeter = nullptr;
+}
+
+/***********************************************************
+ *	UpdateWindowTitle()
+ *
+ *  This function is used to show the draw, state change and
+ *  culling counts of the last frame after the window title.
+ *  The title only changes a few times per second so the
+ *  numbers stay readable.
+ ***********************************************************/
+void UpdateWindowTitle()
+{
+	static double lastUpdate = 0.0;
+	double now = glfwGetTime();
+	if (now - lastUpdate < TITLE_UPDATE_SECONDS)
+	{
+		return;
+	}
+	lastUpdate = now;
+
+	SceneManager::RENDER_COUNTERS counters;
+	{
+		std::lock_guard<std::mutex> lock(g_TitleCountersMutex);
+		counters = g_TitleCounters;
+	}
+	UtilizationMeter::UTILIZATION utilization = g_UtilizationMeter->TakeSample();
+	std::ostringstream title;
+	title.precision(1);
+	title << std::fixed << WINDOW_TITLE
+		<< " | cpu " << utilization.cpuPercent << "%"
+		<< " | gpu " << utilization.gpuPercent << "%"
+		<< " | draws " << counters.draws
+		<< " | calls " << counters.drawCalls
+		<< " | indices " << counters.indicesSubmitted
+		<< " | culled " << counters.objectsCulled
+		<< " | lights " << counters.pointLights
+		<< " | samples " << counters.shadedSamples
+		<< " | lod";
+	for (int level = 0; level < PrimitiveMeshes::LOD_COUNT; level++)
+	{
+		title << " " << counters.levelDraws[level];
+	}
+	glfwSetWindowTitle(g_Window, title.str().c_str());
+}
+
+/***********************************************************
+ *	RunBenchmark()
+ *
+ *  This function is used to render the benchmark frames
+ *  along the fixed camera path and write the CPU and GPU
+ *  frame time statistics as JSON.  The render thread gets
+ *  every frame in order; the main thread waits for a free
+ *  slot instead of replacing a waiting snapshot.  Returns
+ *  false when the report file cannot be written.
+ ***********************************************************/
+bool RunBenchmark()
+{
+	FrameBenchmark benchmark(g_benchmarkFrames);
+	g_FrameBenchmark = &benchmark;
+
+	// measure the render cost, not the display refresh rate
+	if (g_bHeadless == false)
+	{
+		glfwSwapInterval(0);
+	}
+
+	if (g_RenderThread != nullptr)
+	{
+		g_RenderThread->Start(g_Window, RenderSnapshot, g_FrameTrace);
+	}
+
+	int totalFrames = BENCHMARK_WARMUP_FRAMES + g_benchmarkFrames;
+	for (int frame = 0; frame < totalFrames; frame++)
+	{
+		// the camera path always starts at the first measured frame
+		g_ViewManager->SetCameraPathPose(
+			frame - BENCHMARK_WARMUP_FRAMES, g_benchmarkFrames);
+
+		if (g_RenderThread != nullptr)
+		{
+			FrameTrace::Scope scope(g_FrameTrace, "wait for slot", frame);
+			while (g_RenderThread->WaitForFreeSlot(INPUT_POLL_SECONDS) == false)
+			{
+				glfwPollEvents();
+			}
+		}
+		CaptureFrame(frame);
+		SubmitFrame(frame);
+	}
+
+	// the benchmark reads its timer queries with the context
+	if (g_RenderThread != nullptr)
+	{
+		g_RenderThread->Stop();
+	}
+	glFinish();
+	benchmark.Finish();
+	g_FrameBenchmark = nullptr;
+
+	if (g_benchmarkOutput != nullptr)
+	{
+		std::ofstream reportFile(g_benchmarkOutput);
+		if (!reportFile)
+		{
+			std::cout << "Could not write the benchmark report to " << g_benchmarkOutput << std::endl;
+			return(false);
+		}
+		benchmark.WriteReport(reportFile, g_bHeadless);
+		std::cout << "INFO: Benchmark report written to " << g_benchmarkOutput << std::endl;
+	}
+	else
+	{
+		benchmark.WriteReport(std::cout, g_bHeadless);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *	RunLookupBenchmark()
+ *
+ *  This function is used to time the material and texture
+ *  lookups of the prepared scene and write the per-frame
+ *  costs as JSON.  Returns false when the report file
+ *  cannot be written.
+ ***********************************************************/
+bool RunLookupBenchmark()
+{
+	if (g_benchmarkOutput != nullptr)
+	{
+		std::ofstream reportFile(g_benchmarkOutput);
+		if (!reportFile)
+		{
+			std::cout << "Could not write the benchmark report to " << g_benchmarkOutput << std::endl;
+			return(false);
+		}
+		g_SceneManager->BenchmarkStateLookups(g_lookupBenchmarkFrames, reportFile);
+		std::cout << "INFO: Benchmark report written to " << g_benchmarkOutput << std::endl;
+	}
+	else
+	{
+		g_SceneManager->BenchmarkStateLookups(g_lookupBenchmarkFrames, std::cout);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *	RunTransformBenchmark()
+ *
+ *  This function is used to time building model matrices
+ *  with glm and with the batch kernels and write the
+ *  per-transform costs as JSON.  Returns false when the
+ *  report file cannot be written.
+ ***********************************************************/
+bool RunTransformBenchmark()
+{
+	if (g_benchmarkOutput != nullptr)
+	{
+		std::ofstream reportFile(g_benchmarkOutput);
+		if (!reportFile)
+		{
+			std::cout << "Could not write the benchmark report to " << g_benchmarkOutput << std::endl;
+			return(false);
+		}
+		TransformBatch::Benchmark(g_transformBenchmarkCount, reportFile);
+		std::cout << "INFO: Benchmark report written to " << g_benchmarkOutput << std::endl;
+	}
+	else
+	{
+		TransformBatch::Benchmark(g_transformBenchmarkCount, std::cout);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *	ConvertSceneFile()
+ *
+ *  This function is used to compile a text scene into the
+ *  binary form, or to add stress objects to the scene and
+ *  write the result.
+ ***********************************************************/
+bool ConvertSceneFile()
+{
+	SceneFile sceneFile;
+	const char* input = (g_compileSceneInput != nullptr) ? g_compileSceneInput : g_sceneFile;
+	const char* output = (g_compileSceneOutput != nullptr) ? g_compileSceneOutput : g_generateSceneOutput;
+
+	if (sceneFile.Load(input) == false)
+	{
+		return false;
+	}
+	if (g_generateSceneObjects > 0)
+	{
+		sceneFile.AddStressObjects(g_generateSceneObjects);
+	}
+	if (g_generateSceneLights > 0)
+	{
+		sceneFile.AddStressLights(g_generateSceneLights);
+	}
+	if (g_generateSceneGlass > 0)
+	{
+		sceneFile.AddStressGlass(g_generateSceneGlass);
+	}
+	if (sceneFile.Save(output) == false)
+	{
+		return false;
+	}
+
+	std::cout << "INFO: Wrote " << sceneFile.GetRecordCount() << " draws and "
+		<< sceneFile.GetPointLightCount() << " point lights to " << output << std::endl;
+	return(true);
 }
 
 /***********************************************************
@@ -144,7 +1119,19 @@ bool InitializeGLFW()
 {
 	// GLFW: initialize and configure library
 	// --------------------------------------
-	glfwInit();
+#ifdef GLFW_PLATFORM_NULL
+	// headless rendering does not need a window system, so
+	// select the null platform (GLFW 3.4 and newer)
+	if (g_bHeadless == true)
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
+	if (glfwInit() == GLFW_FALSE)
+	{
+		std::cerr << "Failed to initialize GLFW" << std::endl;
+		return false;
+	}
 
 #ifdef __APPLE__
 	// set the version of OpenGL and profile to use
@@ -175,6 +1162,14 @@ bool InitializeGLEW()
 
 	// try to initialize the GLEW library
 	GLEWInitResult = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// a GLX build of GLEW reports this for surfaceless EGL contexts
+	// even though the core entry points were loaded
+	if ((g_bHeadless == true) && (GLEW_ERROR_NO_GLX_DISPLAY == GLEWInitResult))
+	{
+		GLEWInitResult = GLEW_OK;
+	}
+#endif
 	if (GLEW_OK != GLEWInitResult)
 	{
 		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
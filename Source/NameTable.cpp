@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// NameTable.cpp
+// =============
+// map tag strings to integer handles with an open-addressing hash table
+//
+//  Used at scene preparation time to turn material and texture tags
+//  into handles, so the render loop never compares strings.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "NameTable.h"
+
+// declaration of global variables
+namespace
+{
+	// slot count of a new table, must be a power of two
+	const size_t INITIAL_SLOT_COUNT = 16;
+}
+
+/***********************************************************
+ *  NameTable()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+NameTable::NameTable()
+{
+	m_count = 0;
+	Clear();
+}
+
+/***********************************************************
+ *  HashName()
+ *
+ *  This method is used for computing the 32-bit FNV-1a hash
+ *  of a name.  The value 0 is reserved for empty slots.
+ ***********************************************************/
+uint32_t NameTable::HashName(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	for (const unsigned char* p = reinterpret_cast<const unsigned char*>(name); *p != 0; p++)
+	{
+		hash ^= *p;
+		hash *= 16777619u;
+	}
+
+	return((hash != 0) ? hash : 1);
+}
+
+/***********************************************************
+ *  FindSlot()
+ *
+ *  This method is used for probing the slot array for a
+ *  name.  The table is never more than half full, so the
+ *  probe always ends at the name or at an empty slot.
+ ***********************************************************/
+size_t NameTable::FindSlot(const char* name, uint32_t hash) const
+{
+	size_t mask = m_slots.size() - 1;
+	size_t index = hash & mask;
+
+	while (m_slots[index].hash != 0)
+	{
+		if ((m_slots[index].hash == hash) && (m_slots[index].name.compare(name) == 0))
+		{
+			break;
+		}
+		index = (index + 1) & mask;
+	}
+
+	return(index);
+}
+
+/***********************************************************
+ *  Insert()
+ *
+ *  This method is used for registering the handle of a
+ *  name.  The first registration of a name is kept.
+ ***********************************************************/
+bool NameTable::Insert(const char* name, int handle)
+{
+	// keep the load factor at or below one half
+	if (static_cast<size_t>(m_count + 1) * 2 > m_slots.size())
+	{
+		Grow();
+	}
+
+	uint32_t hash = HashName(name);
+	size_t index = FindSlot(name, hash);
+	if (m_slots[index].hash != 0)
+	{
+		return(false);
+	}
+
+	m_slots[index].hash = hash;
+	m_slots[index].handle = handle;
+	m_slots[index].name = name;
+	m_count++;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for getting the handle registered
+ *  for a name.
+ ***********************************************************/
+int NameTable::Find(const char* name) const
+{
+	const NAME_SLOT& slot = m_slots[FindSlot(name, HashName(name))];
+
+	return((slot.hash != 0) ? slot.handle : -1);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every registered name.
+ ***********************************************************/
+void NameTable::Clear()
+{
+	NAME_SLOT emptySlot;
+	emptySlot.hash = 0;
+	emptySlot.handle = -1;
+
+	m_slots.assign(INITIAL_SLOT_COUNT, emptySlot);
+	m_count = 0;
+}
+
+/***********************************************************
+ *  Grow()
+ *
+ *  This method is used for doubling the number of slots and
+ *  placing every registered name into the larger array.
+ ***********************************************************/
+void NameTable::Grow()
+{
+	std::vector<NAME_SLOT> oldSlots;
+	oldSlots.swap(m_slots);
+
+	NAME_SLOT emptySlot;
+	emptySlot.hash = 0;
+	emptySlot.handle = -1;
+	m_slots.assign(oldSlots.size() * 2, emptySlot);
+
+	for (size_t i = 0; i < oldSlots.size(); i++)
+	{
+		if (oldSlots[i].hash != 0)
+		{
+			size_t index = FindSlot(oldSlots[i].name.c_str(), oldSlots[i].hash);
+			m_slots[index].hash = oldSlots[i].hash;
+			m_slots[index].handle = oldSlots[i].handle;
+			m_slots[index].name.swap(oldSlots[i].name);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// NameTable.h
+// ===========
+// map tag strings to integer handles with an open-addressing hash table
+//
+//  Used at scene preparation time to turn material and texture tags
+//  into handles, so the render loop never compares strings.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  NameTable
+ *
+ *  This class stores name to handle pairs in a power-of-two
+ *  sized slot array with linear probing.  Lookups take a
+ *  plain C string, so resolving a string literal does not
+ *  construct a temporary std::string.
+ ***********************************************************/
+class NameTable
+{
+public:
+	// constructor
+	NameTable();
+
+	// add a name, false if it is already registered
+	bool Insert(const char* name, int handle);
+	// handle registered for a name, -1 if there is none
+	int Find(const char* name) const;
+	// remove every name
+	void Clear();
+
+	// number of registered names
+	int GetCount() const { return m_count; }
+
+private:
+	struct NAME_SLOT
+	{
+		uint32_t hash;
+		int handle;
+		std::string name;
+	};
+
+	// FNV-1a hash of a name, never 0 so 0 can mark empty slots
+	static uint32_t HashName(const char* name);
+	// slot holding a name, or the empty slot where it belongs
+	size_t FindSlot(const char* name, uint32_t hash) const;
+	// double the slot array and reinsert every name
+	void Grow();
+
+	// hash slots, a slot with a hash of 0 is empty
+	std::vector<NAME_SLOT> m_slots;
+	// number of occupied slots
+	int m_count;
+};
@@ -0,0 +1,952 @@
+///////////////////////////////////////////////////////////////////////////////
+// PrimitiveMeshes.cpp
+// ===================
+// generate the basic meshes and draw them one at a time or instanced
+//
+//  Every basic shape is an indexed triangle list packed into one shared
+//  vertex buffer and one index buffer behind a single vertex array, and
+//  is drawn by its first index and base vertex.  The vertex array also
+//  reads a per-instance buffer of model matrices, colors and material
+//  and texture indices, so many copies of a shape can be drawn with a
+//  single call.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PrimitiveMeshes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// segments around the round shapes
+	const int ROUND_SLICES = 36;
+	// segments around and rings from pole to pole of the sphere
+	int g_sphereSlices = ROUND_SLICES;
+	int g_sphereStacks = 18;
+	// segments around the tube of the torus
+	const int TORUS_SIDES = 18;
+	// tube radius of the torus
+	const float TORUS_THICKNESS = 0.1f;
+
+	// fewest segments a coarse level may have around a shape,
+	// around the torus tube and from pole to pole
+	const int MIN_ROUND_SLICES = 8;
+	const int MIN_TORUS_SIDES = 4;
+	const int MIN_SPHERE_STACKS = 4;
+
+	// store packed normals and half-float texture coordinates
+	bool g_bPackedVertices = false;
+
+	// instances the instance buffer starts with room for
+	const int INITIAL_INSTANCE_CAPACITY = 1024;
+
+	/***********************************************************
+	 *  LevelSegments()
+	 *
+	 *  Get the segment count of a detail level, halving the
+	 *  full count for each level down to a minimum.
+	 ***********************************************************/
+	int LevelSegments(int segments, int level, int minimum)
+	{
+		int levelSegments = segments >> level;
+		return((levelSegments > minimum) ? levelSegments : minimum);
+	}
+
+	/***********************************************************
+	 *  PackNormal()
+	 *
+	 *  Pack a unit normal into three signed normalized 10-bit
+	 *  fields, x in the lowest bits.
+	 ***********************************************************/
+	uint32_t PackNormal(const float normal[3])
+	{
+		uint32_t packed = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float value = std::min(std::max(normal[axis], -1.0f), 1.0f);
+			int32_t field = static_cast<int32_t>(std::floor(value * 511.0f + 0.5f));
+			packed |= (static_cast<uint32_t>(field) & 0x3FF) << (10 * axis);
+		}
+
+		return(packed);
+	}
+
+	/***********************************************************
+	 *  FloatToHalf()
+	 *
+	 *  Convert a float to a half float, rounding to nearest.
+	 *  Values too large become infinity and values too small
+	 *  become zero or a denormal.
+	 ***********************************************************/
+	uint16_t FloatToHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x007FFFFF;
+
+		if (exponent >= 31)
+		{
+			return(static_cast<uint16_t>(sign | 0x7C00));
+		}
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+			{
+				return(sign);
+			}
+			// denormal, shift in the implicit leading one
+			mantissa |= 0x00800000;
+			uint32_t shift = static_cast<uint32_t>(14 - exponent);
+			uint32_t half = (mantissa + (1u << (shift - 1))) >> shift;
+			return(static_cast<uint16_t>(sign | half));
+		}
+
+		// a mantissa that rounds up carries into the exponent
+		uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+		half += (mantissa >> 12) & 1;
+		return(static_cast<uint16_t>(sign | half));
+	}
+
+	/***********************************************************
+	 *  AddVertex()
+	 *
+	 *  Append one vertex to a mesh, returns its index.
+	 ***********************************************************/
+	GLuint AddVertex(PrimitiveMeshes::MESH_DATA& mesh,
+		float x, float y, float z, float nx, float ny, float nz, float u, float v)
+	{
+		PrimitiveMeshes::VERTEX vertex = { { x, y, z }, { nx, ny, nz }, { u, v } };
+		mesh.vertices.push_back(vertex);
+
+		return(static_cast<GLuint>(mesh.vertices.size() - 1));
+	}
+
+	/***********************************************************
+	 *  AddQuad()
+	 *
+	 *  Append a flat rectangle centered on (cx, cy, cz) that
+	 *  spans the half-extents U and V.  U x V must point along
+	 *  the normal so the triangles wind counter-clockwise.
+	 ***********************************************************/
+	void AddQuad(PrimitiveMeshes::MESH_DATA& mesh, const float center[3], const float U[3], const float V[3], const float normal[3])
+	{
+		const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+
+		GLuint first = static_cast<GLuint>(mesh.vertices.size());
+		for (int i = 0; i < 4; i++)
+		{
+			float s = corners[i][0];
+			float t = corners[i][1];
+			AddVertex(mesh,
+				center[0] + s * U[0] + t * V[0],
+				center[1] + s * U[1] + t * V[1],
+				center[2] + s * U[2] + t * V[2],
+				normal[0], normal[1], normal[2],
+				(s + 1.0f) / 2.0f, (t + 1.0f) / 2.0f);
+		}
+
+		const GLuint quadIndices[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i < 6; i++)
+		{
+			mesh.indices.push_back(first + quadIndices[i]);
+		}
+	}
+
+	/***********************************************************
+	 *  AddGridIndices()
+	 *
+	 *  Append the triangles of a grid of (columns + 1) by
+	 *  (rows + 1) vertices stored row by row.  Columns run
+	 *  counter-clockwise when seen from outside and rows run
+	 *  upwards.
+	 ***********************************************************/
+	void AddGridIndices(PrimitiveMeshes::MESH_DATA& mesh, GLuint first, int columns, int rows)
+	{
+		GLuint rowLength = static_cast<GLuint>(columns + 1);
+		for (int row = 0; row < rows; row++)
+		{
+			for (int column = 0; column < columns; column++)
+			{
+				GLuint v0 = first + row * rowLength + column;
+				GLuint v1 = v0 + 1;
+				GLuint v2 = v1 + rowLength;
+				GLuint v3 = v0 + rowLength;
+
+				mesh.indices.push_back(v0);
+				mesh.indices.push_back(v1);
+				mesh.indices.push_back(v2);
+				mesh.indices.push_back(v0);
+				mesh.indices.push_back(v2);
+				mesh.indices.push_back(v3);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  AddSide()
+	 *
+	 *  Append the side of a cylinder, cone or tapered cylinder
+	 *  around the Y axis, from radius bottomRadius at y = 0
+	 *  to radius topRadius at y = 1.
+	 ***********************************************************/
+	void AddSide(PrimitiveMeshes::MESH_DATA& mesh, float bottomRadius, float topRadius, int slices)
+	{
+		// the slope of the side tilts the normals
+		float normalY = bottomRadius - topRadius;
+		float normalLength = std::sqrt(1.0f + normalY * normalY);
+
+		GLuint first = static_cast<GLuint>(mesh.vertices.size());
+		for (int row = 0; row <= 1; row++)
+		{
+			float radius = (row == 0) ? bottomRadius : topRadius;
+			for (int column = 0; column <= slices; column++)
+			{
+				float angle = 2.0f * PI * column / slices;
+				float s = std::sin(angle);
+				float c = std::cos(angle);
+				AddVertex(mesh,
+					radius * s, static_cast<float>(row), radius * c,
+					s / normalLength, normalY / normalLength, c / normalLength,
+					static_cast<float>(column) / slices, static_cast<float>(row));
+			}
+		}
+		AddGridIndices(mesh, first, slices, 1);
+	}
+
+	/***********************************************************
+	 *  AddCap()
+	 *
+	 *  Append a disc of the passed in radius at height y,
+	 *  facing up or down.
+	 ***********************************************************/
+	void AddCap(PrimitiveMeshes::MESH_DATA& mesh, float radius, float y, bool bFacingUp, int slices)
+	{
+		float normalY = bFacingUp ? 1.0f : -1.0f;
+
+		GLuint center = AddVertex(mesh, 0.0f, y, 0.0f, 0.0f, normalY, 0.0f, 0.5f, 0.5f);
+		for (int column = 0; column <= slices; column++)
+		{
+			float angle = 2.0f * PI * column / slices;
+			float s = std::sin(angle);
+			float c = std::cos(angle);
+			AddVertex(mesh, radius * s, y, radius * c, 0.0f, normalY, 0.0f, 0.5f + 0.5f * s, 0.5f + 0.5f * c);
+		}
+
+		for (int column = 0; column < slices; column++)
+		{
+			GLuint current = center + 1 + column;
+			mesh.indices.push_back(center);
+			mesh.indices.push_back(bFacingUp ? current : current + 1);
+			mesh.indices.push_back(bFacingUp ? current + 1 : current);
+		}
+	}
+}
+
+// both are read by GL as-is, so they must not be padded
+static_assert(sizeof(PrimitiveMeshes::PACKED_VERTEX) == 20, "PACKED_VERTEX does not match the packed vertex format");
+static_assert(sizeof(PrimitiveMeshes::DRAW_COMMAND) == 20, "DRAW_COMMAND does not match DrawElementsIndirectCommand");
+
+/***********************************************************
+ *  PrimitiveMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PrimitiveMeshes::PrimitiveMeshes()
+{
+	for (int i = 0; i < MESH_SLOT_COUNT; i++)
+	{
+		m_meshes[i].firstIndex = 0;
+		m_meshes[i].indexCount = 0;
+		m_meshes[i].baseVertex = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			m_meshes[i].boundsMinimum[axis] = 0.0f;
+			m_meshes[i].boundsMaximum[axis] = 0.0f;
+		}
+	}
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_instanceBuffer = 0;
+	m_instanceCapacity = 0;
+	m_commandBuffer = 0;
+	m_commandCapacity = 0;
+	m_boundVAO = 0;
+}
+
+/***********************************************************
+ *  ~PrimitiveMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PrimitiveMeshes::~PrimitiveMeshes()
+{
+	DestroyMeshes();
+}
+
+/***********************************************************
+ *  BuildMesh()
+ *
+ *  This method is used for generating the vertices and
+ *  triangle indices of a basic shape at a detail level.
+ *  Each level halves the segments of the one before it.
+ *  Triangles wind counter-clockwise when seen from outside.
+ ***********************************************************/
+void PrimitiveMeshes::BuildMesh(int meshID, int level, MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	int slices = LevelSegments(ROUND_SLICES, level, MIN_ROUND_SLICES);
+
+	switch (meshID)
+	{
+	case SceneGraph::MESH_BOX:
+	{
+		// center, U and V half-extents and normal of each face
+		const float faces[6][4][3] =
+		{
+			{ { 0.0f, 0.0f, 0.5f }, { 0.5f, 0.0f, 0.0f }, { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+			{ { 0.0f, 0.0f, -0.5f }, { -0.5f, 0.0f, 0.0f }, { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+			{ { 0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f, -0.5f }, { 0.0f, 0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+			{ { -0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.5f }, { 0.0f, 0.5f, 0.0f }, { -1.0f, 0.0f, 0.0f } },
+			{ { 0.0f, 0.5f, 0.0f }, { 0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f, -0.5f }, { 0.0f, 1.0f, 0.0f } },
+			{ { 0.0f, -0.5f, 0.0f }, { 0.5f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.5f }, { 0.0f, -1.0f, 0.0f } },
+		};
+		for (int i = 0; i < 6; i++)
+		{
+			AddQuad(mesh, faces[i][0], faces[i][1], faces[i][2], faces[i][3]);
+		}
+		break;
+	}
+	case SceneGraph::MESH_PLANE:
+	{
+		const float center[3] = { 0.0f, 0.0f, 0.0f };
+		const float U[3] = { 1.0f, 0.0f, 0.0f };
+		const float V[3] = { 0.0f, 0.0f, -1.0f };
+		const float normal[3] = { 0.0f, 1.0f, 0.0f };
+		AddQuad(mesh, center, U, V, normal);
+		break;
+	}
+	case SceneGraph::MESH_CYLINDER:
+		AddSide(mesh, 1.0f, 1.0f, slices);
+		AddCap(mesh, 1.0f, 1.0f, true, slices);
+		AddCap(mesh, 1.0f, 0.0f, false, slices);
+		break;
+	case SceneGraph::MESH_CONE:
+		AddSide(mesh, 1.0f, 0.0f, slices);
+		AddCap(mesh, 1.0f, 0.0f, false, slices);
+		break;
+	case SceneGraph::MESH_TAPERED_CYLINDER:
+		AddSide(mesh, 1.0f, 0.5f, slices);
+		AddCap(mesh, 0.5f, 1.0f, true, slices);
+		AddCap(mesh, 1.0f, 0.0f, false, slices);
+		break;
+	case SceneGraph::MESH_SPHERE:
+	{
+		int sphereSlices = LevelSegments(g_sphereSlices, level, MIN_ROUND_SLICES);
+		int sphereStacks = LevelSegments(g_sphereStacks, level, MIN_SPHERE_STACKS);
+
+		// rows run from the bottom pole up to the top pole
+		for (int row = 0; row <= sphereStacks; row++)
+		{
+			float polar = PI * (1.0f - static_cast<float>(row) / sphereStacks);
+			for (int column = 0; column <= sphereSlices; column++)
+			{
+				float angle = 2.0f * PI * column / sphereSlices;
+				float x = std::sin(polar) * std::sin(angle);
+				float y = std::cos(polar);
+				float z = std::sin(polar) * std::cos(angle);
+				AddVertex(mesh, x, y, z, x, y, z,
+					static_cast<float>(column) / sphereSlices, static_cast<float>(row) / sphereStacks);
+			}
+		}
+		AddGridIndices(mesh, 0, sphereSlices, sphereStacks);
+		break;
+	}
+	case SceneGraph::MESH_TORUS:
+	{
+		int sides = LevelSegments(TORUS_SIDES, level, MIN_TORUS_SIDES);
+
+		// the ring lies in the XY plane, rows run around the tube
+		for (int row = 0; row <= sides; row++)
+		{
+			float tubeAngle = 2.0f * PI * row / sides;
+			for (int column = 0; column <= slices; column++)
+			{
+				float angle = 2.0f * PI * column / slices;
+				float nx = std::cos(tubeAngle) * std::cos(angle);
+				float ny = std::cos(tubeAngle) * std::sin(angle);
+				float nz = std::sin(tubeAngle);
+				AddVertex(mesh,
+					std::cos(angle) + TORUS_THICKNESS * nx,
+					std::sin(angle) + TORUS_THICKNESS * ny,
+					TORUS_THICKNESS * nz,
+					nx, ny, nz,
+					static_cast<float>(column) / slices, static_cast<float>(row) / sides);
+			}
+		}
+		AddGridIndices(mesh, 0, slices, sides);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/***********************************************************
+ *  SetSphereDetail()
+ *
+ *  This method is used for changing the tessellation of
+ *  the sphere.  Dense spheres make the vertex shader cost
+ *  measurable in benchmarks.
+ ***********************************************************/
+void PrimitiveMeshes::SetSphereDetail(int slices, int stacks)
+{
+	g_sphereSlices = (slices >= 3) ? slices : 3;
+	g_sphereStacks = (stacks >= 2) ? stacks : 2;
+}
+
+/***********************************************************
+ *  SetPackedVertices()
+ *
+ *  This method is used for choosing the vertex format.
+ *  Packed vertices store the normal in 10 bits per axis
+ *  and the texture coordinates as half floats, which is
+ *  plenty for unit normals and UVs between 0 and 1.
+ ***********************************************************/
+void PrimitiveMeshes::SetPackedVertices(bool bPacked)
+{
+	g_bPackedVertices = bPacked;
+}
+
+/***********************************************************
+ *  GetVertexSize()
+ *
+ *  This method is used for getting the bytes one vertex
+ *  takes in the vertex buffer with the chosen format.
+ ***********************************************************/
+int PrimitiveMeshes::GetVertexSize()
+{
+	return((g_bPackedVertices == true) ? sizeof(PACKED_VERTEX) : sizeof(VERTEX));
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method is used for building every basic shape into
+ *  the shared vertex and index buffers.  The indices of a
+ *  shape start at 0 and the draw adds its base vertex, so
+ *  the shapes are built exactly as they would be alone.
+ *  A single vertex array reads the vertex attributes from
+ *  the shared buffer and the instance attributes from the
+ *  instance buffer.
+ ***********************************************************/
+void PrimitiveMeshes::LoadMeshes()
+{
+	DestroyMeshes();
+
+	std::vector<VERTEX> vertices;
+	std::vector<GLuint> indices;
+	MESH_DATA mesh;
+	for (int slot = 0; slot < MESH_SLOT_COUNT; slot++)
+	{
+		int meshID = slot / LOD_COUNT;
+		int level = slot % LOD_COUNT;
+		if (level >= GetLevelCount(meshID))
+		{
+			continue;
+		}
+		BuildMesh(meshID, level, mesh);
+
+		GL_MESH& glMesh = m_meshes[slot];
+		glMesh.firstIndex = static_cast<GLuint>(indices.size());
+		glMesh.indexCount = static_cast<GLsizei>(mesh.indices.size());
+		glMesh.baseVertex = static_cast<GLint>(vertices.size());
+		for (int axis = 0; axis < 3; axis++)
+		{
+			glMesh.boundsMinimum[axis] = mesh.vertices[0].position[axis];
+			glMesh.boundsMaximum[axis] = mesh.vertices[0].position[axis];
+		}
+		for (size_t i = 1; i < mesh.vertices.size(); i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				glMesh.boundsMinimum[axis] = std::min(glMesh.boundsMinimum[axis], mesh.vertices[i].position[axis]);
+				glMesh.boundsMaximum[axis] = std::max(glMesh.boundsMaximum[axis], mesh.vertices[i].position[axis]);
+			}
+		}
+
+		vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+	}
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	if (g_bPackedVertices == true)
+	{
+		std::vector<PACKED_VERTEX> packedVertices(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				packedVertices[i].position[axis] = vertices[i].position[axis];
+			}
+			packedVertices[i].normal = PackNormal(vertices[i].normal);
+			packedVertices[i].textureCoordinate[0] = FloatToHalf(vertices[i].textureCoordinate[0]);
+			packedVertices[i].textureCoordinate[1] = FloatToHalf(vertices[i].textureCoordinate[1]);
+		}
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PACKED_VERTEX) * packedVertices.size(), &packedVertices[0], GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(POSITION_LOCATION);
+		glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(PACKED_VERTEX),
+			reinterpret_cast<const void*>(offsetof(PACKED_VERTEX, position)));
+		glEnableVertexAttribArray(NORMAL_LOCATION);
+		glVertexAttribPointer(NORMAL_LOCATION, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PACKED_VERTEX),
+			reinterpret_cast<const void*>(offsetof(PACKED_VERTEX, normal)));
+		glEnableVertexAttribArray(TEXCOORD_LOCATION);
+		glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PACKED_VERTEX),
+			reinterpret_cast<const void*>(offsetof(PACKED_VERTEX, textureCoordinate)));
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, sizeof(VERTEX) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(POSITION_LOCATION);
+		glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX),
+			reinterpret_cast<const void*>(offsetof(VERTEX, position)));
+		glEnableVertexAttribArray(NORMAL_LOCATION);
+		glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX),
+			reinterpret_cast<const void*>(offsetof(VERTEX, normal)));
+		glEnableVertexAttribArray(TEXCOORD_LOCATION);
+		glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(VERTEX),
+			reinterpret_cast<const void*>(offsetof(VERTEX, textureCoordinate)));
+	}
+
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(INSTANCE_DATA) * INITIAL_INSTANCE_CAPACITY, NULL, GL_STREAM_DRAW);
+	m_instanceCapacity = INITIAL_INSTANCE_CAPACITY;
+
+	// instance attributes advance once per instance
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+		glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+	}
+	glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+	glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+	glEnableVertexAttribArray(INSTANCE_UVSCALE_LOCATION);
+	glVertexAttribDivisor(INSTANCE_UVSCALE_LOCATION, 1);
+	glEnableVertexAttribArray(INSTANCE_INDICES_LOCATION);
+	glVertexAttribDivisor(INSTANCE_INDICES_LOCATION, 1);
+	for (int column = 0; column < 3; column++)
+	{
+		glEnableVertexAttribArray(INSTANCE_NORMAL_MATRIX_LOCATION + column);
+		glVertexAttribDivisor(INSTANCE_NORMAL_MATRIX_LOCATION + column, 1);
+	}
+	SetInstanceOffset(0);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_boundVAO = 0;
+}
+
+/***********************************************************
+ *  GetBounds()
+ *
+ *  This method is used for getting the local-space box
+ *  around the vertices of a shape.  Every detail level
+ *  spans the same box as the finest one.
+ ***********************************************************/
+void PrimitiveMeshes::GetBounds(int meshID, float minimum[3], float maximum[3]) const
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		minimum[axis] = m_meshes[GetSlot(meshID, 0)].boundsMinimum[axis];
+		maximum[axis] = m_meshes[GetSlot(meshID, 0)].boundsMaximum[axis];
+	}
+}
+
+/***********************************************************
+ *  DestroyMeshes()
+ *
+ *  This method is used for freeing the vertex array, the
+ *  shared buffers, the instance buffer and the command
+ *  buffer.
+ ***********************************************************/
+void PrimitiveMeshes::DestroyMeshes()
+{
+	for (int i = 0; i < MESH_SLOT_COUNT; i++)
+	{
+		m_meshes[i].firstIndex = 0;
+		m_meshes[i].indexCount = 0;
+		m_meshes[i].baseVertex = 0;
+	}
+
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+
+	if (m_instanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_instanceBuffer);
+	}
+	m_instanceBuffer = 0;
+	m_instanceCapacity = 0;
+
+	if (m_commandBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_commandBuffer);
+	}
+	m_commandBuffer = 0;
+	m_commandCapacity = 0;
+	m_boundVAO = 0;
+}
+
+/***********************************************************
+ *  SetInstanceOffset()
+ *
+ *  This method is used for pointing the instance attributes
+ *  of the bound vertex array at an instance of the instance
+ *  buffer.  GL 3.3 has no base instance for instanced draws,
+ *  so each batch moves the attribute offsets instead.
+ ***********************************************************/
+void PrimitiveMeshes::SetInstanceOffset(int firstInstance)
+{
+	size_t base = sizeof(INSTANCE_DATA) * static_cast<size_t>(firstInstance);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	for (int column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+			reinterpret_cast<const void*>(base + offsetof(INSTANCE_DATA, modelMatrix) + sizeof(float) * 4 * column));
+	}
+	glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+		reinterpret_cast<const void*>(base + offsetof(INSTANCE_DATA, color)));
+	glVertexAttribPointer(INSTANCE_UVSCALE_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+		reinterpret_cast<const void*>(base + offsetof(INSTANCE_DATA, UVscale)));
+	glVertexAttribIPointer(INSTANCE_INDICES_LOCATION, 2, GL_INT, sizeof(INSTANCE_DATA),
+		reinterpret_cast<const void*>(base + offsetof(INSTANCE_DATA, materialIndex)));
+	for (int column = 0; column < 3; column++)
+	{
+		glVertexAttribPointer(INSTANCE_NORMAL_MATRIX_LOCATION + column, 3, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+			reinterpret_cast<const void*>(base + offsetof(INSTANCE_DATA, normalMatrix) + sizeof(float) * 3 * column));
+	}
+}
+
+/***********************************************************
+ *  BindMeshes()
+ *
+ *  This method is used for binding the shared vertex array,
+ *  skipping the call when it is already bound.  Every shape
+ *  draws from it, so it is bound once per frame.
+ ***********************************************************/
+void PrimitiveMeshes::BindMeshes()
+{
+	if (m_vao != m_boundVAO)
+	{
+		glBindVertexArray(m_vao);
+		m_boundVAO = m_vao;
+	}
+}
+
+/***********************************************************
+ *  GetSlot()
+ *
+ *  This method is used for getting the index in m_meshes
+ *  of a shape's detail level.  Shapes with fewer levels use
+ *  their coarsest level for the missing ones.
+ ***********************************************************/
+int PrimitiveMeshes::GetSlot(int meshID, int level)
+{
+	int levelCount = GetLevelCount(meshID);
+	if (level >= levelCount)
+	{
+		level = levelCount - 1;
+	}
+	if (level < 0)
+	{
+		level = 0;
+	}
+
+	return(meshID * LOD_COUNT + level);
+}
+
+/***********************************************************
+ *  GetLevelCount()
+ *
+ *  This method is used for getting the number of detail
+ *  levels of a shape.  Flat-sided shapes have nothing to
+ *  simplify, so they only have one.
+ ***********************************************************/
+int PrimitiveMeshes::GetLevelCount(int meshID)
+{
+	if ((meshID == SceneGraph::MESH_BOX) || (meshID == SceneGraph::MESH_PLANE))
+	{
+		return(1);
+	}
+
+	return(LOD_COUNT);
+}
+
+/***********************************************************
+ *  GetIndexCount()
+ *
+ *  This method is used for getting the number of indices
+ *  one draw of a shape's detail level submits.
+ ***********************************************************/
+int PrimitiveMeshes::GetIndexCount(int meshID, int level) const
+{
+	if ((meshID < 0) || (meshID >= SceneGraph::MESH_COUNT))
+	{
+		return(0);
+	}
+
+	return(m_meshes[GetSlot(meshID, level)].indexCount);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one copy of a shape at
+ *  a detail level, 0 being the finest.  The shader takes
+ *  the transform, color and material from the per-draw
+ *  uniforms.
+ ***********************************************************/
+void PrimitiveMeshes::DrawMesh(int meshID, int level)
+{
+	if ((meshID < 0) || (meshID >= SceneGraph::MESH_COUNT))
+	{
+		return;
+	}
+
+	const GL_MESH& glMesh = m_meshes[GetSlot(meshID, level)];
+	BindMeshes();
+	glDrawElementsBaseVertex(GL_TRIANGLES, glMesh.indexCount, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(sizeof(GLuint) * glMesh.firstIndex), glMesh.baseVertex);
+}
+
+/***********************************************************
+ *  UploadInstances()
+ *
+ *  This method is used for writing the instances of the
+ *  frame into the instance buffer.  The old contents are
+ *  orphaned, so the upload does not wait for draws of the
+ *  previous frame that still read them.
+ ***********************************************************/
+void PrimitiveMeshes::UploadInstances(const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	if (instanceCount > m_instanceCapacity)
+	{
+		// grow by half again to limit reallocation
+		m_instanceCapacity = instanceCount + instanceCount / 2;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(INSTANCE_DATA) * m_instanceCapacity, NULL, GL_STREAM_DRAW);
+	if (instanceCount > 0)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(INSTANCE_DATA) * instanceCount, pInstances);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DrawMeshInstanced()
+ *
+ *  This method is used for drawing a range of the uploaded
+ *  instances as copies of one shape's detail level in a
+ *  single call.
+ ***********************************************************/
+void PrimitiveMeshes::DrawMeshInstanced(int meshID, int level, int firstInstance, int instanceCount)
+{
+	if ((meshID < 0) || (meshID >= SceneGraph::MESH_COUNT) || (instanceCount <= 0))
+	{
+		return;
+	}
+
+	const GL_MESH& glMesh = m_meshes[GetSlot(meshID, level)];
+	BindMeshes();
+	SetInstanceOffset(firstInstance);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, glMesh.indexCount, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(sizeof(GLuint) * glMesh.firstIndex), instanceCount, glMesh.baseVertex);
+}
+
+/***********************************************************
+ *  IsMultiDrawSupported()
+ *
+ *  This method is used for checking that the context has
+ *  multi-draw indirect and base instances.  Without base
+ *  instances every command would read the instance
+ *  attributes from the start of the instance buffer.
+ ***********************************************************/
+bool PrimitiveMeshes::IsMultiDrawSupported()
+{
+	if (GLEW_VERSION_4_3)
+	{
+		return(true);
+	}
+
+	return(GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+/***********************************************************
+ *  GetDrawCommand()
+ *
+ *  This method is used for getting the indirect command
+ *  that draws a range of the uploaded instances as copies
+ *  of one shape's detail level.
+ ***********************************************************/
+PrimitiveMeshes::DRAW_COMMAND PrimitiveMeshes::GetDrawCommand(int meshID, int level, int firstInstance, int instanceCount) const
+{
+	DRAW_COMMAND command = { 0, 0, 0, 0, 0 };
+	if ((meshID < 0) || (meshID >= SceneGraph::MESH_COUNT))
+	{
+		return(command);
+	}
+
+	const GL_MESH& glMesh = m_meshes[GetSlot(meshID, level)];
+	command.count = static_cast<GLuint>(glMesh.indexCount);
+	command.instanceCount = static_cast<GLuint>(instanceCount);
+	command.firstIndex = glMesh.firstIndex;
+	command.baseVertex = glMesh.baseVertex;
+	command.baseInstance = static_cast<GLuint>(firstInstance);
+
+	return(command);
+}
+
+/***********************************************************
+ *  UploadDrawCommands()
+ *
+ *  This method is used for writing the indirect commands
+ *  of the frame into the command buffer, orphaning the old
+ *  contents like UploadInstances().
+ ***********************************************************/
+void PrimitiveMeshes::UploadDrawCommands(const DRAW_COMMAND* pCommands, int commandCount)
+{
+	if (m_commandBuffer == 0)
+	{
+		glGenBuffers(1, &m_commandBuffer);
+	}
+	if (commandCount > m_commandCapacity)
+	{
+		// grow by half again to limit reallocation
+		m_commandCapacity = commandCount + commandCount / 2;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DRAW_COMMAND) * m_commandCapacity, NULL, GL_STREAM_DRAW);
+	if (commandCount > 0)
+	{
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DRAW_COMMAND) * commandCount, pCommands);
+	}
+}
+
+/***********************************************************
+ *  MultiDrawIndirect()
+ *
+ *  This method is used for submitting a range of the
+ *  uploaded commands with one call.  Each command reads
+ *  its instances from its base instance, so the instance
+ *  attributes stay pointed at the start of the buffer.
+ ***********************************************************/
+void PrimitiveMeshes::MultiDrawIndirect(int firstCommand, int commandCount)
+{
+	if ((commandCount <= 0) || (m_commandBuffer == 0))
+	{
+		return;
+	}
+
+	BindMeshes();
+	SetInstanceOffset(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(sizeof(DRAW_COMMAND) * static_cast<size_t>(firstCommand)),
+		commandCount, sizeof(DRAW_COMMAND));
+}
+
+/***********************************************************
+ *  IsDrawCountSupported()
+ *
+ *  This method is used for checking that the context can
+ *  read the number of indirect commands to draw from a
+ *  buffer, which is part of GL 4.6.
+ ***********************************************************/
+bool PrimitiveMeshes::IsDrawCountSupported()
+{
+	return(GLEW_VERSION_4_6 == GL_TRUE);
+}
+
+/***********************************************************
+ *  ClearDrawCommands()
+ *
+ *  This method is used for making room for the commands of
+ *  the frame and zeroing them.  A zeroed command has no
+ *  instances, so commands the GPU leaves unwritten draw
+ *  nothing.
+ ***********************************************************/
+void PrimitiveMeshes::ClearDrawCommands(int commandCount)
+{
+	if (m_commandBuffer == 0)
+	{
+		glGenBuffers(1, &m_commandBuffer);
+	}
+	if (commandCount > m_commandCapacity)
+	{
+		// grow by half again to limit reallocation
+		m_commandCapacity = commandCount + commandCount / 2;
+	}
+
+	GLuint zero = 0;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DRAW_COMMAND) * m_commandCapacity, NULL, GL_STREAM_DRAW);
+	if (commandCount > 0)
+	{
+		glClearBufferSubData(GL_DRAW_INDIRECT_BUFFER, GL_R32UI, 0, sizeof(DRAW_COMMAND) * commandCount,
+			GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	}
+}
+
+/***********************************************************
+ *  MultiDrawIndirectCount()
+ *
+ *  This method is used for submitting the commands of a
+ *  range whose used length was written on the GPU, so the
+ *  unused commands at its end are not even read.
+ ***********************************************************/
+void PrimitiveMeshes::MultiDrawIndirectCount(int firstCommand, int maxCommandCount, GLuint parameterBuffer, GLintptr parameterOffset)
+{
+	if ((maxCommandCount <= 0) || (m_commandBuffer == 0))
+	{
+		return;
+	}
+
+	BindMeshes();
+	SetInstanceOffset(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBindBuffer(GL_PARAMETER_BUFFER, parameterBuffer);
+	glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(sizeof(DRAW_COMMAND) * static_cast<size_t>(firstCommand)),
+		parameterOffset, maxCommandCount, sizeof(DRAW_COMMAND));
+}
@@ -0,0 +1,213 @@
+///////////////////////////////////////////////////////////////////////////////
+// PrimitiveMeshes.h
+// =================
+// generate the basic meshes and draw them one at a time or instanced
+//
+//  Every basic shape is an indexed triangle list packed into one shared
+//  vertex buffer and one index buffer behind a single vertex array, and
+//  is drawn by its first index and base vertex.  The vertex array also
+//  reads a per-instance buffer of model matrices, colors and material
+//  and texture indices, so many copies of a shape can be drawn with a
+//  single call.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneGraph.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  PrimitiveMeshes
+ *
+ *  This class owns the geometry of the basic shapes.
+ *  The shapes have the sizes of the ShapeMeshes versions:
+ *  a unit box centered on the origin, a 2x2 plane, and a
+ *  cylinder, cone and tapered cylinder of radius 1 from
+ *  y = 0 to y = 1, a unit sphere and a torus of radius 1.
+ *  Round shapes come in several detail levels, so small
+ *  or distant objects can be drawn with fewer vertices.
+ ***********************************************************/
+class PrimitiveMeshes
+{
+public:
+	// detail levels of the round shapes, level 0 is the finest
+	enum
+	{
+		LOD_COUNT = 3
+	};
+
+	// vertex attribute locations of the scene shader
+	enum ATTRIBUTE_LOCATION
+	{
+		POSITION_LOCATION = 0,
+		NORMAL_LOCATION = 1,
+		TEXCOORD_LOCATION = 2,
+		// four consecutive locations, one per matrix column
+		INSTANCE_MODEL_LOCATION = 3,
+		INSTANCE_COLOR_LOCATION = 7,
+		INSTANCE_UVSCALE_LOCATION = 8,
+		INSTANCE_INDICES_LOCATION = 9,
+		// three consecutive locations, one per matrix column
+		INSTANCE_NORMAL_MATRIX_LOCATION = 10
+	};
+
+	struct VERTEX
+	{
+		float position[3];
+		float normal[3];
+		float textureCoordinate[2];
+	};
+
+	// vertex as stored in the vertex buffer when packing is on,
+	// 20 bytes instead of the 32 of VERTEX
+	struct PACKED_VERTEX
+	{
+		float position[3];
+		// signed normalized 10:10:10:2, the 2 bits unused
+		uint32_t normal;
+		// half floats
+		uint16_t textureCoordinate[2];
+	};
+
+	// per-instance attributes read by the vertex shader
+	struct INSTANCE_DATA
+	{
+		float modelMatrix[16];
+		// inverse transpose of the upper 3x3 of the model matrix
+		float normalMatrix[9];
+		float color[4];
+		float UVscale[2];
+		int32_t materialIndex;
+		// texture array layer, -1 draws with the color
+		int32_t textureLayer;
+		// keeps instances 16-byte aligned
+		float padding[3];
+	};
+
+	// one command of a multi-draw indirect call, laid out as
+	// the DrawElementsIndirectCommand that GL reads
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		// first instance of the instance buffer the command reads
+		GLuint baseInstance;
+	};
+
+	// CPU-side geometry of one shape
+	struct MESH_DATA
+	{
+		std::vector<VERTEX> vertices;
+		std::vector<GLuint> indices;
+	};
+
+	// constructor
+	PrimitiveMeshes();
+	// destructor
+	~PrimitiveMeshes();
+
+	// build every shape into the shared buffers
+	void LoadMeshes();
+	// free the vertex array and buffers
+	void DestroyMeshes();
+
+	// local-space box around a shape, valid after LoadMeshes()
+	void GetBounds(int meshID, float minimum[3], float maximum[3]) const;
+
+	// indices one draw of a shape's detail level submits
+	int GetIndexCount(int meshID, int level) const;
+
+	// draw one copy of a shape with the per-draw uniforms
+	void DrawMesh(int meshID, int level);
+	// write the instances of the frame into the instance buffer
+	void UploadInstances(const INSTANCE_DATA* pInstances, int instanceCount);
+	// draw instances [firstInstance, firstInstance + instanceCount)
+	// of the instance buffer as copies of a shape
+	void DrawMeshInstanced(int meshID, int level, int firstInstance, int instanceCount);
+
+	// true when the context can draw many meshes with one
+	// indirect call, each reading its own instances
+	static bool IsMultiDrawSupported();
+	// command drawing instances of a shape's detail level
+	DRAW_COMMAND GetDrawCommand(int meshID, int level, int firstInstance, int instanceCount) const;
+	// write the commands of the frame into the command buffer
+	void UploadDrawCommands(const DRAW_COMMAND* pCommands, int commandCount);
+	// submit commands [firstCommand, firstCommand + commandCount)
+	// of the command buffer with one call
+	void MultiDrawIndirect(int firstCommand, int commandCount);
+
+	// true when the number of commands drawn can come from a buffer
+	static bool IsDrawCountSupported();
+	// make room for the commands of the frame and set them all
+	// to draw nothing, for commands written on the GPU
+	void ClearDrawCommands(int commandCount);
+	GLuint GetCommandBuffer() const { return m_commandBuffer; }
+	// submit up to maxCommandCount commands from firstCommand,
+	// reading the number to draw from a parameter buffer
+	void MultiDrawIndirectCount(int firstCommand, int maxCommandCount, GLuint parameterBuffer, GLintptr parameterOffset);
+
+	// build the geometry of a shape at a detail level
+	static void BuildMesh(int meshID, int level, MESH_DATA& mesh);
+	// detail levels a shape has, 1 for the flat-sided shapes
+	static int GetLevelCount(int meshID);
+	// segments around and from pole to pole of the sphere,
+	// set before LoadMeshes()
+	static void SetSphereDetail(int slices, int stacks);
+	// store packed normals and half-float texture coordinates,
+	// set before LoadMeshes()
+	static void SetPackedVertices(bool bPacked);
+	// bytes one vertex takes in the vertex buffer
+	static int GetVertexSize();
+
+private:
+	// where a shape's detail level sits in the shared buffers
+	struct GL_MESH
+	{
+		// first index in the index buffer
+		GLuint firstIndex;
+		GLsizei indexCount;
+		// added to every index, the indices of a shape start at 0
+		GLint baseVertex;
+		// box around the vertices, for culling
+		float boundsMinimum[3];
+		float boundsMaximum[3];
+	};
+
+	// point the instance attributes of the bound vertex array
+	// at an instance of the instance buffer
+	void SetInstanceOffset(int firstInstance);
+	// bind the shared vertex array unless it is already bound
+	void BindMeshes();
+	// index in m_meshes of a shape's detail level
+	static int GetSlot(int meshID, int level);
+
+	enum
+	{
+		MESH_SLOT_COUNT = SceneGraph::MESH_COUNT * LOD_COUNT
+	};
+
+	// buffer ranges, LOD_COUNT slots per SceneGraph::MESH_ID
+	GL_MESH m_meshes[MESH_SLOT_COUNT];
+	// vertex array reading the shared buffers
+	GLuint m_vao;
+	// vertices and indices of every shape, one after another
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	// per-instance attributes
+	GLuint m_instanceBuffer;
+	// instances the instance buffer has room for
+	int m_instanceCapacity;
+	// multi-draw indirect commands, created on first upload
+	GLuint m_commandBuffer;
+	// commands the command buffer has room for
+	int m_commandCapacity;
+	// vertex array bound by the last draw, 0 when unknown
+	GLuint m_boundVAO;
+};
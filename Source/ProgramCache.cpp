@@ -0,0 +1,497 @@
+///////////////////////////////////////////////////////////////////////////////
+// ProgramCache.cpp
+// ================
+// build shader programs from a binary cache or in the background
+//
+//  A linked program is saved with glGetProgramBinary and loaded with
+//  glProgramBinary on the next launch, skipping compilation.  Cache
+//  files are keyed on a hash of the shader sources and the driver, and
+//  are rebuilt when either changes.  Programs that are compiled can be
+//  started early and linked on the driver's own threads, so they are
+//  ready by the time they are needed.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ProgramCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MAKE_DIRECTORY(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MAKE_DIRECTORY(path) mkdir(path, 0755)
+#endif
+
+// declaration of global variables
+namespace
+{
+	// identifies a program binary file
+	const char g_CacheMagic[4] = { 'B', 'P', 'R', 'G' };
+	// bump whenever the file layout changes
+	const uint32_t g_CacheVersion = 1;
+	// subdirectory next to the shader sources that holds the cache
+	const char* g_CacheDirectory = "cache";
+	// extension appended to the program name
+	const char* g_CacheExtension = ".bprog";
+	// lets the driver pick the number of compiler threads
+	const GLuint ANY_THREAD_COUNT = 0xFFFFFFFF;
+
+	// FNV-1a 64-bit parameters
+	const uint64_t g_FnvOffsetBasis = 14695981039346656037ULL;
+	const uint64_t g_FnvPrime = 1099511628211ULL;
+
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t binaryFormat;
+		uint32_t binaryBytes;
+	};
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  Continue an FNV-1a hash over a block of bytes.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t byteCount)
+	{
+		const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+		for (size_t i = 0; i < byteCount; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= g_FnvPrime;
+		}
+		return(hash);
+	}
+
+	/***********************************************************
+	 *  GetDriverString()
+	 *
+	 *  Read one of the strings naming the driver, empty when
+	 *  the context does not report it.
+	 ***********************************************************/
+	std::string GetDriverString(GLenum name)
+	{
+		const GLubyte* pText = glGetString(name);
+		return((pText != NULL) ? reinterpret_cast<const char*>(pText) : "");
+	}
+}
+
+/***********************************************************
+ *  ProgramCache()
+ *
+ *  The constructor for the class.  The GL context must be
+ *  current, since the driver strings are read here.
+ ***********************************************************/
+ProgramCache::ProgramCache()
+{
+	m_bUseBinaries = IsBinarySupported();
+	m_driver = GetDriverString(GL_VENDOR) + "\n" + GetDriverString(GL_RENDERER) + "\n" + GetDriverString(GL_VERSION);
+	m_stats.programsLoaded = 0;
+	m_stats.programsCompiled = 0;
+	m_stats.milliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~ProgramCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ProgramCache::~ProgramCache()
+{
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		for (size_t stage = 0; stage < m_pending[i].shaders.size(); stage++)
+		{
+			glDeleteShader(m_pending[i].shaders[stage]);
+		}
+		if (m_pending[i].program != 0)
+		{
+			glDeleteProgram(m_pending[i].program);
+		}
+	}
+	m_pending.clear();
+}
+
+/***********************************************************
+ *  IsBinarySupported()
+ *
+ *  This method is used for checking that the context can
+ *  save and load program binaries, part of GL 4.1.  Some
+ *  drivers have the entry points but no binary format.
+ ***********************************************************/
+bool ProgramCache::IsBinarySupported()
+{
+	if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+	{
+		return(false);
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return(formatCount > 0);
+}
+
+/***********************************************************
+ *  IsParallelCompileSupported()
+ *
+ *  This method is used for checking that the driver can
+ *  compile and link on threads of its own, through the KHR
+ *  extension or the ARB one it was promoted from.
+ ***********************************************************/
+bool ProgramCache::IsParallelCompileSupported()
+{
+	return(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile);
+}
+
+/***********************************************************
+ *  EnableParallelCompile()
+ *
+ *  This method is used for letting the driver compile and
+ *  link on as many threads as it likes.  The compile and
+ *  link calls then return at once, and only querying the
+ *  results waits, which Finish() puts off until the
+ *  program is needed.  Without the extension the driver
+ *  may still defer the work, but nothing is promised.
+ ***********************************************************/
+void ProgramCache::EnableParallelCompile()
+{
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(ANY_THREAD_COUNT);
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(ANY_THREAD_COUNT);
+	}
+}
+
+/***********************************************************
+ *  GetProgramName()
+ *
+ *  This method is used for naming a program after the file
+ *  names of its stages, e.g. vertexShader.glsl and
+ *  fragmentShader.glsl make
+ *  vertexShader.glsl+fragmentShader.glsl
+ ***********************************************************/
+std::string ProgramCache::GetProgramName(const SHADER_STAGE* pStages, int stageCount)
+{
+	std::string name;
+	for (int i = 0; i < stageCount; i++)
+	{
+		std::string filename = pStages[i].filename;
+		size_t separator = filename.find_last_of("/\\");
+		if (i > 0)
+		{
+			name += "+";
+		}
+		name += (separator == std::string::npos) ? filename : filename.substr(separator + 1);
+	}
+	return(name);
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This method is used for getting the cache file path of
+ *  a program, next to the source of its first stage, e.g.
+ *  shaders/cache/vertexShader.glsl+fragmentShader.glsl.bprog
+ ***********************************************************/
+std::string ProgramCache::GetCachePath(const SHADER_STAGE* pStages, int stageCount)
+{
+	std::string filename = pStages[0].filename;
+	size_t separator = filename.find_last_of("/\\");
+	std::string directory = (separator == std::string::npos) ? "" : filename.substr(0, separator + 1);
+
+	return(directory + g_CacheDirectory + "/" + GetProgramName(pStages, stageCount) + g_CacheExtension);
+}
+
+/***********************************************************
+ *  FindPending()
+ *
+ *  This method is used for finding a requested program by
+ *  name.  Only a handful of programs exist, so the list is
+ *  searched in order.
+ ***********************************************************/
+int ProgramCache::FindPending(const std::string& name) const
+{
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		if (m_pending[i].name == name)
+		{
+			return(static_cast<int>(i));
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  LoadBinary()
+ *
+ *  This method is used for loading the saved binary of a
+ *  program.  The file is rejected if it was saved from
+ *  other sources or by another driver, or if it is shorter
+ *  than its header claims, and the driver may still reject
+ *  a binary it no longer accepts.
+ ***********************************************************/
+bool ProgramCache::LoadBinary(PENDING_PROGRAM& pending)
+{
+	std::ifstream file(pending.cachePath.c_str(), std::ios::binary);
+	if (!file)
+	{
+		return(false);
+	}
+
+	CACHE_HEADER header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file ||
+		(memcmp(header.magic, g_CacheMagic, sizeof(g_CacheMagic)) != 0) ||
+		(header.version != g_CacheVersion) ||
+		(header.sourceHash != pending.sourceHash) ||
+		(header.binaryBytes == 0))
+	{
+		return(false);
+	}
+
+	// a damaged header must not size the allocation, so the
+	// binary has to fit in what is left of the file
+	std::streamoff binaryStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	if ((binaryStart < 0) || (fileSize < binaryStart) ||
+		(static_cast<uint64_t>(fileSize - binaryStart) < header.binaryBytes))
+	{
+		return(false);
+	}
+	file.seekg(binaryStart);
+
+	std::vector<char> binary(header.binaryBytes);
+	file.read(binary.data(), binary.size());
+	if (!file)
+	{
+		return(false);
+	}
+
+	glProgramBinary(pending.program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+	GLint status = GL_FALSE;
+	glGetProgramiv(pending.program, GL_LINK_STATUS, &status);
+	return(status == GL_TRUE);
+}
+
+/***********************************************************
+ *  SaveBinary()
+ *
+ *  This method is used for writing the binary of a linked
+ *  program to its cache file.  The data is written to a
+ *  temporary file first so an interrupted write never
+ *  leaves a truncated cache file behind.
+ ***********************************************************/
+void ProgramCache::SaveBinary(const PENDING_PROGRAM& pending)
+{
+	GLint binaryBytes = 0;
+	glGetProgramiv(pending.program, GL_PROGRAM_BINARY_LENGTH, &binaryBytes);
+	if (binaryBytes <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(static_cast<size_t>(binaryBytes));
+	GLsizei writtenBytes = 0;
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(pending.program, binaryBytes, &writtenBytes, &binaryFormat, binary.data());
+	if (writtenBytes <= 0)
+	{
+		return;
+	}
+
+	size_t separator = pending.cachePath.find_last_of("/\\");
+	if (separator != std::string::npos)
+	{
+		// fails harmlessly when the directory already exists
+		MAKE_DIRECTORY(pending.cachePath.substr(0, separator).c_str());
+	}
+
+	CACHE_HEADER header;
+	memcpy(header.magic, g_CacheMagic, sizeof(g_CacheMagic));
+	header.version = g_CacheVersion;
+	header.sourceHash = pending.sourceHash;
+	header.binaryFormat = binaryFormat;
+	header.binaryBytes = static_cast<uint32_t>(writtenBytes);
+
+	std::string temporaryPath = pending.cachePath + ".tmp";
+	{
+		std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), writtenBytes);
+		if (!file)
+		{
+			std::cout << "Could not write program cache:" << pending.cachePath << std::endl;
+			return;
+		}
+	}
+
+	std::remove(pending.cachePath.c_str());
+	std::rename(temporaryPath.c_str(), pending.cachePath.c_str());
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  This method is used for starting to build a program.
+ *  A cached binary is loaded right away; otherwise the
+ *  stages are compiled and linked without asking for the
+ *  results, so with parallel compilation the driver does
+ *  the work in the background.  The sources are hashed
+ *  with the driver strings to find a binary that is still
+ *  valid.
+ ***********************************************************/
+void ProgramCache::Request(const SHADER_STAGE* pStages, int stageCount)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	PENDING_PROGRAM pending;
+	pending.name = GetProgramName(pStages, stageCount);
+	if (FindPending(pending.name) >= 0)
+	{
+		return;
+	}
+	pending.cachePath = GetCachePath(pStages, stageCount);
+	pending.program = 0;
+
+	// read every stage before creating any GL object
+	std::vector<std::string> sources(stageCount);
+	uint64_t hash = HashBytes(g_FnvOffsetBasis, m_driver.data(), m_driver.size());
+	bool bRead = true;
+	for (int i = 0; (i < stageCount) && (bRead == true); i++)
+	{
+		std::ifstream file(pStages[i].filename);
+		if (!file)
+		{
+			std::cout << "Could not open shader:" << pStages[i].filename << std::endl;
+			bRead = false;
+			continue;
+		}
+		std::stringstream source;
+		source << file.rdbuf();
+		sources[i] = source.str();
+
+		hash = HashBytes(hash, &pStages[i].type, sizeof(pStages[i].type));
+		hash = HashBytes(hash, sources[i].data(), sources[i].size() + 1);
+		pending.filenames.push_back(pStages[i].filename);
+	}
+	pending.sourceHash = hash;
+
+	if (bRead == true)
+	{
+		pending.program = glCreateProgram();
+		if ((m_bUseBinaries == false) || (LoadBinary(pending) == false))
+		{
+			// a rejected binary can leave the program in any
+			// state, so compile into a fresh one
+			glDeleteProgram(pending.program);
+			pending.program = glCreateProgram();
+
+			for (int i = 0; i < stageCount; i++)
+			{
+				const char* pSource = sources[i].c_str();
+				GLuint shader = glCreateShader(pStages[i].type);
+				glShaderSource(shader, 1, &pSource, NULL);
+				glCompileShader(shader);
+				glAttachShader(pending.program, shader);
+				pending.shaders.push_back(shader);
+			}
+			if (m_bUseBinaries == true)
+			{
+				glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			}
+			glLinkProgram(pending.program);
+		}
+	}
+	m_pending.push_back(pending);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_stats.milliseconds += elapsed.count();
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for handing over the program of the
+ *  stages, requesting it first if needed.  For a compiled
+ *  program this waits for the driver, prints the logs of
+ *  any stage that failed and saves the binary for the next
+ *  launch.  The caller owns the returned program.
+ ***********************************************************/
+GLuint ProgramCache::Finish(const SHADER_STAGE* pStages, int stageCount)
+{
+	Request(pStages, stageCount);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	int index = FindPending(GetProgramName(pStages, stageCount));
+	PENDING_PROGRAM pending = m_pending[index];
+	m_pending.erase(m_pending.begin() + index);
+
+	if ((pending.program != 0) && (pending.shaders.empty() == true))
+	{
+		m_stats.programsLoaded++;
+	}
+	else if (pending.program != 0)
+	{
+		bool bBuilt = true;
+		for (size_t i = 0; i < pending.shaders.size(); i++)
+		{
+			GLint status = GL_FALSE;
+			glGetShaderiv(pending.shaders[i], GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE)
+			{
+				char log[1024];
+				glGetShaderInfoLog(pending.shaders[i], sizeof(log), NULL, log);
+				std::cout << "Shader " << pending.filenames[i] << " failed to compile:\n" << log << std::endl;
+				bBuilt = false;
+			}
+		}
+
+		GLint status = GL_FALSE;
+		glGetProgramiv(pending.program, GL_LINK_STATUS, &status);
+		if ((bBuilt == true) && (status != GL_TRUE))
+		{
+			char log[1024];
+			glGetProgramInfoLog(pending.program, sizeof(log), NULL, log);
+			std::cout << "Program " << pending.name << " failed to link:\n" << log << std::endl;
+			bBuilt = false;
+		}
+
+		for (size_t i = 0; i < pending.shaders.size(); i++)
+		{
+			glDetachShader(pending.program, pending.shaders[i]);
+			glDeleteShader(pending.shaders[i]);
+		}
+
+		if (bBuilt == true)
+		{
+			if (m_bUseBinaries == true)
+			{
+				SaveBinary(pending);
+			}
+			m_stats.programsCompiled++;
+		}
+		else
+		{
+			glDeleteProgram(pending.program);
+			pending.program = 0;
+		}
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_stats.milliseconds += elapsed.count();
+
+	return(pending.program);
+}
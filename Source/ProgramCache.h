@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+// ProgramCache.h
+// ==============
+// build shader programs from a binary cache or in the background
+//
+//  A linked program is saved with glGetProgramBinary and loaded with
+//  glProgramBinary on the next launch, skipping compilation.  Cache
+//  files are keyed on a hash of the shader sources and the driver, and
+//  are rebuilt when either changes.  Programs that are compiled can be
+//  started early and linked on the driver's own threads, so they are
+//  ready by the time they are needed.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ProgramCache
+ *
+ *  This class owns the programs between Request(), which
+ *  starts building one, and Finish(), which waits for it
+ *  and hands it over.  Requesting the same stages again
+ *  does nothing, so a program can be requested early and
+ *  finished where it is used.  Programs that are never
+ *  finished are freed with the cache.
+ ***********************************************************/
+class ProgramCache
+{
+public:
+	// one shader stage of a program
+	struct SHADER_STAGE
+	{
+		GLenum type;
+		const char* filename;
+	};
+
+	// programs handed out so far and the time spent waiting
+	struct CACHE_STATS
+	{
+		int programsLoaded;
+		int programsCompiled;
+		double milliseconds;
+	};
+
+	// constructor
+	ProgramCache();
+	// destructor
+	~ProgramCache();
+
+	// true when the context can save and load program binaries
+	static bool IsBinarySupported();
+	// true when the driver can compile and link on its own threads
+	static bool IsParallelCompileSupported();
+
+	// enable or disable reading and writing the cache files,
+	// before the first Request(); stays off without support
+	void SetUseBinaries(bool bUseBinaries) { m_bUseBinaries = bUseBinaries && IsBinarySupported(); }
+	// let the driver compile in the background when it can
+	void EnableParallelCompile();
+
+	// start building the program of the stages unless it is
+	// already being built
+	void Request(const SHADER_STAGE* pStages, int stageCount);
+	// wait for the program of the stages and hand it to the
+	// caller, 0 when it failed to build
+	GLuint Finish(const SHADER_STAGE* pStages, int stageCount);
+
+	const CACHE_STATS& GetStats() const { return m_stats; }
+
+private:
+	// a requested program that was not finished yet
+	struct PENDING_PROGRAM
+	{
+		std::string name;
+		std::string cachePath;
+		uint64_t sourceHash;
+		GLuint program;
+		// compiled stages, empty when loaded from the cache
+		std::vector<GLuint> shaders;
+		std::vector<std::string> filenames;
+	};
+
+	// name of a program, from the file names of its stages
+	static std::string GetProgramName(const SHADER_STAGE* pStages, int stageCount);
+	// path of the cache file of a program
+	static std::string GetCachePath(const SHADER_STAGE* pStages, int stageCount);
+	// load a saved binary into the program, false if missing,
+	// stale or rejected by the driver
+	bool LoadBinary(PENDING_PROGRAM& pending);
+	// save the binary of a linked program
+	void SaveBinary(const PENDING_PROGRAM& pending);
+	// index in m_pending of a program, -1 if not requested
+	int FindPending(const std::string& name) const;
+
+	std::vector<PENDING_PROGRAM> m_pending;
+	bool m_bUseBinaries;
+	// vendor, renderer and version, part of every cache key
+	std::string m_driver;
+	CACHE_STATS m_stats;
+};
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.cpp
+// ===============
+// sort the draws of a frame by a 64-bit state key
+//
+//  Each draw gets a key built from the GL state it needs, so sorting the
+//  keys groups draws that share a program, mesh, texture and material,
+//  and the render loop only changes the state that actually differs.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// the radix sort handles one byte of the key per pass
+	const int RADIX_BITS = 8;
+	const int RADIX_BUCKETS = 1 << RADIX_BITS;
+	const int RADIX_PASSES = 64 / RADIX_BITS;
+
+	/***********************************************************
+	 *  DepthBits()
+	 *
+	 *  Get the bits of a non-negative depth as an integer that
+	 *  sorts in the same order as the depth.
+	 ***********************************************************/
+	uint32_t DepthBits(float depth)
+	{
+		if (!(depth > 0.0f))
+		{
+			return(0);
+		}
+
+		// positive IEEE floats order like their bit patterns
+		uint32_t bits = 0;
+		memcpy(&bits, &depth, sizeof(bits));
+		return(bits);
+	}
+
+	/***********************************************************
+	 *  Field()
+	 *
+	 *  Place a state value, where -1 means none, into a key
+	 *  field of the passed in width and position.
+	 ***********************************************************/
+	uint64_t Field(int value, int width, int shift)
+	{
+		uint64_t mask = (static_cast<uint64_t>(1) << width) - 1;
+		return((static_cast<uint64_t>(value + 1) & mask) << shift);
+	}
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+}
+
+/***********************************************************
+ *  MakeOpaqueKey()
+ *
+ *  This method is used for building the key of an opaque
+ *  draw.  From the most significant bit down:
+ *    1 bit   0 for opaque
+ *    4 bits  program
+ *    8 bits  mesh
+ *    16 bits texture handle
+ *    16 bits material handle
+ *    19 bits depth, so equal state is drawn front to back
+ ***********************************************************/
+uint64_t RenderQueue::MakeOpaqueKey(int program, int meshID, int texture, int material, float depth)
+{
+	uint64_t key = 0;
+	key |= Field(program, 4, 59);
+	key |= Field(meshID, 8, 51);
+	key |= Field(texture, 16, 35);
+	key |= Field(material, 16, 19);
+	key |= static_cast<uint64_t>(DepthBits(depth) >> 13);
+
+	return(key);
+}
+
+/***********************************************************
+ *  MakeTransparentKey()
+ *
+ *  This method is used for building the key of a blended
+ *  draw.  Blending needs the farthest draw first, so the
+ *  depth comes before any state:
+ *    1 bit   1 for transparent
+ *    31 bits inverted depth
+ *    4 bits  program
+ *    8 bits  mesh
+ *    10 bits texture handle
+ *    10 bits material handle
+ ***********************************************************/
+uint64_t RenderQueue::MakeTransparentKey(int program, float depth, int meshID, int texture, int material)
+{
+	uint64_t key = static_cast<uint64_t>(1) << 63;
+	key |= static_cast<uint64_t>(~DepthBits(depth) & 0x7FFFFFFFu) << 32;
+	key |= Field(program, 4, 28);
+	key |= Field(meshID, 8, 20);
+	key |= Field(texture, 10, 10);
+	key |= Field(material, 10, 0);
+
+	return(key);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing the queued draws.  The
+ *  storage is kept, so a steady scene does not allocate.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	m_items.clear();
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for queueing a draw with its key.
+ ***********************************************************/
+void RenderQueue::Add(uint64_t key, int drawIndex)
+{
+	DRAW_ITEM item;
+	item.key = key;
+	item.drawIndex = drawIndex;
+	m_items.push_back(item);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used for sorting the queued draws by key
+ *  with a least significant digit radix sort.  A pass whose
+ *  byte is the same for every key is skipped, which is most
+ *  of them for a small scene.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+	size_t count = m_items.size();
+	if (count < 2)
+	{
+		return;
+	}
+	m_scratch.resize(count);
+
+	DRAW_ITEM* pSource = &m_items[0];
+	DRAW_ITEM* pDestination = &m_scratch[0];
+
+	for (int pass = 0; pass < RADIX_PASSES; pass++)
+	{
+		int shift = pass * RADIX_BITS;
+
+		size_t offsets[RADIX_BUCKETS] = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			offsets[(pSource[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+		}
+
+		// every key has the same byte, nothing moves
+		if (offsets[(pSource[0].key >> shift) & (RADIX_BUCKETS - 1)] == count)
+		{
+			continue;
+		}
+
+		// turn the counts into the first slot of each bucket
+		size_t total = 0;
+		for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+		{
+			size_t bucketCount = offsets[bucket];
+			offsets[bucket] = total;
+			total += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			pDestination[offsets[(pSource[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = pSource[i];
+		}
+
+		DRAW_ITEM* pSwap = pSource;
+		pSource = pDestination;
+		pDestination = pSwap;
+	}
+
+	// an odd number of passes leaves the result in the scratch buffer
+	if (pSource != &m_items[0])
+	{
+		m_items.swap(m_scratch);
+	}
+}
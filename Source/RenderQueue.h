@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.h
+// =============
+// sort the draws of a frame by a 64-bit state key
+//
+//  Each draw gets a key built from the GL state it needs, so sorting the
+//  keys groups draws that share a program, mesh, texture and material,
+//  and the render loop only changes the state that actually differs.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class collects the draws of one frame as key and
+ *  draw index pairs and sorts them with an LSD radix sort.
+ *  Opaque draws come first, grouped by state and then
+ *  front to back; transparent draws follow back to front.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	struct DRAW_ITEM
+	{
+		uint64_t key;
+		// index of the draw in the caller's draw list
+		int drawIndex;
+	};
+
+	// constructor
+	RenderQueue();
+
+	// key of an opaque draw, state first and depth last
+	static uint64_t MakeOpaqueKey(int program, int meshID, int texture, int material, float depth);
+	// key of a transparent draw, farthest first
+	static uint64_t MakeTransparentKey(int program, float depth, int meshID, int texture, int material);
+
+	// remove every draw, keeping the storage
+	void Clear();
+	// queue a draw
+	void Add(uint64_t key, int drawIndex);
+	// sort the queued draws by key, draws with equal keys
+	// keep the order they were added in
+	void Sort();
+
+	const std::vector<DRAW_ITEM>& GetItems() const { return m_items; }
+	int GetCount() const { return static_cast<int>(m_items.size()); }
+
+private:
+	// queued draws
+	std::vector<DRAW_ITEM> m_items;
+	// second buffer the radix sort scatters into
+	std::vector<DRAW_ITEM> m_scratch;
+};
@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderThread.cpp
+// ================
+// thread owning the GL context, rendering frames handed over by the main
+// thread
+//
+//  The main thread polls input, moves the camera and culls and sorts
+//  the scene, then hands each frame over as a snapshot.  The render
+//  thread uploads and draws the snapshots in order and presents them,
+//  so a stall in the swap or the driver no longer holds up input, and
+//  the main thread's work on the next frame overlaps the submission of
+//  the current one.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderThread.h"
+
+#include <chrono>
+
+/***********************************************************
+ *  RenderThread()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderThread::RenderThread()
+{
+	m_pWindow = NULL;
+	m_pTrace = NULL;
+	m_renderingSlot = -1;
+	m_fillingSlot = -1;
+	m_bStopping = false;
+}
+
+/***********************************************************
+ *  ~RenderThread()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderThread::~RenderThread()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for moving the GL context of the
+ *  window to a new render thread.  A context is current on
+ *  one thread at a time, so the calling thread gives it up
+ *  first and must make no GL calls until Stop().
+ ***********************************************************/
+void RenderThread::Start(GLFWwindow* window, RENDER_FUNCTION render, FrameTrace* pTrace)
+{
+	m_pWindow = window;
+	m_render = render;
+	m_pTrace = pTrace;
+	m_pendingSlots.clear();
+	m_renderingSlot = -1;
+	m_fillingSlot = -1;
+	m_bStopping = false;
+
+	glfwMakeContextCurrent(NULL);
+	m_thread = std::thread(&RenderThread::ThreadMain, this);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for letting the render thread
+ *  finish the waiting snapshots, joining it and taking the
+ *  GL context back, so the caller can read results and
+ *  free GL objects.
+ ***********************************************************/
+void RenderThread::Stop()
+{
+	if (m_thread.joinable() == false)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_snapshotQueued.notify_all();
+	m_thread.join();
+
+	glfwMakeContextCurrent(m_pWindow);
+}
+
+/***********************************************************
+ *  FindFreeSlot()
+ *
+ *  This method is used for finding a slot that is not
+ *  waiting, being rendered or being filled.  The lock must
+ *  be held.
+ ***********************************************************/
+int RenderThread::FindFreeSlot() const
+{
+	for (int slot = 0; slot < SNAPSHOT_COUNT; slot++)
+	{
+		bool bUsed = (slot == m_renderingSlot) || (slot == m_fillingSlot);
+		for (size_t i = 0; (i < m_pendingSlots.size()) && (bUsed == false); i++)
+		{
+			bUsed = (m_pendingSlots[i] == slot);
+		}
+		if (bUsed == false)
+		{
+			return(slot);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  WaitForFreeSlot()
+ *
+ *  This method is used for pacing the main thread to the
+ *  render thread.  The timeout keeps the main thread
+ *  polling input while a frame takes long to render.
+ ***********************************************************/
+bool RenderThread::WaitForFreeSlot(double timeoutSeconds)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return(m_slotFreed.wait_for(lock, std::chrono::duration<double>(timeoutSeconds), [this]() {
+		return (FindFreeSlot() >= 0);
+	}));
+}
+
+/***********************************************************
+ *  AcquireSlot()
+ *
+ *  This method is used for giving the main thread a slot
+ *  to prepare the next frame in.  It never blocks: when
+ *  every slot is used, the newest waiting snapshot is
+ *  stale, so it is taken back and overwritten.  The render
+ *  thread leaves the slot alone until Submit().
+ ***********************************************************/
+RenderThread::FRAME_SNAPSHOT& RenderThread::AcquireSlot()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int slot = FindFreeSlot();
+	if (slot < 0)
+	{
+		slot = m_pendingSlots.back();
+		m_pendingSlots.pop_back();
+	}
+	m_fillingSlot = slot;
+	return(m_snapshots[slot]);
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for handing the slot filled since
+ *  AcquireSlot() to the render thread, after any that are
+ *  still waiting.
+ ***********************************************************/
+void RenderThread::Submit()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_fillingSlot < 0)
+		{
+			return;
+		}
+		m_pendingSlots.push_back(m_fillingSlot);
+		m_fillingSlot = -1;
+	}
+	m_snapshotQueued.notify_one();
+}
+
+/***********************************************************
+ *  ThreadMain()
+ *
+ *  This method is the loop of the render thread.  It takes
+ *  the context, then renders the oldest waiting snapshot
+ *  until it is stopped with none waiting.
+ ***********************************************************/
+void RenderThread::ThreadMain()
+{
+	glfwMakeContextCurrent(m_pWindow);
+	if (m_pTrace != NULL)
+	{
+		m_pTrace->SetThreadName("render");
+	}
+
+	while (true)
+	{
+		int slot = -1;
+		{
+			FrameTrace::Scope scope(m_pTrace, "wait for snapshot", -1);
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_snapshotQueued.wait(lock, [this]() {
+				return (m_bStopping || !m_pendingSlots.empty());
+			});
+			if (m_pendingSlots.empty())
+			{
+				break;
+			}
+			slot = m_pendingSlots.front();
+			m_pendingSlots.pop_front();
+			m_renderingSlot = slot;
+		}
+
+		// AcquireSlot() never hands out the slot being
+		// rendered, so it stays unchanged until released below
+		m_render(m_snapshots[slot]);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_renderingSlot = -1;
+		}
+		m_slotFreed.notify_one();
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderThread.h
+// ==============
+// thread owning the GL context, rendering frames handed over by the main
+// thread
+//
+//  The main thread polls input, moves the camera and culls and sorts
+//  the scene, then hands each frame over as a snapshot.  The render
+//  thread uploads and draws the snapshots in order and presents them,
+//  so a stall in the swap or the driver no longer holds up input, and
+//  the main thread's work on the next frame overlaps the submission of
+//  the current one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrameTrace.h"
+#include "SceneManager.h"
+
+#include "GLFW/glfw3.h"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/***********************************************************
+ *  RenderThread
+ *
+ *  This class owns the render thread and a ring of three
+ *  snapshots: one being rendered and up to two waiting or
+ *  being filled, so the main thread runs at most two
+ *  frames ahead.  A slot is not written again until its
+ *  frame is rendered, so the render thread reads it
+ *  without a copy or a lock, and the main thread fills it
+ *  in place, reusing the storage of its earlier frames.
+ ***********************************************************/
+class RenderThread
+{
+public:
+	// snapshots in the ring
+	static const int SNAPSHOT_COUNT = 3;
+
+	// everything the render thread needs from the main thread
+	// for one frame; the scene itself does not change after
+	// it is prepared
+	struct FRAME_SNAPSHOT
+	{
+		int frameIndex;
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 viewPosition;
+		// visible records, detail levels, sorted draws and
+		// binned lights for the camera
+		SceneManager::PREPARED_FRAME prepared;
+	};
+
+	// renders and presents one frame on the render thread
+	typedef std::function<void(const FRAME_SNAPSHOT&)> RENDER_FUNCTION;
+
+	// constructor
+	RenderThread();
+	// destructor
+	~RenderThread();
+
+	// release the context of the calling thread and start
+	// rendering with it on the render thread
+	void Start(GLFWwindow* window, RENDER_FUNCTION render, FrameTrace* pTrace);
+	// render the waiting snapshots, end the thread and make
+	// the context current on the calling thread again
+	void Stop();
+
+	// block until a slot is free or the timeout passes, true
+	// when a snapshot can be submitted without replacing one
+	bool WaitForFreeSlot(double timeoutSeconds);
+	// slot to fill with the next frame, taking back the
+	// newest waiting one when no slot is free
+	FRAME_SNAPSHOT& AcquireSlot();
+	// queue the slot filled since AcquireSlot()
+	void Submit();
+
+private:
+	// loop of the render thread
+	void ThreadMain();
+	// slot that no snapshot is using, -1 when all are
+	int FindFreeSlot() const;
+
+	std::thread m_thread;
+	GLFWwindow* m_pWindow;
+	RENDER_FUNCTION m_render;
+	FrameTrace* m_pTrace;
+
+	FRAME_SNAPSHOT m_snapshots[SNAPSHOT_COUNT];
+	// slots waiting to be rendered, oldest first
+	std::deque<int> m_pendingSlots;
+	// slot being rendered, -1 between frames
+	int m_renderingSlot;
+	// slot being filled by the main thread, -1 when none is
+	int m_fillingSlot;
+	// set by Stop(), the thread ends once the ring is empty
+	bool m_bStopping;
+
+	// guards the ring
+	std::mutex m_mutex;
+	// signalled when a snapshot is queued or the thread stops
+	std::condition_variable m_snapshotQueued;
+	// signalled when a frame is rendered and frees its slot
+	std::condition_variable m_slotFreed;
+};
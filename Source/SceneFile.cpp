@@ -0,0 +1,1041 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneFile.cpp
+// =============
+// load scene descriptions from text files or memory-mapped binary files
+//
+//  A text scene lists the textures, materials, lights and objects of a
+//  scene, one per line.  Compiling it bakes every object's world matrix
+//  into a draw record and writes the tables and records to a binary
+//  file, which is memory-mapped and drawn from without any parsing.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+#include "NameTable.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// identifies a binary scene file and its layout version; the
+	// record flags took over padding that was always 0, so files
+	// of this version read as entirely static
+	const char g_BinaryMagic[8] = { 'S', 'C', 'E', 'N', 'E', 'B', 'I', 'N' };
+	const uint32_t BINARY_VERSION = 2;
+	// alignment of each table in a binary scene file
+	const uint32_t TABLE_ALIGNMENT = 16;
+
+	// mesh names used in text scenes, indexed by SceneGraph::MESH_ID
+	const char* g_MeshNames[] =
+	{
+		"box",
+		"cone",
+		"cylinder",
+		"plane",
+		"sphere",
+		"tapered_cylinder",
+		"torus",
+	};
+	const int g_MeshNameCount = sizeof(g_MeshNames) / sizeof(g_MeshNames[0]);
+
+	/***********************************************************
+	 *  AlignOffset()
+	 *
+	 *  Round a file offset up to the table alignment.
+	 ***********************************************************/
+	uint32_t AlignOffset(size_t offset)
+	{
+		return(static_cast<uint32_t>((offset + TABLE_ALIGNMENT - 1) & ~static_cast<size_t>(TABLE_ALIGNMENT - 1)));
+	}
+
+	/***********************************************************
+	 *  ReadFloats()
+	 *
+	 *  Read a fixed number of floats from a line of a text scene.
+	 ***********************************************************/
+	bool ReadFloats(std::istringstream& line, float* values, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (!(line >> values[i]))
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	/***********************************************************
+	 *  CopyTag()
+	 *
+	 *  Copy a string into a fixed-size record field, false if
+	 *  it does not fit.
+	 ***********************************************************/
+	bool CopyTag(char* destination, size_t destinationSize, const std::string& source)
+	{
+		if (source.size() >= destinationSize)
+		{
+			return(false);
+		}
+		memset(destination, 0, destinationSize);
+		memcpy(destination, source.c_str(), source.size());
+		return(true);
+	}
+
+	/***********************************************************
+	 *  WriteVector()
+	 *
+	 *  Write a keyword followed by a fixed number of floats.
+	 ***********************************************************/
+	void WriteVector(std::ostream& output, const char* keyword, const float* values, int count)
+	{
+		output << " " << keyword;
+		for (int i = 0; i < count; i++)
+		{
+			output << " " << values[i];
+		}
+	}
+}
+
+const char* SceneFile::BINARY_EXTENSION = ".scenebin";
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_pMapping = NULL;
+	m_mappingSize = 0;
+	UseOwnedTables();
+}
+
+/***********************************************************
+ *  ~SceneFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for loading a scene file.  Files
+ *  with the binary extension are memory-mapped, all other
+ *  files are parsed as text.
+ ***********************************************************/
+bool SceneFile::Load(const std::string& filename)
+{
+	Close();
+
+	size_t extensionLength = strlen(BINARY_EXTENSION);
+	if ((filename.size() > extensionLength) &&
+		(filename.compare(filename.size() - extensionLength, extensionLength, BINARY_EXTENSION) == 0))
+	{
+		return(MapBinary(filename));
+	}
+
+	if (ParseText(filename) == false)
+	{
+		Close();
+		return(false);
+	}
+	BuildRecords();
+	UseOwnedTables();
+
+	return(true);
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method is used for writing the loaded scene.  Files
+ *  with the binary extension get the compiled form.
+ ***********************************************************/
+bool SceneFile::Save(const std::string& filename) const
+{
+	size_t extensionLength = strlen(BINARY_EXTENSION);
+	if ((filename.size() > extensionLength) &&
+		(filename.compare(filename.size() - extensionLength, extensionLength, BINARY_EXTENSION) == 0))
+	{
+		return(WriteBinary(filename));
+	}
+
+	return(WriteText(filename));
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for releasing the loaded scene.
+ ***********************************************************/
+void SceneFile::Close()
+{
+	if (m_pMapping != NULL)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_pMapping);
+#else
+		munmap(m_pMapping, m_mappingSize);
+#endif
+	}
+	m_pMapping = NULL;
+	m_mappingSize = 0;
+
+	m_textures.clear();
+	m_materials.clear();
+	m_lights.clear();
+	m_pointLights.clear();
+	m_records.clear();
+	m_nodes.clear();
+	m_nodeNames.clear();
+	UseOwnedTables();
+}
+
+/***********************************************************
+ *  UseOwnedTables()
+ *
+ *  This method is used for pointing the table accessors at
+ *  the vectors filled by the parser.
+ ***********************************************************/
+void SceneFile::UseOwnedTables()
+{
+	m_pTextures = m_textures.empty() ? NULL : &m_textures[0];
+	m_textureCount = static_cast<int>(m_textures.size());
+	m_pMaterials = m_materials.empty() ? NULL : &m_materials[0];
+	m_materialCount = static_cast<int>(m_materials.size());
+	m_pLights = m_lights.empty() ? NULL : &m_lights[0];
+	m_lightCount = static_cast<int>(m_lights.size());
+	m_pPointLights = m_pointLights.empty() ? NULL : &m_pointLights[0];
+	m_pointLightCount = static_cast<int>(m_pointLights.size());
+	m_pRecords = m_records.empty() ? NULL : &m_records[0];
+	m_recordCount = static_cast<int>(m_records.size());
+}
+
+/***********************************************************
+ *  ParseText()
+ *
+ *  This method is used for reading a text scene.  Each line
+ *  holds one entry, '#' starts a comment:
+ *    texture <tag> <file>
+ *    material <tag> ambient r g b strength s diffuse r g b
+ *        specular r g b shininess s
+ *    light position x y z ambient r g b diffuse r g b
+ *        specular r g b [focal f] [intensity i]
+ *    pointlight position x y z color r g b range r
+ *        [intensity i]
+ *    group <name> [parent <name>] [position x y z]
+ *        [rotate x y z] [scale x y z] [dynamic]
+ *    object <mesh> [name <name>] [parent <name>]
+ *        [position x y z] [rotate x y z] [scale x y z]
+ *        material <tag> [texture <tag>] [color r g b a] [uv u v]
+ *        [dynamic]
+ *  Tags and names must be defined before they are used,
+ *  and at most MAX_MATERIALS materials fit the shader.
+ *  Nodes marked dynamic, and their children, are kept out
+ *  of the static batches so they can be moved.
+ ***********************************************************/
+bool SceneFile::ParseText(const std::string& filename)
+{
+	std::ifstream file(filename.c_str());
+	if (!file)
+	{
+		std::cout << "Could not open scene file:" << filename << std::endl;
+		return(false);
+	}
+
+	NameTable textureTags;
+	NameTable materialTags;
+	NameTable nodeNames;
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+
+		// drop the comment and skip empty lines
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+		{
+			text.erase(comment);
+		}
+
+		std::istringstream line(text);
+		std::string entry;
+		if (!(line >> entry))
+		{
+			continue;
+		}
+
+		std::string error;
+		if (entry == "texture")
+		{
+			TEXTURE_RECORD texture;
+			std::string tag;
+			std::string path;
+			if (!(line >> tag >> path))
+			{
+				error = "texture needs a tag and a file";
+			}
+			else if ((CopyTag(texture.tag, sizeof(texture.tag), tag) == false) ||
+				(CopyTag(texture.filename, sizeof(texture.filename), path) == false))
+			{
+				error = "texture tag or file name is too long";
+			}
+			else if (textureTags.Insert(tag.c_str(), static_cast<int>(m_textures.size())) == false)
+			{
+				error = "texture " + tag + " is defined twice";
+			}
+			else
+			{
+				m_textures.push_back(texture);
+			}
+		}
+		else if (entry == "material")
+		{
+			MATERIAL_RECORD material;
+			memset(&material, 0, sizeof(material));
+			std::string tag;
+			if (!(line >> tag) || (CopyTag(material.tag, sizeof(material.tag), tag) == false))
+			{
+				error = "material needs a tag of less than 32 characters";
+			}
+
+			std::string key;
+			while ((error.empty() == true) && (line >> key))
+			{
+				bool bRead = false;
+				if (key == "ambient") bRead = ReadFloats(line, material.ambientColor, 3);
+				else if (key == "strength") bRead = ReadFloats(line, &material.ambientStrength, 1);
+				else if (key == "diffuse") bRead = ReadFloats(line, material.diffuseColor, 3);
+				else if (key == "specular") bRead = ReadFloats(line, material.specularColor, 3);
+				else if (key == "shininess") bRead = ReadFloats(line, &material.shininess, 1);
+				if (bRead == false)
+				{
+					error = "bad material value " + key;
+				}
+			}
+
+			if ((error.empty() == true) &&
+				(materialTags.Insert(tag.c_str(), static_cast<int>(m_materials.size())) == false))
+			{
+				error = "material " + tag + " is defined twice";
+			}
+			if ((error.empty() == true) && (m_materials.size() >= static_cast<size_t>(MAX_MATERIALS)))
+			{
+				error = "more than " + std::to_string(MAX_MATERIALS) + " materials are defined";
+			}
+			if (error.empty() == true)
+			{
+				m_materials.push_back(material);
+			}
+		}
+		else if (entry == "light")
+		{
+			LIGHT_RECORD light;
+			memset(&light, 0, sizeof(light));
+
+			std::string key;
+			while ((error.empty() == true) && (line >> key))
+			{
+				bool bRead = false;
+				if (key == "position") bRead = ReadFloats(line, light.position, 3);
+				else if (key == "ambient") bRead = ReadFloats(line, light.ambientColor, 3);
+				else if (key == "diffuse") bRead = ReadFloats(line, light.diffuseColor, 3);
+				else if (key == "specular") bRead = ReadFloats(line, light.specularColor, 3);
+				else if (key == "focal") bRead = ReadFloats(line, &light.focalStrength, 1);
+				else if (key == "intensity") bRead = ReadFloats(line, &light.specularIntensity, 1);
+				if (bRead == false)
+				{
+					error = "bad light value " + key;
+				}
+			}
+
+			if (error.empty() == true)
+			{
+				m_lights.push_back(light);
+			}
+		}
+		else if (entry == "pointlight")
+		{
+			POINT_LIGHT_RECORD light;
+			memset(&light, 0, sizeof(light));
+			light.intensity = 1.0f;
+
+			std::string key;
+			while ((error.empty() == true) && (line >> key))
+			{
+				bool bRead = false;
+				if (key == "position") bRead = ReadFloats(line, light.position, 3);
+				else if (key == "color") bRead = ReadFloats(line, light.color, 3);
+				else if (key == "range") bRead = ReadFloats(line, &light.range, 1);
+				else if (key == "intensity") bRead = ReadFloats(line, &light.intensity, 1);
+				if (bRead == false)
+				{
+					error = "bad point light value " + key;
+				}
+			}
+
+			if ((error.empty() == true) && (light.range <= 0.0f))
+			{
+				error = "point light needs a positive range";
+			}
+			if (error.empty() == true)
+			{
+				m_pointLights.push_back(light);
+			}
+		}
+		else if ((entry == "group") || (entry == "object"))
+		{
+			SceneGraph::SCENE_NODE node = SceneGraph::MakeNode(SceneGraph::MESH_NONE);
+			std::string name;
+
+			if (entry == "group")
+			{
+				if (!(line >> name))
+				{
+					error = "group needs a name";
+				}
+			}
+			else
+			{
+				std::string meshName;
+				line >> meshName;
+				for (int i = 0; i < g_MeshNameCount; i++)
+				{
+					if (meshName == g_MeshNames[i])
+					{
+						node.meshID = i;
+					}
+				}
+				if (node.meshID == SceneGraph::MESH_NONE)
+				{
+					error = "unknown mesh " + meshName;
+				}
+			}
+
+			std::string key;
+			while ((error.empty() == true) && (line >> key))
+			{
+				bool bRead = true;
+				std::string value;
+				if (key == "position") bRead = ReadFloats(line, glm::value_ptr(node.positionXYZ), 3);
+				else if (key == "rotate") bRead = ReadFloats(line, glm::value_ptr(node.rotationDegrees), 3);
+				else if (key == "scale") bRead = ReadFloats(line, glm::value_ptr(node.scaleXYZ), 3);
+				else if (key == "color") bRead = ReadFloats(line, glm::value_ptr(node.color), 4);
+				else if (key == "uv") bRead = ReadFloats(line, glm::value_ptr(node.UVscale), 2);
+				else if (key == "name") bRead = static_cast<bool>(line >> name);
+				else if (key == "dynamic") node.bDynamic = true;
+				else if (key == "parent")
+				{
+					bRead = static_cast<bool>(line >> value);
+					node.parent = nodeNames.Find(value.c_str());
+					if (node.parent < 0)
+					{
+						error = "unknown parent " + value;
+					}
+				}
+				else if (key == "material")
+				{
+					bRead = static_cast<bool>(line >> value);
+					node.materialIndex = materialTags.Find(value.c_str());
+					if (node.materialIndex < 0)
+					{
+						error = "unknown material " + value;
+					}
+				}
+				else if (key == "texture")
+				{
+					bRead = static_cast<bool>(line >> value);
+					node.textureIndex = textureTags.Find(value.c_str());
+					if (node.textureIndex < 0)
+					{
+						error = "unknown texture " + value;
+					}
+				}
+				else
+				{
+					bRead = false;
+				}
+
+				if ((bRead == false) && (error.empty() == true))
+				{
+					error = "bad value for " + key;
+				}
+			}
+
+			if ((error.empty() == true) && (node.meshID != SceneGraph::MESH_NONE) && (m_materials.empty() == true))
+			{
+				error = "objects need a material to be defined first";
+			}
+			if ((error.empty() == true) && (name.empty() == false) &&
+				(nodeNames.Insert(name.c_str(), static_cast<int>(m_nodes.size())) == false))
+			{
+				error = "name " + name + " is used twice";
+			}
+			if (error.empty() == true)
+			{
+				m_nodes.push_back(node);
+				m_nodeNames.push_back(name);
+			}
+		}
+		else
+		{
+			error = "unknown entry " + entry;
+		}
+
+		if (error.empty() == false)
+		{
+			std::cout << filename << ":" << lineNumber << ": " << error << std::endl;
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  BuildRecords()
+ *
+ *  This method is used for computing the world matrix of
+ *  every node and writing a draw record for each node that
+ *  has a mesh, in file order.  Records below a dynamic
+ *  group are dynamic too.
+ ***********************************************************/
+void SceneFile::BuildRecords()
+{
+	SceneGraph sceneGraph;
+	for (size_t i = 0; i < m_nodes.size(); i++)
+	{
+		sceneGraph.AddNode(m_nodes[i]);
+	}
+	sceneGraph.UpdateWorldMatrices();
+
+	const std::vector<SceneGraph::SCENE_NODE>& nodes = sceneGraph.GetNodes();
+	m_records.clear();
+	m_records.reserve(nodes.size());
+	// parents come before their children, so a node only
+	// looks at its parent to inherit the flag
+	std::vector<bool> dynamicNodes(nodes.size(), false);
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		dynamicNodes[i] = (nodes[i].bDynamic == true) ||
+			((nodes[i].parent >= 0) && (dynamicNodes[nodes[i].parent] == true));
+		if (nodes[i].meshID == SceneGraph::MESH_NONE)
+		{
+			continue;
+		}
+
+		DRAW_RECORD record;
+		memcpy(record.worldMatrix, glm::value_ptr(nodes[i].worldMatrix), sizeof(record.worldMatrix));
+		record.meshID = nodes[i].meshID;
+		record.materialIndex = nodes[i].materialIndex;
+		record.textureIndex = nodes[i].textureIndex;
+		record.node = static_cast<int32_t>(i);
+		record.UVscale[0] = nodes[i].UVscale.x;
+		record.UVscale[1] = nodes[i].UVscale.y;
+		record.flags = (dynamicNodes[i] == true) ? RECORD_DYNAMIC : 0;
+		record.padding = 0.0f;
+		memcpy(record.color, glm::value_ptr(nodes[i].color), sizeof(record.color));
+		m_records.push_back(record);
+	}
+}
+
+/***********************************************************
+ *  AddStressObjects()
+ *
+ *  This method is used for adding a square grid of small
+ *  objects hovering above the desk.  Large counts spread
+ *  past the desk at the same spacing, so part of the grid
+ *  is always behind the benchmark camera.  Meshes,
+ *  materials, textures and colors are picked with a fixed
+ *  seed, so a given count always produces the same scene.
+ ***********************************************************/
+void SceneFile::AddStressObjects(int objectCount)
+{
+	if ((IsBinary() == true) || (m_materials.empty() == true))
+	{
+		std::cout << "Stress objects need a text scene with materials" << std::endl;
+		return;
+	}
+
+	// the square is taken in 64 bits, so a count near INT_MAX
+	// cannot overflow it
+	int gridSize = 1;
+	while (static_cast<int64_t>(gridSize) * gridSize < objectCount)
+	{
+		gridSize++;
+	}
+
+	// the grid covers at least the table top
+	const float minimumGridWidth = 20.0f;
+	const float maximumCellSize = 0.5f;
+	float gridWidth = std::max(minimumGridWidth, gridSize * maximumCellSize);
+	float cellSize = gridWidth / gridSize;
+
+	uint32_t random = 12345u;
+	for (int i = 0; i < objectCount; i++)
+	{
+		SceneGraph::SCENE_NODE node = SceneGraph::MakeNode(SceneGraph::MESH_BOX);
+
+		// numerical recipes linear congruential generator
+		random = random * 1664525u + 1013904223u;
+		node.meshID = (random >> 8) % g_MeshNameCount;
+		random = random * 1664525u + 1013904223u;
+		node.materialIndex = (random >> 8) % m_materials.size();
+		random = random * 1664525u + 1013904223u;
+		node.textureIndex = m_textures.empty() ? -1 : static_cast<int>((random >> 8) % (m_textures.size() + 1)) - 1;
+		random = random * 1664525u + 1013904223u;
+		node.color = glm::vec4(((random >> 8) & 255) / 255.0f, ((random >> 16) & 255) / 255.0f, ((random >> 24) & 255) / 255.0f, 1.0f);
+		random = random * 1664525u + 1013904223u;
+		node.rotationDegrees = glm::vec3(0.0f, static_cast<float>((random >> 8) % 360), 0.0f);
+
+		node.scaleXYZ = glm::vec3(cellSize * 0.4f);
+		node.positionXYZ = glm::vec3(
+			(i % gridSize + 0.5f) * cellSize - gridWidth / 2.0f,
+			3.0f,
+			(i / gridSize + 0.5f) * cellSize + 10.0f - gridWidth / 2.0f);
+
+		m_nodes.push_back(node);
+		m_nodeNames.push_back(std::string());
+	}
+
+	BuildRecords();
+	UseOwnedTables();
+}
+
+/***********************************************************
+ *  AddStressLights()
+ *
+ *  This method is used for adding point lights scattered
+ *  over the area the stress objects cover, a little above
+ *  them.  Like AddStressObjects() the lights come from a
+ *  fixed seed.
+ ***********************************************************/
+void SceneFile::AddStressLights(int lightCount)
+{
+	if (IsBinary() == true)
+	{
+		std::cout << "Stress lights need a text scene" << std::endl;
+		return;
+	}
+
+	const float areaWidth = 20.0f;
+	uint32_t random = 54321u;
+	for (int i = 0; i < lightCount; i++)
+	{
+		POINT_LIGHT_RECORD light;
+
+		// numerical recipes linear congruential generator
+		random = random * 1664525u + 1013904223u;
+		light.position[0] = ((random >> 8) & 0xFFFF) / 65535.0f * areaWidth - areaWidth / 2.0f;
+		random = random * 1664525u + 1013904223u;
+		light.position[1] = 1.0f + ((random >> 8) & 0xFFFF) / 65535.0f * 4.0f;
+		random = random * 1664525u + 1013904223u;
+		light.position[2] = ((random >> 8) & 0xFFFF) / 65535.0f * areaWidth + 10.0f - areaWidth / 2.0f;
+		random = random * 1664525u + 1013904223u;
+		light.color[0] = ((random >> 8) & 255) / 255.0f;
+		light.color[1] = ((random >> 16) & 255) / 255.0f;
+		light.color[2] = ((random >> 24) & 255) / 255.0f;
+		random = random * 1664525u + 1013904223u;
+		light.range = 2.0f + ((random >> 8) & 0xFFFF) / 65535.0f * 3.0f;
+		light.intensity = 0.5f;
+
+		m_pointLights.push_back(light);
+	}
+
+	UseOwnedTables();
+}
+
+/***********************************************************
+ *  AddStressGlass()
+ *
+ *  This method is used for adding untextured objects with
+ *  an alpha below one, packed into a small volume above
+ *  the desk so that most of them overlap on screen.  Like
+ *  AddStressObjects() they come from a fixed seed.
+ ***********************************************************/
+void SceneFile::AddStressGlass(int glassCount)
+{
+	if ((IsBinary() == true) || (m_materials.empty() == true))
+	{
+		std::cout << "Stress glass needs a text scene with materials" << std::endl;
+		return;
+	}
+
+	const float volumeWidth = 6.0f;
+	const float volumeHeight = 3.0f;
+	uint32_t random = 24680u;
+	for (int i = 0; i < glassCount; i++)
+	{
+		SceneGraph::SCENE_NODE node = SceneGraph::MakeNode(SceneGraph::MESH_BOX);
+
+		// numerical recipes linear congruential generator
+		random = random * 1664525u + 1013904223u;
+		node.meshID = (random >> 8) % g_MeshNameCount;
+		random = random * 1664525u + 1013904223u;
+		node.materialIndex = (random >> 8) % m_materials.size();
+		node.textureIndex = -1;
+		random = random * 1664525u + 1013904223u;
+		node.color = glm::vec4(((random >> 8) & 255) / 255.0f, ((random >> 16) & 255) / 255.0f,
+			((random >> 24) & 255) / 255.0f, 0.2f + ((random >> 4) & 15) / 15.0f * 0.4f);
+		random = random * 1664525u + 1013904223u;
+		node.rotationDegrees = glm::vec3(0.0f, static_cast<float>((random >> 8) % 360), 0.0f);
+		random = random * 1664525u + 1013904223u;
+		node.scaleXYZ = glm::vec3(0.5f + ((random >> 8) & 255) / 255.0f);
+
+		random = random * 1664525u + 1013904223u;
+		node.positionXYZ.x = ((random >> 8) & 0xFFFF) / 65535.0f * volumeWidth - volumeWidth / 2.0f;
+		random = random * 1664525u + 1013904223u;
+		node.positionXYZ.y = 1.0f + ((random >> 8) & 0xFFFF) / 65535.0f * volumeHeight;
+		random = random * 1664525u + 1013904223u;
+		node.positionXYZ.z = ((random >> 8) & 0xFFFF) / 65535.0f * volumeWidth - volumeWidth / 2.0f;
+
+		m_nodes.push_back(node);
+		m_nodeNames.push_back(std::string());
+	}
+
+	BuildRecords();
+	UseOwnedTables();
+}
+
+/***********************************************************
+ *  WriteText()
+ *
+ *  This method is used for writing the tables and nodes in
+ *  the text scene format.  Unnamed parent nodes are given
+ *  generated names.
+ ***********************************************************/
+bool SceneFile::WriteText(const std::string& filename) const
+{
+	if (IsBinary() == true)
+	{
+		std::cout << "A compiled scene cannot be written as text:" << filename << std::endl;
+		return(false);
+	}
+
+	std::ofstream file(filename.c_str());
+	if (!file)
+	{
+		std::cout << "Could not write scene file:" << filename << std::endl;
+		return(false);
+	}
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		file << "texture " << m_textures[i].tag << " " << m_textures[i].filename << "\n";
+	}
+	for (size_t i = 0; i < m_materials.size(); i++)
+	{
+		const MATERIAL_RECORD& material = m_materials[i];
+		file << "material " << material.tag;
+		WriteVector(file, "ambient", material.ambientColor, 3);
+		WriteVector(file, "strength", &material.ambientStrength, 1);
+		WriteVector(file, "diffuse", material.diffuseColor, 3);
+		WriteVector(file, "specular", material.specularColor, 3);
+		WriteVector(file, "shininess", &material.shininess, 1);
+		file << "\n";
+	}
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		const LIGHT_RECORD& light = m_lights[i];
+		file << "light";
+		WriteVector(file, "position", light.position, 3);
+		WriteVector(file, "ambient", light.ambientColor, 3);
+		WriteVector(file, "diffuse", light.diffuseColor, 3);
+		WriteVector(file, "specular", light.specularColor, 3);
+		WriteVector(file, "focal", &light.focalStrength, 1);
+		WriteVector(file, "intensity", &light.specularIntensity, 1);
+		file << "\n";
+	}
+	for (size_t i = 0; i < m_pointLights.size(); i++)
+	{
+		const POINT_LIGHT_RECORD& light = m_pointLights[i];
+		file << "pointlight";
+		WriteVector(file, "position", light.position, 3);
+		WriteVector(file, "color", light.color, 3);
+		WriteVector(file, "range", &light.range, 1);
+		WriteVector(file, "intensity", &light.intensity, 1);
+		file << "\n";
+	}
+
+	// every node that is a parent needs a name
+	std::vector<std::string> names(m_nodeNames);
+	for (size_t i = 0; i < m_nodes.size(); i++)
+	{
+		int parent = m_nodes[i].parent;
+		if ((parent >= 0) && (names[parent].empty() == true))
+		{
+			std::ostringstream generatedName;
+			generatedName << "node" << parent;
+			names[parent] = generatedName.str();
+		}
+	}
+
+	for (size_t i = 0; i < m_nodes.size(); i++)
+	{
+		const SceneGraph::SCENE_NODE& node = m_nodes[i];
+		if (node.meshID == SceneGraph::MESH_NONE)
+		{
+			file << "group " << names[i];
+		}
+		else
+		{
+			file << "object " << g_MeshNames[node.meshID];
+			if (names[i].empty() == false)
+			{
+				file << " name " << names[i];
+			}
+		}
+		if (node.parent >= 0)
+		{
+			file << " parent " << names[node.parent];
+		}
+		WriteVector(file, "position", glm::value_ptr(node.positionXYZ), 3);
+		WriteVector(file, "rotate", glm::value_ptr(node.rotationDegrees), 3);
+		WriteVector(file, "scale", glm::value_ptr(node.scaleXYZ), 3);
+		if (node.meshID != SceneGraph::MESH_NONE)
+		{
+			file << " material " << m_materials[node.materialIndex].tag;
+			if (node.textureIndex >= 0)
+			{
+				file << " texture " << m_textures[node.textureIndex].tag;
+			}
+			WriteVector(file, "color", glm::value_ptr(node.color), 4);
+			WriteVector(file, "uv", glm::value_ptr(node.UVscale), 2);
+		}
+		if (node.bDynamic == true)
+		{
+			file << " dynamic";
+		}
+		file << "\n";
+	}
+
+	return(file.good());
+}
+
+/***********************************************************
+ *  WriteBinary()
+ *
+ *  This method is used for writing the compiled form of
+ *  the scene: a header followed by the texture, material,
+ *  light and draw record tables, each 16-byte aligned.
+ *  The layout is the host's, little-endian on every
+ *  supported platform.
+ ***********************************************************/
+bool SceneFile::WriteBinary(const std::string& filename) const
+{
+	FILE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_BinaryMagic, sizeof(header.magic));
+	header.version = BINARY_VERSION;
+	header.headerSize = sizeof(FILE_HEADER);
+	header.textureCount = m_textureCount;
+	header.textureOffset = AlignOffset(sizeof(FILE_HEADER));
+	header.materialCount = m_materialCount;
+	header.materialOffset = AlignOffset(header.textureOffset + sizeof(TEXTURE_RECORD) * m_textureCount);
+	header.lightCount = m_lightCount;
+	header.lightOffset = AlignOffset(header.materialOffset + sizeof(MATERIAL_RECORD) * m_materialCount);
+	header.pointLightCount = m_pointLightCount;
+	header.pointLightOffset = AlignOffset(header.lightOffset + sizeof(LIGHT_RECORD) * m_lightCount);
+	header.recordCount = m_recordCount;
+	header.recordOffset = AlignOffset(header.pointLightOffset + sizeof(POINT_LIGHT_RECORD) * m_pointLightCount);
+	size_t fileSize = header.recordOffset + sizeof(DRAW_RECORD) * static_cast<size_t>(m_recordCount);
+
+	std::vector<char> contents(fileSize, 0);
+	memcpy(&contents[0], &header, sizeof(header));
+	if (m_textureCount > 0)
+	{
+		memcpy(&contents[header.textureOffset], m_pTextures, sizeof(TEXTURE_RECORD) * m_textureCount);
+	}
+	if (m_materialCount > 0)
+	{
+		memcpy(&contents[header.materialOffset], m_pMaterials, sizeof(MATERIAL_RECORD) * m_materialCount);
+	}
+	if (m_lightCount > 0)
+	{
+		memcpy(&contents[header.lightOffset], m_pLights, sizeof(LIGHT_RECORD) * m_lightCount);
+	}
+	if (m_pointLightCount > 0)
+	{
+		memcpy(&contents[header.pointLightOffset], m_pPointLights, sizeof(POINT_LIGHT_RECORD) * m_pointLightCount);
+	}
+	if (m_recordCount > 0)
+	{
+		// binary scenes have no scene graph nodes
+		DRAW_RECORD* pRecords = reinterpret_cast<DRAW_RECORD*>(&contents[header.recordOffset]);
+		memcpy(pRecords, m_pRecords, sizeof(DRAW_RECORD) * m_recordCount);
+		for (int i = 0; i < m_recordCount; i++)
+		{
+			pRecords[i].node = -1;
+		}
+	}
+
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not write scene file:" << filename << std::endl;
+		return(false);
+	}
+	file.write(&contents[0], contents.size());
+
+	return(file.good());
+}
+
+/***********************************************************
+ *  MapBinary()
+ *
+ *  This method is used for memory-mapping a compiled scene.
+ *  Only the header and the table indices are checked; the
+ *  records are used in place.
+ ***********************************************************/
+bool SceneFile::MapBinary(const std::string& filename)
+{
+	void* pMapping = NULL;
+	size_t fileSize = 0;
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER size;
+		if ((GetFileSizeEx(hFile, &size) == TRUE) && (size.QuadPart > 0))
+		{
+			fileSize = static_cast<size_t>(size.QuadPart);
+			HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (hMapping != NULL)
+			{
+				pMapping = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+				// the view keeps the mapping alive
+				CloseHandle(hMapping);
+			}
+		}
+		CloseHandle(hFile);
+	}
+#else
+	int fileDescriptor = open(filename.c_str(), O_RDONLY);
+	if (fileDescriptor >= 0)
+	{
+		struct stat fileStatus;
+		if ((fstat(fileDescriptor, &fileStatus) == 0) && (fileStatus.st_size > 0))
+		{
+			fileSize = static_cast<size_t>(fileStatus.st_size);
+			pMapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+			if (pMapping == MAP_FAILED)
+			{
+				pMapping = NULL;
+			}
+		}
+		// the mapping keeps the file alive
+		close(fileDescriptor);
+	}
+#endif
+
+	if (pMapping == NULL)
+	{
+		std::cout << "Could not map scene file:" << filename << std::endl;
+		return(false);
+	}
+	m_pMapping = pMapping;
+	m_mappingSize = fileSize;
+
+	// the header is read only once the file is known to hold it
+	if (fileSize < sizeof(FILE_HEADER))
+	{
+		std::cout << "Scene file is corrupt or from another version:" << filename << std::endl;
+		Close();
+		return(false);
+	}
+
+	const char* pBase = static_cast<const char*>(m_pMapping);
+	const FILE_HEADER* pHeader = reinterpret_cast<const FILE_HEADER*>(pBase);
+
+	// every table must lie inside the file and be aligned
+	bool bValid = (memcmp(pHeader->magic, g_BinaryMagic, sizeof(g_BinaryMagic)) == 0) &&
+		(pHeader->version == BINARY_VERSION) &&
+		(pHeader->headerSize == sizeof(FILE_HEADER));
+	const uint32_t counts[5] = { pHeader->textureCount, pHeader->materialCount, pHeader->lightCount,
+		pHeader->pointLightCount, pHeader->recordCount };
+	const uint32_t offsets[5] = { pHeader->textureOffset, pHeader->materialOffset, pHeader->lightOffset,
+		pHeader->pointLightOffset, pHeader->recordOffset };
+	const size_t recordSizes[5] = { sizeof(TEXTURE_RECORD), sizeof(MATERIAL_RECORD), sizeof(LIGHT_RECORD),
+		sizeof(POINT_LIGHT_RECORD), sizeof(DRAW_RECORD) };
+	for (int i = 0; (i < 5) && (bValid == true); i++)
+	{
+		bValid = ((offsets[i] % TABLE_ALIGNMENT) == 0) &&
+			(offsets[i] <= fileSize) &&
+			(counts[i] <= (fileSize - offsets[i]) / recordSizes[i]);
+	}
+
+	if (bValid == true)
+	{
+		m_pTextures = reinterpret_cast<const TEXTURE_RECORD*>(pBase + pHeader->textureOffset);
+		m_textureCount = static_cast<int>(pHeader->textureCount);
+		m_pMaterials = reinterpret_cast<const MATERIAL_RECORD*>(pBase + pHeader->materialOffset);
+		m_materialCount = static_cast<int>(pHeader->materialCount);
+		m_pLights = reinterpret_cast<const LIGHT_RECORD*>(pBase + pHeader->lightOffset);
+		m_lightCount = static_cast<int>(pHeader->lightCount);
+		m_pPointLights = reinterpret_cast<const POINT_LIGHT_RECORD*>(pBase + pHeader->pointLightOffset);
+		m_pointLightCount = static_cast<int>(pHeader->pointLightCount);
+		m_pRecords = reinterpret_cast<const DRAW_RECORD*>(pBase + pHeader->recordOffset);
+		m_recordCount = static_cast<int>(pHeader->recordCount);
+
+		// tags and paths are used as C strings
+		for (int i = 0; (i < m_textureCount) && (bValid == true); i++)
+		{
+			bValid = (memchr(m_pTextures[i].tag, '\0', MAX_TAG_LENGTH) != NULL) &&
+				(memchr(m_pTextures[i].filename, '\0', MAX_PATH_LENGTH) != NULL);
+		}
+		for (int i = 0; (i < m_materialCount) && (bValid == true); i++)
+		{
+			bValid = (memchr(m_pMaterials[i].tag, '\0', MAX_TAG_LENGTH) != NULL);
+		}
+
+		// indices that would read outside the tables
+		for (int i = 0; (i < m_recordCount) && (bValid == true); i++)
+		{
+			const DRAW_RECORD& record = m_pRecords[i];
+			bValid = (record.meshID >= 0) && (record.meshID < g_MeshNameCount) &&
+				(record.materialIndex >= 0) && (record.materialIndex < m_materialCount) &&
+				(record.textureIndex >= -1) && (record.textureIndex < m_textureCount);
+		}
+	}
+
+	if (bValid == false)
+	{
+		std::cout << "Scene file is corrupt or from another version:" << filename << std::endl;
+		Close();
+		return(false);
+	}
+	if (m_materialCount > MAX_MATERIALS)
+	{
+		std::cout << "Scene file defines more than " << MAX_MATERIALS << " materials:" << filename << std::endl;
+		Close();
+		return(false);
+	}
+
+	return(true);
+}
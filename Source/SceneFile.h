@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneFile.h
+// ===========
+// load scene descriptions from text files or memory-mapped binary files
+//
+//  A text scene lists the textures, materials, lights and objects of a
+//  scene, one per line.  Compiling it bakes every object's world matrix
+//  into a draw record and writes the tables and records to a binary
+//  file, which is memory-mapped and drawn from without any parsing.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneGraph.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class holds one loaded scene.  The record structs
+ *  are the on-disk layout of the binary form, so for a
+ *  binary scene the accessors point straight into the
+ *  mapped file.  For a text scene they point into vectors
+ *  built by the parser, and the objects are also kept as
+ *  scene graph nodes with their parent links.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// longest texture or material tag, including the terminator
+	static const int MAX_TAG_LENGTH = 32;
+	// longest texture file path, including the terminator
+	static const int MAX_PATH_LENGTH = 96;
+	// most materials a scene can define, must match
+	// SceneUniforms::MAX_MATERIALS
+	static const int MAX_MATERIALS = 64;
+
+	// bits of DRAW_RECORD::flags
+	enum RECORD_FLAGS
+	{
+		// the object moves, so it is drawn on its own instead
+		// of being baked into a static batch
+		RECORD_DYNAMIC = 1
+	};
+
+	struct TEXTURE_RECORD
+	{
+		char tag[MAX_TAG_LENGTH];
+		char filename[MAX_PATH_LENGTH];
+	};
+
+	struct MATERIAL_RECORD
+	{
+		char tag[MAX_TAG_LENGTH];
+		float ambientColor[3];
+		float ambientStrength;
+		float diffuseColor[3];
+		float specularColor[3];
+		float shininess;
+	};
+
+	struct LIGHT_RECORD
+	{
+		float position[3];
+		float ambientColor[3];
+		float diffuseColor[3];
+		float specularColor[3];
+		float focalStrength;
+		float specularIntensity;
+	};
+
+	// light that only reaches objects within its range
+	struct POINT_LIGHT_RECORD
+	{
+		float position[3];
+		float range;
+		float color[3];
+		float intensity;
+	};
+
+	struct DRAW_RECORD
+	{
+		float worldMatrix[16];
+		int32_t meshID;
+		// indices into the material and texture tables
+		int32_t materialIndex;
+		int32_t textureIndex;
+		// scene graph node of a text scene, -1 in a binary scene
+		int32_t node;
+		float UVscale[2];
+		// RECORD_FLAGS bits
+		uint32_t flags;
+		float padding;
+		float color[4];
+	};
+
+	// constructor
+	SceneFile();
+	// destructor
+	~SceneFile();
+
+	// load a text scene, or map a binary scene when the file
+	// name ends with BINARY_EXTENSION
+	bool Load(const std::string& filename);
+	// write the scene as text or, by extension, as binary
+	bool Save(const std::string& filename) const;
+	// unmap or free the loaded scene
+	void Close();
+
+	// add a grid of random objects above the scene that use the
+	// textures and materials already in it - text scenes only
+	void AddStressObjects(int objectCount);
+	// add point lights of random colors over the area of the
+	// stress objects - text scenes only
+	void AddStressLights(int lightCount);
+	// add a cluster of overlapping see-through objects above the
+	// desk, for measuring transparency - text scenes only
+	void AddStressGlass(int glassCount);
+
+	// scene tables
+	int GetTextureCount() const { return m_textureCount; }
+	const TEXTURE_RECORD* GetTextures() const { return m_pTextures; }
+	int GetMaterialCount() const { return m_materialCount; }
+	const MATERIAL_RECORD* GetMaterials() const { return m_pMaterials; }
+	int GetLightCount() const { return m_lightCount; }
+	const LIGHT_RECORD* GetLights() const { return m_pLights; }
+	int GetPointLightCount() const { return m_pointLightCount; }
+	const POINT_LIGHT_RECORD* GetPointLights() const { return m_pPointLights; }
+	int GetRecordCount() const { return m_recordCount; }
+	const DRAW_RECORD* GetRecords() const { return m_pRecords; }
+
+	// objects of a text scene, empty for a binary scene
+	const std::vector<SceneGraph::SCENE_NODE>& GetNodes() const { return m_nodes; }
+	// true when the scene was mapped from a binary file
+	bool IsBinary() const { return m_pMapping != NULL; }
+
+	// file name extension of compiled scenes
+	static const char* BINARY_EXTENSION;
+
+private:
+	// start of a binary scene file
+	struct FILE_HEADER
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		uint32_t textureCount;
+		uint32_t textureOffset;
+		uint32_t materialCount;
+		uint32_t materialOffset;
+		uint32_t lightCount;
+		uint32_t lightOffset;
+		uint32_t pointLightCount;
+		uint32_t pointLightOffset;
+		uint32_t recordCount;
+		uint32_t recordOffset;
+	};
+
+	// read a text scene into the tables and nodes
+	bool ParseText(const std::string& filename);
+	// map a binary scene and point the tables into it
+	bool MapBinary(const std::string& filename);
+	bool WriteText(const std::string& filename) const;
+	bool WriteBinary(const std::string& filename) const;
+	// bake the nodes into draw records
+	void BuildRecords();
+	// point the table accessors at the owned vectors
+	void UseOwnedTables();
+
+	// tables owned by a text or generated scene
+	std::vector<TEXTURE_RECORD> m_textures;
+	std::vector<MATERIAL_RECORD> m_materials;
+	std::vector<LIGHT_RECORD> m_lights;
+	std::vector<POINT_LIGHT_RECORD> m_pointLights;
+	std::vector<DRAW_RECORD> m_records;
+	std::vector<SceneGraph::SCENE_NODE> m_nodes;
+	// names of the nodes, empty for unnamed nodes
+	std::vector<std::string> m_nodeNames;
+
+	// tables of the loaded scene, owned or mapped
+	const TEXTURE_RECORD* m_pTextures;
+	int m_textureCount;
+	const MATERIAL_RECORD* m_pMaterials;
+	int m_materialCount;
+	const LIGHT_RECORD* m_pLights;
+	int m_lightCount;
+	const POINT_LIGHT_RECORD* m_pPointLights;
+	int m_pointLightCount;
+	const DRAW_RECORD* m_pRecords;
+	int m_recordCount;
+
+	// mapped binary file, NULL when none is mapped
+	void* m_pMapping;
+	size_t m_mappingSize;
+};
@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneGraph.cpp
+// ==============
+// retained list of scene nodes with cached world matrices
+//
+//  The scene is described once as a flat array of nodes.  Each frame
+//  only the nodes whose transform changed, and their children, get a
+//  new world matrix.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneGraph.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <cstddef>
+#include <iostream>
+
+/***********************************************************
+ *  SceneGraph()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneGraph::SceneGraph()
+{
+	m_bDirty = false;
+	m_pWorkerPool = NULL;
+}
+
+/***********************************************************
+ *  MakeNode()
+ *
+ *  This method is used for getting a node description with
+ *  unit scale, no rotation, no parent, no texture, white
+ *  color and a UV scale of one, that never moves.
+ ***********************************************************/
+SceneGraph::SCENE_NODE SceneGraph::MakeNode(int meshID)
+{
+	SCENE_NODE node;
+	node.meshID = meshID;
+	node.materialIndex = 0;
+	node.textureIndex = -1;
+	node.UVscale = glm::vec2(1.0f, 1.0f);
+	node.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	node.scaleXYZ = glm::vec3(1.0f, 1.0f, 1.0f);
+	node.rotationDegrees = glm::vec3(0.0f, 0.0f, 0.0f);
+	node.positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+	node.parent = -1;
+	node.bDynamic = false;
+	node.worldMatrix = glm::mat4(1.0f);
+	node.bDirty = true;
+
+	return(node);
+}
+
+/***********************************************************
+ *  AddNode()
+ *
+ *  This method is used for appending a node.  Its world
+ *  matrix is computed by the next UpdateWorldMatrices(),
+ *  which walks the nodes once in order, so a node whose
+ *  parent is not already in the graph is rejected.
+ ***********************************************************/
+int SceneGraph::AddNode(const SCENE_NODE& node)
+{
+	if ((node.parent < -1) || (node.parent >= static_cast<int>(m_nodes.size())))
+	{
+		std::cout << "Scene node parent " << node.parent << " must be added before the node" << std::endl;
+		return(-1);
+	}
+
+	m_nodes.push_back(node);
+	m_nodes.back().bDirty = true;
+	m_bDirty = true;
+
+	return(static_cast<int>(m_nodes.size()) - 1);
+}
+
+/***********************************************************
+ *  AddGroup()
+ *
+ *  This method is used for appending a node that draws
+ *  nothing and only positions its children.
+ ***********************************************************/
+int SceneGraph::AddGroup(glm::vec3 positionXYZ, int parent)
+{
+	SCENE_NODE group = MakeNode(MESH_NONE);
+	group.positionXYZ = positionXYZ;
+	group.parent = parent;
+
+	return(AddNode(group));
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every node.
+ ***********************************************************/
+void SceneGraph::Clear()
+{
+	m_nodes.clear();
+	m_bDirty = false;
+}
+
+/***********************************************************
+ *  SetTransform()
+ *
+ *  This method is used for changing the transform of a node
+ *  relative to its parent.
+ ***********************************************************/
+void SceneGraph::SetTransform(int node, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ)
+{
+	m_nodes[node].scaleXYZ = scaleXYZ;
+	m_nodes[node].rotationDegrees = rotationDegrees;
+	m_nodes[node].positionXYZ = positionXYZ;
+	m_nodes[node].bDirty = true;
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  UpdateWorldMatrices()
+ *
+ *  This method is used for recomputing the world matrix of
+ *  every dirty node.  A node whose parent was recomputed in
+ *  the same pass is recomputed too.  The local transforms
+ *  of all dirty nodes are composed as one batch, on the
+ *  worker threads when there are many, before the parent
+ *  matrices are applied.  When nothing changed since the
+ *  last call this returns immediately.
+ ***********************************************************/
+bool SceneGraph::UpdateWorldMatrices()
+{
+	if (m_bDirty == false)
+	{
+		return(false);
+	}
+
+	m_dirtyNodes.clear();
+	m_localTransforms.Clear();
+	for (size_t i = 0; i < m_nodes.size(); i++)
+	{
+		SCENE_NODE& node = m_nodes[i];
+
+		// parents come first, so their flag is already final
+		if ((node.parent >= 0) && (m_nodes[node.parent].bDirty == true))
+		{
+			node.bDirty = true;
+		}
+
+		if (node.bDirty == true)
+		{
+			m_dirtyNodes.push_back(static_cast<int>(i));
+			m_localTransforms.Add(node.scaleXYZ, node.rotationDegrees, node.positionXYZ);
+		}
+	}
+
+	m_localMatrices.resize(m_dirtyNodes.size());
+	if (m_localMatrices.empty() == false)
+	{
+		m_localTransforms.Compose(&m_localMatrices[0][0][0], m_pWorkerPool);
+	}
+
+	for (size_t i = 0; i < m_dirtyNodes.size(); i++)
+	{
+		SCENE_NODE& node = m_nodes[m_dirtyNodes[i]];
+		node.worldMatrix = m_localMatrices[i];
+		if (node.parent >= 0)
+		{
+			node.worldMatrix = m_nodes[node.parent].worldMatrix * node.worldMatrix;
+		}
+	}
+
+	// flags are cleared after the pass so children can see them
+	for (size_t i = 0; i < m_nodes.size(); i++)
+	{
+		m_nodes[i].bDirty = false;
+	}
+	m_bDirty = false;
+
+	return(true);
+}
+
+/***********************************************************
+ *  ComposeTransform()
+ *
+ *  This method is used for building a transform matrix that
+ *  scales, rotates about the Z, Y and X axes in that order,
+ *  then translates.  Many transforms at once are cheaper
+ *  through TransformBatch.
+ ***********************************************************/
+glm::mat4 SceneGraph::ComposeTransform(glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ)
+{
+	glm::mat4 scale = glm::scale(scaleXYZ);
+	glm::mat4 rotationX = glm::rotate(glm::radians(rotationDegrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 rotationY = glm::rotate(glm::radians(rotationDegrees.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 rotationZ = glm::rotate(glm::radians(rotationDegrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 translation = glm::translate(positionXYZ);
+
+	return(translation * rotationX * rotationY * rotationZ * scale);
+}
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneGraph.h
+// ============
+// retained list of scene nodes with cached world matrices
+//
+//  The scene is described once as a flat array of nodes.  Each frame
+//  only the nodes whose transform changed, and their children, get a
+//  new world matrix.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TransformBatch.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class WorkerPool;
+
+/***********************************************************
+ *  SceneGraph
+ *
+ *  This class stores the nodes of the scene in the order
+ *  they are added.  A parent must be added before its
+ *  children, so a single front-to-back pass updates every
+ *  world matrix.  Nodes without a mesh act as groups.
+ ***********************************************************/
+class SceneGraph
+{
+public:
+	// basic meshes a node can draw
+	enum MESH_ID
+	{
+		MESH_NONE = -1,
+		MESH_BOX,
+		MESH_CONE,
+		MESH_CYLINDER,
+		MESH_PLANE,
+		MESH_SPHERE,
+		MESH_TAPERED_CYLINDER,
+		MESH_TORUS,
+		MESH_COUNT
+	};
+
+	struct SCENE_NODE
+	{
+		// what to draw - MESH_NONE for a group
+		int meshID;
+		// index into the material table of the scene
+		int materialIndex;
+		// index into the texture table of the scene, -1 draws
+		// the node with its color instead of a texture
+		int textureIndex;
+		glm::vec2 UVscale;
+		glm::vec4 color;
+
+		// transform relative to the parent node
+		glm::vec3 scaleXYZ;
+		glm::vec3 rotationDegrees;
+		glm::vec3 positionXYZ;
+		// index of the parent node, -1 for none
+		int parent;
+		// moved while the scene runs, so the node and its
+		// children are left out of the static batches
+		bool bDynamic;
+
+		// parent world matrix times the local transform
+		glm::mat4 worldMatrix;
+		// set when the world matrix needs recomputing
+		bool bDirty;
+	};
+
+	// constructor
+	SceneGraph();
+
+	// node with identity transform, no parent and default values
+	static SCENE_NODE MakeNode(int meshID);
+	// add a node, returns its index, or -1 when its parent
+	// was not added before it
+	int AddNode(const SCENE_NODE& node);
+	// add a mesh-less node that children can be attached to
+	int AddGroup(glm::vec3 positionXYZ, int parent);
+	// remove every node
+	void Clear();
+	// threads used when many nodes change at once, NULL for none
+	void SetWorkerPool(WorkerPool* pWorkerPool) { m_pWorkerPool = pWorkerPool; }
+
+	// change the local transform of a node
+	void SetTransform(int node, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ);
+	// recompute the world matrices of dirty nodes and their children,
+	// returns false when nothing had to be recomputed
+	bool UpdateWorldMatrices();
+
+	const std::vector<SCENE_NODE>& GetNodes() const { return m_nodes; }
+	int GetNodeCount() const { return static_cast<int>(m_nodes.size()); }
+
+	// scale, then rotate about X, Y and Z, then translate
+	static glm::mat4 ComposeTransform(glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ);
+
+private:
+	// scene nodes, parents before children
+	std::vector<SCENE_NODE> m_nodes;
+	// set when any node is dirty
+	bool m_bDirty;
+	// threads for composing large batches of local transforms
+	WorkerPool* m_pWorkerPool;
+	// local transforms of the dirty nodes, composed in one batch
+	TransformBatch m_localTransforms;
+	std::vector<glm::mat4> m_localMatrices;
+	// indices of the dirty nodes, in node order
+	std::vector<int> m_dirtyNodes;
+};
@@ -8,6 +8,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "TextureLoader.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -15,15 +16,91 @@
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// the scene file rejects the materials the shader has no room for
+static_assert(SceneFile::MAX_MATERIALS == SceneUniforms::MAX_MATERIALS, "SceneFile::MAX_MATERIALS does not match the material block");
 
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
+	const char* g_NormalMatrixName = "normalMatrix";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
+	const char* g_TextureLayerName = "objectTextureLayer";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UVScaleName = "UVscale";
+	const char* g_MaterialIndexName = "materialIndex";
+	const char* g_InstancedName = "bInstanced";
+	const char* g_DepthOnlyName = "bDepthOnly";
+	const char* g_OverdrawViewName = "bOverdrawView";
+	const char* g_WeightedBlendName = "bWeightedBlend";
+
+	// shaders of the optional passes
+	const char* g_CullingShaderName = "shaders/cullCompute.glsl";
+	const char* g_CompositeVertexName = "shaders/transparencyCompositeVertex.glsl";
+	const char* g_CompositeFragmentName = "shaders/transparencyCompositeFragment.glsl";
+
+	// smallest screen size, as the fraction of the viewport height
+	// covered by the bounding sphere, that keeps each detail level
+	const float LEVEL_MIN_SIZES[PrimitiveMeshes::LOD_COUNT - 1] = { 0.08f, 0.02f };
+	// how far past a threshold the size must move before the level
+	// changes, so objects near a threshold do not pop every frame
+	const float LEVEL_HYSTERESIS = 0.25f;
+
+	// fewest objects worth baking into a static batch
+	const int STATIC_BATCH_MIN_OBJECTS = 2;
+	// scenes with more draw records are not baked, since the baked
+	// copies would cost more memory and startup time than the draw
+	// calls they save over instancing and culling
+	const int STATIC_BATCH_MAX_RECORDS = 8192;
+
+	// material and texture tags set for one draw, NULL for no texture
+	struct FRAME_STATE_TAGS
+	{
+		const char* materialTag;
+		const char* textureTag;
+	};
+
+	/***********************************************************
+	 *  ComputeNormalMatrix()
+	 *
+	 *  Compute the inverse transpose of the upper 3x3 of a
+	 *  column-major model matrix.  Its columns are the cross
+	 *  products of the model columns over the determinant, so
+	 *  no general inverse is needed.
+	 ***********************************************************/
+	void ComputeNormalMatrix(const float model[16], float normal[9])
+	{
+		const float* c0 = &model[0];
+		const float* c1 = &model[4];
+		const float* c2 = &model[8];
+
+		float cofactors[9] =
+		{
+			c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2], c1[0] * c2[1] - c1[1] * c2[0],
+			c2[1] * c0[2] - c2[2] * c0[1], c2[2] * c0[0] - c2[0] * c0[2], c2[0] * c0[1] - c2[1] * c0[0],
+			c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2], c0[0] * c1[1] - c0[1] * c1[0]
+		};
+
+		// a singular matrix has no inverse, so its cofactors are
+		// used unscaled; the fragment shader normalizes, and for
+		// a shape flattened along one axis they still point
+		// along that axis, with the other directions collapsed
+		float determinant = c0[0] * cofactors[0] + c0[1] * cofactors[1] + c0[2] * cofactors[2];
+		float scale = (determinant != 0.0f) ? 1.0f / determinant : 1.0f;
+		for (int i = 0; i < 9; i++)
+		{
+			normal[i] = cofactors[i] * scale;
+		}
+	}
 }
 
 /***********************************************************
@@ -31,10 +108,61 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager* pShaderManager)
+SceneManager::SceneManager(ShaderManager* pShaderManager, SceneUniforms* pSceneUniforms, ProgramCache* pProgramCache)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pSceneUniforms = pSceneUniforms;
+	m_pProgramCache = pProgramCache;
+	m_basicMeshes = new PrimitiveMeshes();
+	m_pWorkerPool = new WorkerPool();
+	m_sceneGraph.SetWorkerPool(m_pWorkerPool);
+	m_pTextureManager = new TextureManager();
+	m_bUseTextureCache = true;
+	m_pDrawRecords = NULL;
+	m_drawRecordCount = 0;
+	m_bSortDraws = true;
+	m_bUseInstancing = true;
+	m_bUseMultiDraw = true;
+	m_bCullObjects = true;
+	m_bUseLevelsOfDetail = true;
+	m_bStaticBatching = true;
+	m_bGpuCulling = false;
+	m_bGpuCullingReady = false;
+	m_pFrame = NULL;
+	m_viewportWidth = 1;
+	m_viewportHeight = 1;
+	m_bDepthPrepass = false;
+	m_bOverdrawView = false;
+	m_bWeightedBlend = false;
+	m_bWeightedBlendReady = false;
+	m_lightCount = 0;
+	m_bShadows = true;
+	m_bShadowsReady = false;
+	m_bShadowsDirty = true;
+	m_shadowKernelSize = 3;
+	for (int i = 0; i < SAMPLE_QUERY_FRAMES; i++)
+	{
+		m_sampleQueries[i].depthID = 0;
+		m_sampleQueries[i].shadeID = 0;
+		m_sampleQueries[i].bPending = false;
+	}
+	m_sampleQueryFrame = 0;
+	m_depthPrepassSamples = 0;
+	m_shadedSamples = 0;
+	m_renderCounters = RENDER_COUNTERS();
+	m_drawState = DRAW_STATE();
+	m_uniformLocations.model = -1;
+	m_uniformLocations.normalMatrix = -1;
+	m_uniformLocations.objectColor = -1;
+	m_uniformLocations.objectTexture = -1;
+	m_uniformLocations.objectTextureLayer = -1;
+	m_uniformLocations.useTexture = -1;
+	m_uniformLocations.uvScale = -1;
+	m_uniformLocations.materialIndex = -1;
+	m_uniformLocations.instanced = -1;
+	m_uniformLocations.depthOnly = -1;
+	m_uniformLocations.overdrawView = -1;
+	m_uniformLocations.weightedBlend = -1;
 }
 
 /***********************************************************
@@ -45,8 +173,22 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
+	m_pSceneUniforms = NULL;
+	m_pProgramCache = NULL;
+	for (int i = 0; i < SAMPLE_QUERY_FRAMES; i++)
+	{
+		if (m_sampleQueries[i].depthID != 0)
+		{
+			glDeleteQueries(1, &m_sampleQueries[i].depthID);
+			glDeleteQueries(1, &m_sampleQueries[i].shadeID);
+		}
+	}
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	delete m_pWorkerPool;
+	m_pWorkerPool = NULL;
+	delete m_pTextureManager;
+	m_pTextureManager = NULL;
 }
 
 /***********************************************************
@@ -55,88 +197,38 @@ SceneManager::~SceneManager()
  *  This method is used for loading textures from image files,
  *  configuring the texture mapping parameters in OpenGL,
  *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  the next available texture array layer in memory.
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
-
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+	TextureLoader textureLoader(m_pWorkerPool, m_pTextureManager);
+	textureLoader.SetUseTextureCache(m_bUseTextureCache);
+	textureLoader.AddTexture(filename, tag);
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
-
-		return true;
+	const TextureLoader::LOADED_TEXTURE& texture = textureLoader.LoadAll()[0];
+	if (texture.bLoaded == false)
+	{
+		// Error loading the image
+		return false;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	// register the loaded texture and associate it with the special tag string
+	RegisterTexture(tag, texture.handle);
 
-	// Error loading the image
-	return false;
+	return true;
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for binding the loaded texture arrays
+ *  to OpenGL texture memory slots.  Each array holds every
+ *  texture of one size and format, so the number of slots
+ *  no longer limits the number of textures.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
-	}
+	m_pTextureManager->BindArrays();
 }
 
 /***********************************************************
@@ -147,97 +239,68 @@ void SceneManager::BindGLTextures()
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glGenTextures(1, &m_textureIDs[i].ID);
-	}
+	m_pTextureManager->DestroyArrays();
+	m_textureIDs.clear();
+	m_textureNames.Clear();
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  RegisterTexture()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for adding a loaded texture to the
+ *  list of textures and to the tag lookup table.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::RegisterTexture(const std::string& tag, int textureHandle)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	TEXTURE_INFO textureInfo;
+	textureInfo.handle = textureHandle;
+	textureInfo.tag = tag;
+	m_textureIDs.push_back(textureInfo);
 
-	while ((index < m_loadedTextures) && (bFound == false))
-	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
-	}
-
-	return(textureID);
+	m_textureNames.Insert(tag.c_str(), textureHandle);
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  FindTextureHandle()
  *
- *  This method is used for getting a slot index for the previously
+ *  This method is used for getting the handle of the previously
  *  loaded texture bitmap associated with the passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+int SceneManager::FindTextureHandle(const char* tag) const
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
-	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
-	}
-
-	return(textureSlot);
+	return(m_textureNames.Find(tag));
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  RegisterMaterial()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for adding a material to the defined
+ *  materials list.  The returned handle indexes the list.
+ *  Registering a tag a second time returns the handle of
+ *  the first registration.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+int SceneManager::RegisterMaterial(const OBJECT_MATERIAL& material)
 {
-	if (m_objectMaterials.size() == 0)
+	int materialHandle = m_materialNames.Find(material.tag.c_str());
+	if (materialHandle < 0)
 	{
-		return(false);
+		materialHandle = static_cast<int>(m_objectMaterials.size());
+		m_objectMaterials.push_back(material);
+		m_materialNames.Insert(material.tag.c_str(), materialHandle);
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
-	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
-		{
-			index++;
-		}
-	}
+	return(materialHandle);
+}
 
-	return(true);
+/***********************************************************
+ *  FindMaterialHandle()
+ *
+ *  This method is used for getting the handle of the previously
+ *  defined material associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindMaterialHandle(const char* tag) const
+{
+	return(m_materialNames.Find(tag));
 }
 
 /***********************************************************
@@ -253,29 +316,40 @@ void SceneManager::SetTransformations(
 	float ZrotationDegrees,
 	glm::vec3 positionXYZ)
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
+	glm::mat4 modelView = SceneGraph::ComposeTransform(
+		scaleXYZ,
+		glm::vec3(XrotationDegrees, YrotationDegrees, ZrotationDegrees),
+		positionXYZ);
 
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
+	SetModelMatrix(modelView);
+}
 
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+/***********************************************************
+ *  SetModelMatrix()
+ *
+ *  This method is used for setting the passed in model
+ *  matrix into the shader for the next draw command.  The
+ *  normal matrix is computed here once, not per vertex.
+ ***********************************************************/
+void SceneManager::SetModelMatrix(const glm::mat4& modelMatrix)
+{
+	float normalMatrix[9];
+	ComputeNormalMatrix(glm::value_ptr(modelMatrix), normalMatrix);
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
+	SetModelMatrix(glm::value_ptr(modelMatrix), normalMatrix);
+}
+
+/***********************************************************
+ *  SetModelMatrix()
+ *
+ *  This method is used for setting the passed in model
+ *  matrix and its precomputed normal matrix into the
+ *  shader for the next draw command.
+ ***********************************************************/
+void SceneManager::SetModelMatrix(const float modelMatrix[16], const float normalMatrix[9])
+{
+	glUniformMatrix4fv(m_uniformLocations.model, 1, GL_FALSE, modelMatrix);
+	glUniformMatrix3fv(m_uniformLocations.normalMatrix, 1, GL_FALSE, normalMatrix);
 }
 
 /***********************************************************
@@ -298,29 +372,38 @@ void SceneManager::SetShaderColor(
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
+	glUniform1i(m_uniformLocations.useTexture, false);
+	glUniform4fv(m_uniformLocations.objectColor, 1, glm::value_ptr(currentColor));
 }
 
 /***********************************************************
  *  SetShaderTexture()
  *
  *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  associated with the passed in tag into the shader.
  ***********************************************************/
 void SceneManager::SetShaderTexture(
 	std::string textureTag)
 {
-	if (NULL != m_pShaderManager)
+	SetShaderTexture(FindTextureHandle(textureTag.c_str()));
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data of the
+ *  passed in texture handle into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	int textureHandle)
+{
+	if (textureHandle >= 0)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		glUniform1i(m_uniformLocations.useTexture, true);
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		// select the array's texture unit and the texture's layer in it
+		glUniform1i(m_uniformLocations.objectTexture, m_pTextureManager->BindForDraw(textureHandle));
+		glUniform1i(m_uniformLocations.objectTextureLayer, m_pTextureManager->GetLayer(textureHandle));
 	}
 }
 
@@ -332,10 +415,7 @@ void SceneManager::SetShaderTexture(
  ***********************************************************/
 void SceneManager::SetTextureUVScale(float u, float v)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
+	glUniform2f(m_uniformLocations.uvScale, u, v);
 }
 
 /***********************************************************
@@ -347,23 +427,73 @@ void SceneManager::SetTextureUVScale(float u, float v)
 void SceneManager::SetShaderMaterial(
 	std::string materialTag)
 {
-	if (m_objectMaterials.size() > 0)
+	SetShaderMaterial(FindMaterialHandle(materialTag.c_str()));
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for selecting the entry of the
+ *  material table used by the next draw command.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	int materialHandle)
+{
+	// the material values are already in the material table,
+	// so a draw only selects its entry
+	if (materialHandle >= 0)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		glUniform1i(m_uniformLocations.materialIndex, materialHandle);
+	}
+}
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+/***********************************************************
+ *  UploadMaterials()
+ *
+ *  This method is used for writing the defined materials
+ *  into the material table uniform block, in handle order.
+ ***********************************************************/
+void SceneManager::UploadMaterials()
+{
+	std::vector<SceneUniforms::MATERIAL_DATA> materials(m_objectMaterials.size());
+	for (size_t i = 0; i < m_objectMaterials.size(); i++)
+	{
+		materials[i].ambientColor = m_objectMaterials[i].ambientColor;
+		materials[i].ambientStrength = m_objectMaterials[i].ambientStrength;
+		materials[i].diffuseColor = m_objectMaterials[i].diffuseColor;
+		materials[i].padding0 = 0.0f;
+		materials[i].specularColor = m_objectMaterials[i].specularColor;
+		materials[i].shininess = m_objectMaterials[i].shininess;
+	}
+
+	if (materials.size() > 0)
+	{
+		m_pSceneUniforms->SetMaterials(&materials[0], static_cast<int>(materials.size()));
 	}
 }
 
+/***********************************************************
+ *  ResolveUniformLocations()
+ *
+ *  This method is used for looking up the locations of the
+ *  uniforms that are set for every draw.
+ ***********************************************************/
+void SceneManager::ResolveUniformLocations()
+{
+	m_uniformLocations.model = m_pSceneUniforms->GetUniformLocation(g_ModelName);
+	m_uniformLocations.normalMatrix = m_pSceneUniforms->GetUniformLocation(g_NormalMatrixName);
+	m_uniformLocations.objectColor = m_pSceneUniforms->GetUniformLocation(g_ColorValueName);
+	m_uniformLocations.objectTexture = m_pSceneUniforms->GetUniformLocation(g_TextureValueName);
+	m_uniformLocations.objectTextureLayer = m_pSceneUniforms->GetUniformLocation(g_TextureLayerName);
+	m_uniformLocations.useTexture = m_pSceneUniforms->GetUniformLocation(g_UseTextureName);
+	m_uniformLocations.uvScale = m_pSceneUniforms->GetUniformLocation(g_UVScaleName);
+	m_uniformLocations.materialIndex = m_pSceneUniforms->GetUniformLocation(g_MaterialIndexName);
+	m_uniformLocations.instanced = m_pSceneUniforms->GetUniformLocation(g_InstancedName);
+	m_uniformLocations.depthOnly = m_pSceneUniforms->GetUniformLocation(g_DepthOnlyName);
+	m_uniformLocations.overdrawView = m_pSceneUniforms->GetUniformLocation(g_OverdrawViewName);
+	m_uniformLocations.weightedBlend = m_pSceneUniforms->GetUniformLocation(g_WeightedBlendName);
+}
+
 /**************************************************************/
 /*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
 /*** preparing and rendering their own 3D replicated scenes.***/
@@ -376,166 +506,182 @@ void SceneManager::SetShaderMaterial(
  *
  *  This method is used for preparing the 3D scene by loading
  *  the shapes, textures in memory to support the 3D scene
- *  rendering
+ *  rendering.  The image files are decoded in parallel on
+ *  the worker pool and uploaded as each decode finishes.
  ***********************************************************/
 void SceneManager::LoadSceneTextures()
 {
 	/*** STUDENTS - add the code BELOW for loading the textures that ***/
-	/*** will be used for mapping to objects in the 3D scene. Up to  ***/
-	/*** 16 textures can be loaded per scene. Refer to the code in   ***/
-	/*** the OpenGL Sample for help.                                 ***/
+	/*** will be used for mapping to objects in the 3D scene. Any    ***/
+	/*** number of textures can be loaded per scene. Refer to the    ***/
+	/*** code in the OpenGL Sample for help.                         ***/
 
+	TextureLoader textureLoader(m_pWorkerPool, m_pTextureManager);
+	textureLoader.SetUseTextureCache(m_bUseTextureCache);
 
-	this->CreateGLTexture("textures/Wood.jpg", "Wood");
-	this->CreateGLTexture("textures/mac.jpg", "laptop");
-	this->CreateGLTexture("textures/white.jpg", "white");
-	this->CreateGLTexture("textures/jotter.png", "jotter");
-	this->CreateGLTexture("textures/pod.jpg", "Pod");
-	this->CreateGLTexture("textures/pen.png", "pen");
-	this->CreateGLTexture("textures/rubber.jpg", "rubber");
-	this->CreateGLTexture("textures/glass.jpg", "glass");
-	this->CreateGLTexture("textures/base.jpg", "base");
-	this->CreateGLTexture("textures/case.png", "case");
-	
+	const SceneFile::TEXTURE_RECORD* pTextures = m_sceneFile.GetTextures();
+	for (int i = 0; i < m_sceneFile.GetTextureCount(); i++)
+	{
+		textureLoader.AddTexture(pTextures[i].filename, pTextures[i].tag);
+	}
+
+	// register the loaded textures in the order they were queued,
+	// so texture handles do not depend on which decode finished first
+	// and the scene's texture table indexes them directly
+	const std::vector<TextureLoader::LOADED_TEXTURE>& textures = textureLoader.LoadAll();
+	m_sceneTextureHandles.assign(textures.size(), -1);
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].bLoaded == true)
+		{
+			RegisterTexture(textures[i].tag, textures[i].handle);
+			m_sceneTextureHandles[i] = textures[i].handle;
+		}
+	}
+	textureLoader.PrintTimings(std::cout);
 
 
 	// after the texture image data is loaded into memory, the
-	// loaded textures need to be bound to texture slots - there
-	// are a total of 16 available slots for scene textures
+	// texture arrays need to be bound to texture slots - there
+	// is one slot per array, not per texture
 	BindGLTextures();
 }
 
+/***********************************************************
+ *  BakeSceneTextures()
+ *
+ *  This method is used for the offline bake step.  Every
+ *  texture of the passed in scene file is encoded into the
+ *  compressed texture cache so the first launch does not
+ *  pay for it.  It needs no GL context.
+ ***********************************************************/
+bool SceneManager::BakeSceneTextures(const std::string& sceneFilename)
+{
+	SceneFile sceneFile;
+	if (sceneFile.Load(sceneFilename) == false)
+	{
+		return(false);
+	}
+
+	WorkerPool workerPool;
+	TextureLoader textureLoader(&workerPool, NULL);
+
+	const SceneFile::TEXTURE_RECORD* pTextures = sceneFile.GetTextures();
+	for (int i = 0; i < sceneFile.GetTextureCount(); i++)
+	{
+		textureLoader.AddTexture(pTextures[i].filename, pTextures[i].tag);
+	}
+	textureLoader.BakeAll();
+	textureLoader.PrintTimings(std::cout);
+
+	return(true);
+}
+
 /***********************************************************
  *  DefineObjectMaterials()
  *
  *  This method is used for configuring the various material
  *  settings for all of the objects within the 3D scene.
+ *  The materials are read from the scene file.
  ***********************************************************/
 void SceneManager::DefineObjectMaterials()
 {
-	/*** STUDENTS - add the code BELOW for defining object materials. ***/
-	/*** There is no limit to the number of object materials that can ***/
-	/*** be defined. Refer to the code in the OpenGL Sample for help  ***/
-
-	//Define Objects Materials To improve lignting effect
-
-
-	// Normal Material
-	OBJECT_MATERIAL normal_Material_shade;
-	normal_Material_shade.ambientColor = glm::vec3(0.02f, 0.02f, 0.02f); // Uniform gray
-	normal_Material_shade.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);    // Balanced diffuse for visibility
-	normal_Material_shade.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);   // Low specular for matte look
-	normal_Material_shade.shininess = 32.0f;                             // Moderate shininess
-	normal_Material_shade.ambientStrength = 0.2f;                       // Stronger ambient strength
-	normal_Material_shade.tag = "NORMAL";
-
-	// Glass Material
-	OBJECT_MATERIAL glassMaterial;
-	glassMaterial.ambientColor = glm::vec3(0.0f, 0.0f, 0.0f);            // Minimal ambient for glass
-	glassMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f);            // Subtle diffuse for edges
-	glassMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);           // Strong specular for shine
-	glassMaterial.shininess = 128.0f;                                    // Very shiny surface
-	glassMaterial.ambientStrength = 0.1f;                               // Light ambient for clarity
-	glassMaterial.tag = "GlassMaterial";
-
-	// Water Material
-	OBJECT_MATERIAL waterMaterial;
-	waterMaterial.ambientColor = glm::vec3(0.0f, 0.0f, 0.4f);            // Slight blue tint for water
-	waterMaterial.diffuseColor = glm::vec3(0.3f, 0.5f, 0.8f);            // Softer diffuse for transparency
-	waterMaterial.specularColor = glm::vec3(0.6f, 0.8f, 1.0f);           // High specular for reflection
-	waterMaterial.shininess = 64.0f;                                     // Moderate shininess
-	waterMaterial.ambientStrength = 0.25f;                              // Balanced ambient
-	waterMaterial.tag = "WaterMaterial";
-
-	// Rubber Material
-	OBJECT_MATERIAL rubberMaterial;
-	rubberMaterial.ambientColor = glm::vec3(0.1f, 0.1f, 0.1f);           // Low ambient for rubber
-	rubberMaterial.diffuseColor = glm::vec3(0.6f, 0.6f, 0.6f);           // Visible diffuse light
-	rubberMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);          // Minimal specular for matte finish
-	rubberMaterial.shininess = 8.0f;                                     // Low shininess for a rubber-like effect
-	rubberMaterial.ambientStrength = 0.15f;                             // Balanced ambient strength
-	rubberMaterial.tag = "RubberMaterial";
-
-	// Plastic Material
-	OBJECT_MATERIAL plasticMaterial;
-	plasticMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.2f);   // Slight ambient for smooth appearance
-	plasticMaterial.diffuseColor = glm::vec3(0.8f, 0.8f, 0.8f);   // Strong diffuse for smooth light scattering
-	plasticMaterial.specularColor = glm::vec3(0.5f, 0.5f, 0.5f);  // Moderate specular for semi-glossy effect
-	plasticMaterial.shininess = 32.0f;                            // Medium shininess for a plastic-like reflection
-	plasticMaterial.ambientStrength = 0.1f;                      // Moderate ambient strength
-	plasticMaterial.tag = "PlasticMaterial";
-	m_objectMaterials.push_back(plasticMaterial);
-
-	// Aluminum Material
-	OBJECT_MATERIAL aluminumMaterial;
-	aluminumMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.2f);  // Subtle base reflection
-	aluminumMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.3f);  // Brighter diffuse for metal shine
-	aluminumMaterial.specularColor = glm::vec3(0.9f, 0.9f, 0.6f); // High specular for a metallic look
-	aluminumMaterial.shininess = 64.0f;                           // Medium shininess
-	aluminumMaterial.ambientStrength = 0.5f;                     // Enhanced ambient light reflection
-	aluminumMaterial.tag = "AluminumMaterial";
-	m_objectMaterials.push_back(aluminumMaterial);
-
-
-
-	// Push all materials to the list
-	m_objectMaterials.push_back(normal_Material_shade);
-	m_objectMaterials.push_back(glassMaterial);
-	m_objectMaterials.push_back(waterMaterial);
-	m_objectMaterials.push_back(rubberMaterial);
-
-
-
-
-
-	m_objectMaterials.push_back(normal_Material_shade);
+	/*** STUDENTS - add the materials to the scene file.  Up   ***/
+	/*** to 64 object materials can be defined, and the scene   ***/
+	/*** file is rejected when it has more.                     ***/
 
+	const SceneFile::MATERIAL_RECORD* pMaterials = m_sceneFile.GetMaterials();
+	m_sceneMaterialHandles.assign(m_sceneFile.GetMaterialCount(), -1);
+	for (int i = 0; i < m_sceneFile.GetMaterialCount(); i++)
+	{
+		OBJECT_MATERIAL material;
+		material.ambientColor = glm::make_vec3(pMaterials[i].ambientColor);
+		material.ambientStrength = pMaterials[i].ambientStrength;
+		material.diffuseColor = glm::make_vec3(pMaterials[i].diffuseColor);
+		material.specularColor = glm::make_vec3(pMaterials[i].specularColor);
+		material.shininess = pMaterials[i].shininess;
+		material.tag = pMaterials[i].tag;
+
+		// each gets a handle for RenderScene()
+		m_sceneMaterialHandles[i] = RegisterMaterial(material);
+	}
 }
 
 /***********************************************************
  *  SetupSceneLights()
  *
  *  This method is called to add and configure the light
- *  sources for the 3D scene.  There are up to 4 light sources.
+ *  sources for the 3D scene.  There are up to 4 light sources,
+ *  read from the scene file, and any number of point lights
+ *  that are shaded through the light clusters.  The shadow
+ *  atlas is rendered again for the new lights.
  ***********************************************************/
 void SceneManager::SetupSceneLights()
 {
 	// Enable lighting in the shader
-	m_pShaderManager->setBoolValue("bUseLighting", true);
-
-	// Light Source 1: Warm Light (Left Side of the Scene)
-	m_pShaderManager->setBoolValue("lightSources[0].bActive", true);
-	m_pShaderManager->setVec3Value("lightSources[0].position", glm::vec3(-10.0f, 5.0f, 0.0f)); // Positioned to the left
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", glm::vec3(0.05f, 0.05f, 0.05f)); // Soft ambient
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", glm::vec3(0.25f, 0.2f, 0.15f));  // Warm diffuse
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", glm::vec3(0.25f, 0.225f, 0.2f)); // Warm specular
-
-	// Light Source 2: Cool Light (Left Side, Further Back)
-	m_pShaderManager->setBoolValue("lightSources[1].bActive", true);
-	m_pShaderManager->setVec3Value("lightSources[1].position", glm::vec3(-10.0f, 8.0f, -5.0f)); // Left and back
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", glm::vec3(0.025f, 0.025f, 0.05f)); // Cool ambient
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", glm::vec3(0.15f, 0.175f, 0.25f));  // Cool diffuse
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", glm::vec3(0.125f, 0.15f, 0.2f));  // Cool specular
-
-	// Light Source 3: Overhead Light (Centered but Slightly Left)
-	m_pShaderManager->setBoolValue("lightSources[2].bActive", true);
-	m_pShaderManager->setVec3Value("lightSources[2].position", glm::vec3(-5.0f, 12.0f, 0.0f)); // Centered overhead but shifted left
-	m_pShaderManager->setVec3Value("lightSources[2].ambientColor", glm::vec3(0.075f, 0.075f, 0.075f)); // Neutral ambient
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", glm::vec3(0.25f, 0.25f, 0.25f));    // Neutral diffuse
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", glm::vec3(0.25f, 0.25f, 0.25f));   // Neutral specular
-
-	// Disable any additional unused lights
-	for (int i = 3; i < 4; ++i)
-	{
-		std::stringstream ss;
-		ss << "lightSources[" << i << "].bActive";
-		m_pShaderManager->setBoolValue(ss.str().c_str(), false);
+	glUniform1i(m_pSceneUniforms->GetUniformLocation(g_UseLightingName), true);
+
+	// unused lights and fields stay zero, shadows included
+	SceneUniforms::LIGHT_DATA* lights = m_lights;
+	memset(static_cast<void*>(m_lights), 0, sizeof(m_lights));
+
+	const SceneFile::LIGHT_RECORD* pLights = m_sceneFile.GetLights();
+	int lightCount = m_sceneFile.GetLightCount();
+	if (lightCount > SceneUniforms::MAX_LIGHTS)
+	{
+		std::cout << "Only " << SceneUniforms::MAX_LIGHTS << " light sources are supported" << std::endl;
+		lightCount = SceneUniforms::MAX_LIGHTS;
 	}
-}
+	for (int i = 0; i < lightCount; i++)
+	{
+		lights[i].position = glm::make_vec3(pLights[i].position);
+		lights[i].ambientColor = glm::make_vec3(pLights[i].ambientColor);
+		lights[i].diffuseColor = glm::make_vec3(pLights[i].diffuseColor);
+		lights[i].specularColor = glm::make_vec3(pLights[i].specularColor);
+		lights[i].focalStrength = pLights[i].focalStrength;
+		lights[i].specularIntensity = pLights[i].specularIntensity;
+		lights[i].bActive = 1;
+	}
+	m_lightCount = lightCount;
+	m_bShadowsDirty = true;
 
+	// write all the lights into the light block at once
+	m_pSceneUniforms->SetLights(lights, SceneUniforms::MAX_LIGHTS);
 
+	const SceneFile::POINT_LIGHT_RECORD* pPointLights = m_sceneFile.GetPointLights();
+	std::vector<LightClusters::POINT_LIGHT> pointLights(m_sceneFile.GetPointLightCount());
+	for (size_t i = 0; i < pointLights.size(); i++)
+	{
+		pointLights[i].position = glm::make_vec3(pPointLights[i].position);
+		pointLights[i].range = pPointLights[i].range;
+		pointLights[i].color = glm::make_vec3(pPointLights[i].color);
+		pointLights[i].intensity = pPointLights[i].intensity;
+	}
+	m_lightClusters.Create();
+	m_lightClusters.SetLights(pointLights);
+}
 
+/***********************************************************
+ *  LoadScene()
+ *
+ *  This method is used for loading the scene file that
+ *  PrepareScene() and RenderScene() use.  A compiled scene
+ *  is mapped instead of parsed.
+ ***********************************************************/
+bool SceneManager::LoadScene(const std::string& filename)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	if (m_sceneFile.Load(filename) == false)
+	{
+		return(false);
+	}
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - start;
 
+	std::cout << "INFO: Loaded scene " << filename << ": " << m_sceneFile.GetRecordCount()
+		<< " draws in " << loadTime.count() << " ms" << std::endl;
+
+	return(true);
+}
 
 /***********************************************************
  *  PrepareScene()
@@ -546,585 +692,1368 @@ void SceneManager::SetupSceneLights()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	// start the programs of the optional passes first, so the
+	// driver can build them while the textures load
+	bool bGpuCulling = (m_bGpuCulling == true) && (GpuCulling::IsSupported() == true);
+	bool bWeightedBlend = (m_bWeightedBlend == true) && (TransparencyBuffer::IsSupported() == true);
+	if (bGpuCulling == true)
+	{
+		const ProgramCache::SHADER_STAGE stage = { GL_COMPUTE_SHADER, g_CullingShaderName };
+		m_pProgramCache->Request(&stage, 1);
+	}
+	if (bWeightedBlend == true)
+	{
+		const ProgramCache::SHADER_STAGE stages[] =
+		{
+			{ GL_VERTEX_SHADER, g_CompositeVertexName },
+			{ GL_FRAGMENT_SHADER, g_CompositeFragmentName }
+		};
+		m_pProgramCache->Request(stages, 2);
+	}
+
+	// look up the per-draw uniform locations once
+	ResolveUniformLocations();
 	// define the materials for objects in the scene
 	DefineObjectMaterials();
+	UploadMaterials();
 	// add and define the light sources for the scene
 	SetupSceneLights();
 
 	LoadSceneTextures();
 
-	//load Box mesh For Rendering Books
-	m_basicMeshes->LoadBoxMesh();
-	//load Plane Mesh For rendering the Grpound
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadTaperedCylinderMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadConeMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadSphereMesh();
+	// build every basic shape into the shared vertex buffers
+	m_basicMeshes->LoadMeshes();
 
-}
+	// culling on the GPU falls back to the CPU when unavailable
+	if (bGpuCulling == true)
+	{
+		m_bGpuCullingReady = m_gpuCulling.Create(*m_pProgramCache, g_CullingShaderName);
+	}
 
-/***********************************************************
- *  RenderScene()
- *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes
- ***********************************************************/
-void SceneManager::RenderScene()
-{
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	//table
-	/******************************************************************/
-
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(35.50f, 9.0f, 15.50f);
-
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, -10.0f, 10.0f);
-
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	// blended records fall back to back-to-front drawing
+	if (bWeightedBlend == true)
+	{
+		m_bWeightedBlendReady = m_transparencyBuffer.Create(*m_pProgramCache, g_CompositeVertexName, g_CompositeFragmentName);
+	}
 
-	SetShaderColor(0.1, 0.1, 0.1, 1);
+	// the atlas is rendered by the first frame
+	if (m_bShadows == true)
+	{
+		m_shadowAtlas.SetKernelSize(m_shadowKernelSize);
+		m_bShadowsReady = m_shadowAtlas.Create(ShadowAtlas::DEFAULT_SIZE);
+		m_bShadowsDirty = true;
+	}
 
-	SetShaderMaterial("NORMAL");
+	// occlusion queries counting the samples of each pass
+	for (int i = 0; i < SAMPLE_QUERY_FRAMES; i++)
+	{
+		glGenQueries(1, &m_sampleQueries[i].depthID);
+		glGenQueries(1, &m_sampleQueries[i].shadeID);
+		m_sampleQueries[i].bPending = false;
+	}
 
-	SetShaderTexture("base");
+	// nothing resizes the viewport once the window is made,
+	// the projection assumes the window size as well
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	m_viewportWidth = viewport[2];
+	m_viewportHeight = viewport[3];
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	/****************************************************************/
+	// describe the scene objects once, RenderScene() only draws them
+	BuildSceneGraph();
+}
 
+/***********************************************************
+ *  BuildSceneGraph()
+ *
+ *  This method is used for adding the objects of a text
+ *  scene to the scene graph, so moving a node moves its
+ *  children.  A compiled scene has no nodes and is drawn
+ *  straight from its mapped draw records.  Either way the
+ *  records that never move are baked into static batches.
+ ***********************************************************/
+void SceneManager::BuildSceneGraph()
+{
+	m_sceneGraph.Clear();
+	m_drawRecords.clear();
 
+	if (m_sceneFile.IsBinary() == true)
+	{
+		m_pDrawRecords = m_sceneFile.GetRecords();
+		m_drawRecordCount = m_sceneFile.GetRecordCount();
+		UpdateNormalMatrices();
+		UpdateObjectBounds();
+		m_objectBVH.Build(m_objectBounds);
+		m_recordLevels.assign(m_drawRecordCount, 0);
+		BuildStaticBatches();
+		return;
+	}
 
+	const std::vector<SceneGraph::SCENE_NODE>& nodes = m_sceneFile.GetNodes();
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		m_sceneGraph.AddNode(nodes[i]);
+	}
+	m_sceneGraph.UpdateWorldMatrices();
+
+	// the records already hold the world matrices just computed
+	m_drawRecords.assign(m_sceneFile.GetRecords(), m_sceneFile.GetRecords() + m_sceneFile.GetRecordCount());
+	m_pDrawRecords = m_drawRecords.empty() ? NULL : &m_drawRecords[0];
+	m_drawRecordCount = static_cast<int>(m_drawRecords.size());
+	UpdateNormalMatrices();
+	UpdateObjectBounds();
+	m_objectBVH.Build(m_objectBounds);
+	m_recordLevels.assign(m_drawRecordCount, 0);
+	BuildStaticBatches();
+}
 
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 13.0f);
+/***********************************************************
+ *  UpdateNormalMatrices()
+ *
+ *  This method is used for computing the normal matrix of
+ *  every draw record from its world matrix.  It runs when
+ *  the scene is built and when nodes move, so the shaders
+ *  never invert a matrix.
+ ***********************************************************/
+void SceneManager::UpdateNormalMatrices()
+{
+	m_normalMatrices.resize(static_cast<size_t>(m_drawRecordCount) * 9);
+	for (int i = 0; i < m_drawRecordCount; i++)
+	{
+		ComputeNormalMatrix(m_pDrawRecords[i].worldMatrix, &m_normalMatrices[static_cast<size_t>(i) * 9]);
+	}
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  UpdateObjectBounds()
+ *
+ *  This method is used for computing the world-space box of
+ *  every draw record from the box of its mesh and its world
+ *  matrix.  The objects moved, so the shadows are stale.
+ ***********************************************************/
+void SceneManager::UpdateObjectBounds()
+{
+	m_bShadowsDirty = true;
+	m_objectBounds.resize(m_drawRecordCount);
+	for (int i = 0; i < m_drawRecordCount; i++)
+	{
+		const SceneFile::DRAW_RECORD& record = m_pDrawRecords[i];
+		float localMinimum[3];
+		float localMaximum[3];
+		m_basicMeshes->GetBounds(record.meshID, localMinimum, localMaximum);
+		m_objectBounds[i] = BoundingVolumeHierarchy::TransformBounds(localMinimum, localMaximum, record.worldMatrix);
+	}
+}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 0.0f, 10.0f);
+/***********************************************************
+ *  SelectLevel()
+ *
+ *  This method is used for picking the detail level of a
+ *  draw record from the share of the viewport height its
+ *  bounding sphere covers.  A level is only left once the
+ *  size moves a margin past the threshold, so an object
+ *  sitting on a threshold keeps its level.  Shapes with a
+ *  single level, such as the box and the plane, always
+ *  draw level 0, so they keep one sort and batch key.
+ ***********************************************************/
+int SceneManager::SelectLevel(int recordIndex, const glm::vec4& clipW, float projectionScale)
+{
+	int lastLevel = PrimitiveMeshes::GetLevelCount(m_pDrawRecords[recordIndex].meshID) - 1;
+	if ((m_bUseLevelsOfDetail == false) || (lastLevel <= 0))
+	{
+		return(0);
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	const BoundingVolumeHierarchy::AABB& bounds = m_objectBounds[recordIndex];
+	glm::vec3 center = (bounds.minimum + bounds.maximum) * 0.5f;
+	glm::vec3 halfSize = (bounds.maximum - bounds.minimum) * 0.5f;
+	float radius = std::sqrt(halfSize.x * halfSize.x + halfSize.y * halfSize.y + halfSize.z * halfSize.z);
 
-	SetShaderColor(0.8, 0.8, 0.8, 1);
+	// w is the distance along the view direction, or 1 for
+	// an orthographic projection
+	float w = clipW.x * center.x + clipW.y * center.y + clipW.z * center.z + clipW.w;
+	if (w <= radius)
+	{
+		m_recordLevels[recordIndex] = 0;
+		return(0);
+	}
+	float size = radius * projectionScale / w;
 
-	SetShaderMaterial("NORMAL");
+	int level = m_recordLevels[recordIndex];
+	while ((level > 0) && (size >= LEVEL_MIN_SIZES[level - 1] * (1.0f + LEVEL_HYSTERESIS)))
+	{
+		level--;
+	}
+	while ((level < lastLevel) && (size < LEVEL_MIN_SIZES[level] * (1.0f - LEVEL_HYSTERESIS)))
+	{
+		level++;
+	}
+	m_recordLevels[recordIndex] = level;
 
-	SetShaderTexture("Wood");
+	return(level);
+}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
+/***********************************************************
+ *  QueueDraws()
+ *
+ *  This method is used for filling the render queue with
+ *  the draw records of the frame that are inside the view
+ *  frustum, found through the bounding volume hierarchy
+ *  unless culling is off or done on the GPU.  Opaque draws are keyed
+ *  by the state they need; untextured draws with alpha are
+ *  blended, so they are keyed back to front by their
+ *  distance from the camera.  Unsorted drawing still keeps
+ *  the blended draws after the opaque ones, which are drawn
+ *  without blending.  Records baked into a static batch are
+ *  left out; the visible batches are found here as well.
+ *  Everything is written to the frame, apart from the
+ *  detail levels kept for the hysteresis, which the frame
+ *  gets a copy of.
+ ***********************************************************/
+void SceneManager::QueueDraws(const glm::mat4& viewProjection, const glm::mat4& projection, const glm::vec3& viewPosition,
+	PREPARED_FRAME& frame)
+{
+	// there is a single shader program for now
+	const int program = 0;
 
+	frame.cullNodesTested = 0;
+	frame.cullObjectsTested = 0;
+	frame.objectsCulled = 0;
+	if ((m_bCullObjects == true) && (IsGpuCullingActive() == false))
+	{
+		BoundingVolumeHierarchy::CULL_STATS stats;
+		m_objectBVH.Cull(viewProjection, frame.visibleRecords, stats);
+		frame.cullNodesTested = stats.nodesTested;
+		frame.cullObjectsTested = stats.objectsTested;
+		frame.objectsCulled = stats.objectsCulled;
+
+		// the tree returns them in tree order, unsorted drawing
+		// still wants file order
+		if (m_bSortDraws == false)
+		{
+			std::sort(frame.visibleRecords.begin(), frame.visibleRecords.end());
+		}
+	}
+	else
+	{
+		frame.visibleRecords.resize(m_drawRecordCount);
+		for (int i = 0; i < m_drawRecordCount; i++)
+		{
+			frame.visibleRecords[i] = i;
+		}
+	}
 
-	//legs
-		// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.50f, 9.0f, .50f);
+	// the batches are few and drawn without instancing, so
+	// they are culled here even when the GPU culls the rest
+	if (m_bCullObjects == true)
+	{
+		BoundingVolumeHierarchy::CULL_STATS stats;
+		m_batchBVH.Cull(viewProjection, frame.visibleBatches, stats);
+		frame.cullNodesTested += stats.nodesTested;
+		std::sort(frame.visibleBatches.begin(), frame.visibleBatches.end());
+	}
+	else
+	{
+		frame.visibleBatches.resize(m_staticBatches.GetBatchCount());
+		for (int i = 0; i < m_staticBatches.GetBatchCount(); i++)
+		{
+			frame.visibleBatches[i] = i;
+		}
+	}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	// the last row of the view-projection gives the clip w
+	glm::vec4 clipW = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+	float projectionScale = projection[1][1];
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-9.0f, -4.0f, 4.5f);
+	int blendedCount = 0;
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	frame.renderQueue.Clear();
+	for (size_t visible = 0; visible < frame.visibleRecords.size(); visible++)
+	{
+		int i = frame.visibleRecords[visible];
+		// baked records are drawn with their static batch
+		if (m_recordBatches[i] >= 0)
+		{
+			continue;
+		}
+		const SceneFile::DRAW_RECORD& record = m_pDrawRecords[i];
+		int level = SelectLevel(i, clipW, projectionScale);
+		// each detail level sorts as a mesh of its own
+		int meshSlot = record.meshID * PrimitiveMeshes::LOD_COUNT + level;
+		int textureHandle = (record.textureIndex >= 0) ? m_sceneTextureHandles[record.textureIndex] : -1;
+		bool bBlended = (textureHandle < 0) && (record.color[3] < 1.0f);
+		if (bBlended == true)
+		{
+			blendedCount++;
+		}
 
-	SetShaderColor(0.8, 0.8, 0.8, 1);
+		// with sorting off every key is equal, or only marks
+		// the blended draws, and the stable sort keeps the
+		// file order
+		uint64_t key = 0;
+		if (m_bSortDraws == true)
+		{
+			int materialHandle = m_sceneMaterialHandles[record.materialIndex];
+			glm::vec3 offset = glm::vec3(
+				record.worldMatrix[12] - viewPosition.x,
+				record.worldMatrix[13] - viewPosition.y,
+				record.worldMatrix[14] - viewPosition.z);
+			float depth = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+
+			if (bBlended == true)
+			{
+				key = RenderQueue::MakeTransparentKey(program, depth, meshSlot, textureHandle, materialHandle);
+			}
+			else
+			{
+				key = RenderQueue::MakeOpaqueKey(program, meshSlot, textureHandle, materialHandle, depth);
+			}
+		}
+		else if (bBlended == true)
+		{
+			key = RenderQueue::MakeTransparentKey(program, 0.0f, 0, 0, 0);
+		}
+		frame.renderQueue.Add(key, i);
+	}
+	frame.renderQueue.Sort();
 
-	SetShaderMaterial("NORMAL");
+	frame.opaqueCount = frame.renderQueue.GetCount() - blendedCount;
+	frame.recordLevels = m_recordLevels;
+}
 
-	SetShaderTexture("Wood");
+/***********************************************************
+ *  PrepareFrame()
+ *
+ *  This method is used for doing the CPU work of a frame
+ *  for a camera: culling, picking the detail levels,
+ *  sorting the draws and binning the point lights.  No GL
+ *  calls are made, so the main thread prepares the next
+ *  frame while the render thread draws this one.  Moved
+ *  nodes are still picked up by RenderScene(), which
+ *  refits the culling trees read here, so the scene must
+ *  hold still while the render thread runs.
+ ***********************************************************/
+void SceneManager::PrepareFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition,
+	PREPARED_FRAME& frame)
+{
+	QueueDraws(projection * view, projection, viewPosition, frame);
+	m_lightClusters.Bin(view, projection, m_viewportWidth, m_viewportHeight, frame.lights);
+}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
+/***********************************************************
+ *  ApplyDrawState()
+ *
+ *  This method is used for setting the material, texture,
+ *  color and UV scale of the next draw.  Only the state
+ *  that differs from the previous draw is set, and the
+ *  skipped changes are counted.
+ ***********************************************************/
+void SceneManager::ApplyDrawState(int materialHandle, int textureHandle, const glm::vec4& color, const glm::vec2& UVscale)
+{
+	if (materialHandle != m_drawState.materialHandle)
+	{
+		SetShaderMaterial(materialHandle);
+		m_drawState.materialHandle = materialHandle;
+		m_renderCounters.materialBinds++;
+	}
+	else
+	{
+		m_renderCounters.materialBindsAvoided++;
+	}
 
+	if (textureHandle >= 0)
+	{
+		if (textureHandle != m_drawState.textureHandle)
+		{
+			SetShaderTexture(textureHandle);
+			m_drawState.textureHandle = textureHandle;
+			m_renderCounters.textureBinds++;
+		}
+		else
+		{
+			m_renderCounters.textureBindsAvoided++;
+		}
 
+		// the UV scale only matters for textured draws
+		if (UVscale != m_drawState.UVscale)
+		{
+			SetTextureUVScale(UVscale.x, UVscale.y);
+			m_drawState.UVscale = UVscale;
+		}
+	}
+	else
+	{
+		// the color only matters for untextured draws
+		bool bTextureChange = (m_drawState.textureHandle != -1);
+		if ((bTextureChange == true) || (color != m_drawState.color))
+		{
+			SetShaderColor(color.r, color.g, color.b, color.a);
+			m_drawState.color = color;
+		}
 
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.50f, 9.0f, .50f);
+		if (bTextureChange == true)
+		{
+			m_drawState.textureHandle = -1;
+			m_renderCounters.textureBinds++;
+		}
+		else
+		{
+			m_renderCounters.textureBindsAvoided++;
+		}
+	}
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  DrawRecord()
+ *
+ *  This method is used for drawing one draw record.  Only
+ *  the state that differs from the previous draw is set,
+ *  and the skipped changes are counted.
+ ***********************************************************/
+void SceneManager::DrawRecord(int recordIndex)
+{
+	const SceneFile::DRAW_RECORD& record = m_pDrawRecords[recordIndex];
+	int materialHandle = m_sceneMaterialHandles[record.materialIndex];
+	int textureHandle = (record.textureIndex >= 0) ? m_sceneTextureHandles[record.textureIndex] : -1;
+
+	SetModelMatrix(record.worldMatrix, &m_normalMatrices[static_cast<size_t>(recordIndex) * 9]);
+	ApplyDrawState(materialHandle, textureHandle, glm::make_vec4(record.color),
+		glm::vec2(record.UVscale[0], record.UVscale[1]));
+
+	// every mesh draws from one vertex array, so a mesh change
+	// only moves the draw to another range of the shared buffers
+	int level = m_pFrame->recordLevels[recordIndex];
+	if ((record.meshID != m_drawState.meshID) || (level != m_drawState.level))
+	{
+		m_drawState.meshID = record.meshID;
+		m_drawState.level = level;
+		m_renderCounters.meshBinds++;
+	}
+	else
+	{
+		m_renderCounters.meshBindsAvoided++;
+	}
+	m_basicMeshes->DrawMesh(record.meshID, level);
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(9.0f, -4.0f, 4.5f);
+	m_renderCounters.draws++;
+	m_renderCounters.drawCalls++;
+	m_renderCounters.indicesSubmitted += m_basicMeshes->GetIndexCount(record.meshID, level);
+	m_renderCounters.levelDraws[level]++;
+}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+/***********************************************************
+ *  BuildStaticBatches()
+ *
+ *  This method is used for baking every opaque draw record
+ *  that is not dynamic into the static batches, which are
+ *  then drawn instead of the records.  Blended records stay
+ *  out, since they are sorted every frame, and so does a
+ *  record whose batch would hold it alone.  Large scenes
+ *  are not baked at all.  The batches get a culling tree
+ *  of their own.
+ ***********************************************************/
+void SceneManager::BuildStaticBatches()
+{
+	m_staticBatches.Destroy();
+	m_recordBatches.assign(m_drawRecordCount, -1);
 
-	SetShaderColor(0.8, 0.8, 0.8, 1);
+	if ((m_bStaticBatching == true) && (m_drawRecordCount > STATIC_BATCH_MAX_RECORDS))
+	{
+		std::cout << "INFO: Static batching skipped for " << m_drawRecordCount << " draw records, more than "
+			<< STATIC_BATCH_MAX_RECORDS << std::endl;
+	}
+	else if (m_bStaticBatching == true)
+	{
+		// the object index of each added record for now, the
+		// batch index once uploaded
+		for (int i = 0; i < m_drawRecordCount; i++)
+		{
+			const SceneFile::DRAW_RECORD& record = m_pDrawRecords[i];
+			int textureHandle = (record.textureIndex >= 0) ? m_sceneTextureHandles[record.textureIndex] : -1;
+			bool bBlended = (textureHandle < 0) && (record.color[3] < 1.0f);
+			if (((record.flags & SceneFile::RECORD_DYNAMIC) != 0) || (bBlended == true))
+			{
+				continue;
+			}
+
+			m_recordBatches[i] = m_staticBatches.AddObject(record.meshID, record.worldMatrix,
+				&m_normalMatrices[static_cast<size_t>(i) * 9], record.UVscale,
+				m_sceneMaterialHandles[record.materialIndex], textureHandle, record.color);
+		}
+		m_staticBatches.Upload(STATIC_BATCH_MIN_OBJECTS);
 
-	SetShaderMaterial("NORMAL");
+		for (int i = 0; i < m_drawRecordCount; i++)
+		{
+			if (m_recordBatches[i] >= 0)
+			{
+				m_recordBatches[i] = m_staticBatches.GetObjectBatch(m_recordBatches[i]);
+			}
+		}
+	}
 
-	SetShaderTexture("Wood");
+	m_batchBVH.Build(m_staticBatches.GetBounds());
+}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
+/***********************************************************
+ *  DrawStaticBatches()
+ *
+ *  This method is used for drawing the static batches that
+ *  survived culling, one call each.  Their vertices are in
+ *  world space with the UV scale applied, so the model
+ *  matrix is the identity and the UV scale is one.  The
+ *  instanced paths change the texture uniforms without
+ *  the draw state, so every state is set again.
+ ***********************************************************/
+void SceneManager::DrawStaticBatches()
+{
+	if (m_pFrame->visibleBatches.empty() == true)
+	{
+		return;
+	}
 
+	m_drawState.materialHandle = -2;
+	m_drawState.textureHandle = -2;
+	m_drawState.color = glm::vec4(-1.0f);
+	m_drawState.UVscale = glm::vec2(0.0f, 0.0f);
 
+	SetModelMatrix(glm::mat4(1.0f));
+	m_staticBatches.Begin();
+	for (size_t visible = 0; visible < m_pFrame->visibleBatches.size(); visible++)
+	{
+		int batchIndex = m_pFrame->visibleBatches[visible];
+		const StaticBatches::BATCH& batch = m_staticBatches.GetBatch(batchIndex);
+		ApplyDrawState(batch.materialHandle, batch.textureHandle, glm::make_vec4(batch.color), glm::vec2(1.0f, 1.0f));
+		m_staticBatches.Draw(batchIndex);
+
+		m_renderCounters.draws += batch.objectCount;
+		m_renderCounters.drawCalls++;
+		m_renderCounters.indicesSubmitted += batch.indexCount;
+		m_renderCounters.levelDraws[0] += batch.objectCount;
+		m_renderCounters.meshBinds++;
+		m_renderCounters.staticBatches++;
+	}
+	m_staticBatches.End();
 
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.50f, 9.0f, .50f);
+	// the next record draw returns to the shared buffers
+	m_drawState.meshID = -2;
+	m_drawState.level = -2;
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  UploadInstances()
+ *
+ *  This method is used for writing the queued records into
+ *  the instance buffer in queue order.  Every record
+ *  becomes an instance holding its model matrix, color, UV
+ *  scale, material and texture layer.
+ ***********************************************************/
+int SceneManager::UploadInstances()
+{
+	const std::vector<RenderQueue::DRAW_ITEM>& items = m_pFrame->renderQueue.GetItems();
+	int instanceCount = static_cast<int>(items.size());
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(-9.0f, -4.0f, 15.5f);
+	m_instances.resize(instanceCount);
+	for (int i = 0; i < instanceCount; i++)
+	{
+		const SceneFile::DRAW_RECORD& record = m_pDrawRecords[items[i].drawIndex];
+		int textureHandle = (record.textureIndex >= 0) ? m_sceneTextureHandles[record.textureIndex] : -1;
+
+		PrimitiveMeshes::INSTANCE_DATA& instance = m_instances[i];
+		memcpy(instance.modelMatrix, record.worldMatrix, sizeof(instance.modelMatrix));
+		memcpy(instance.normalMatrix, &m_normalMatrices[static_cast<size_t>(items[i].drawIndex) * 9], sizeof(instance.normalMatrix));
+		memcpy(instance.color, record.color, sizeof(instance.color));
+		instance.UVscale[0] = record.UVscale[0];
+		instance.UVscale[1] = record.UVscale[1];
+		instance.materialIndex = m_sceneMaterialHandles[record.materialIndex];
+		instance.textureLayer = (textureHandle >= 0) ? m_pTextureManager->GetLayer(textureHandle) : -1;
+	}
+	if (instanceCount > 0)
+	{
+		m_basicMeshes->UploadInstances(&m_instances[0], instanceCount);
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	return(instanceCount);
+}
 
-	SetShaderColor(0.8, 0.8, 0.8, 1);
+/***********************************************************
+ *  DrawInstanced()
+ *
+ *  This method is used for drawing a range of the queued
+ *  records, already in the instance buffer, with instanced
+ *  draw calls.  Consecutive records with the same
+ *  mesh whose textures share a texture array are drawn by
+ *  one call; untextured records join any batch of their
+ *  mesh.
+ ***********************************************************/
+void SceneManager::DrawInstanced(int firstItem, int endItem)
+{
+	const std::vector<RenderQueue::DRAW_ITEM>& items = m_pFrame->renderQueue.GetItems();
+	if (firstItem >= endItem)
+	{
+		return;
+	}
 
-	SetShaderMaterial("NORMAL");
+	glUniform1i(m_uniformLocations.instanced, true);
 
-	SetShaderTexture("Wood");
+	int first = firstItem;
+	while (first < endItem)
+	{
+		int meshID = m_pDrawRecords[items[first].drawIndex].meshID;
+		int level = m_pFrame->recordLevels[items[first].drawIndex];
+		int batchTexture = -1;
+		GLuint batchArray = 0;
+
+		// extend the batch while the mesh, detail level and
+		// texture array match
+		int last = first;
+		for (; last < endItem; last++)
+		{
+			const SceneFile::DRAW_RECORD& record = m_pDrawRecords[items[last].drawIndex];
+			if ((record.meshID != meshID) || (m_pFrame->recordLevels[items[last].drawIndex] != level))
+			{
+				break;
+			}
+
+			int textureHandle = (record.textureIndex >= 0) ? m_sceneTextureHandles[record.textureIndex] : -1;
+			if (textureHandle >= 0)
+			{
+				GLuint arrayTexture = m_pTextureManager->GetArrayTexture(textureHandle);
+				if (batchTexture < 0)
+				{
+					batchTexture = textureHandle;
+					batchArray = arrayTexture;
+				}
+				else if (arrayTexture != batchArray)
+				{
+					break;
+				}
+			}
+		}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
+		int batchSize = last - first;
+		if (batchTexture >= 0)
+		{
+			glUniform1i(m_uniformLocations.objectTexture, m_pTextureManager->BindForDraw(batchTexture));
+			m_renderCounters.textureBinds++;
+		}
+		m_basicMeshes->DrawMeshInstanced(meshID, level, first, batchSize);
+
+		// material and texture layer come with each instance
+		m_renderCounters.draws += batchSize;
+		m_renderCounters.drawCalls++;
+		m_renderCounters.indicesSubmitted += m_basicMeshes->GetIndexCount(meshID, level) * batchSize;
+		m_renderCounters.levelDraws[level] += batchSize;
+		m_renderCounters.meshBinds++;
+		m_renderCounters.meshBindsAvoided += batchSize - 1;
+		m_renderCounters.materialBindsAvoided += batchSize;
+		m_renderCounters.textureBindsAvoided += (batchTexture >= 0) ? batchSize - 1 : batchSize;
+
+		first = last;
+	}
 
+	glUniform1i(m_uniformLocations.instanced, false);
+}
 
-	// set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(0.50f, 9.0f, .50f);
+/***********************************************************
+ *  BuildIndirectCommands()
+ *
+ *  This method is used for turning the queued records into
+ *  multi-draw indirect commands.  Consecutive records of the
+ *  same mesh and detail level become one command, and one
+ *  batch holds every command while the texture array
+ *  stays the same, so the number of calls depends on the
+ *  texture arrays rather than on the objects.  Each command
+ *  starts at its records' instances through its base
+ *  instance, which the instance attributes honor.  Batches
+ *  end where the blended records start, so the passes can
+ *  submit the opaque ones alone.
+ ***********************************************************/
+void SceneManager::BuildIndirectCommands()
+{
+	const std::vector<RenderQueue::DRAW_ITEM>& items = m_pFrame->renderQueue.GetItems();
+	int instanceCount = static_cast<int>(items.size());
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+	m_drawCommands.clear();
+	m_indirectBatches.clear();
+	int first = 0;
+	while (first < instanceCount)
+	{
+		INDIRECT_BATCH batch;
+		batch.firstItem = first;
+		batch.firstCommand = static_cast<int>(m_drawCommands.size());
+		batch.textureHandle = -1;
+		batch.bFixedCommands = false;
+		GLuint batchArray = 0;
+		int end = (first < m_pFrame->opaqueCount) ? m_pFrame->opaqueCount : instanceCount;
+
+		// extend the batch while the texture array matches,
+		// merging runs of the same mesh and level into commands
+		int last = first;
+		for (; last < end; last++)
+		{
+			const SceneFile::DRAW_RECORD& record = m_pDrawRecords[items[last].drawIndex];
+			int textureHandle = (record.textureIndex >= 0) ? m_sceneTextureHandles[record.textureIndex] : -1;
+			if (textureHandle >= 0)
+			{
+				GLuint arrayTexture = m_pTextureManager->GetArrayTexture(textureHandle);
+				if (batch.textureHandle < 0)
+				{
+					batch.textureHandle = textureHandle;
+					batchArray = arrayTexture;
+				}
+				else if (arrayTexture != batchArray)
+				{
+					break;
+				}
+			}
+
+			int level = m_pFrame->recordLevels[items[last].drawIndex];
+			PrimitiveMeshes::DRAW_COMMAND command = m_basicMeshes->GetDrawCommand(record.meshID, level, last, 1);
+			if ((static_cast<int>(m_drawCommands.size()) > batch.firstCommand) &&
+				(m_drawCommands.back().firstIndex == command.firstIndex) &&
+				(m_drawCommands.back().baseVertex == command.baseVertex))
+			{
+				m_drawCommands.back().instanceCount++;
+			}
+			else
+			{
+				m_drawCommands.push_back(command);
+			}
+
+			m_renderCounters.indicesSubmitted += static_cast<int>(command.count);
+			m_renderCounters.levelDraws[level]++;
+		}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(9.0f, -4.0f, 15.5f);
+		int batchSize = last - first;
+		batch.itemCount = batchSize;
+		batch.commandCount = static_cast<int>(m_drawCommands.size()) - batch.firstCommand;
+		m_indirectBatches.push_back(batch);
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+		// material and texture layer come with each instance
+		m_renderCounters.draws += batchSize;
+		m_renderCounters.meshBinds += batch.commandCount;
+		m_renderCounters.meshBindsAvoided += batchSize - batch.commandCount;
+		m_renderCounters.materialBindsAvoided += batchSize;
+		m_renderCounters.textureBindsAvoided += (batch.textureHandle >= 0) ? batchSize - 1 : batchSize;
 
-	SetShaderColor(0.8, 0.8, 0.8, 1);
+		first = last;
+	}
 
-	SetShaderMaterial("NORMAL");
+	// every command is uploaded before the first call reads them
+	if (m_drawCommands.empty() == false)
+	{
+		m_basicMeshes->UploadDrawCommands(&m_drawCommands[0], static_cast<int>(m_drawCommands.size()));
+	}
+}
 
-	SetShaderTexture("Wood");
+/***********************************************************
+ *  IsGpuCullingActive()
+ *
+ *  This method is used for checking whether this frame is
+ *  culled in the compute shader.  That needs culling on,
+ *  the compute program built and the multi-draw path,
+ *  whose command buffer the shader writes.
+ ***********************************************************/
+bool SceneManager::IsGpuCullingActive() const
+{
+	return((m_bCullObjects == true) && (m_bGpuCullingReady == true) &&
+		(m_bUseInstancing == true) && (m_bUseMultiDraw == true) &&
+		(PrimitiveMeshes::IsMultiDrawSupported() == true));
+}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-	/****************************************************************/
+/***********************************************************
+ *  BuildGpuCulledCommands()
+ *
+ *  This method is used for culling every queued record
+ *  in the compute shader.  The records are
+ *  batched by texture array like BuildIndirectCommands(),
+ *  and each record gets one command slot in its batch's
+ *  range.  The shader packs the visible records of a batch
+ *  to the front of its range; blended batches keep their
+ *  slots so they still draw back to front.  The draw and
+ *  detail level counters count the records sent to the
+ *  GPU, culled or not.  The culled count and the indices of
+ *  the visible records are read back from the shader two
+ *  frames late; until the first readback the index count
+ *  covers every record.
+ ***********************************************************/
+void SceneManager::BuildGpuCulledCommands()
+{
+	const std::vector<RenderQueue::DRAW_ITEM>& items = m_pFrame->renderQueue.GetItems();
+	int instanceCount = static_cast<int>(items.size());
+	m_indirectBatches.clear();
+	if (instanceCount == 0)
+	{
+		return;
+	}
 
+	m_cullObjects.resize(instanceCount);
+	int queuedIndices = 0;
+	int first = 0;
+	while (first < instanceCount)
+	{
+		const SceneFile::DRAW_RECORD& firstRecord = m_pDrawRecords[items[first].drawIndex];
+		INDIRECT_BATCH batch;
+		batch.firstItem = first;
+		batch.firstCommand = first;
+		batch.textureHandle = -1;
+		batch.bFixedCommands = (firstRecord.textureIndex < 0) && (firstRecord.color[3] < 1.0f);
+		GLuint batchArray = 0;
+
+		// extend the batch while blending and the texture array match
+		int last = first;
+		for (; last < instanceCount; last++)
+		{
+			int recordIndex = items[last].drawIndex;
+			const SceneFile::DRAW_RECORD& record = m_pDrawRecords[recordIndex];
+			int textureHandle = (record.textureIndex >= 0) ? m_sceneTextureHandles[record.textureIndex] : -1;
+			bool bBlended = (textureHandle < 0) && (record.color[3] < 1.0f);
+			if (bBlended != batch.bFixedCommands)
+			{
+				break;
+			}
+			if (textureHandle >= 0)
+			{
+				GLuint arrayTexture = m_pTextureManager->GetArrayTexture(textureHandle);
+				if (batch.textureHandle < 0)
+				{
+					batch.textureHandle = textureHandle;
+					batchArray = arrayTexture;
+				}
+				else if (arrayTexture != batchArray)
+				{
+					break;
+				}
+			}
+
+			int level = m_pFrame->recordLevels[recordIndex];
+			PrimitiveMeshes::DRAW_COMMAND command = m_basicMeshes->GetDrawCommand(record.meshID, level, last, 1);
+			const BoundingVolumeHierarchy::AABB& bounds = m_objectBounds[recordIndex];
+			GpuCulling::CULL_OBJECT& object = m_cullObjects[last];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				object.boundsMinimum[axis] = bounds.minimum[axis];
+				object.boundsMaximum[axis] = bounds.maximum[axis];
+			}
+			object.boundsMinimum[3] = 1.0f;
+			object.boundsMaximum[3] = 1.0f;
+			object.indexCount = command.count;
+			object.firstIndex = command.firstIndex;
+			object.baseVertex = command.baseVertex;
+			object.batch = static_cast<GLuint>(m_indirectBatches.size());
+			object.commandBase = static_cast<GLuint>(first);
+			object.fixedCommand = (batch.bFixedCommands == true) ? static_cast<GLuint>(last - first) : GpuCulling::NEXT_FREE_COMMAND;
+			object.padding[0] = 0;
+			object.padding[1] = 0;
+
+			queuedIndices += static_cast<int>(command.count);
+			m_renderCounters.levelDraws[level]++;
+		}
 
+		int batchSize = last - first;
+		batch.itemCount = batchSize;
+		batch.commandCount = batchSize;
+		m_indirectBatches.push_back(batch);
 
-	// Draw MacBook
-/******************************************************************/
-// Set the XYZ scale for the mesh
-	scaleXYZ = glm::vec3(4.250f, 0.050f, 2.250f);
+		m_renderCounters.draws += batchSize;
+		m_renderCounters.materialBindsAvoided += batchSize;
+		m_renderCounters.textureBindsAvoided += (batch.textureHandle >= 0) ? batchSize - 1 : batchSize;
 
-	// Set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		first = last;
+	}
 
-	// Set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 0.5f, 8.0f);
+	m_basicMeshes->ClearDrawCommands(instanceCount);
+	m_gpuCulling.Cull(m_pSceneUniforms->GetViewProjection(), m_cullObjects,
+		static_cast<int>(m_indirectBatches.size()), m_basicMeshes->GetCommandBuffer(), m_pSceneUniforms->GetProgram());
+	m_renderCounters.cullObjectsTested = instanceCount;
+	m_renderCounters.objectsCulled = (m_gpuCulling.GetCulledCount() > 0) ? m_gpuCulling.GetCulledCount() : 0;
+	m_renderCounters.indicesSubmitted += (m_gpuCulling.GetVisibleIndexCount() >= 0) ? m_gpuCulling.GetVisibleIndexCount() : queuedIndices;
+}
 
-	// Set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ
-	);
-
-	// Set the aluminum material for the MacBook
-	SetShaderMaterial("AluminumMaterial");
-
-	// Optionally apply a texture for fine details (e.g., brushed metal look)
-	SetShaderTexture("laptop");
-
-	// Draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
-
-	/****************************************************************/
-
-		//draw Air Pods
-			/******************************************************************/
-		// set the XYZ scale for the mesh
-		//first Book Draw One Cube For the Outer Layer
-		scaleXYZ = glm::vec3(0.080f);
-
-		// set the XYZ rotation for the mesh
-		// Render First AirPod
-			// Bud
-				// Render First AirPod
-			// Bud
-		// First AirPod
-		// Bud
-		scaleXYZ = glm::vec3(0.15f, 0.15f, 0.15f);
-		positionXYZ = glm::vec3(3.0f, 0.66f, 8.0f); // Slightly adjusted above the table
-		XrotationDegrees = -5.0f;
-		YrotationDegrees = 2.0f;
-		ZrotationDegrees = -3.0f;
-		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		SetShaderMaterial("PlasticMaterial"); // Updated to plastic material
-		SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f); // White plastic
-		SetShaderTexture("Pod");
-		m_basicMeshes->DrawSphereMesh();
-
-		// Ear Tip
-		scaleXYZ = glm::vec3(0.1f, 0.1f, 0.1f);
-		positionXYZ = glm::vec3(3.02f, 0.64f, 8.1f); // Adjusted slightly forward
-		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		SetShaderMaterial("RubberMaterial"); // Rubber texture for the ear tip
-		SetShaderTexture("rubber");
-		m_basicMeshes->DrawSphereMesh();
-
-		// Stem
-		scaleXYZ = glm::vec3(0.05f, 0.4f, 0.05f);
-		positionXYZ = glm::vec3(3.0f, 0.58f, 7.92f); // Adjusted to align with the bud
-		XrotationDegrees = 92.0f; // Vertical orientation with a slight tilt
-		YrotationDegrees = 5.0f;
-		ZrotationDegrees = -2.0f;
-		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		SetShaderMaterial("PlasticMaterial");
-		SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f); // White plastic
-		SetShaderTexture("Pod");
-		m_basicMeshes->DrawCylinderMesh();
-
-		// Second AirPod
-		// Bud
-		scaleXYZ = glm::vec3(0.15f, 0.15f, 0.15f);
-		positionXYZ = glm::vec3(2.6f, 0.65f, 8.05f); // Slightly adjusted for a scattered look
-		XrotationDegrees = 25.0f;
-		YrotationDegrees = -25.0f;
-		ZrotationDegrees = 15.0f;
-		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		SetShaderMaterial("PlasticMaterial");
-		SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f); // White plastic
-		SetShaderTexture("Pod");
-		m_basicMeshes->DrawSphereMesh();
-
-		// Ear Tip
-		scaleXYZ = glm::vec3(0.1f, 0.1f, 0.1f);
-		positionXYZ = glm::vec3(2.62f, 0.63f, 8.15f); // Adjusted slightly forward
-		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		SetShaderMaterial("RubberMaterial");
-		SetShaderTexture("rubber");
-		m_basicMeshes->DrawSphereMesh();
-
-		// Stem
-		scaleXYZ = glm::vec3(0.05f, 0.4f, 0.05f);
-		positionXYZ = glm::vec3(2.58f, 0.58f, 8.0f); // Slight adjustment for natural placement
-		XrotationDegrees = 95.0f; // Angled orientation
-		YrotationDegrees = -30.0f;
-		ZrotationDegrees = 10.0f;
-		SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-		SetShaderMaterial("PlasticMaterial");
-		SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f); // White plastic
-		SetShaderTexture("Pod");
-		m_basicMeshes->DrawCylinderMesh();
-
-
-
-
-
-	//Draw Cup
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	//first Book Draw One Cube For the Outer Layer
-	// Draw Outer Cylinder (Outer Glass Body)
-
-	// Base position for the cup
-	// Table Top Position
-	float tableTopY = -0.1f;  // Height of the table's surface
-	float glassHeight = 2.17f; // Height of the glass
-
-	// Base position of the cup (to align with the table surface)
-	glm::vec3 cupBasePosition = glm::vec3(2.44f, tableTopY + glassHeight / 2.0f, 6.0f);
-
-	// **************************
-	// Draw Glass Outer Cylinder
-	// **************************
-	glm::vec3 glassOuterPosition = cupBasePosition; // Center of the glass
-	scaleXYZ = glm::vec3(0.503f, glassHeight / 2.0f, 0.503f); // Outer dimensions
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, glassOuterPosition);
-
-	SetShaderMaterial("GlassMaterial");          // Transparent glass material
-	SetShaderColor(1.0f, 1.0f, 1.0f, 0.3f);      // White color with transparency
-	m_basicMeshes->DrawCylinderMesh();           // Default cylinder mesh
-
-	// **************************
-	// Draw Glass Inner Cylinder
-	// **************************
-	glm::vec3 glassInnerPosition = glassOuterPosition; // Same position as outer glass
-	scaleXYZ = glm::vec3(0.45f, glassHeight / 2.0f - 0.025f, 0.45f); // Slightly shorter inner cylinder
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, glassInnerPosition);
-
-	SetShaderMaterial("GlassMaterial");
-	SetShaderColor(1.0f, 1.0f, 1.0f, 0.3f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// **************************
-	// Draw Bottom
-	// **************************
-	float waterHeight = glassHeight * 0.75f; // 3/4th of the glass height
-	glm::vec3 waterPosition = glm::vec3(cupBasePosition.x, tableTopY + waterHeight / 2.0f, cupBasePosition.z); // Centered water inside the glass
-	scaleXYZ = glm::vec3(0.45f, waterHeight / 2.0f, 0.45f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, waterPosition);
-
-	SetShaderMaterial("WaterMaterial");         // Transparent blue material for water
-	m_basicMeshes->DrawCylinderMesh();
-
-
-
-
-
-
-	/****************************************************************/
-
-
-	//Planner
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	//first Book Draw One Cube For the Outer Layer
-	// Combined Books
-/******************************************************************/
-// Set the XYZ scale for the mesh (twice the width to represent two books side by side)
-	scaleXYZ = glm::vec3(3.0f, 0.01f, 1.50f);  // Wider scale to include both books
-
-	// Set the XYZ rotation for the mesh
-	XrotationDegrees = 0;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  SubmitIndirect()
+ *
+ *  This method is used for submitting the indirect batches
+ *  whose records lie in a range of the queue, one
+ *  multi-draw call per batch.  When the GPU culled the
+ *  frame, packed batches only read their visible commands.
+ ***********************************************************/
+void SceneManager::SubmitIndirect(int firstItem, int endItem)
+{
+	bool bDrawCount = (IsGpuCullingActive() == true) && (PrimitiveMeshes::IsDrawCountSupported() == true);
 
-	// Set the XYZ position for the mesh (centered between the positions of the original books)
-	positionXYZ = glm::vec3(-0.28f, 0.5f, 11.1f); // Adjust position to account for both books
+	glUniform1i(m_uniformLocations.instanced, true);
+	for (size_t i = 0; i < m_indirectBatches.size(); i++)
+	{
+		const INDIRECT_BATCH& batch = m_indirectBatches[i];
+		if ((batch.firstItem < firstItem) || (batch.firstItem >= endItem))
+		{
+			continue;
+		}
 
-	// Set the transformations into memory to be used on the drawn mesh
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ
-	);
+		if (batch.textureHandle >= 0)
+		{
+			glUniform1i(m_uniformLocations.objectTexture, m_pTextureManager->BindForDraw(batch.textureHandle));
+			m_renderCounters.textureBinds++;
+		}
 
-	// Apply a single texture
-	SetShaderMaterial("NORMAL"); // Use a default or book-specific material
-	SetShaderTexture("jotter");  // The texture applied to both books
+		if ((bDrawCount == true) && (batch.bFixedCommands == false))
+		{
+			m_basicMeshes->MultiDrawIndirectCount(batch.firstCommand, batch.commandCount,
+				m_gpuCulling.GetCounterBuffer(), GpuCulling::GetBatchCountOffset(static_cast<int>(i)));
+		}
+		else
+		{
+			m_basicMeshes->MultiDrawIndirect(batch.firstCommand, batch.commandCount);
+		}
+		m_renderCounters.drawCalls++;
+	}
+	glUniform1i(m_uniformLocations.instanced, false);
+}
 
-	// Draw the combined mesh
-	m_basicMeshes->DrawBoxMesh();
+/***********************************************************
+ *  DrawQueued()
+ *
+ *  This method is used for drawing a range of the queued
+ *  records with the path chosen for the frame: multi-draw
+ *  indirect calls, instanced batches or one draw call per
+ *  record.
+ ***********************************************************/
+void SceneManager::DrawQueued(int firstItem, int endItem)
+{
+	if (m_bUseInstancing == true)
+	{
+		if ((IsGpuCullingActive() == true) ||
+			((m_bUseMultiDraw == true) && (PrimitiveMeshes::IsMultiDrawSupported() == true)))
+		{
+			SubmitIndirect(firstItem, endItem);
+		}
+		else
+		{
+			DrawInstanced(firstItem, endItem);
+		}
+		return;
+	}
 
+	const std::vector<RenderQueue::DRAW_ITEM>& items = m_pFrame->renderQueue.GetItems();
+	for (int i = firstItem; i < endItem; i++)
+	{
+		DrawRecord(items[i].drawIndex);
+	}
+}
 
+/***********************************************************
+ *  ResolveSampleQuery()
+ *
+ *  This method is used for reading the sample counts of a
+ *  frame whose queries were issued a few frames ago, so
+ *  the GPU has normally finished them.
+ ***********************************************************/
+void SceneManager::ResolveSampleQuery(SAMPLE_QUERY& query)
+{
+	GLuint samples = 0;
+	glGetQueryObjectuiv(query.depthID, GL_QUERY_RESULT, &samples);
+	m_depthPrepassSamples = static_cast<int>(samples);
+	glGetQueryObjectuiv(query.shadeID, GL_QUERY_RESULT, &samples);
+	m_shadedSamples = static_cast<int>(samples);
+	query.bPending = false;
+}
 
-	/****************************************************************/
+/***********************************************************
+ *  DrawShadowCasters()
+ *
+ *  This method is used for drawing every opaque draw
+ *  record at its finest detail level, one call each.  It
+ *  only runs when the shadow atlas is rendered again, so
+ *  it favors simplicity over batching; the records are not
+ *  culled since the lights see more than the camera.
+ ***********************************************************/
+void SceneManager::DrawShadowCasters()
+{
+	for (int i = 0; i < m_drawRecordCount; i++)
+	{
+		const SceneFile::DRAW_RECORD& record = m_pDrawRecords[i];
+		// blended objects let the light through
+		if ((record.textureIndex < 0) && (record.color[3] < 1.0f))
+		{
+			continue;
+		}
 
+		SetModelMatrix(record.worldMatrix, &m_normalMatrices[static_cast<size_t>(i) * 9]);
+		m_basicMeshes->DrawMesh(record.meshID, 0);
+	}
+}
 
-	// Draw the Pen Body
-/******************************************************************/
-// Set the XYZ scale for the pen body
-	scaleXYZ = glm::vec3(0.05f, 0.9f, 0.05f); // Slim and long for the body
+/***********************************************************
+ *  UpdateShadowMaps()
+ *
+ *  This method is used for rendering the shadow atlas when
+ *  a light or a shadow caster changed since it was last
+ *  rendered, and doing nothing otherwise.  Each light gets
+ *  a camera that encloses the box of the opaque records,
+ *  written with the light into the light block; the scene
+ *  camera is put back afterwards.
+ ***********************************************************/
+void SceneManager::UpdateShadowMaps()
+{
+	if ((m_bShadowsReady == false) || (m_bShadowsDirty == false))
+	{
+		return;
+	}
+	m_bShadowsDirty = false;
 
-	// Set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;  // Lay horizontally
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 180.0f; // Reverse orientation
+	// box around every shadow caster
+	bool bCasters = false;
+	glm::vec3 boundsMinimum = glm::vec3(0.0f);
+	glm::vec3 boundsMaximum = glm::vec3(0.0f);
+	for (int i = 0; i < m_drawRecordCount; i++)
+	{
+		const SceneFile::DRAW_RECORD& record = m_pDrawRecords[i];
+		if ((record.textureIndex < 0) && (record.color[3] < 1.0f))
+		{
+			continue;
+		}
 
-	// Set the XYZ position for the pen body
-	positionXYZ = glm::vec3(0.44f, 0.5f, 11.19f);
+		const BoundingVolumeHierarchy::AABB& bounds = m_objectBounds[i];
+		boundsMinimum = (bCasters == true) ? glm::min(boundsMinimum, bounds.minimum) : bounds.minimum;
+		boundsMaximum = (bCasters == true) ? glm::max(boundsMaximum, bounds.maximum) : bounds.maximum;
+		bCasters = true;
+	}
+	if ((bCasters == false) || (m_lightCount == 0))
+	{
+		return;
+	}
 
-	// Set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ
-	);
-
-	// Apply the pen body material and texture
-	SetShaderColor(0.1f, 0.1f, 0.1f, 1.0f);  // Dark black for the pen body
-	SetShaderMaterial("PlasticMaterial");    // Plastic for the pen body
-	SetShaderTexture("pen");                 // Apply texture for detailing
-
-	// Draw the pen body (tapered cylinder for slight variation)
-	m_basicMeshes->DrawTaperedCylinderMesh();
-
-	// Draw the Pen Tip
-	/******************************************************************/
-	// Set the XYZ scale for the pen tip
-	scaleXYZ = glm::vec3(0.03f, 0.1f, 0.03f); // Small and sharp for the tip
-
-	// Set the XYZ position for the pen tip (aligned to the body)
-	positionXYZ = glm::vec3(0.44f, 0.49f, 11.0f); // Slightly in front of the body
-
-	// Set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ
-	);
-
-	// Apply the tip material and texture
-	SetShaderColor(0.6f, 0.6f, 0.6f, 1.0f);  // Metallic silver for the tip
-	SetShaderMaterial("AluminumMaterial");      // Metallic material for the tip
-	SetShaderTexture("pen");
-
-	// Draw the pen tip
-	m_basicMeshes->DrawConeMesh(); // Cone shape for the tip
-
-	// Draw the Pen Grip
-	/******************************************************************/
-	// Set the XYZ scale for the pen grip
-	scaleXYZ = glm::vec3(0.055f, 0.15f, 0.055f); // Slightly thicker than the body
-
-	// Set the XYZ position for the pen grip (near the tip)
-	positionXYZ = glm::vec3(0.44f, 0.49f, 11.09f); // Just behind the tip
-
-	// Set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ
-	);
-
-	// Apply the grip material and texture
-	SetShaderColor(0.2f, 0.2f, 0.2f, 1.0f);  // Dark rubber for the grip
-	SetShaderMaterial("RubberMaterial");     // Rubber material for the grip
-	SetShaderTexture("rubber");
-
-	// Draw the pen grip
-	m_basicMeshes->DrawCylinderMesh(); // Simple cylinder for the grip
-
-	// Draw the Pen Cap
-	/******************************************************************/
-	// Set the XYZ scale for the pen cap
-	scaleXYZ = glm::vec3(0.055f, 0.3f, 0.055f); // Slightly larger than the body
-
-	// Set the XYZ position for the pen cap (aligned to the opposite end)
-	positionXYZ = glm::vec3(0.44f, 0.51f, 11.38f); // On the opposite end of the body
-
-	// Set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ
-	);
+	ShadowAtlas::LIGHT_VIEW lightViews[SceneUniforms::MAX_LIGHTS];
+	for (int i = 0; i < m_lightCount; i++)
+	{
+		lightViews[i] = ShadowAtlas::FitLight(i, m_lights[i].position, boundsMinimum, boundsMaximum);
+		m_lights[i].shadowTile = lightViews[i].tile;
+		m_lights[i].shadowMatrix = lightViews[i].projection * lightViews[i].view;
+	}
+	m_pSceneUniforms->SetLights(m_lights, SceneUniforms::MAX_LIGHTS);
 
-	// Apply the cap material and texture
-	SetShaderColor(0.1f, 0.1f, 0.1f, 1.0f);  // Dark plastic for the cap
-	SetShaderMaterial("PlasticMaterial");    // Plastic material for the cap
-	SetShaderTexture("pen");
+	// copies, SetCamera() overwrites what the getters return
+	glm::mat4 view = m_pSceneUniforms->GetView();
+	glm::mat4 projection = m_pSceneUniforms->GetProjection();
+	glm::vec3 viewPosition = m_pSceneUniforms->GetViewPosition();
 
-	// Draw the pen cap
-	m_basicMeshes->DrawCylinderMesh();
+	m_shadowAtlas.Begin();
+	glUniform1i(m_uniformLocations.depthOnly, true);
+	for (int i = 0; i < m_lightCount; i++)
+	{
+		m_shadowAtlas.SetTile(i);
+		m_pSceneUniforms->SetCamera(lightViews[i].view, lightViews[i].projection, m_lights[i].position);
+		DrawShadowCasters();
+	}
+	glUniform1i(m_uniformLocations.depthOnly, false);
+	m_shadowAtlas.End();
 
-	/****************************************************************/
+	m_pSceneUniforms->SetCamera(view, projection, viewPosition);
+	m_renderCounters.shadowMapUpdates++;
+}
 
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by
+ *  drawing the draw records of a prepared frame, culled
+ *  and sorted by PrepareFrame() so that draws sharing
+ *  state follow each other, either as multi-draw indirect
+ *  calls, instanced batches or one draw call per record.
+ *  Only the uploads and draws are left for this thread.
+ *  Only world matrices of nodes that moved are recomputed,
+ *  and then the culling tree is refitted to the new boxes.
+ *
+ *  The opaque records are drawn without blending.  With
+ *  the depth pre-pass they are first drawn into the depth
+ *  buffer only, then shaded with an equal depth test, so
+ *  every covered pixel runs the lighting once.  The
+ *  blended records follow without writing depth, either
+ *  back to front or into the weighted blended targets.
+ *  Occlusion queries count the samples of both passes.
+ *  The shadow atlas is rendered first when it is stale.
+ *  The static batches are drawn ahead of the queued opaque
+ *  records in each opaque pass.
+ ***********************************************************/
+void SceneManager::RenderScene(const PREPARED_FRAME& frame)
+{
+	m_pFrame = &frame;
 
-	// Base position for the AirPods case (ensures it is on the table)
-	glm::vec3 caseBasePosition = glm::vec3(3.5f, 0.65f, 9.2f);
+	if (m_sceneGraph.UpdateWorldMatrices() == true)
+	{
+		const std::vector<SceneGraph::SCENE_NODE>& nodes = m_sceneGraph.GetNodes();
+		bool bBatchesMoved = false;
+		for (size_t i = 0; i < m_drawRecords.size(); i++)
+		{
+			const float* worldMatrix = glm::value_ptr(nodes[m_drawRecords[i].node].worldMatrix);
+			if ((m_recordBatches[i] >= 0) &&
+				(memcmp(m_drawRecords[i].worldMatrix, worldMatrix, sizeof(m_drawRecords[i].worldMatrix)) != 0))
+			{
+				bBatchesMoved = true;
+			}
+			memcpy(m_drawRecords[i].worldMatrix, worldMatrix, sizeof(m_drawRecords[i].worldMatrix));
+		}
+		UpdateNormalMatrices();
+		UpdateObjectBounds();
+		m_objectBVH.Refit(m_objectBounds);
 
-	// Dimensions for the case
-	float caseWidth = 0.90f;  // Width of the case
-	float caseHeight = 0.50f; // Height of the case
-	float caseDepth = 0.15f;  // Depth of the case
+		// nodes that move should be marked dynamic, a baked one
+		// that moves anyway has every batch baked again
+		if (bBatchesMoved == true)
+		{
+			BuildStaticBatches();
+		}
+	}
 
-	// Define scaling factors for the sphere
-	glm::vec3 sphereScale = glm::vec3(caseWidth / 2.0f, caseHeight / 2.0f, caseDepth / 2.0f);
+	m_renderCounters = RENDER_COUNTERS();
+	m_renderCounters.cullNodesTested = frame.cullNodesTested;
+	m_renderCounters.cullObjectsTested = frame.cullObjectsTested;
+	m_renderCounters.objectsCulled = frame.objectsCulled;
+	UpdateShadowMaps();
+	m_shadowAtlas.Bind(*m_pSceneUniforms);
+
+	// the point lights were binned for this frame's camera
+	m_lightClusters.Upload(frame.lights);
+	m_lightClusters.Bind(*m_pSceneUniforms);
+	m_renderCounters.pointLights = m_lightClusters.GetLightCount();
+	m_renderCounters.clusterLightReferences = static_cast<int>(frame.lights.lightIndices.size());
+
+	// other code may have changed the uniforms since the last
+	// frame, so the first draw sets everything
+	m_drawState.materialHandle = -2;
+	m_drawState.textureHandle = -2;
+	m_drawState.meshID = -2;
+	m_drawState.level = -2;
+	m_drawState.color = glm::vec4(-1.0f);
+	m_drawState.UVscale = glm::vec2(0.0f, 0.0f);
+
+	// the instanced paths write every queued record once,
+	// and the passes draw ranges of them
+	if (m_bUseInstancing == true)
+	{
+		UploadInstances();
+		if (IsGpuCullingActive() == true)
+		{
+			BuildGpuCulledCommands();
+		}
+		else if ((m_bUseMultiDraw == true) && (PrimitiveMeshes::IsMultiDrawSupported() == true))
+		{
+			BuildIndirectCommands();
+		}
+	}
 
-	// Create the transformation matrix
-	glm::mat4 modelMatrix = glm::mat4(1.0f); // Initialize to identity matrix
+	// the query of this slot is from a few frames ago
+	SAMPLE_QUERY& query = m_sampleQueries[m_sampleQueryFrame % SAMPLE_QUERY_FRAMES];
+	if (query.bPending == true)
+	{
+		ResolveSampleQuery(query);
+	}
+	m_renderCounters.depthPrepassSamples = m_depthPrepassSamples;
+	m_renderCounters.shadedSamples = m_shadedSamples;
+	bool bQueries = (query.depthID != 0);
 
-	// Apply transformations in the correct order:
-	// 1. Translate to the base position (centered horizontally on the table)
-	modelMatrix = glm::translate(modelMatrix, caseBasePosition);
+	// the overdraw view adds a constant per fragment
+	glUniform1i(m_uniformLocations.overdrawView, m_bOverdrawView);
+	if (m_bOverdrawView == true)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+	else
+	{
+		glDisable(GL_BLEND);
+	}
 
-	// 2. Rotate 90 degrees around the X-axis to lay the shape horizontally
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(270.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	int itemCount = frame.renderQueue.GetCount();
+	bool bOpaque = (frame.opaqueCount > 0) || (frame.visibleBatches.empty() == false);
+	if (bQueries == true)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, query.depthID);
+	}
+	if ((m_bDepthPrepass == true) && (bOpaque == true))
+	{
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glUniform1i(m_uniformLocations.depthOnly, true);
+		DrawStaticBatches();
+		DrawQueued(0, frame.opaqueCount);
+		glUniform1i(m_uniformLocations.depthOnly, false);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+	if (bQueries == true)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		glBeginQuery(GL_SAMPLES_PASSED, query.shadeID);
+	}
+	if ((m_bDepthPrepass == true) && (bOpaque == true))
+	{
+		// only the nearest fragment of each pixel passes, and
+		// the depth is already written
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		DrawStaticBatches();
+		DrawQueued(0, frame.opaqueCount);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+	}
+	else
+	{
+		DrawStaticBatches();
+		DrawQueued(0, frame.opaqueCount);
+	}
 
-	// 3. Apply scaling to create the desired dimensions
-	modelMatrix = glm::scale(modelMatrix, sphereScale);
+	// blended records test against the opaque depth but do
+	// not write it, so they never hide each other
+	bool bWeightedBlend = (m_bWeightedBlendReady == true) && (m_bOverdrawView == false) &&
+		(frame.opaqueCount < itemCount);
+	if (bWeightedBlend == true)
+	{
+		m_transparencyBuffer.Begin(m_viewportWidth, m_viewportHeight);
+		glUniform1i(m_uniformLocations.weightedBlend, true);
+		DrawQueued(frame.opaqueCount, itemCount);
+		glUniform1i(m_uniformLocations.weightedBlend, false);
+	}
+	else if (frame.opaqueCount < itemCount)
+	{
+		if (m_bOverdrawView == false)
+		{
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+		glDepthMask(GL_FALSE);
+		DrawQueued(frame.opaqueCount, itemCount);
+		glDepthMask(GL_TRUE);
+	}
+	if (bQueries == true)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		query.bPending = true;
+	}
+	m_sampleQueryFrame++;
 
-	// Send the matrix to the shader
-	m_pShaderManager->setMat4Value("model", modelMatrix);
+	if (bWeightedBlend == true)
+	{
+		m_transparencyBuffer.Resolve();
+	}
+	glDisable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// Apply the corrected texture orientation
-	SetTextureUVScale(-1.0f, 1.0f); // Flip texture to fix the upside-down issue
+	m_pFrame = NULL;
+}
 
-	// Render the sphere
-	SetShaderMaterial("PlasticMaterial"); // Plastic material
-	SetShaderColor(0.3f, 0.3f, 0.3f, 1.0f); // Light gray plastic
-	SetShaderTexture("case");
-	m_basicMeshes->DrawSphereMesh();
+/***********************************************************
+ *  BenchmarkStateLookups()
+ *
+ *  This method is used for measuring the CPU cost of finding
+ *  the material and texture state of one frame's draws.
+ *  The tag path repeats what the setters did before handles
+ *  existed: copy each tag into a std::string and compare it
+ *  against every entry.  The hash path looks the tags up in
+ *  the name tables, and the handle path indexes the lists
+ *  with handles resolved in advance, as RenderScene() does.
+ *  The tags are those of the loaded scene's draw records.
+ ***********************************************************/
+void SceneManager::BenchmarkStateLookups(int frameCount, std::ostream& output) const
+{
+	// the tags each draw of one frame would look up
+	const SceneFile::MATERIAL_RECORD* pMaterials = m_sceneFile.GetMaterials();
+	const SceneFile::TEXTURE_RECORD* pTextures = m_sceneFile.GetTextures();
+	const int drawCount = m_drawRecordCount;
+	std::vector<FRAME_STATE_TAGS> frameTags(drawCount);
+	for (int i = 0; i < drawCount; i++)
+	{
+		const SceneFile::DRAW_RECORD& record = m_pDrawRecords[i];
+		frameTags[i].materialTag = pMaterials[record.materialIndex].tag;
+		frameTags[i].textureTag = (record.textureIndex >= 0) ? pTextures[record.textureIndex].tag : NULL;
+	}
 
+	// resolve the frame's handles once, as PrepareScene() does
+	std::vector<int> materialHandles(drawCount);
+	std::vector<int> textureHandles(drawCount);
+	for (int i = 0; i < drawCount; i++)
+	{
+		materialHandles[i] = FindMaterialHandle(frameTags[i].materialTag);
+		textureHandles[i] = (frameTags[i].textureTag != NULL) ?
+			FindTextureHandle(frameTags[i].textureTag) : -1;
+	}
 
+	// the checksum keeps the compiler from removing the lookups
+	float checksum = 0.0f;
+	std::chrono::high_resolution_clock::time_point start;
+	std::chrono::duration<double, std::nano> tagTime(0.0);
+	std::chrono::duration<double, std::nano> hashTime(0.0);
+	std::chrono::duration<double, std::nano> handleTime(0.0);
 
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		for (int i = 0; i < drawCount; i++)
+		{
+			std::string materialTag = frameTags[i].materialTag;
+			for (size_t index = 0; index < m_objectMaterials.size(); index++)
+			{
+				if (m_objectMaterials[index].tag.compare(materialTag) == 0)
+				{
+					checksum += m_objectMaterials[index].shininess;
+					break;
+				}
+			}
+
+			if (frameTags[i].textureTag != NULL)
+			{
+				std::string textureTag = frameTags[i].textureTag;
+				for (size_t index = 0; index < m_textureIDs.size(); index++)
+				{
+					if (m_textureIDs[index].tag.compare(textureTag) == 0)
+					{
+						checksum += static_cast<float>(m_textureIDs[index].handle);
+						break;
+					}
+				}
+			}
+		}
+	}
+	tagTime = std::chrono::high_resolution_clock::now() - start;
 
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		for (int i = 0; i < drawCount; i++)
+		{
+			int materialHandle = FindMaterialHandle(frameTags[i].materialTag);
+			if (materialHandle >= 0)
+			{
+				checksum += m_objectMaterials[materialHandle].shininess;
+			}
+			if (frameTags[i].textureTag != NULL)
+			{
+				checksum += static_cast<float>(FindTextureHandle(frameTags[i].textureTag));
+			}
+		}
+	}
+	hashTime = std::chrono::high_resolution_clock::now() - start;
 
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		for (int i = 0; i < drawCount; i++)
+		{
+			if (materialHandles[i] >= 0)
+			{
+				checksum += m_objectMaterials[materialHandles[i]].shininess;
+			}
+			checksum += static_cast<float>(textureHandles[i]);
+		}
+	}
+	handleTime = std::chrono::high_resolution_clock::now() - start;
+
+	double frames = (frameCount > 0) ? frameCount : 1;
+	output << "{" << std::endl;
+	output << "  \"frames\": " << frameCount << "," << std::endl;
+	output << "  \"draws_per_frame\": " << drawCount << "," << std::endl;
+	output << "  \"tag_ns_per_frame\": " << tagTime.count() / frames << "," << std::endl;
+	output << "  \"hash_ns_per_frame\": " << hashTime.count() / frames << "," << std::endl;
+	output << "  \"handle_ns_per_frame\": " << handleTime.count() / frames << "," << std::endl;
+	output << "  \"checksum\": " << checksum << std::endl;
+	output << "}" << std::endl;
 }
@@ -10,8 +10,23 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "BoundingVolumeHierarchy.h"
+#include "GpuCulling.h"
+#include "LightClusters.h"
+#include "NameTable.h"
+#include "PrimitiveMeshes.h"
+#include "ProgramCache.h"
+#include "RenderQueue.h"
+#include "SceneFile.h"
+#include "SceneGraph.h"
+#include "SceneUniforms.h"
+#include "ShadowAtlas.h"
+#include "StaticBatches.h"
+#include "TextureManager.h"
+#include "TransparencyBuffer.h"
+#include "WorkerPool.h"
 
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -25,14 +40,14 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager* pShaderManager);
+	SceneManager(ShaderManager* pShaderManager, SceneUniforms* pSceneUniforms, ProgramCache* pProgramCache);
 	// destructor
 	~SceneManager();
 
 	struct TEXTURE_INFO
 	{
 		std::string tag;
-		uint32_t ID;
+		int handle;
 	};
 
 	struct OBJECT_MATERIAL
@@ -45,29 +60,257 @@ public:
 		std::string tag;
 	};
 
+	// state changes of the last RenderScene() call
+	struct RENDER_COUNTERS
+	{
+		int draws;
+		int materialBinds;
+		int materialBindsAvoided;
+		int textureBinds;
+		int textureBindsAvoided;
+		// switches between meshes, all in one vertex array
+		int meshBinds;
+		int meshBindsAvoided;
+		// draw calls issued, fewer than draws when instancing
+		int drawCalls;
+		// frustum culling work, draws is what was left
+		int cullNodesTested;
+		int cullObjectsTested;
+		int objectsCulled;
+		// indices drawn, summed over every draw and instance
+		int indicesSubmitted;
+		// draws using each detail level, 0 the finest
+		int levelDraws[PrimitiveMeshes::LOD_COUNT];
+		// point lights in the scene, and their references over
+		// all light clusters of the frame
+		int pointLights;
+		int clusterLightReferences;
+		// samples that passed the depth test in the depth
+		// pre-pass and in the shading passes, counted by
+		// occlusion queries a few frames ago
+		int depthPrepassSamples;
+		int shadedSamples;
+		// times the shadow atlas was rendered, 0 when cached
+		int shadowMapUpdates;
+		// static batches drawn, each counted in drawCalls too
+		int staticBatches;
+	};
+
+	// the work of a frame that needs the camera but no GL
+	// calls, done by PrepareFrame() ahead of RenderScene()
+	struct PREPARED_FRAME
+	{
+		// draw records and static batches that survived culling
+		std::vector<int> visibleRecords;
+		std::vector<int> visibleBatches;
+		// detail level of every draw record for the frame
+		std::vector<int> recordLevels;
+		// queued draws sorted by state, the opaque ones first
+		RenderQueue renderQueue;
+		int opaqueCount;
+		// frustum culling work of the frame
+		int cullNodesTested;
+		int cullObjectsTested;
+		int objectsCulled;
+		// point lights binned for the camera
+		LightClusters::BINNED_LIGHTS lights;
+	};
+
 private:
-	// pointer to shader manager object
+	// indirect commands submitted with one texture array bound
+	struct INDIRECT_BATCH
+	{
+		// queued draws of the batch
+		int firstItem;
+		int itemCount;
+		int firstCommand;
+		int commandCount;
+		// texture to bind for the batch, -1 when untextured
+		int textureHandle;
+		// every command keeps its place, culled ones draw nothing,
+		// so the draw order is kept
+		bool bFixedCommands;
+	};
+
+	// per-draw state last set by RenderScene(), -2 when unknown
+	struct DRAW_STATE
+	{
+		int materialHandle;
+		// texture handle, -1 when drawing with a color
+		int textureHandle;
+		int meshID;
+		int level;
+		glm::vec4 color;
+		glm::vec2 UVscale;
+	};
+
+	// locations of the uniforms set for every draw
+	struct UNIFORM_LOCATIONS
+	{
+		GLint model;
+		GLint normalMatrix;
+		GLint objectColor;
+		GLint objectTexture;
+		GLint objectTextureLayer;
+		GLint useTexture;
+		GLint uvScale;
+		GLint materialIndex;
+		GLint instanced;
+		GLint depthOnly;
+		GLint overdrawView;
+		GLint weightedBlend;
+	};
+
+	// occlusion queries of one frame's passes
+	struct SAMPLE_QUERY
+	{
+		GLuint depthID;
+		GLuint shadeID;
+		bool bPending;
+	};
+
+	// frames a sample query waits before it is read
+	enum
+	{
+		SAMPLE_QUERY_FRAMES = 3
+	};
+
+	// pointer to shader manager object, unused since the programs
+	// come from the program cache and the uniforms from the
+	// uniform buffers
 	ShaderManager* m_pShaderManager;
+	// pointer to the uniform buffers and uniform location cache
+	SceneUniforms* m_pSceneUniforms;
+	// pointer to the cache the shader programs are built through
+	ProgramCache* m_pProgramCache;
+	// per-draw uniform locations, resolved in PrepareScene()
+	UNIFORM_LOCATIONS m_uniformLocations;
 	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
+	PrimitiveMeshes* m_basicMeshes;
+	// pointer to the worker threads used for CPU-side loading
+	WorkerPool* m_pWorkerPool;
+	// pointer to the texture arrays holding the loaded textures
+	TextureManager* m_pTextureManager;
 	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
-	// defined object materials
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// load textures through the compressed texture cache
+	bool m_bUseTextureCache;
+	// defined object materials, indexed by material handle
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// material tag to material handle lookup
+	NameTable m_materialNames;
+	// texture tag to texture handle lookup
+	NameTable m_textureNames;
+	// loaded scene description
+	SceneFile m_sceneFile;
+	// material and texture handles of the scene file's tables,
+	// indexed by the table indices in the draw records
+	std::vector<int> m_sceneMaterialHandles;
+	std::vector<int> m_sceneTextureHandles;
+	// objects of a text scene, built once in PrepareScene()
+	SceneGraph m_sceneGraph;
+	// draw records of a text scene, kept in step with the scene graph
+	std::vector<SceneFile::DRAW_RECORD> m_drawRecords;
+	// draw records of the loaded scene, owned or mapped
+	const SceneFile::DRAW_RECORD* m_pDrawRecords;
+	int m_drawRecordCount;
+	// world-space box of each draw record
+	std::vector<BoundingVolumeHierarchy::AABB> m_objectBounds;
+	// tree over the object boxes for frustum culling
+	BoundingVolumeHierarchy m_objectBVH;
+	// skip the draw records outside the view frustum
+	bool m_bCullObjects;
+	// cull on the GPU instead, when the multi-draw path is used
+	bool m_bGpuCulling;
+	// compute shader culling, created in PrepareScene() when asked for
+	GpuCulling m_gpuCulling;
+	bool m_bGpuCullingReady;
+	// objects of the frame as the compute shader reads them
+	std::vector<GpuCulling::CULL_OBJECT> m_cullObjects;
+	// point lights of the scene, binned per frame
+	LightClusters m_lightClusters;
+	// light sources as last written to the light block
+	SceneUniforms::LIGHT_DATA m_lights[SceneUniforms::MAX_LIGHTS];
+	int m_lightCount;
+	// shadow maps of the light sources
+	bool m_bShadows;
+	ShadowAtlas m_shadowAtlas;
+	bool m_bShadowsReady;
+	// a light or shadow caster changed since the atlas was rendered
+	bool m_bShadowsDirty;
+	int m_shadowKernelSize;
+	// draw the objects that never move from pre-transformed batches
+	bool m_bStaticBatching;
+	StaticBatches m_staticBatches;
+	// batch each draw record is baked into, -1 when drawn alone
+	std::vector<int> m_recordBatches;
+	// tree over the batch boxes
+	BoundingVolumeHierarchy m_batchBVH;
+	// pick a detail level per object from its size on screen
+	bool m_bUseLevelsOfDetail;
+	// detail level each draw record was last prepared with,
+	// kept across frames for the hysteresis; only
+	// PrepareFrame() reads it, the frames carry copies
+	std::vector<int> m_recordLevels;
+	// normal matrix of each draw record, 9 floats per record,
+	// recomputed only when the world matrices change
+	std::vector<float> m_normalMatrices;
+	// frame being drawn by RenderScene(), NULL outside it
+	const PREPARED_FRAME* m_pFrame;
+	// viewport the scene is drawn into, read in PrepareScene()
+	// so frames can be prepared without the GL context
+	int m_viewportWidth;
+	int m_viewportHeight;
+	// sort the draws by state instead of drawing in file order
+	bool m_bSortDraws;
+	// draw runs of the same mesh with one instanced call
+	bool m_bUseInstancing;
+	// submit the instanced batches with multi-draw indirect
+	// calls when the context supports them
+	bool m_bUseMultiDraw;
+	// per-instance attributes of the frame, in queue order
+	std::vector<PrimitiveMeshes::INSTANCE_DATA> m_instances;
+	// indirect commands of the frame and the calls submitting them
+	std::vector<PrimitiveMeshes::DRAW_COMMAND> m_drawCommands;
+	std::vector<INDIRECT_BATCH> m_indirectBatches;
+	// lay down the depth of the opaque draws before shading
+	bool m_bDepthPrepass;
+	// add up the fragments of each pixel instead of shading
+	bool m_bOverdrawView;
+	// draw the blended records with weighted blended
+	// transparency instead of back to front
+	bool m_bWeightedBlend;
+	// accumulation targets, created in PrepareScene() when asked for
+	TransparencyBuffer m_transparencyBuffer;
+	bool m_bWeightedBlendReady;
+	// samples passed by the depth and shading passes
+	SAMPLE_QUERY m_sampleQueries[SAMPLE_QUERY_FRAMES];
+	int m_sampleQueryFrame;
+	int m_depthPrepassSamples;
+	int m_shadedSamples;
+	// state changes of the last frame
+	RENDER_COUNTERS m_renderCounters;
+	// state set by the previous draw of the frame
+	DRAW_STATE m_drawState;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
+	// bind loaded OpenGL texture arrays to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
-	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	// register a loaded texture under a tag
+	void RegisterTexture(const std::string& tag, int textureHandle);
+	// find a loaded texture handle by tag, -1 if there is none
+	int FindTextureHandle(const char* tag) const;
+	// register a material, returns its handle
+	int RegisterMaterial(const OBJECT_MATERIAL& material);
+	// find a defined material handle by tag, -1 if there is none
+	int FindMaterialHandle(const char* tag) const;
+	// look up the locations of the per-draw uniforms
+	void ResolveUniformLocations();
+	// write the defined materials into the material table
+	void UploadMaterials();
 
 	// set the transformation values 
 	// into the transform buffer
@@ -78,6 +321,53 @@ private:
 		float ZrotationDegrees,
 		glm::vec3 positionXYZ);
 
+	// cull the draw records of a frame, pick their detail
+	// levels and queue them in state order
+	void QueueDraws(const glm::mat4& viewProjection, const glm::mat4& projection, const glm::vec3& viewPosition,
+		PREPARED_FRAME& frame);
+	// recompute the normal matrix of every draw record
+	void UpdateNormalMatrices();
+	// recompute the world-space box of every draw record
+	void UpdateObjectBounds();
+	// pick the detail level of a draw record for this frame
+	int SelectLevel(int recordIndex, const glm::vec4& clipW, float projectionScale);
+	// set the material, texture, color and UV scale of the
+	// next draw, skipping what is already set
+	void ApplyDrawState(int materialHandle, int textureHandle, const glm::vec4& color, const glm::vec2& UVscale);
+	// set the state of one draw record, skipping what is
+	// already set, then draw it
+	void DrawRecord(int recordIndex);
+	// bake the static opaque records into the static batches
+	void BuildStaticBatches();
+	// draw the static batches that survived culling
+	void DrawStaticBatches();
+	// write the queued records into the instance buffer,
+	// returns the number of instances
+	int UploadInstances();
+	// draw a range of the queued records as instanced batches
+	void DrawInstanced(int firstItem, int endItem);
+	// build and upload the indirect commands of the queued records
+	void BuildIndirectCommands();
+	// true when this frame culls on the GPU
+	bool IsGpuCullingActive() const;
+	// cull the queued records on the GPU into indirect commands
+	void BuildGpuCulledCommands();
+	// submit the indirect batches of a range of the queued records
+	void SubmitIndirect(int firstItem, int endItem);
+	// draw a range of the queued records with this frame's path
+	void DrawQueued(int firstItem, int endItem);
+	// read the sample counts of a finished frame
+	void ResolveSampleQuery(SAMPLE_QUERY& query);
+	// render the shadow atlas again if anything it shows changed
+	void UpdateShadowMaps();
+	// draw every opaque record into the bound depth target
+	void DrawShadowCasters();
+
+	// set a model matrix and its normal matrix into the shader
+	void SetModelMatrix(const glm::mat4& modelMatrix);
+	// set a model matrix with a precomputed normal matrix
+	void SetModelMatrix(const float modelMatrix[16], const float normalMatrix[9]);
+
 	// set the color values into the shader
 	void SetShaderColor(
 		float redColorValue,
@@ -88,6 +378,8 @@ private:
 	// set the texture data into the shader
 	void SetShaderTexture(
 		std::string textureTag);
+	void SetShaderTexture(
+		int textureHandle);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -96,18 +388,66 @@ private:
 	// set the object material into the shader
 	void SetShaderMaterial(
 		std::string materialTag);
+	void SetShaderMaterial(
+		int materialHandle);
 
 public:
 
 	// The following methods are for the students to 
 	// customize for their own 3D scene
 	void PrepareScene();
-	void RenderScene();
+	// cull, pick the detail levels, sort and bin the lights of
+	// a frame; makes no GL calls, so it can run on another
+	// thread than RenderScene()
+	void PrepareFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition,
+		PREPARED_FRAME& frame);
+	// draw a prepared frame with the camera set in the uniforms
+	void RenderScene(const PREPARED_FRAME& frame);
+
+	// load the scene file drawn by PrepareScene() and RenderScene()
+	bool LoadScene(const std::string& filename);
+	// add the scene file's objects to the scene graph
+	void BuildSceneGraph();
 
 	void LoadSceneTextures();
+	// bake the textures of a scene file into the compressed texture cache
+	static bool BakeSceneTextures(const std::string& sceneFilename);
+	// enable or disable the compressed texture cache before PrepareScene()
+	void SetUseTextureCache(bool bUseCache) { m_bUseTextureCache = bUseCache; }
+	// enable or disable sorting the draws by state
+	void SetSortDraws(bool bSortDraws) { m_bSortDraws = bSortDraws; }
+	// enable or disable drawing runs of the same mesh instanced
+	void SetUseInstancing(bool bUseInstancing) { m_bUseInstancing = bUseInstancing; }
+	// enable or disable submitting the batches with multi-draw indirect
+	void SetUseMultiDraw(bool bUseMultiDraw) { m_bUseMultiDraw = bUseMultiDraw; }
+	// enable or disable baking the static objects into batches,
+	// before PrepareScene()
+	void SetStaticBatching(bool bStaticBatching) { m_bStaticBatching = bStaticBatching; }
+	// enable or disable picking detail levels by screen size
+	void SetLevelsOfDetail(bool bUseLevels) { m_bUseLevelsOfDetail = bUseLevels; }
+	// enable or disable skipping objects outside the view
+	void SetFrustumCulling(bool bCullObjects) { m_bCullObjects = bCullObjects; }
+	// enable or disable culling in a compute shader, before PrepareScene()
+	void SetGpuCulling(bool bGpuCulling) { m_bGpuCulling = bGpuCulling; }
+	// enable or disable the depth-only pass before shading
+	void SetDepthPrepass(bool bDepthPrepass) { m_bDepthPrepass = bDepthPrepass; }
+	// enable or disable showing the fragments per pixel
+	void SetOverdrawView(bool bOverdrawView) { m_bOverdrawView = bOverdrawView; }
+	// enable or disable order-independent transparency, before PrepareScene()
+	void SetWeightedBlend(bool bWeightedBlend) { m_bWeightedBlend = bWeightedBlend; }
+	// enable or disable the shadow maps, before PrepareScene()
+	void SetShadows(bool bShadows) { m_bShadows = bShadows; }
+	// taps across the shadow filter kernel, before PrepareScene()
+	void SetShadowKernelSize(int kernelSize) { m_shadowKernelSize = kernelSize; }
+	// state changes made and avoided by the last RenderScene()
+	const RENDER_COUNTERS& GetRenderCounters() const { return m_renderCounters; }
 
 	// pre-set light sources for 3D scene
 	void SetupSceneLights();
 	// pre-define the object materials for lighting
 	void DefineObjectMaterials();
+
+	// time the per-frame material and texture lookups of the loaded
+	// scene by tag and by handle, and write the results as JSON
+	void BenchmarkStateLookups(int frameCount, std::ostream& output) const;
 };
\ No newline at end of file
@@ -0,0 +1,218 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneUniforms.cpp
+// =================
+// uniform buffer objects and cached uniform locations for the scene shader
+//
+//  The camera, the light sources and the material table live in std140
+//  uniform blocks that are written once per frame or once per scene.
+//  Per-draw uniforms are set through locations that are looked up once
+//  per program instead of once per call.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneUniforms.h"
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_CameraBlockName = "CameraBlock";
+	const char* g_LightBlockName = "LightBlock";
+	const char* g_MaterialBlockName = "MaterialBlock";
+}
+
+// the structs are uploaded as-is, so their sizes must match std140
+static_assert(sizeof(SceneUniforms::LIGHT_DATA) == 160, "LIGHT_DATA does not match the std140 LightSource layout");
+static_assert(sizeof(SceneUniforms::MATERIAL_DATA) == 48, "MATERIAL_DATA does not match the std140 Material layout");
+
+/***********************************************************
+ *  SceneUniforms()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneUniforms::SceneUniforms()
+{
+	m_programID = 0;
+	m_cameraBuffer = 0;
+	m_lightBuffer = 0;
+	m_materialBuffer = 0;
+	m_camera.view = glm::mat4(1.0f);
+	m_camera.projection = glm::mat4(1.0f);
+	m_camera.viewProjection = glm::mat4(1.0f);
+	m_camera.viewPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_camera.padding0 = 0.0f;
+}
+
+/***********************************************************
+ *  ~SceneUniforms()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneUniforms::~SceneUniforms()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the uniform buffers,
+ *  binding them to their binding points and attaching the
+ *  uniform blocks of the passed in program to those points.
+ ***********************************************************/
+bool SceneUniforms::Create(GLuint programID)
+{
+	Destroy();
+
+	m_programID = programID;
+
+	GLuint buffers[3];
+	glGenBuffers(3, buffers);
+	m_cameraBuffer = buffers[0];
+	m_lightBuffer = buffers[1];
+	m_materialBuffer = buffers[2];
+
+	// allocate the full size of each block, so partial writes are valid
+	glBindBuffer(GL_UNIFORM_BUFFER, m_cameraBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CAMERA_DATA), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LIGHT_DATA) * MAX_LIGHTS, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(MATERIAL_DATA) * MAX_MATERIALS, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_cameraBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_lightBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialBuffer);
+
+	// GLSL 3.30 has no binding layout qualifier, so the
+	// blocks are attached to their binding points here
+	bool bSuccess = true;
+	bSuccess &= BindBlock(g_CameraBlockName, CAMERA_BLOCK_BINDING);
+	bSuccess &= BindBlock(g_LightBlockName, LIGHT_BLOCK_BINDING);
+	bSuccess &= BindBlock(g_MaterialBlockName, MATERIAL_BLOCK_BINDING);
+
+	return(bSuccess);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the uniform buffers and
+ *  forgetting the cached uniform locations.
+ ***********************************************************/
+void SceneUniforms::Destroy()
+{
+	if (m_cameraBuffer != 0)
+	{
+		GLuint buffers[3] = { m_cameraBuffer, m_lightBuffer, m_materialBuffer };
+		glDeleteBuffers(3, buffers);
+	}
+	m_cameraBuffer = 0;
+	m_lightBuffer = 0;
+	m_materialBuffer = 0;
+	m_programID = 0;
+	m_locations.Clear();
+}
+
+/***********************************************************
+ *  BindBlock()
+ *
+ *  This method is used for attaching a named uniform block
+ *  of the program to a binding point.
+ ***********************************************************/
+bool SceneUniforms::BindBlock(const char* blockName, GLuint binding)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(m_programID, blockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "Uniform block " << blockName << " not found in shader program" << std::endl;
+		return(false);
+	}
+
+	glUniformBlockBinding(m_programID, blockIndex, binding);
+	return(true);
+}
+
+/***********************************************************
+ *  GetUniformLocation()
+ *
+ *  This method is used for getting the location of a
+ *  uniform.  Each name is only looked up in GL once; later
+ *  calls are answered from the cache.
+ ***********************************************************/
+GLint SceneUniforms::GetUniformLocation(const char* name)
+{
+	// -1 is both a cache miss and the GL result for an
+	// unused uniform, so misses are stored as -2
+	GLint location = m_locations.Find(name);
+	if (location == -1)
+	{
+		location = glGetUniformLocation(m_programID, name);
+		m_locations.Insert(name, (location >= 0) ? location : -2);
+	}
+
+	return((location >= 0) ? location : -1);
+}
+
+/***********************************************************
+ *  SetCamera()
+ *
+ *  This method is used for writing the view and projection
+ *  matrices, their product and the camera position into
+ *  the camera block.  The product is formed once per frame
+ *  here instead of once per vertex in the shader.
+ ***********************************************************/
+void SceneUniforms::SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition)
+{
+	static_assert(sizeof(CAMERA_DATA) == 208, "CAMERA_DATA does not match the std140 CameraBlock layout");
+
+	m_camera.view = view;
+	m_camera.projection = projection;
+	m_camera.viewProjection = projection * view;
+	m_camera.viewPosition = viewPosition;
+	m_camera.padding0 = 0.0f;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_cameraBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CAMERA_DATA), &m_camera);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for writing the light sources into
+ *  the light block.  Lights past the passed in count are
+ *  left unchanged.
+ ***********************************************************/
+void SceneUniforms::SetLights(const LIGHT_DATA* lights, int lightCount)
+{
+	if (lightCount > MAX_LIGHTS)
+	{
+		std::cout << "Only " << MAX_LIGHTS << " light sources are supported" << std::endl;
+		lightCount = MAX_LIGHTS;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LIGHT_DATA) * lightCount, lights);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/***********************************************************
+ *  SetMaterials()
+ *
+ *  This method is used for writing the material table.  A
+ *  draw selects its entry with the materialIndex uniform.
+ ***********************************************************/
+void SceneUniforms::SetMaterials(const MATERIAL_DATA* materials, int materialCount)
+{
+	if (materialCount > MAX_MATERIALS)
+	{
+		std::cout << "Only " << MAX_MATERIALS << " materials are supported" << std::endl;
+		materialCount = MAX_MATERIALS;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MATERIAL_DATA) * materialCount, materials);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
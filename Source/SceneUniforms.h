@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneUniforms.h
+// ===============
+// uniform buffer objects and cached uniform locations for the scene shader
+//
+//  The camera, the light sources and the material table live in std140
+//  uniform blocks that are written once per frame or once per scene.
+//  Per-draw uniforms are set through locations that are looked up once
+//  per program instead of once per call.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "NameTable.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  SceneUniforms
+ *
+ *  This class owns the uniform buffers shared by the view
+ *  and scene managers.  The C++ structs below mirror the
+ *  std140 layout of the blocks in the shaders, so they
+ *  are uploaded with a single glBufferSubData each.
+ ***********************************************************/
+class SceneUniforms
+{
+public:
+	// must match TOTAL_LIGHTS in fragmentShader.glsl
+	static const int MAX_LIGHTS = 4;
+	// must match TOTAL_MATERIALS in fragmentShader.glsl and
+	// SceneFile::MAX_MATERIALS
+	static const int MAX_MATERIALS = 64;
+
+	// binding points of the uniform blocks
+	static const GLuint CAMERA_BLOCK_BINDING = 0;
+	static const GLuint LIGHT_BLOCK_BINDING = 1;
+	static const GLuint MATERIAL_BLOCK_BINDING = 2;
+
+	// std140 layout of LightSource
+	struct LIGHT_DATA
+	{
+		glm::vec3 position;
+		float padding0;
+		glm::vec3 ambientColor;
+		float padding1;
+		glm::vec3 diffuseColor;
+		float padding2;
+		glm::vec3 specularColor;
+		float focalStrength;
+		float specularIntensity;
+		// std140 bool, zero for unused lights
+		int bActive;
+		float padding3[2];
+		// shadow atlas tile, see ShadowAtlas::LIGHT_VIEW,
+		// with a zero size for lights without a shadow
+		glm::vec4 shadowTile;
+		// world space to the light's clip space
+		glm::mat4 shadowMatrix;
+	};
+
+	// std140 layout of Material
+	struct MATERIAL_DATA
+	{
+		glm::vec3 ambientColor;
+		float ambientStrength;
+		glm::vec3 diffuseColor;
+		float padding0;
+		glm::vec3 specularColor;
+		float shininess;
+	};
+
+	// constructor
+	SceneUniforms();
+	// destructor
+	~SceneUniforms();
+
+	// create the uniform buffers and attach the blocks of a program
+	bool Create(GLuint programID);
+	// free the uniform buffers
+	void Destroy();
+
+	// location of a uniform in the program, looked up on first use
+	GLint GetUniformLocation(const char* name);
+
+	// write the camera block
+	void SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition);
+	// write the light block
+	void SetLights(const LIGHT_DATA* lights, int lightCount);
+	// write the material table
+	void SetMaterials(const MATERIAL_DATA* materials, int materialCount);
+
+	// camera position and matrices last written to the camera block
+	const glm::vec3& GetViewPosition() const { return m_camera.viewPosition; }
+	const glm::mat4& GetView() const { return m_camera.view; }
+	const glm::mat4& GetProjection() const { return m_camera.projection; }
+	const glm::mat4& GetViewProjection() const { return m_camera.viewProjection; }
+	// program the blocks are attached to, the scene program
+	GLuint GetProgram() const { return m_programID; }
+
+private:
+	// std140 layout of CameraBlock
+	struct CAMERA_DATA
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		// projection times view, so vertices need one multiply
+		glm::mat4 viewProjection;
+		glm::vec3 viewPosition;
+		float padding0;
+	};
+
+	// attach one named block of the program to a binding point
+	bool BindBlock(const char* blockName, GLuint binding);
+
+	// program the blocks and uniform locations belong to
+	GLuint m_programID;
+	// uniform buffers
+	GLuint m_cameraBuffer;
+	GLuint m_lightBuffer;
+	GLuint m_materialBuffer;
+	// uniform name to location cache of the program
+	NameTable m_locations;
+	// copy of the camera block, for CPU-side sorting
+	CAMERA_DATA m_camera;
+};
@@ -0,0 +1,245 @@
+///////////////////////////////////////////////////////////////////////////////
+// ShadowAtlas.cpp
+// ===============
+// one depth texture holding the shadow maps of every scene light
+//
+//  Each light source gets a tile of the atlas, rendered from the light
+//  towards the scene.  The maps are only rendered again when a light or
+//  a shadow casting object changes, so a static scene pays for its
+//  shadows once.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowAtlas.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	const char* g_ShadowAtlasName = "shadowAtlas";
+	const char* g_ShadowKernelName = "shadowKernelRadius";
+
+	// widest view a tile covers when the light is close to
+	// or inside the casters' box
+	const float MAXIMUM_FIELD_OF_VIEW = glm::radians(150.0f);
+	const float MINIMUM_NEAR_PLANE = 0.05f;
+	// depth offset of the casters against shadow acne, in
+	// units of the slope and of the smallest depth step
+	const float POLYGON_OFFSET_FACTOR = 1.5f;
+	const float POLYGON_OFFSET_UNITS = 3.0f;
+}
+
+/***********************************************************
+ *  ShadowAtlas()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowAtlas::ShadowAtlas()
+{
+	m_framebuffer = 0;
+	m_depthTexture = 0;
+	m_size = 0;
+	m_kernelRadius = 1;
+	m_previousFramebuffer = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_previousViewport[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  ~ShadowAtlas()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowAtlas::~ShadowAtlas()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the atlas depth
+ *  texture, set up to compare against a reference depth
+ *  with bilinear filtering, and a framebuffer with only
+ *  that depth attached.
+ ***********************************************************/
+bool ShadowAtlas::Create(int size)
+{
+	Destroy();
+
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Shadow atlas framebuffer is incomplete" << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	m_size = size;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the atlas texture and
+ *  framebuffer.
+ ***********************************************************/
+void ShadowAtlas::Destroy()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+	}
+	if (m_depthTexture != 0)
+	{
+		glDeleteTextures(1, &m_depthTexture);
+	}
+	m_framebuffer = 0;
+	m_depthTexture = 0;
+	m_size = 0;
+}
+
+/***********************************************************
+ *  FitLight()
+ *
+ *  This method is used for building the camera of a tile.
+ *  The light looks at the center of the box with a field
+ *  of view that just holds the box's bounding sphere, and
+ *  the near and far planes hug the sphere, which keeps the
+ *  depth precision where the casters are.
+ ***********************************************************/
+ShadowAtlas::LIGHT_VIEW ShadowAtlas::FitLight(int tile, const glm::vec3& position,
+	const glm::vec3& boundsMinimum, const glm::vec3& boundsMaximum)
+{
+	glm::vec3 center = (boundsMinimum + boundsMaximum) * 0.5f;
+	float radius = glm::length(boundsMaximum - boundsMinimum) * 0.5f;
+	glm::vec3 toCenter = center - position;
+	float distance = glm::length(toCenter);
+
+	// a light at the center looks down, as the scene lights hang above it
+	glm::vec3 direction = (distance > 0.0f) ? toCenter / distance : glm::vec3(0.0f, -1.0f, 0.0f);
+	glm::vec3 up = (std::fabs(direction.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	float fieldOfView = MAXIMUM_FIELD_OF_VIEW;
+	if (distance > radius)
+	{
+		fieldOfView = std::min(2.0f * std::asin(radius / distance), MAXIMUM_FIELD_OF_VIEW);
+	}
+	float nearPlane = std::max(distance - radius, MINIMUM_NEAR_PLANE);
+	float farPlane = std::max(distance + radius, nearPlane * 2.0f);
+
+	LIGHT_VIEW lightView;
+	lightView.view = glm::lookAt(position, position + direction, up);
+	lightView.projection = glm::perspective(fieldOfView, 1.0f, nearPlane, farPlane);
+
+	float tileSize = 1.0f / TILES_PER_ROW;
+	lightView.tile = glm::vec4(
+		(tile % TILES_PER_ROW) * tileSize,
+		(tile / TILES_PER_ROW) * tileSize,
+		tileSize,
+		0.0f);
+
+	return(lightView);
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for binding the atlas framebuffer,
+ *  clearing it and offsetting the depth of the casters.
+ ***********************************************************/
+void ShadowAtlas::Begin()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_size, m_size);
+	glDepthMask(GL_TRUE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(POLYGON_OFFSET_FACTOR, POLYGON_OFFSET_UNITS);
+}
+
+/***********************************************************
+ *  SetTile()
+ *
+ *  This method is used for pointing the viewport at one
+ *  tile of the atlas.
+ ***********************************************************/
+void ShadowAtlas::SetTile(int tile)
+{
+	int tileSize = m_size / TILES_PER_ROW;
+	glViewport((tile % TILES_PER_ROW) * tileSize, (tile / TILES_PER_ROW) * tileSize, tileSize, tileSize);
+}
+
+/***********************************************************
+ *  End()
+ *
+ *  This method is used for returning to the framebuffer
+ *  and viewport that were set before Begin().
+ ***********************************************************/
+void ShadowAtlas::End()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_previousFramebuffer));
+	glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the atlas to its unit
+ *  and setting the sampler and kernel uniforms.
+ ***********************************************************/
+void ShadowAtlas::Bind(SceneUniforms& uniforms)
+{
+	glActiveTexture(GL_TEXTURE0 + ATLAS_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(uniforms.GetUniformLocation(g_ShadowAtlasName), ATLAS_UNIT);
+	glUniform1i(uniforms.GetUniformLocation(g_ShadowKernelName), m_kernelRadius);
+}
+
+/***********************************************************
+ *  SetKernelSize()
+ *
+ *  This method is used for setting the taps across the
+ *  filter kernel.  Each tap is already a bilinear 2x2
+ *  comparison, so 1 gives soft edges and wider kernels
+ *  blur them further.  Even sizes round up.
+ ***********************************************************/
+void ShadowAtlas::SetKernelSize(int kernelSize)
+{
+	m_kernelRadius = std::max(kernelSize, 1) / 2;
+}
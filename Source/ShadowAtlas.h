@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// ShadowAtlas.h
+// =============
+// one depth texture holding the shadow maps of every scene light
+//
+//  Each light source gets a tile of the atlas, rendered from the light
+//  towards the scene.  The maps are only rendered again when a light or
+//  a shadow casting object changes, so a static scene pays for its
+//  shadows once.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneUniforms.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  ShadowAtlas
+ *
+ *  This class owns the atlas depth texture and the
+ *  framebuffer its tiles are rendered through.  The scene
+ *  lights shine in every direction, so each tile holds a
+ *  perspective view from its light that just encloses the
+ *  box of the shadow casters; fragments outside that view
+ *  are lit.  The fragment shader compares against the
+ *  atlas with a square kernel of hardware filtered taps.
+ ***********************************************************/
+class ShadowAtlas
+{
+public:
+	// texture unit of the atlas, above the texture arrays
+	static const int ATLAS_UNIT = 15;
+	// tiles across and down, one per light source
+	static const int TILES_PER_ROW = 2;
+	// texels across the whole atlas
+	static const int DEFAULT_SIZE = 4096;
+
+	// camera of one light's tile
+	struct LIGHT_VIEW
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		// atlas offset in x and y and the tile size in z,
+		// in texture coordinates
+		glm::vec4 tile;
+	};
+
+	// constructor
+	ShadowAtlas();
+	// destructor
+	~ShadowAtlas();
+
+	// create the atlas texture and framebuffer
+	bool Create(int size);
+	// free the atlas texture and framebuffer
+	void Destroy();
+
+	// camera from a light position that encloses a box
+	static LIGHT_VIEW FitLight(int tile, const glm::vec3& position,
+		const glm::vec3& boundsMinimum, const glm::vec3& boundsMaximum);
+
+	// bind the framebuffer and clear every tile
+	void Begin();
+	// restrict the following draws to one tile
+	void SetTile(int tile);
+	// restore the framebuffer and state Begin() changed
+	void End();
+
+	// bind the atlas and set the sampling uniforms
+	void Bind(SceneUniforms& uniforms);
+
+	// taps across the filter kernel, odd, 1 for a single tap
+	void SetKernelSize(int kernelSize);
+
+private:
+	GLuint m_framebuffer;
+	GLuint m_depthTexture;
+	int m_size;
+	// filter taps from the center tap to the kernel edge
+	int m_kernelRadius;
+	// state saved by Begin()
+	GLint m_previousFramebuffer;
+	GLint m_previousViewport[4];
+};
@@ -0,0 +1,399 @@
+///////////////////////////////////////////////////////////////////////////////
+// StaticBatches.cpp
+// =================
+// bake the objects that never move into a few pre-transformed meshes
+//
+//  The basic shapes of every static object are moved into world space
+//  once, when the scene is prepared, and merged into one vertex and
+//  index buffer.  Objects drawn with the same material, texture and
+//  color in the same cell of a world grid share a batch, so the static
+//  scene draws with one call per batch instead of one per object while
+//  each batch stays small enough to cull.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StaticBatches.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	// edge of the world grid cells batches are split by, so a
+	// batch covers no more of the scene than a cell
+	const float CELL_SIZE = 16.0f;
+}
+
+/***********************************************************
+ *  StaticBatches()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StaticBatches::StaticBatches()
+{
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_previousVAO = 0;
+}
+
+/***********************************************************
+ *  ~StaticBatches()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StaticBatches::~StaticBatches()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  BATCH_KEY::operator==()
+ *
+ *  This method is used for comparing two keys byte by
+ *  byte, the same bytes the hash is taken over.
+ ***********************************************************/
+bool StaticBatches::BATCH_KEY::operator==(const BATCH_KEY& other) const
+{
+	return(memcmp(this, &other, sizeof(BATCH_KEY)) == 0);
+}
+
+/***********************************************************
+ *  BATCH_KEY_HASH::operator()()
+ *
+ *  This method is used for hashing the bytes of a key with
+ *  FNV-1a.  The key fields are all four bytes wide, so
+ *  there is no padding to hash.
+ ***********************************************************/
+size_t StaticBatches::BATCH_KEY_HASH::operator()(const BATCH_KEY& key) const
+{
+	const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(&key);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < sizeof(BATCH_KEY); i++)
+	{
+		hash ^= pBytes[i];
+		hash *= 16777619u;
+	}
+	return(static_cast<size_t>(hash));
+}
+
+/***********************************************************
+ *  FindBatch()
+ *
+ *  This method is used for finding the batch of a draw
+ *  state and cell, adding an empty one when there is none.
+ *  Generated scenes can have a state per object, so the
+ *  batches are looked up by hash.
+ ***********************************************************/
+int StaticBatches::FindBatch(const BATCH_KEY& key)
+{
+	std::unordered_map<BATCH_KEY, int, BATCH_KEY_HASH>::iterator found = m_batchLookup.find(key);
+	if (found != m_batchLookup.end())
+	{
+		return(found->second);
+	}
+
+	BATCH batch;
+	batch.materialHandle = key.materialHandle;
+	batch.textureHandle = key.textureHandle;
+	for (int i = 0; i < 4; i++)
+	{
+		batch.color[i] = key.color[i];
+	}
+	batch.firstIndex = 0;
+	batch.indexCount = 0;
+	batch.objectCount = 0;
+	m_batches.push_back(batch);
+
+	int batchIndex = static_cast<int>(m_batches.size()) - 1;
+	m_batchLookup[key] = batchIndex;
+
+	return(batchIndex);
+}
+
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method is used for adding one copy of a shape to
+ *  the batch of its draw state and of the grid cell its
+ *  origin lies in.  The color only matters for untextured
+ *  batches.  Nothing is baked until Upload(), when it is
+ *  known which batches hold enough objects.
+ ***********************************************************/
+int StaticBatches::AddObject(int meshID, const float worldMatrix[16], const float normalMatrix[9], const float UVscale[2],
+	int materialHandle, int textureHandle, const float color[4])
+{
+	if ((meshID < 0) || (meshID >= SceneGraph::MESH_COUNT))
+	{
+		return(-1);
+	}
+
+	BATCH_KEY key;
+	key.materialHandle = materialHandle;
+	key.textureHandle = textureHandle;
+	for (int i = 0; i < 4; i++)
+	{
+		key.color[i] = (textureHandle >= 0) ? 0.0f : color[i];
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		key.cell[axis] = static_cast<int>(std::floor(worldMatrix[12 + axis] / CELL_SIZE));
+	}
+
+	PENDING_OBJECT object;
+	object.meshID = meshID;
+	object.batchIndex = FindBatch(key);
+	memcpy(object.worldMatrix, worldMatrix, sizeof(object.worldMatrix));
+	memcpy(object.normalMatrix, normalMatrix, sizeof(object.normalMatrix));
+	memcpy(object.UVscale, UVscale, sizeof(object.UVscale));
+	m_objects.push_back(object);
+
+	m_batches[object.batchIndex].objectCount++;
+
+	return(static_cast<int>(m_objects.size()) - 1);
+}
+
+/***********************************************************
+ *  BakeObject()
+ *
+ *  This method is used for appending one object to the
+ *  merged geometry.  The positions are moved by the world
+ *  matrix, the normals by the normal matrix, and the
+ *  texture coordinates are multiplied by the UV scale,
+ *  which is what the vertex shader would do.  The bounds
+ *  start over for the first object of a batch.
+ ***********************************************************/
+void StaticBatches::BakeObject(const PENDING_OBJECT& object, std::vector<PrimitiveMeshes::VERTEX>& vertices,
+	std::vector<GLuint>& indices, BoundingVolumeHierarchy::AABB& bounds, bool bFirst)
+{
+	if (m_meshes.empty() == true)
+	{
+		m_meshes.resize(SceneGraph::MESH_COUNT);
+	}
+	PrimitiveMeshes::MESH_DATA& mesh = m_meshes[object.meshID];
+	if (mesh.vertices.empty() == true)
+	{
+		PrimitiveMeshes::BuildMesh(object.meshID, 0, mesh);
+	}
+
+	const float* worldMatrix = object.worldMatrix;
+	const float* normalMatrix = object.normalMatrix;
+	GLuint first = static_cast<GLuint>(vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const PrimitiveMeshes::VERTEX& local = mesh.vertices[i];
+		PrimitiveMeshes::VERTEX vertex;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			vertex.position[axis] = worldMatrix[axis] * local.position[0] + worldMatrix[4 + axis] * local.position[1] +
+				worldMatrix[8 + axis] * local.position[2] + worldMatrix[12 + axis];
+			vertex.normal[axis] = normalMatrix[axis] * local.normal[0] + normalMatrix[3 + axis] * local.normal[1] +
+				normalMatrix[6 + axis] * local.normal[2];
+		}
+		float length = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] +
+			vertex.normal[2] * vertex.normal[2]);
+		if (length > 0.0f)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				vertex.normal[axis] /= length;
+			}
+		}
+		vertex.textureCoordinate[0] = local.textureCoordinate[0] * object.UVscale[0];
+		vertex.textureCoordinate[1] = local.textureCoordinate[1] * object.UVscale[1];
+		vertices.push_back(vertex);
+
+		glm::vec3 position = glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+		bounds.minimum = (bFirst == true) ? position : glm::min(bounds.minimum, position);
+		bounds.maximum = (bFirst == true) ? position : glm::max(bounds.maximum, position);
+		bFirst = false;
+	}
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		indices.push_back(first + mesh.indices[i]);
+	}
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for baking the objects of every
+ *  batch that holds enough of them, one batch after
+ *  another, into the merged vertex and index buffers.  A
+ *  batch of a single object saves no draw call and would
+ *  only lose the detail levels and instancing of its
+ *  record, so smaller batches are dropped and their objects
+ *  are drawn as records.  Buffers of an earlier upload are
+ *  replaced.  The vertex array bound before is bound again,
+ *  since PrimitiveMeshes skips binding its own when it
+ *  thinks it still is.
+ ***********************************************************/
+void StaticBatches::Upload(int minimumObjects)
+{
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+
+	// number the kept batches in the order they were added
+	std::vector<int> keptIndices(m_batches.size(), -1);
+	std::vector<BATCH> keptBatches;
+	for (size_t i = 0; i < m_batches.size(); i++)
+	{
+		if (m_batches[i].objectCount >= minimumObjects)
+		{
+			keptIndices[i] = static_cast<int>(keptBatches.size());
+			keptBatches.push_back(m_batches[i]);
+		}
+	}
+
+	// order the objects of the kept batches by batch, keeping
+	// the order they were added in within a batch
+	std::vector<int> batchStarts(keptBatches.size() + 1, 0);
+	m_objectBatches.assign(m_objects.size(), -1);
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		int batchIndex = keptIndices[m_objects[i].batchIndex];
+		m_objectBatches[i] = batchIndex;
+		if (batchIndex >= 0)
+		{
+			batchStarts[batchIndex + 1]++;
+		}
+	}
+	for (size_t i = 1; i < batchStarts.size(); i++)
+	{
+		batchStarts[i] += batchStarts[i - 1];
+	}
+	std::vector<int> nextSlots(batchStarts.begin(), batchStarts.end() - 1);
+	std::vector<int> objectOrder(batchStarts.back());
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		if (m_objectBatches[i] >= 0)
+		{
+			objectOrder[nextSlots[m_objectBatches[i]]++] = static_cast<int>(i);
+		}
+	}
+
+	std::vector<PrimitiveMeshes::VERTEX> vertices;
+	std::vector<GLuint> indices;
+	m_bounds.assign(keptBatches.size(), BoundingVolumeHierarchy::AABB());
+	for (size_t i = 0; i < keptBatches.size(); i++)
+	{
+		keptBatches[i].firstIndex = static_cast<GLuint>(indices.size());
+		for (int slot = batchStarts[i]; slot < batchStarts[i + 1]; slot++)
+		{
+			BakeObject(m_objects[objectOrder[slot]], vertices, indices, m_bounds[i], slot == batchStarts[i]);
+		}
+		keptBatches[i].indexCount = static_cast<GLsizei>(indices.size() - keptBatches[i].firstIndex);
+	}
+	m_batches.swap(keptBatches);
+	m_batchLookup.clear();
+	m_objects.clear();
+	m_meshes.clear();
+
+	if (indices.empty() == true)
+	{
+		return;
+	}
+
+	GLint previousVAO = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(PrimitiveMeshes::VERTEX) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(PrimitiveMeshes::POSITION_LOCATION);
+	glVertexAttribPointer(PrimitiveMeshes::POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(PrimitiveMeshes::VERTEX),
+		reinterpret_cast<const void*>(offsetof(PrimitiveMeshes::VERTEX, position)));
+	glEnableVertexAttribArray(PrimitiveMeshes::NORMAL_LOCATION);
+	glVertexAttribPointer(PrimitiveMeshes::NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(PrimitiveMeshes::VERTEX),
+		reinterpret_cast<const void*>(offsetof(PrimitiveMeshes::VERTEX, normal)));
+	glEnableVertexAttribArray(PrimitiveMeshes::TEXCOORD_LOCATION);
+	glVertexAttribPointer(PrimitiveMeshes::TEXCOORD_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(PrimitiveMeshes::VERTEX),
+		reinterpret_cast<const void*>(offsetof(PrimitiveMeshes::VERTEX, textureCoordinate)));
+
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+
+	glBindVertexArray(static_cast<GLuint>(previousVAO));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the merged buffers and
+ *  forgetting every batch, so objects can be added again.
+ ***********************************************************/
+void StaticBatches::Destroy()
+{
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+
+	m_batches.clear();
+	m_bounds.clear();
+	m_batchLookup.clear();
+	m_objects.clear();
+	m_objectBatches.clear();
+	m_meshes.clear();
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for binding the vertex array of the
+ *  merged buffers, remembering the one bound before.
+ ***********************************************************/
+void StaticBatches::Begin()
+{
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_previousVAO);
+	glBindVertexArray(m_vao);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used for drawing every object of one
+ *  batch with a single call.  The shader takes the
+ *  material, texture and color from the per-draw uniforms.
+ ***********************************************************/
+void StaticBatches::Draw(int batchIndex)
+{
+	const BATCH& batch = m_batches[batchIndex];
+	if (batch.indexCount == 0)
+	{
+		return;
+	}
+
+	glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(sizeof(GLuint) * batch.firstIndex));
+}
+
+/***********************************************************
+ *  End()
+ *
+ *  This method is used for binding the vertex array that
+ *  was bound before Begin() again.
+ ***********************************************************/
+void StaticBatches::End()
+{
+	glBindVertexArray(static_cast<GLuint>(m_previousVAO));
+}
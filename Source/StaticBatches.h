@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// StaticBatches.h
+// ===============
+// bake the objects that never move into a few pre-transformed meshes
+//
+//  The basic shapes of every static object are moved into world space
+//  once, when the scene is prepared, and merged into one vertex and
+//  index buffer.  Objects drawn with the same material, texture and
+//  color in the same cell of a world grid share a batch, so the static
+//  scene draws with one call per batch instead of one per object while
+//  each batch stays small enough to cull.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "BoundingVolumeHierarchy.h"
+#include "PrimitiveMeshes.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  StaticBatches
+ *
+ *  This class collects static objects into batches keyed
+ *  by their draw state and grid cell, and owns the buffers
+ *  they are drawn from.  The vertices are already in world
+ *  space with the UV scale applied, so a batch draws with
+ *  an identity model matrix and a UV scale of one.  Objects
+ *  are baked at their finest detail level when uploaded,
+ *  and batches left with too few objects are not baked.
+ ***********************************************************/
+class StaticBatches
+{
+public:
+	// one range of the merged buffers drawn with one state
+	struct BATCH
+	{
+		int materialHandle;
+		// texture handle, -1 when drawing with the color
+		int textureHandle;
+		float color[4];
+		// indices of the batch in the merged index buffer
+		GLuint firstIndex;
+		GLsizei indexCount;
+		// objects baked into the batch
+		int objectCount;
+	};
+
+	// constructor
+	StaticBatches();
+	// destructor
+	~StaticBatches();
+
+	// add one copy of a shape, moved by a column-major world
+	// matrix and its normal matrix, to the batch of its state
+	// and cell; returns the object index, -1 for an unknown shape
+	int AddObject(int meshID, const float worldMatrix[16], const float normalMatrix[9], const float UVscale[2],
+		int materialHandle, int textureHandle, const float color[4]);
+	// bake the batches holding at least the given number of
+	// objects into the merged buffers and drop the others
+	void Upload(int minimumObjects);
+	// batch an added object was baked into after Upload(), -1
+	// when its batch was dropped
+	int GetObjectBatch(int objectIndex) const { return m_objectBatches[objectIndex]; }
+	// free the buffers and forget the batches
+	void Destroy();
+
+	int GetBatchCount() const { return static_cast<int>(m_batches.size()); }
+	const BATCH& GetBatch(int batchIndex) const { return m_batches[batchIndex]; }
+	// world-space box of each batch
+	const std::vector<BoundingVolumeHierarchy::AABB>& GetBounds() const { return m_bounds; }
+
+	// bind the merged buffers, keeping the previous binding
+	void Begin();
+	// draw one batch, between Begin() and End()
+	void Draw(int batchIndex);
+	// put the previous vertex array back
+	void End();
+
+private:
+	// draw state and grid cell shared by the objects of a
+	// batch, compared and hashed as raw bytes
+	struct BATCH_KEY
+	{
+		int materialHandle;
+		int textureHandle;
+		// zero for textured batches, where it is not used
+		float color[4];
+		int cell[3];
+
+		bool operator==(const BATCH_KEY& other) const;
+	};
+	struct BATCH_KEY_HASH
+	{
+		size_t operator()(const BATCH_KEY& key) const;
+	};
+
+	// an added object waiting for Upload()
+	struct PENDING_OBJECT
+	{
+		int meshID;
+		int batchIndex;
+		float worldMatrix[16];
+		float normalMatrix[9];
+		float UVscale[2];
+	};
+
+	// index of the batch of a key, added if needed
+	int FindBatch(const BATCH_KEY& key);
+	// append the baked vertices and indices of one object
+	void BakeObject(const PENDING_OBJECT& object, std::vector<PrimitiveMeshes::VERTEX>& vertices,
+		std::vector<GLuint>& indices, BoundingVolumeHierarchy::AABB& bounds, bool bFirst);
+
+	std::vector<BATCH> m_batches;
+	std::vector<BoundingVolumeHierarchy::AABB> m_bounds;
+	// batch of each key, released by Upload()
+	std::unordered_map<BATCH_KEY, int, BATCH_KEY_HASH> m_batchLookup;
+	// added objects, released by Upload()
+	std::vector<PENDING_OBJECT> m_objects;
+	// batch of each added object once uploaded
+	std::vector<int> m_objectBatches;
+	// finest level of each shape, built on first use
+	std::vector<PrimitiveMeshes::MESH_DATA> m_meshes;
+
+	// vertex array reading the merged buffers
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	// vertex array bound before Begin()
+	GLint m_previousVAO;
+};
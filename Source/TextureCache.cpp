@@ -0,0 +1,506 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCache.cpp
+// ================
+// bake textures into block-compressed mip chains stored on disk
+//
+//  A baked texture holds every mip level of an image encoded as BC1
+//  (RGB) or BC3 (RGBA) blocks, so it can be uploaded directly with
+//  glCompressedTexImage2D.  Cache files are keyed on a hash of the
+//  source image file and are rebaked when the source changes.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MAKE_DIRECTORY(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MAKE_DIRECTORY(path) mkdir(path, 0755)
+#endif
+
+namespace
+{
+	// identifies a baked texture file
+	const char g_CacheMagic[4] = { 'B', 'T', 'E', 'X' };
+	// bump whenever the file layout or the encoder output changes
+	const uint32_t g_CacheVersion = 1;
+	// subdirectory next to the source images that holds the cache
+	const char* g_CacheDirectory = "cache";
+	// extension appended to the source file name
+	const char* g_CacheExtension = ".btex";
+	// longest mip chain, for a 2^31 texel wide texture
+	const uint32_t MAX_LEVEL_COUNT = 32;
+
+	// FNV-1a 64-bit parameters
+	const uint64_t g_FnvOffsetBasis = 14695981039346656037ULL;
+	const uint64_t g_FnvPrime = 1099511628211ULL;
+
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t internalFormat;
+		uint32_t width;
+		uint32_t height;
+		uint32_t colorChannels;
+		uint32_t levelCount;
+		uint32_t blockBytes;
+	};
+
+	// pack an 8-bit color into RGB565
+	uint16_t PackRGB565(const unsigned char color[3])
+	{
+		return static_cast<uint16_t>(
+			(((color[0] * 31 + 127) / 255) << 11) |
+			(((color[1] * 63 + 127) / 255) << 5) |
+			((color[2] * 31 + 127) / 255));
+	}
+
+	// expand RGB565 back to 8 bits per channel
+	void UnpackRGB565(uint16_t packed, int color[3])
+	{
+		int red = (packed >> 11) & 31;
+		int green = (packed >> 5) & 63;
+		int blue = packed & 31;
+		color[0] = (red << 3) | (red >> 2);
+		color[1] = (green << 2) | (green >> 4);
+		color[2] = (blue << 3) | (blue >> 2);
+	}
+
+	void WriteLittleEndian16(unsigned char* destination, uint16_t value)
+	{
+		destination[0] = static_cast<unsigned char>(value & 0xFF);
+		destination[1] = static_cast<unsigned char>(value >> 8);
+	}
+
+	void WriteLittleEndian32(unsigned char* destination, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			destination[i] = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
+		}
+	}
+}
+
+/***********************************************************
+ *  HashFile()
+ *
+ *  This method is used for computing the FNV-1a hash of a
+ *  file.  The file contents are optionally returned so a
+ *  cache miss does not need to read the file twice.
+ ***********************************************************/
+bool TextureCache::HashFile(const std::string& filename, uint64_t& hash, std::vector<unsigned char>* pContents)
+{
+	std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> contents(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(contents.data()), contents.size());
+	if (!file)
+	{
+		return false;
+	}
+
+	hash = g_FnvOffsetBasis;
+	for (size_t i = 0; i < contents.size(); i++)
+	{
+		hash ^= contents[i];
+		hash *= g_FnvPrime;
+	}
+
+	if (pContents != NULL)
+	{
+		pContents->swap(contents);
+	}
+	return true;
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This method is used for getting the cache file path of
+ *  a source image, e.g. textures/Wood.jpg is cached in
+ *  textures/cache/Wood.jpg.btex
+ ***********************************************************/
+std::string TextureCache::GetCachePath(const std::string& filename)
+{
+	size_t separator = filename.find_last_of("/\\");
+	std::string directory = (separator == std::string::npos) ? "" : filename.substr(0, separator + 1);
+	std::string name = (separator == std::string::npos) ? filename : filename.substr(separator + 1);
+
+	return directory + g_CacheDirectory + "/" + name + g_CacheExtension;
+}
+
+/***********************************************************
+ *  ReadCache()
+ *
+ *  This method is used for reading a baked texture from its
+ *  cache file.  The file is rejected if it was baked from
+ *  a different version of the source image, and also when
+ *  it is truncated or its sizes do not add up, since the
+ *  levels are uploaded straight from the blocks.
+ ***********************************************************/
+bool TextureCache::ReadCache(const std::string& cachePath, uint64_t sourceHash, BAKED_TEXTURE& texture)
+{
+	std::ifstream file(cachePath.c_str(), std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+	uint64_t fileBytes = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	CACHE_HEADER header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file ||
+		(memcmp(header.magic, g_CacheMagic, sizeof(g_CacheMagic)) != 0) ||
+		(header.version != g_CacheVersion) ||
+		(header.sourceHash != sourceHash))
+	{
+		return false;
+	}
+
+	// only the two formats Bake() writes, with a level table
+	// and blocks that fit in the file
+	if (((header.internalFormat != GL_COMPRESSED_RGB_S3TC_DXT1_EXT) &&
+		(header.internalFormat != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)) ||
+		(header.levelCount == 0) || (header.levelCount > MAX_LEVEL_COUNT) ||
+		(sizeof(header) + header.levelCount * sizeof(MIP_LEVEL) + static_cast<uint64_t>(header.blockBytes) > fileBytes))
+	{
+		return false;
+	}
+
+	texture.sourceHash = header.sourceHash;
+	texture.internalFormat = header.internalFormat;
+	texture.width = header.width;
+	texture.height = header.height;
+	texture.colorChannels = header.colorChannels;
+	texture.levels.resize(header.levelCount);
+	texture.blocks.resize(header.blockBytes);
+
+	file.read(reinterpret_cast<char*>(texture.levels.data()), header.levelCount * sizeof(MIP_LEVEL));
+	file.read(reinterpret_cast<char*>(texture.blocks.data()), header.blockBytes);
+	if (!file)
+	{
+		return false;
+	}
+
+	// every level must lie inside the blocks and hold exactly
+	// the blocks of its size
+	uint64_t bytesPerBlock = (header.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		const MIP_LEVEL& mip = texture.levels[i];
+		uint64_t levelBytes = ((static_cast<uint64_t>(mip.width) + 3) / 4) * ((static_cast<uint64_t>(mip.height) + 3) / 4) * bytesPerBlock;
+		if ((mip.width == 0) || (mip.height == 0) || (mip.byteSize != levelBytes) ||
+			(static_cast<uint64_t>(mip.byteOffset) + mip.byteSize > texture.blocks.size()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  WriteCache()
+ *
+ *  This method is used for writing a baked texture to its
+ *  cache file.  The data is written to a temporary file
+ *  first so an interrupted bake never leaves a truncated
+ *  cache file behind.
+ ***********************************************************/
+bool TextureCache::WriteCache(const std::string& cachePath, const BAKED_TEXTURE& texture)
+{
+	size_t separator = cachePath.find_last_of("/\\");
+	if (separator != std::string::npos)
+	{
+		// fails harmlessly when the directory already exists
+		MAKE_DIRECTORY(cachePath.substr(0, separator).c_str());
+	}
+
+	CACHE_HEADER header;
+	memcpy(header.magic, g_CacheMagic, sizeof(g_CacheMagic));
+	header.version = g_CacheVersion;
+	header.sourceHash = texture.sourceHash;
+	header.internalFormat = texture.internalFormat;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.colorChannels = texture.colorChannels;
+	header.levelCount = static_cast<uint32_t>(texture.levels.size());
+	header.blockBytes = static_cast<uint32_t>(texture.blocks.size());
+
+	std::string temporaryPath = cachePath + ".tmp";
+	{
+		std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(texture.levels.data()), texture.levels.size() * sizeof(MIP_LEVEL));
+		file.write(reinterpret_cast<const char*>(texture.blocks.data()), texture.blocks.size());
+		if (!file)
+		{
+			return false;
+		}
+	}
+
+	std::remove(cachePath.c_str());
+	return (std::rename(temporaryPath.c_str(), cachePath.c_str()) == 0);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method is used for building the full mip chain of
+ *  an image and encoding every level into BC1 blocks for
+ *  RGB images or BC3 blocks for RGBA images.
+ ***********************************************************/
+bool TextureCache::Bake(const unsigned char* pixels, int width, int height, int colorChannels, BAKED_TEXTURE& texture)
+{
+	if ((colorChannels != 3) && (colorChannels != 4))
+	{
+		return false;
+	}
+
+	bool bHasAlpha = (colorChannels == 4);
+	uint32_t blockSize = bHasAlpha ? 16 : 8;
+
+	texture.internalFormat = bHasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	texture.width = width;
+	texture.height = height;
+	texture.colorChannels = colorChannels;
+	texture.levels.clear();
+	texture.blocks.clear();
+
+	std::vector<unsigned char> level(pixels, pixels + static_cast<size_t>(width) * height * colorChannels);
+	std::vector<unsigned char> nextLevel;
+	int levelWidth = width;
+	int levelHeight = height;
+
+	while (true)
+	{
+		int blocksWide = (levelWidth + 3) / 4;
+		int blocksHigh = (levelHeight + 3) / 4;
+
+		MIP_LEVEL mip;
+		mip.width = levelWidth;
+		mip.height = levelHeight;
+		mip.byteOffset = static_cast<uint32_t>(texture.blocks.size());
+		mip.byteSize = blocksWide * blocksHigh * blockSize;
+		texture.levels.push_back(mip);
+		texture.blocks.resize(texture.blocks.size() + mip.byteSize);
+
+		unsigned char* block = texture.blocks.data() + mip.byteOffset;
+		for (int blockY = 0; blockY < blocksHigh; blockY++)
+		{
+			for (int blockX = 0; blockX < blocksWide; blockX++)
+			{
+				// gather the block, repeating edge pixels for partial blocks
+				unsigned char rgba[16][4];
+				for (int i = 0; i < 16; i++)
+				{
+					int x = std::min(blockX * 4 + (i % 4), levelWidth - 1);
+					int y = std::min(blockY * 4 + (i / 4), levelHeight - 1);
+					const unsigned char* pixel = &level[(static_cast<size_t>(y) * levelWidth + x) * colorChannels];
+					rgba[i][0] = pixel[0];
+					rgba[i][1] = pixel[1];
+					rgba[i][2] = pixel[2];
+					rgba[i][3] = bHasAlpha ? pixel[3] : 255;
+				}
+
+				if (bHasAlpha)
+				{
+					EncodeAlphaBlock(rgba, block);
+					block += 8;
+				}
+				EncodeColorBlock(rgba, block);
+				block += 8;
+			}
+		}
+
+		if ((levelWidth == 1) && (levelHeight == 1))
+		{
+			break;
+		}
+		Downsample(level, levelWidth, levelHeight, colorChannels, nextLevel);
+		level.swap(nextLevel);
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Downsample()
+ *
+ *  This method is used for producing the next mip level by
+ *  averaging each 2x2 group of pixels.
+ ***********************************************************/
+void TextureCache::Downsample(const std::vector<unsigned char>& source, int width, int height,
+	int colorChannels, std::vector<unsigned char>& destination)
+{
+	int newWidth = std::max(1, width / 2);
+	int newHeight = std::max(1, height / 2);
+	destination.resize(static_cast<size_t>(newWidth) * newHeight * colorChannels);
+
+	for (int y = 0; y < newHeight; y++)
+	{
+		int y0 = std::min(y * 2, height - 1);
+		int y1 = std::min(y * 2 + 1, height - 1);
+		for (int x = 0; x < newWidth; x++)
+		{
+			int x0 = std::min(x * 2, width - 1);
+			int x1 = std::min(x * 2 + 1, width - 1);
+			for (int c = 0; c < colorChannels; c++)
+			{
+				int sum =
+					source[(static_cast<size_t>(y0) * width + x0) * colorChannels + c] +
+					source[(static_cast<size_t>(y0) * width + x1) * colorChannels + c] +
+					source[(static_cast<size_t>(y1) * width + x0) * colorChannels + c] +
+					source[(static_cast<size_t>(y1) * width + x1) * colorChannels + c];
+				destination[(static_cast<size_t>(y) * newWidth + x) * colorChannels + c] =
+					static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  EncodeColorBlock()
+ *
+ *  This method is used for encoding the RGB part of a 4x4
+ *  block as a BC1 block.  The endpoints are the corners of
+ *  the block's color bounding box, inset slightly to reduce
+ *  quantization error, and every pixel picks the nearest of
+ *  the four interpolated palette colors.
+ ***********************************************************/
+void TextureCache::EncodeColorBlock(const unsigned char rgba[16][4], unsigned char* block)
+{
+	unsigned char minColor[3] = { 255, 255, 255 };
+	unsigned char maxColor[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			minColor[c] = std::min(minColor[c], rgba[i][c]);
+			maxColor[c] = std::max(maxColor[c], rgba[i][c]);
+		}
+	}
+	for (int c = 0; c < 3; c++)
+	{
+		int inset = (maxColor[c] - minColor[c]) / 16;
+		minColor[c] = static_cast<unsigned char>(minColor[c] + inset);
+		maxColor[c] = static_cast<unsigned char>(maxColor[c] - inset);
+	}
+
+	uint16_t color0 = PackRGB565(maxColor);
+	uint16_t color1 = PackRGB565(minColor);
+	// color0 > color1 selects the opaque four color mode
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		UnpackRGB565(color0, palette[0]);
+		UnpackRGB565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int bestIndex = 0;
+			int bestDistance = INT_MAX;
+			for (int p = 0; p < 4; p++)
+			{
+				int distance = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int delta = rgba[i][c] - palette[p][c];
+					distance += delta * delta;
+				}
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = p;
+				}
+			}
+			indices |= static_cast<uint32_t>(bestIndex) << (2 * i);
+		}
+	}
+
+	WriteLittleEndian16(block, color0);
+	WriteLittleEndian16(block + 2, color1);
+	WriteLittleEndian32(block + 4, indices);
+}
+
+/***********************************************************
+ *  EncodeAlphaBlock()
+ *
+ *  This method is used for encoding the alpha channel of a
+ *  4x4 block as the interpolated alpha half of a BC3 block.
+ ***********************************************************/
+void TextureCache::EncodeAlphaBlock(const unsigned char rgba[16][4], unsigned char* block)
+{
+	unsigned char alpha0 = 0;
+	unsigned char alpha1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		alpha0 = std::max(alpha0, rgba[i][3]);
+		alpha1 = std::min(alpha1, rgba[i][3]);
+	}
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		// alpha0 > alpha1 selects the eight value mode
+		int palette[8];
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (int p = 1; p < 7; p++)
+		{
+			palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int bestIndex = 0;
+			int bestDistance = INT_MAX;
+			for (int p = 0; p < 8; p++)
+			{
+				int distance = std::abs(rgba[i][3] - palette[p]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = p;
+				}
+			}
+			indices |= static_cast<uint64_t>(bestIndex) << (3 * i);
+		}
+	}
+
+	block[0] = alpha0;
+	block[1] = alpha1;
+	for (int i = 0; i < 6; i++)
+	{
+		block[2 + i] = static_cast<unsigned char>((indices >> (8 * i)) & 0xFF);
+	}
+}
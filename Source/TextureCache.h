@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCache.h
+// ==============
+// bake textures into block-compressed mip chains stored on disk
+//
+//  A baked texture holds every mip level of an image encoded as BC1
+//  (RGB) or BC3 (RGBA) blocks, so it can be uploaded directly with
+//  glCompressedTexImage2D.  Cache files are keyed on a hash of the
+//  source image file and are rebaked when the source changes.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class contains the CPU-side baking, hashing and
+ *  cache file handling for compressed textures.  None of
+ *  the methods make OpenGL calls, so they are safe to run
+ *  on worker threads.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	struct MIP_LEVEL
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t byteOffset;
+		uint32_t byteSize;
+	};
+
+	struct BAKED_TEXTURE
+	{
+		uint64_t sourceHash;
+		uint32_t internalFormat;
+		uint32_t width;
+		uint32_t height;
+		uint32_t colorChannels;
+		std::vector<MIP_LEVEL> levels;
+		std::vector<unsigned char> blocks;
+	};
+
+	// hash the contents of a source file - false if it cannot be read
+	static bool HashFile(const std::string& filename, uint64_t& hash, std::vector<unsigned char>* pContents);
+	// path of the cache file that belongs to a source image
+	static std::string GetCachePath(const std::string& filename);
+
+	// read a cache file, false if missing, corrupt or stale
+	static bool ReadCache(const std::string& cachePath, uint64_t sourceHash, BAKED_TEXTURE& texture);
+	// write a cache file, creating the cache directory if needed
+	static bool WriteCache(const std::string& cachePath, const BAKED_TEXTURE& texture);
+
+	// encode an RGB or RGBA image and its mip chain into blocks
+	static bool Bake(const unsigned char* pixels, int width, int height, int colorChannels, BAKED_TEXTURE& texture);
+
+private:
+	// halve an image with a 2x2 box filter
+	static void Downsample(const std::vector<unsigned char>& source, int width, int height,
+		int colorChannels, std::vector<unsigned char>& destination);
+	// encode one 4x4 block of RGBA pixels
+	static void EncodeColorBlock(const unsigned char rgba[16][4], unsigned char* block);
+	static void EncodeAlphaBlock(const unsigned char rgba[16][4], unsigned char* block);
+};
@@ -0,0 +1,640 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.cpp
+// =================
+// decode scene textures in parallel and upload them on the GL thread
+//
+//  Image files are decoded by stb_image on the worker pool while the
+//  thread that owns the GL context uploads each image as soon as its
+//  decode finishes, through a ring of pixel unpack buffers.  When the
+//  texture cache is enabled, images are baked to block-compressed mip
+//  chains once and later loads read the baked blocks instead.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+
+// the stb_image implementation is compiled in SceneManager.cpp
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	// time to wait on an upload fence before checking again
+	const GLuint64 g_FenceTimeoutNanoseconds = 1000000000;
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// levels of a full mip chain, whether it is baked or generated
+	int CountLevels(int width, int height)
+	{
+		int levelCount = 1;
+		while ((width >> levelCount) > 0 || (height >> levelCount) > 0)
+		{
+			levelCount++;
+		}
+		return levelCount;
+	}
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader(WorkerPool* pWorkerPool, TextureManager* pTextureManager)
+{
+	m_pWorkerPool = pWorkerPool;
+	m_pTextureManager = pTextureManager;
+	m_uploadBuffer = 0;
+	m_uploadSlotBytes = 0;
+	m_pPersistentRing = NULL;
+	m_nextUploadSlot = 0;
+	m_activeUploadSlot = 0;
+	m_totalMilliseconds = 0.0;
+	m_bUseTextureCache = true;
+	m_bCacheActive = false;
+
+	for (int i = 0; i < UPLOAD_RING_SLOTS; i++)
+	{
+		m_uploadFences[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	DestroyUploadRing();
+	m_pWorkerPool = NULL;
+	m_pTextureManager = NULL;
+}
+
+/***********************************************************
+ *  AddTexture()
+ *
+ *  This method is used for queueing an image file to be
+ *  loaded by the next call to LoadAll().
+ ***********************************************************/
+void TextureLoader::AddTexture(const char* filename, std::string tag)
+{
+	LOADED_TEXTURE texture;
+	texture.tag = tag;
+	texture.filename = filename;
+	texture.handle = -1;
+	texture.width = 0;
+	texture.height = 0;
+	texture.colorChannels = 0;
+	texture.decodeMilliseconds = 0.0;
+	texture.uploadMilliseconds = 0.0;
+	texture.gpuBytes = 0;
+	texture.bCompressed = false;
+	texture.bCacheHit = false;
+	texture.bLoaded = false;
+
+	m_textures.push_back(texture);
+}
+
+/***********************************************************
+ *  LoadAll()
+ *
+ *  This method is used for loading every queued texture.
+ *  The image headers are read first to size the upload
+ *  ring, then every decode is handed to the worker pool
+ *  and the textures are uploaded in the order their
+ *  decodes complete.
+ ***********************************************************/
+const std::vector<TextureLoader::LOADED_TEXTURE>& TextureLoader::LoadAll()
+{
+	Clock::time_point loadStart = Clock::now();
+	size_t largestImageBytes = 0;
+
+	// baked blocks are uploaded with glCompressedTexSubImage3D, so
+	// the cache is only used when the driver accepts S3TC formats
+	m_bCacheActive = (m_bUseTextureCache && GLEW_EXT_texture_compression_s3tc);
+
+	// read only the image headers to reserve a texture array layer
+	// for every image and to find the largest upload
+	std::vector<int> pendingTextures;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		LOADED_TEXTURE& texture = m_textures[i];
+		if (stbi_info(texture.filename.c_str(), &texture.width, &texture.height, &texture.colorChannels) == 0)
+		{
+			std::cout << "Could not load image:" << texture.filename << std::endl;
+			continue;
+		}
+		if ((texture.colorChannels != 3) && (texture.colorChannels != 4))
+		{
+			std::cout << "Not implemented to handle image with " << texture.colorChannels << " channels" << std::endl;
+			continue;
+		}
+
+		int levelCount = CountLevels(texture.width, texture.height);
+
+		bool bHasAlpha = (texture.colorChannels == 4);
+		GLenum internalFormat = bHasAlpha ? GL_RGBA8 : GL_RGB8;
+		if (m_bCacheActive == true)
+		{
+			internalFormat = bHasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		}
+		texture.handle = m_pTextureManager->ReserveTexture(internalFormat,
+			texture.width, texture.height, levelCount, m_bCacheActive);
+
+		size_t imageBytes = static_cast<size_t>(texture.width) * texture.height * texture.colorChannels;
+		if (imageBytes > largestImageBytes)
+		{
+			largestImageBytes = imageBytes;
+		}
+		pendingTextures.push_back(static_cast<int>(i));
+	}
+	m_pTextureManager->AllocateArrays();
+	CreateUploadRing(largestImageBytes);
+
+	// the flip setting is global in stb_image, so it is set
+	// once here before any worker starts decoding
+	stbi_set_flip_vertically_on_load(true);
+
+	m_decodedImages.assign(m_textures.size(), NULL);
+	m_bakedImages.assign(m_textures.size(), TextureCache::BAKED_TEXTURE());
+	for (size_t i = 0; i < pendingTextures.size(); i++)
+	{
+		int index = pendingTextures[i];
+		m_pWorkerPool->Submit([this, index]() { DecodeImage(index); });
+	}
+
+	// upload each texture as soon as its decode is done
+	for (size_t uploaded = 0; uploaded < pendingTextures.size(); uploaded++)
+	{
+		int index = -1;
+		{
+			std::unique_lock<std::mutex> lock(m_decodedMutex);
+			m_decodedReady.wait(lock, [this]() { return !m_decodedQueue.empty(); });
+			index = m_decodedQueue.front();
+			m_decodedQueue.pop();
+		}
+		UploadImage(index);
+	}
+
+	m_pTextureManager->FinishUploads();
+	DestroyUploadRing();
+	m_totalMilliseconds = MillisecondsSince(loadStart);
+
+	return(m_textures);
+}
+
+/***********************************************************
+ *  BakeAll()
+ *
+ *  This method is used for the offline bake step.  Every
+ *  queued texture whose cache file is missing or stale is
+ *  baked on the worker pool.  No GL context is needed.
+ ***********************************************************/
+void TextureLoader::BakeAll()
+{
+	Clock::time_point bakeStart = Clock::now();
+
+	stbi_set_flip_vertically_on_load(true);
+	m_bakedImages.assign(m_textures.size(), TextureCache::BAKED_TEXTURE());
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		int index = static_cast<int>(i);
+		m_pWorkerPool->Submit([this, index]() {
+			Clock::time_point decodeStart = Clock::now();
+			m_textures[index].bLoaded = LoadBakedImage(index);
+			m_textures[index].bCompressed = m_textures[index].bLoaded;
+			m_textures[index].gpuBytes = m_bakedImages[index].blocks.size();
+			m_textures[index].decodeMilliseconds = MillisecondsSince(decodeStart);
+			// only the cache file is wanted, not the blocks
+			m_bakedImages[index] = TextureCache::BAKED_TEXTURE();
+		});
+	}
+	m_pWorkerPool->Wait();
+
+	m_totalMilliseconds = MillisecondsSince(bakeStart);
+}
+
+/***********************************************************
+ *  DecodeImage()
+ *
+ *  This method is used for decoding one queued image file
+ *  into memory, or reading its baked blocks when the cache
+ *  is in use.  An image that cannot be baked is decoded
+ *  instead and uploaded uncompressed.  It runs on a worker
+ *  thread and must not make any OpenGL calls.
+ ***********************************************************/
+void TextureLoader::DecodeImage(int index)
+{
+	LOADED_TEXTURE& texture = m_textures[index];
+	Clock::time_point decodeStart = Clock::now();
+
+	if (m_bCacheActive == true)
+	{
+		texture.bCompressed = LoadBakedImage(index);
+		if (texture.bCompressed == false)
+		{
+			m_bakedImages[index] = TextureCache::BAKED_TEXTURE();
+		}
+	}
+
+	// without the cache, or when baking failed, the image is
+	// decoded into the reserved shape
+	if (texture.bCompressed == false)
+	{
+		int width = 0;
+		int height = 0;
+		int colorChannels = 0;
+		m_decodedImages[index] = stbi_load(
+			texture.filename.c_str(),
+			&width,
+			&height,
+			&colorChannels,
+			0);
+
+		// the file changed since its header was read
+		if ((m_decodedImages[index] != NULL) &&
+			((width != texture.width) || (height != texture.height) || (colorChannels != texture.colorChannels)))
+		{
+			stbi_image_free(m_decodedImages[index]);
+			m_decodedImages[index] = NULL;
+		}
+	}
+
+	texture.decodeMilliseconds = MillisecondsSince(decodeStart);
+
+	{
+		std::lock_guard<std::mutex> lock(m_decodedMutex);
+		m_decodedQueue.push(index);
+	}
+	m_decodedReady.notify_one();
+}
+
+/***********************************************************
+ *  LoadBakedImage()
+ *
+ *  This method is used for getting the baked blocks of one
+ *  image.  A valid cache file is read directly; otherwise
+ *  the source image is decoded, baked and written to the
+ *  cache for the next run.
+ ***********************************************************/
+bool TextureLoader::LoadBakedImage(int index)
+{
+	LOADED_TEXTURE& texture = m_textures[index];
+	TextureCache::BAKED_TEXTURE& baked = m_bakedImages[index];
+
+	uint64_t sourceHash = 0;
+	std::vector<unsigned char> sourceBytes;
+	if (TextureCache::HashFile(texture.filename, sourceHash, &sourceBytes) == false)
+	{
+		return false;
+	}
+
+	std::string cachePath = TextureCache::GetCachePath(texture.filename);
+	texture.bCacheHit = TextureCache::ReadCache(cachePath, sourceHash, baked);
+
+	if (texture.bCacheHit == false)
+	{
+		int width = 0;
+		int height = 0;
+		int colorChannels = 0;
+		unsigned char* image = stbi_load_from_memory(
+			sourceBytes.data(),
+			static_cast<int>(sourceBytes.size()),
+			&width,
+			&height,
+			&colorChannels,
+			0);
+		if (image == NULL)
+		{
+			return false;
+		}
+
+		bool bBaked = TextureCache::Bake(image, width, height, colorChannels, baked);
+		stbi_image_free(image);
+		if (bBaked == false)
+		{
+			return false;
+		}
+
+		baked.sourceHash = sourceHash;
+		if (TextureCache::WriteCache(cachePath, baked) == false)
+		{
+			std::cout << "Could not write texture cache:" << cachePath << std::endl;
+		}
+	}
+
+	// the file changed since its header was read for the layer reservation
+	if ((texture.handle >= 0) &&
+		((static_cast<int>(baked.width) != texture.width) || (static_cast<int>(baked.height) != texture.height) ||
+		(static_cast<int>(baked.colorChannels) != texture.colorChannels)))
+	{
+		return false;
+	}
+
+	texture.width = baked.width;
+	texture.height = baked.height;
+	texture.colorChannels = baked.colorChannels;
+	return true;
+}
+
+/***********************************************************
+ *  UploadImage()
+ *
+ *  This method is used for copying one decoded image into
+ *  the upload ring and creating its GL texture from there,
+ *  with the same wrapping, filtering and mipmaps as
+ *  SceneManager::CreateGLTexture().
+ ***********************************************************/
+void TextureLoader::UploadImage(int index)
+{
+	LOADED_TEXTURE& texture = m_textures[index];
+	unsigned char* image = m_decodedImages[index];
+
+	if ((image == NULL) && (texture.bCompressed == false))
+	{
+		std::cout << "Could not load image:" << texture.filename << std::endl;
+		return;
+	}
+
+	Clock::time_point uploadStart = Clock::now();
+
+	// the layer was reserved compressed, so a decoded image
+	// moves to an uncompressed array of its own shape
+	if ((m_bCacheActive == true) && (texture.bCompressed == false))
+	{
+		m_pTextureManager->ReplaceTexture(texture.handle, (texture.colorChannels == 4) ? GL_RGBA8 : GL_RGB8,
+			texture.width, texture.height, CountLevels(texture.width, texture.height), false);
+		m_pTextureManager->AllocateArrays();
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_pTextureManager->GetArrayTexture(texture.handle));
+
+	if (texture.bCompressed == true)
+	{
+		// the mip chain was baked offline, so no mipmaps are generated
+		UploadBakedImage(index);
+	}
+	else
+	{
+		GLenum pixelFormat = (texture.colorChannels == 4) ? GL_RGBA : GL_RGB;
+		int layer = m_pTextureManager->GetLayer(texture.handle);
+
+		// RGB rows are not always a multiple of four bytes long
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		size_t imageBytes = static_cast<size_t>(texture.width) * texture.height * texture.colorChannels;
+		size_t bufferOffset = 0;
+		unsigned char* pUploadMemory = AcquireUploadSlot(imageBytes, bufferOffset);
+		memcpy(pUploadMemory, image, imageBytes);
+		ReleaseUploadSlot();
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, texture.width, texture.height, 1,
+			pixelFormat, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(bufferOffset));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		// the ring region can be reused once the GL has read it
+		if (m_pPersistentRing != NULL)
+		{
+			m_uploadFences[m_activeUploadSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		// free the image data from local memory
+		stbi_image_free(image);
+		m_decodedImages[index] = NULL;
+
+		// RGB8 is padded to four bytes per texel by most drivers,
+		// and the mip chain adds another third
+		texture.gpuBytes = static_cast<size_t>(texture.width) * texture.height * 4 * 4 / 3;
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	texture.uploadMilliseconds = MillisecondsSince(uploadStart);
+	texture.bLoaded = true;
+
+	std::cout << "Successfully loaded image:" << texture.filename << ", width:" << texture.width << ", height:" << texture.height << ", channels:" << texture.colorChannels;
+	if (texture.bCompressed == true)
+	{
+		std::cout << (texture.bCacheHit ? " (cached)" : " (baked)");
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  UploadBakedImage()
+ *
+ *  This method is used for uploading every mip level of a
+ *  baked image into its layer of the bound texture array.
+ *  The whole chain is staged in one upload ring region.
+ ***********************************************************/
+void TextureLoader::UploadBakedImage(int index)
+{
+	LOADED_TEXTURE& texture = m_textures[index];
+	TextureCache::BAKED_TEXTURE& baked = m_bakedImages[index];
+
+	size_t bufferOffset = 0;
+	bool bUseRing = (baked.blocks.size() <= m_uploadSlotBytes);
+	if (bUseRing == true)
+	{
+		unsigned char* pUploadMemory = AcquireUploadSlot(baked.blocks.size(), bufferOffset);
+		memcpy(pUploadMemory, baked.blocks.data(), baked.blocks.size());
+		ReleaseUploadSlot();
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+	}
+
+	int layer = m_pTextureManager->GetLayer(texture.handle);
+	for (size_t level = 0; level < baked.levels.size(); level++)
+	{
+		const TextureCache::MIP_LEVEL& mip = baked.levels[level];
+		// an offset into the bound unpack buffer, or client memory
+		const void* pLevelData = (bUseRing == true)
+			? reinterpret_cast<const void*>(bufferOffset + mip.byteOffset)
+			: static_cast<const void*>(baked.blocks.data() + mip.byteOffset);
+		glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0, layer,
+			mip.width, mip.height, 1, baked.internalFormat, mip.byteSize, pLevelData);
+	}
+
+	if (bUseRing == true)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (m_pPersistentRing != NULL)
+		{
+			m_uploadFences[m_activeUploadSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	texture.gpuBytes = baked.blocks.size();
+	// the blocks are no longer needed once they are on the GPU
+	baked = TextureCache::BAKED_TEXTURE();
+}
+
+/***********************************************************
+ *  CreateUploadRing()
+ *
+ *  This method is used for creating the pixel unpack buffer
+ *  that images are staged in.  When buffer storage is
+ *  available the whole ring is mapped once and stays mapped,
+ *  otherwise a single region is orphaned for every upload.
+ ***********************************************************/
+void TextureLoader::CreateUploadRing(size_t slotBytes)
+{
+	if (slotBytes == 0)
+	{
+		return;
+	}
+
+	m_uploadSlotBytes = slotBytes;
+	m_nextUploadSlot = 0;
+
+	glGenBuffers(1, &m_uploadBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+
+	if (GLEW_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr ringBytes = static_cast<GLsizeiptr>(slotBytes * UPLOAD_RING_SLOTS);
+
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringBytes, NULL, flags);
+		m_pPersistentRing = static_cast<unsigned char*>(
+			glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringBytes, flags));
+	}
+	else
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(slotBytes), NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DestroyUploadRing()
+ *
+ *  This method is used for freeing the upload ring and any
+ *  fences still guarding it.
+ ***********************************************************/
+void TextureLoader::DestroyUploadRing()
+{
+	for (int i = 0; i < UPLOAD_RING_SLOTS; i++)
+	{
+		if (m_uploadFences[i] != 0)
+		{
+			glDeleteSync(m_uploadFences[i]);
+			m_uploadFences[i] = 0;
+		}
+	}
+
+	if (m_uploadBuffer != 0)
+	{
+		if (m_pPersistentRing != NULL)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			m_pPersistentRing = NULL;
+		}
+		glDeleteBuffers(1, &m_uploadBuffer);
+		m_uploadBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  AcquireUploadSlot()
+ *
+ *  This method is used for getting writable memory for the
+ *  next upload.  It only blocks if the GL has not finished
+ *  reading the region from UPLOAD_RING_SLOTS uploads ago.
+ ***********************************************************/
+unsigned char* TextureLoader::AcquireUploadSlot(size_t bytes, size_t& bufferOffset)
+{
+	int slot = m_nextUploadSlot;
+	m_nextUploadSlot = (m_nextUploadSlot + 1) % UPLOAD_RING_SLOTS;
+	m_activeUploadSlot = slot;
+
+	if (m_pPersistentRing != NULL)
+	{
+		if (m_uploadFences[slot] != 0)
+		{
+			while (glClientWaitSync(m_uploadFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT,
+				g_FenceTimeoutNanoseconds) == GL_TIMEOUT_EXPIRED)
+			{
+			}
+			glDeleteSync(m_uploadFences[slot]);
+			m_uploadFences[slot] = 0;
+		}
+
+		bufferOffset = slot * m_uploadSlotBytes;
+		return(m_pPersistentRing + bufferOffset);
+	}
+
+	// without persistent mapping, orphan the buffer so the driver
+	// hands out fresh storage instead of waiting on the last upload
+	bufferOffset = 0;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(m_uploadSlotBytes), NULL, GL_STREAM_DRAW);
+	return static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+		static_cast<GLsizeiptr>(bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+
+/***********************************************************
+ *  ReleaseUploadSlot()
+ *
+ *  This method is used for finishing the write into the
+ *  region returned by AcquireUploadSlot().
+ ***********************************************************/
+void TextureLoader::ReleaseUploadSlot()
+{
+	// coherent persistent memory needs no unmap or flush
+	if (m_pPersistentRing == NULL)
+	{
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+}
+
+/***********************************************************
+ *  PrintTimings()
+ *
+ *  This method is used for writing the decode and upload
+ *  time of every texture, followed by the total wall time
+ *  of the load compared to decoding everything serially.
+ ***********************************************************/
+void TextureLoader::PrintTimings(std::ostream& output) const
+{
+	double decodeTotal = 0.0;
+	double uploadTotal = 0.0;
+	size_t gpuBytesTotal = 0;
+
+	output << "INFO: Texture load timings (" << m_pWorkerPool->GetThreadCount() << " decode threads)" << std::endl;
+	output << std::fixed << std::setprecision(2);
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		const LOADED_TEXTURE& texture = m_textures[i];
+		output << "  " << std::left << std::setw(10) << texture.tag << std::right
+			<< std::setw(6) << texture.width << "x" << std::setw(5) << std::left << texture.height << std::right
+			<< " decode " << std::setw(8) << texture.decodeMilliseconds << " ms"
+			<< "  upload " << std::setw(8) << texture.uploadMilliseconds << " ms"
+			<< "  " << std::setw(8) << (texture.gpuBytes / 1024) << " KB"
+			<< (texture.bCompressed ? (texture.bCacheHit ? "  cached" : "  baked") : "  decoded") << std::endl;
+		decodeTotal += texture.decodeMilliseconds;
+		uploadTotal += texture.uploadMilliseconds;
+		gpuBytesTotal += texture.gpuBytes;
+	}
+	output << "  serial decode+upload " << (decodeTotal + uploadTotal) << " ms,"
+		<< " parallel load " << m_totalMilliseconds << " ms,"
+		<< " texture memory " << (gpuBytesTotal / (1024.0 * 1024.0)) << " MB" << std::endl;
+	output << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.h
+// ===============
+// decode scene textures in parallel and upload them on the GL thread
+//
+//  Image files are decoded by stb_image on the worker pool while the
+//  thread that owns the GL context uploads each image as soon as its
+//  decode finishes, through a ring of pixel unpack buffers.  When the
+//  texture cache is enabled, images are baked to block-compressed mip
+//  chains once and later loads read the baked blocks instead.  Every
+//  image is uploaded into a texture array layer from the TextureManager.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureCache.h"
+#include "TextureManager.h"
+#include "WorkerPool.h"
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class loads a batch of texture image files.  The
+ *  textures are queued with AddTexture() and then loaded
+ *  together with LoadAll(), which must be called on the
+ *  thread where the GL context is current.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// constructor - the texture manager may be NULL for BakeAll()
+	TextureLoader(WorkerPool* pWorkerPool, TextureManager* pTextureManager);
+	// destructor
+	~TextureLoader();
+
+	struct LOADED_TEXTURE
+	{
+		std::string tag;
+		std::string filename;
+		int handle;
+		int width;
+		int height;
+		int colorChannels;
+		double decodeMilliseconds;
+		double uploadMilliseconds;
+		size_t gpuBytes;
+		bool bCompressed;
+		bool bCacheHit;
+		bool bLoaded;
+	};
+
+	// enable or disable the compressed texture cache (default on)
+	void SetUseTextureCache(bool bUseCache) { m_bUseTextureCache = bUseCache; }
+
+	// queue an image file to be loaded under the passed in tag
+	void AddTexture(const char* filename, std::string tag);
+	// decode and upload every queued texture, results are in queue order
+	const std::vector<LOADED_TEXTURE>& LoadAll();
+	// bake every queued texture into the cache without any GL upload
+	void BakeAll();
+	// write the per-texture decode and upload timings
+	void PrintTimings(std::ostream& output) const;
+
+private:
+	// number of regions in the pixel upload ring
+	static const int UPLOAD_RING_SLOTS = 2;
+
+	// decode one queued image - runs on a worker thread
+	void DecodeImage(int index);
+	// read one image from the cache or bake it - runs on a worker thread
+	bool LoadBakedImage(int index);
+	// upload one decoded image into a new GL texture
+	void UploadImage(int index);
+	// upload the blocks of one baked image into the bound texture
+	void UploadBakedImage(int index);
+
+	// create and destroy the pixel unpack buffer ring
+	void CreateUploadRing(size_t slotBytes);
+	void DestroyUploadRing();
+	// wait for the next ring region and return a pointer for writing
+	unsigned char* AcquireUploadSlot(size_t bytes, size_t& bufferOffset);
+	// hand the region written by AcquireUploadSlot() back to the GL
+	void ReleaseUploadSlot();
+
+	// pointer to the pool that runs the decodes
+	WorkerPool* m_pWorkerPool;
+	// pointer to the manager owning the texture arrays
+	TextureManager* m_pTextureManager;
+	// queued textures and their results
+	std::vector<LOADED_TEXTURE> m_textures;
+	// decoded pixel data waiting for upload, one per texture
+	std::vector<unsigned char*> m_decodedImages;
+	// baked block data waiting for upload, one per texture
+	std::vector<TextureCache::BAKED_TEXTURE> m_bakedImages;
+	// true to load through the compressed texture cache
+	bool m_bUseTextureCache;
+	// true while the current load uses the cache
+	bool m_bCacheActive;
+
+	// indices of textures whose decode has finished
+	std::queue<int> m_decodedQueue;
+	std::mutex m_decodedMutex;
+	std::condition_variable m_decodedReady;
+
+	// pixel unpack buffer used as the upload ring
+	GLuint m_uploadBuffer;
+	// size of one ring region in bytes
+	size_t m_uploadSlotBytes;
+	// persistently mapped ring memory, or NULL when unsupported
+	unsigned char* m_pPersistentRing;
+	// fences guarding each ring region until its upload completes
+	GLsync m_uploadFences[UPLOAD_RING_SLOTS];
+	// next ring region to write
+	int m_nextUploadSlot;
+	// ring region returned by the last AcquireUploadSlot()
+	int m_activeUploadSlot;
+
+	// wall clock time of the whole LoadAll() call
+	double m_totalMilliseconds;
+};
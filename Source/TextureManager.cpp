@@ -0,0 +1,285 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureManager.cpp
+// ==================
+// pack scene textures into 2D texture array layers behind stable handles
+//
+//  Textures with the same size, format and mip count share one
+//  GL_TEXTURE_2D_ARRAY.  Every array stays bound to its own texture
+//  unit, so selecting a texture for a draw only changes the sampler
+//  unit and layer uniforms, never a texture binding.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureManager.h"
+
+#include <cstddef>
+
+/***********************************************************
+ *  TextureManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureManager::TextureManager()
+{
+	m_residentUnits = 0;
+	m_overflowArray = -1;
+}
+
+/***********************************************************
+ *  ~TextureManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureManager::~TextureManager()
+{
+	DestroyArrays();
+}
+
+/***********************************************************
+ *  ReserveTexture()
+ *
+ *  This method is used for reserving a layer for a texture
+ *  of the passed in shape.  The returned handle stays valid
+ *  for the lifetime of the manager.
+ ***********************************************************/
+int TextureManager::ReserveTexture(GLenum internalFormat, int width, int height, int levelCount, bool bCompressed)
+{
+	TEXTURE_SLOT slot;
+	slot.arrayIndex = FindArray(internalFormat, width, height, levelCount, bCompressed);
+	slot.layer = m_arrays[slot.arrayIndex].layerCount++;
+	m_textures.push_back(slot);
+
+	return static_cast<int>(m_textures.size()) - 1;
+}
+
+/***********************************************************
+ *  ReplaceTexture()
+ *
+ *  This method is used for moving a handle to a layer of a
+ *  different shape, when its image turns out not to match
+ *  the reserved one after the arrays were allocated.  The
+ *  handle stays the same, so it can be given out already.
+ *  The layer reserved first cannot be taken back from its
+ *  allocated array and stays empty.
+ ***********************************************************/
+void TextureManager::ReplaceTexture(int handle, GLenum internalFormat, int width, int height, int levelCount, bool bCompressed)
+{
+	TEXTURE_SLOT& slot = m_textures[handle];
+	slot.arrayIndex = FindArray(internalFormat, width, height, levelCount, bCompressed);
+	slot.layer = m_arrays[slot.arrayIndex].layerCount++;
+}
+
+/***********************************************************
+ *  FindArray()
+ *
+ *  This method is used for finding the array a layer of
+ *  the passed in shape is reserved in, adding one when no
+ *  unallocated array has that shape.
+ ***********************************************************/
+int TextureManager::FindArray(GLenum internalFormat, int width, int height, int levelCount, bool bCompressed)
+{
+	int arrayIndex = -1;
+
+	// join an array of the same shape that is not allocated yet
+	for (size_t i = 0; (i < m_arrays.size()) && (arrayIndex < 0); i++)
+	{
+		const TEXTURE_ARRAY& textureArray = m_arrays[i];
+		if ((textureArray.bAllocated == false) &&
+			(textureArray.internalFormat == internalFormat) &&
+			(textureArray.width == width) &&
+			(textureArray.height == height) &&
+			(textureArray.levelCount == levelCount))
+		{
+			arrayIndex = static_cast<int>(i);
+		}
+	}
+
+	if (arrayIndex < 0)
+	{
+		TEXTURE_ARRAY textureArray;
+		textureArray.ID = 0;
+		textureArray.internalFormat = internalFormat;
+		textureArray.width = width;
+		textureArray.height = height;
+		textureArray.levelCount = levelCount;
+		textureArray.layerCount = 0;
+		textureArray.bCompressed = bCompressed;
+		textureArray.bAllocated = false;
+
+		arrayIndex = static_cast<int>(m_arrays.size());
+		m_arrays.push_back(textureArray);
+	}
+
+	return arrayIndex;
+}
+
+/***********************************************************
+ *  AllocateArrays()
+ *
+ *  This method is used for creating the storage of every
+ *  array that has reserved layers but no storage yet.
+ ***********************************************************/
+void TextureManager::AllocateArrays()
+{
+	for (size_t i = 0; i < m_arrays.size(); i++)
+	{
+		TEXTURE_ARRAY& textureArray = m_arrays[i];
+		if (textureArray.bAllocated == true)
+		{
+			continue;
+		}
+
+		glGenTextures(1, &textureArray.ID);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+
+		if (GLEW_ARB_texture_storage)
+		{
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, textureArray.levelCount, textureArray.internalFormat,
+				textureArray.width, textureArray.height, textureArray.layerCount);
+		}
+		else
+		{
+			// allocate every mip level one at a time
+			int levelWidth = textureArray.width;
+			int levelHeight = textureArray.height;
+			for (int level = 0; level < textureArray.levelCount; level++)
+			{
+				if (textureArray.bCompressed == true)
+				{
+					// DXT1 blocks are 8 bytes, DXT5 blocks 16 bytes
+					int blockBytes = (textureArray.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 8 : 16;
+					GLsizei levelBytes = ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockBytes * textureArray.layerCount;
+					glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, textureArray.internalFormat,
+						levelWidth, levelHeight, textureArray.layerCount, 0, levelBytes, NULL);
+				}
+				else
+				{
+					GLenum pixelFormat = (textureArray.internalFormat == GL_RGBA8) ? GL_RGBA : GL_RGB;
+					glTexImage3D(GL_TEXTURE_2D_ARRAY, level, textureArray.internalFormat,
+						levelWidth, levelHeight, textureArray.layerCount, 0, pixelFormat, GL_UNSIGNED_BYTE, NULL);
+				}
+				levelWidth = (levelWidth > 1) ? levelWidth / 2 : 1;
+				levelHeight = (levelHeight > 1) ? levelHeight / 2 : 1;
+			}
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, textureArray.levelCount - 1);
+		}
+
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		textureArray.bAllocated = true;
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+/***********************************************************
+ *  FinishUploads()
+ *
+ *  This method is used for generating the mip chain of the
+ *  arrays filled from uncompressed images.  Compressed
+ *  arrays are uploaded with their mip chains already baked.
+ ***********************************************************/
+void TextureManager::FinishUploads()
+{
+	for (size_t i = 0; i < m_arrays.size(); i++)
+	{
+		if ((m_arrays[i].bAllocated == true) && (m_arrays[i].bCompressed == false))
+		{
+			glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[i].ID);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+/***********************************************************
+ *  BindArrays()
+ *
+ *  This method is used for binding each texture array to
+ *  the texture unit matching its index.  If there are more
+ *  arrays than units, the last unit is shared by the rest
+ *  and bound on demand by BindForDraw().  The reserved
+ *  units at the top are left alone.
+ ***********************************************************/
+void TextureManager::BindArrays()
+{
+	GLint maxUnits = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxUnits);
+	if (maxUnits > FIRST_RESERVED_UNIT)
+	{
+		maxUnits = FIRST_RESERVED_UNIT;
+	}
+
+	m_residentUnits = static_cast<int>(m_arrays.size());
+	if (m_residentUnits > maxUnits)
+	{
+		m_residentUnits = maxUnits - 1;
+	}
+
+	for (int i = 0; i < m_residentUnits; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[i].ID);
+	}
+	m_overflowArray = -1;
+}
+
+/***********************************************************
+ *  DestroyArrays()
+ *
+ *  This method is used for freeing every texture array.
+ *  Handles become invalid afterwards.
+ ***********************************************************/
+void TextureManager::DestroyArrays()
+{
+	for (size_t i = 0; i < m_arrays.size(); i++)
+	{
+		if (m_arrays[i].ID != 0)
+		{
+			glDeleteTextures(1, &m_arrays[i].ID);
+		}
+	}
+	m_arrays.clear();
+	m_textures.clear();
+	m_residentUnits = 0;
+	m_overflowArray = -1;
+}
+
+/***********************************************************
+ *  GetArrayTexture()
+ *
+ *  This method is used for getting the GL texture array
+ *  that holds the image of a handle.
+ ***********************************************************/
+GLuint TextureManager::GetArrayTexture(int handle) const
+{
+	return m_arrays[m_textures[handle].arrayIndex].ID;
+}
+
+/***********************************************************
+ *  BindForDraw()
+ *
+ *  This method is used for getting the texture unit that
+ *  samples the array of a handle.  Resident arrays are
+ *  already bound; others are bound to the shared last unit.
+ ***********************************************************/
+int TextureManager::BindForDraw(int handle)
+{
+	int arrayIndex = m_textures[handle].arrayIndex;
+	if (arrayIndex < m_residentUnits)
+	{
+		return(arrayIndex);
+	}
+
+	if (m_overflowArray != arrayIndex)
+	{
+		glActiveTexture(GL_TEXTURE0 + m_residentUnits);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[arrayIndex].ID);
+		m_overflowArray = arrayIndex;
+	}
+	return(m_residentUnits);
+}
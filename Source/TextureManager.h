@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureManager.h
+// ================
+// pack scene textures into 2D texture array layers behind stable handles
+//
+//  Textures with the same size, format and mip count share one
+//  GL_TEXTURE_2D_ARRAY.  Every array stays bound to its own texture
+//  unit, so selecting a texture for a draw only changes the sampler
+//  unit and layer uniforms, never a texture binding.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  TextureManager
+ *
+ *  This class owns the texture arrays of the scene.  Space
+ *  for a batch of textures is reserved first, then the
+ *  arrays are allocated with exactly the reserved number of
+ *  layers and the images are uploaded into their layers.
+ *  Textures reserved after their array was allocated start
+ *  a new array of the same shape.
+ ***********************************************************/
+class TextureManager
+{
+public:
+	// constructor
+	TextureManager();
+	// destructor
+	~TextureManager();
+
+	// reserve a layer for a texture, returns its handle
+	int ReserveTexture(GLenum internalFormat, int width, int height, int levelCount, bool bCompressed);
+	// move a handle to a new layer of another shape, before
+	// AllocateArrays() creates its storage; the old layer is
+	// left unused
+	void ReplaceTexture(int handle, GLenum internalFormat, int width, int height, int levelCount, bool bCompressed);
+	// create the GL storage of every array with reserved layers
+	void AllocateArrays();
+	// generate mipmaps of arrays filled from uncompressed images
+	void FinishUploads();
+	// bind every array to its texture unit
+	void BindArrays();
+	// free all texture arrays
+	void DestroyArrays();
+
+	// texture array and layer that a handle's image is uploaded into
+	GLuint GetArrayTexture(int handle) const;
+	int GetLayer(int handle) const { return m_textures[handle].layer; }
+	// texture unit to sample from for a handle, binding it if needed
+	int BindForDraw(int handle);
+
+	// units from this one up to the 16 GL 3.3 guarantees are
+	// never used for arrays, so other samplers can keep them:
+	// the light clusters use 12 to 14, the shadow atlas 15
+	static const int FIRST_RESERVED_UNIT = 12;
+
+	// number of textures and arrays managed
+	int GetTextureCount() const { return static_cast<int>(m_textures.size()); }
+	int GetArrayCount() const { return static_cast<int>(m_arrays.size()); }
+
+private:
+	struct TEXTURE_ARRAY
+	{
+		GLuint ID;
+		GLenum internalFormat;
+		int width;
+		int height;
+		int levelCount;
+		int layerCount;
+		bool bCompressed;
+		bool bAllocated;
+	};
+
+	struct TEXTURE_SLOT
+	{
+		int arrayIndex;
+		int layer;
+	};
+
+	// index of an unallocated array of a shape, added if needed
+	int FindArray(GLenum internalFormat, int width, int height, int levelCount, bool bCompressed);
+
+	// texture arrays, each bound to the unit matching its index
+	std::vector<TEXTURE_ARRAY> m_arrays;
+	// texture handles, indexing this vector
+	std::vector<TEXTURE_SLOT> m_textures;
+	// number of texture units arrays can stay bound to
+	int m_residentUnits;
+	// array currently bound to the last unit when arrays outnumber units
+	int m_overflowArray;
+};
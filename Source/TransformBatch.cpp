@@ -0,0 +1,655 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformBatch.cpp
+// ==================
+// build many model matrices at once from scale, rotation and position
+//
+//  The transforms are stored as separate arrays of each component, so
+//  the SSE and AVX2 kernels load four or eight objects per instruction
+//  and write the scale-rotate-translate matrix directly, without the
+//  generic 4x4 products of the glm path.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformBatch.h"
+
+#include "SceneGraph.h"
+#include "WorkerPool.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+// the SIMD kernels are built for x86 processors with SSE2
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define TRANSFORM_BATCH_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics in any function
+#define TARGET_AVX2
+#else
+// GCC and Clang need AVX2 enabled per function, the rest of
+// the program must still run on older processors
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define TRANSFORM_BATCH_SIMD 0
+#endif
+
+// declaration of global variables
+namespace
+{
+	const float DEGREES_TO_RADIANS = 3.14159265358979f / 180.0f;
+
+	// transforms below this count are composed on the calling thread
+	const int PARALLEL_MIN_TRANSFORMS = 4096;
+	// smallest share of a batch given to one worker task
+	const int PARALLEL_MIN_TASK = 1024;
+
+	// polynomials for sin and cos on [-pi/4, pi/4]
+	const float SIN_C1 = -1.6666654611e-1f;
+	const float SIN_C2 = 8.3321608736e-3f;
+	const float SIN_C3 = -1.9515295891e-4f;
+	const float COS_C1 = 4.166664568298827e-2f;
+	const float COS_C2 = -1.388731625493765e-3f;
+	const float COS_C3 = 2.443315711809948e-5f;
+
+	// read-only view of the component arrays
+	struct COMPONENTS
+	{
+		const float* scaleX;
+		const float* scaleY;
+		const float* scaleZ;
+		const float* rotationX;
+		const float* rotationY;
+		const float* rotationZ;
+		const float* positionX;
+		const float* positionY;
+		const float* positionZ;
+	};
+
+	/***********************************************************
+	 *  ComposeScalar()
+	 *
+	 *  Write the matrices of transforms [first, end) one at a
+	 *  time.  R = Rx * Ry * Rz is expanded by hand, and each
+	 *  column is scaled by the matching scale component.
+	 ***********************************************************/
+	void ComposeScalar(const COMPONENTS& in, int first, int end, float* pMatrices)
+	{
+		for (int i = first; i < end; i++)
+		{
+			float sa = std::sin(in.rotationX[i] * DEGREES_TO_RADIANS);
+			float ca = std::cos(in.rotationX[i] * DEGREES_TO_RADIANS);
+			float sb = std::sin(in.rotationY[i] * DEGREES_TO_RADIANS);
+			float cb = std::cos(in.rotationY[i] * DEGREES_TO_RADIANS);
+			float sc = std::sin(in.rotationZ[i] * DEGREES_TO_RADIANS);
+			float cc = std::cos(in.rotationZ[i] * DEGREES_TO_RADIANS);
+			float sx = in.scaleX[i];
+			float sy = in.scaleY[i];
+			float sz = in.scaleZ[i];
+
+			float* m = pMatrices + static_cast<size_t>(i) * 16;
+			m[0] = cb * cc * sx;
+			m[1] = (ca * sc + sa * sb * cc) * sx;
+			m[2] = (sa * sc - ca * sb * cc) * sx;
+			m[3] = 0.0f;
+			m[4] = -cb * sc * sy;
+			m[5] = (ca * cc - sa * sb * sc) * sy;
+			m[6] = (sa * cc + ca * sb * sc) * sy;
+			m[7] = 0.0f;
+			m[8] = sb * sz;
+			m[9] = -sa * cb * sz;
+			m[10] = ca * cb * sz;
+			m[11] = 0.0f;
+			m[12] = in.positionX[i];
+			m[13] = in.positionY[i];
+			m[14] = in.positionZ[i];
+			m[15] = 1.0f;
+		}
+	}
+
+#if TRANSFORM_BATCH_SIMD
+	/***********************************************************
+	 *  SinCosDegrees4()
+	 *
+	 *  Compute the sine and cosine of four angles in degrees.
+	 *  The angle is reduced to [-45, 45] degrees around the
+	 *  nearest multiple of 90, which is exact in degrees, and
+	 *  the quadrant picks and signs the two polynomials.
+	 ***********************************************************/
+	inline void SinCosDegrees4(__m128 degrees, __m128* pSin, __m128* pCos)
+	{
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128i two = _mm_set1_epi32(2);
+
+		__m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(degrees, _mm_set1_ps(1.0f / 90.0f)));
+		__m128 reduced = _mm_sub_ps(degrees, _mm_mul_ps(_mm_cvtepi32_ps(quadrant), _mm_set1_ps(90.0f)));
+		__m128 r = _mm_mul_ps(reduced, _mm_set1_ps(DEGREES_TO_RADIANS));
+		__m128 r2 = _mm_mul_ps(r, r);
+
+		__m128 sinPoly = _mm_add_ps(_mm_set1_ps(SIN_C2), _mm_mul_ps(r2, _mm_set1_ps(SIN_C3)));
+		sinPoly = _mm_add_ps(_mm_set1_ps(SIN_C1), _mm_mul_ps(r2, sinPoly));
+		sinPoly = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinPoly));
+
+		__m128 cosPoly = _mm_add_ps(_mm_set1_ps(COS_C2), _mm_mul_ps(r2, _mm_set1_ps(COS_C3)));
+		cosPoly = _mm_add_ps(_mm_set1_ps(COS_C1), _mm_mul_ps(r2, cosPoly));
+		cosPoly = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)),
+			_mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly));
+
+		// odd quadrants swap sin and cos, bit 1 of the quadrant
+		// (and of quadrant + 1 for cos) flips the sign
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+		__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+		__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+		__m128 sinValue = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+		__m128 cosValue = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+		*pSin = _mm_xor_ps(sinValue, sinSign);
+		*pCos = _mm_xor_ps(cosValue, cosSign);
+	}
+
+	/***********************************************************
+	 *  ComposeSSE()
+	 *
+	 *  Write the matrices of transforms [first, end) four at
+	 *  a time, with each register holding one matrix element
+	 *  of four objects.  A 4x4 transpose per column turns them
+	 *  back into whole columns.  The remainder is scalar.
+	 ***********************************************************/
+	void ComposeSSE(const COMPONENTS& in, int first, int end, float* pMatrices)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 oneValue = _mm_set1_ps(1.0f);
+
+		int i = first;
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 sa, ca, sb, cb, sc, cc;
+			SinCosDegrees4(_mm_loadu_ps(in.rotationX + i), &sa, &ca);
+			SinCosDegrees4(_mm_loadu_ps(in.rotationY + i), &sb, &cb);
+			SinCosDegrees4(_mm_loadu_ps(in.rotationZ + i), &sc, &cc);
+			__m128 sx = _mm_loadu_ps(in.scaleX + i);
+			__m128 sy = _mm_loadu_ps(in.scaleY + i);
+			__m128 sz = _mm_loadu_ps(in.scaleZ + i);
+
+			__m128 sbcc = _mm_mul_ps(sb, cc);
+			__m128 sbsc = _mm_mul_ps(sb, sc);
+
+			__m128 columns[4][4];
+			columns[0][0] = _mm_mul_ps(_mm_mul_ps(cb, cc), sx);
+			columns[0][1] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ca, sc), _mm_mul_ps(sa, sbcc)), sx);
+			columns[0][2] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sa, sc), _mm_mul_ps(ca, sbcc)), sx);
+			columns[0][3] = zero;
+			columns[1][0] = _mm_sub_ps(zero, _mm_mul_ps(_mm_mul_ps(cb, sc), sy));
+			columns[1][1] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ca, cc), _mm_mul_ps(sa, sbsc)), sy);
+			columns[1][2] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sa, cc), _mm_mul_ps(ca, sbsc)), sy);
+			columns[1][3] = zero;
+			columns[2][0] = _mm_mul_ps(sb, sz);
+			columns[2][1] = _mm_sub_ps(zero, _mm_mul_ps(_mm_mul_ps(sa, cb), sz));
+			columns[2][2] = _mm_mul_ps(_mm_mul_ps(ca, cb), sz);
+			columns[2][3] = zero;
+			columns[3][0] = _mm_loadu_ps(in.positionX + i);
+			columns[3][1] = _mm_loadu_ps(in.positionY + i);
+			columns[3][2] = _mm_loadu_ps(in.positionZ + i);
+			columns[3][3] = oneValue;
+
+			float* m = pMatrices + static_cast<size_t>(i) * 16;
+			for (int column = 0; column < 4; column++)
+			{
+				__m128* c = columns[column];
+				_MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+				for (int object = 0; object < 4; object++)
+				{
+					_mm_storeu_ps(m + object * 16 + column * 4, c[object]);
+				}
+			}
+		}
+
+		ComposeScalar(in, i, end, pMatrices);
+	}
+
+	/***********************************************************
+	 *  SinCosDegrees8()
+	 *
+	 *  Compute the sine and cosine of eight angles in degrees,
+	 *  the same way as SinCosDegrees4().
+	 ***********************************************************/
+	TARGET_AVX2 inline void SinCosDegrees8(__m256 degrees, __m256* pSin, __m256* pCos)
+	{
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i two = _mm256_set1_epi32(2);
+
+		__m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(degrees, _mm256_set1_ps(1.0f / 90.0f)));
+		__m256 reduced = _mm256_sub_ps(degrees, _mm256_mul_ps(_mm256_cvtepi32_ps(quadrant), _mm256_set1_ps(90.0f)));
+		__m256 r = _mm256_mul_ps(reduced, _mm256_set1_ps(DEGREES_TO_RADIANS));
+		__m256 r2 = _mm256_mul_ps(r, r);
+
+		__m256 sinPoly = _mm256_add_ps(_mm256_set1_ps(SIN_C2), _mm256_mul_ps(r2, _mm256_set1_ps(SIN_C3)));
+		sinPoly = _mm256_add_ps(_mm256_set1_ps(SIN_C1), _mm256_mul_ps(r2, sinPoly));
+		sinPoly = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sinPoly));
+
+		__m256 cosPoly = _mm256_add_ps(_mm256_set1_ps(COS_C2), _mm256_mul_ps(r2, _mm256_set1_ps(COS_C3)));
+		cosPoly = _mm256_add_ps(_mm256_set1_ps(COS_C1), _mm256_mul_ps(r2, cosPoly));
+		cosPoly = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)),
+			_mm256_mul_ps(_mm256_mul_ps(r2, r2), cosPoly));
+
+		__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+		__m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+		__m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+
+		*pSin = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+		*pCos = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+	}
+
+	/***********************************************************
+	 *  ComposeAVX2()
+	 *
+	 *  Write the matrices of transforms [first, end) eight at
+	 *  a time.  The transpose works within each 128-bit half,
+	 *  so the low half holds objects 0-3 and the high half
+	 *  objects 4-7.  The remainder goes to the SSE kernel.
+	 ***********************************************************/
+	TARGET_AVX2 void ComposeAVX2(const COMPONENTS& in, int first, int end, float* pMatrices)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 oneValue = _mm256_set1_ps(1.0f);
+
+		int i = first;
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 sa, ca, sb, cb, sc, cc;
+			SinCosDegrees8(_mm256_loadu_ps(in.rotationX + i), &sa, &ca);
+			SinCosDegrees8(_mm256_loadu_ps(in.rotationY + i), &sb, &cb);
+			SinCosDegrees8(_mm256_loadu_ps(in.rotationZ + i), &sc, &cc);
+			__m256 sx = _mm256_loadu_ps(in.scaleX + i);
+			__m256 sy = _mm256_loadu_ps(in.scaleY + i);
+			__m256 sz = _mm256_loadu_ps(in.scaleZ + i);
+
+			__m256 sbcc = _mm256_mul_ps(sb, cc);
+			__m256 sbsc = _mm256_mul_ps(sb, sc);
+
+			__m256 columns[4][4];
+			columns[0][0] = _mm256_mul_ps(_mm256_mul_ps(cb, cc), sx);
+			columns[0][1] = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ca, sc), _mm256_mul_ps(sa, sbcc)), sx);
+			columns[0][2] = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(sa, sc), _mm256_mul_ps(ca, sbcc)), sx);
+			columns[0][3] = zero;
+			columns[1][0] = _mm256_sub_ps(zero, _mm256_mul_ps(_mm256_mul_ps(cb, sc), sy));
+			columns[1][1] = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(ca, cc), _mm256_mul_ps(sa, sbsc)), sy);
+			columns[1][2] = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(sa, cc), _mm256_mul_ps(ca, sbsc)), sy);
+			columns[1][3] = zero;
+			columns[2][0] = _mm256_mul_ps(sb, sz);
+			columns[2][1] = _mm256_sub_ps(zero, _mm256_mul_ps(_mm256_mul_ps(sa, cb), sz));
+			columns[2][2] = _mm256_mul_ps(_mm256_mul_ps(ca, cb), sz);
+			columns[2][3] = zero;
+			columns[3][0] = _mm256_loadu_ps(in.positionX + i);
+			columns[3][1] = _mm256_loadu_ps(in.positionY + i);
+			columns[3][2] = _mm256_loadu_ps(in.positionZ + i);
+			columns[3][3] = oneValue;
+
+			float* m = pMatrices + static_cast<size_t>(i) * 16;
+			for (int column = 0; column < 4; column++)
+			{
+				const __m256* c = columns[column];
+				__m256 t0 = _mm256_unpacklo_ps(c[0], c[1]);
+				__m256 t1 = _mm256_unpackhi_ps(c[0], c[1]);
+				__m256 t2 = _mm256_unpacklo_ps(c[2], c[3]);
+				__m256 t3 = _mm256_unpackhi_ps(c[2], c[3]);
+
+				__m256 rows[4];
+				rows[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+				rows[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+				rows[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+				rows[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+				for (int object = 0; object < 4; object++)
+				{
+					_mm_storeu_ps(m + object * 16 + column * 4, _mm256_castps256_ps128(rows[object]));
+					_mm_storeu_ps(m + (object + 4) * 16 + column * 4, _mm256_extractf128_ps(rows[object], 1));
+				}
+			}
+		}
+
+		ComposeSSE(in, i, end, pMatrices);
+	}
+
+	/***********************************************************
+	 *  DetectAVX2()
+	 *
+	 *  Check that the processor has AVX2 and that the OS
+	 *  saves the AVX registers on a context switch.
+	 ***********************************************************/
+	bool DetectAVX2()
+	{
+#if defined(_MSC_VER)
+		int info[4] = {};
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return(false);
+		}
+
+		__cpuid(info, 1);
+		bool bOSXSave = (info[2] & (1 << 27)) != 0;
+		bool bAVX = (info[2] & (1 << 28)) != 0;
+		if ((bOSXSave == false) || (bAVX == false) || ((_xgetbv(0) & 6) != 6))
+		{
+			return(false);
+		}
+
+		__cpuidex(info, 7, 0);
+		return((info[1] & (1 << 5)) != 0);
+#else
+		__builtin_cpu_init();
+		return(__builtin_cpu_supports("avx2") != 0);
+#endif
+	}
+#endif
+
+	/***********************************************************
+	 *  MaxDifference()
+	 *
+	 *  Get the largest difference between two lists of
+	 *  matrices, to check a kernel against the glm path.
+	 ***********************************************************/
+	float MaxDifference(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		float difference = 0.0f;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			difference = std::max(difference, std::fabs(a[i] - b[i]));
+		}
+
+		return(difference);
+	}
+}
+
+/***********************************************************
+ *  TransformBatch()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransformBatch::TransformBatch()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every transform.  The
+ *  storage is kept for the next batch.
+ ***********************************************************/
+void TransformBatch::Clear()
+{
+	m_scaleX.clear();
+	m_scaleY.clear();
+	m_scaleZ.clear();
+	m_rotationX.clear();
+	m_rotationY.clear();
+	m_rotationZ.clear();
+	m_positionX.clear();
+	m_positionY.clear();
+	m_positionZ.clear();
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for appending one transform to the
+ *  component arrays.
+ ***********************************************************/
+int TransformBatch::Add(glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ)
+{
+	m_scaleX.push_back(scaleXYZ.x);
+	m_scaleY.push_back(scaleXYZ.y);
+	m_scaleZ.push_back(scaleXYZ.z);
+	m_rotationX.push_back(rotationDegrees.x);
+	m_rotationY.push_back(rotationDegrees.y);
+	m_rotationZ.push_back(rotationDegrees.z);
+	m_positionX.push_back(positionXYZ.x);
+	m_positionY.push_back(positionXYZ.y);
+	m_positionZ.push_back(positionXYZ.z);
+
+	return(GetCount() - 1);
+}
+
+/***********************************************************
+ *  Compose()
+ *
+ *  This method is used for writing the matrix of every
+ *  transform with the fastest kernel.  Large batches are
+ *  cut into one slice per worker thread, each a multiple
+ *  of eight transforms so only the last slice has a scalar
+ *  remainder.
+ ***********************************************************/
+void TransformBatch::Compose(float* pMatrices, WorkerPool* pWorkerPool) const
+{
+	int count = GetCount();
+	KERNEL kernel = GetBestKernel();
+
+	if ((pWorkerPool == NULL) || (count < PARALLEL_MIN_TRANSFORMS))
+	{
+		ComposeRange(0, count, pMatrices, kernel);
+		return;
+	}
+
+	int threadCount = pWorkerPool->GetThreadCount();
+	int slice = (count + threadCount - 1) / threadCount;
+	slice = std::max(slice, PARALLEL_MIN_TASK);
+	slice = (slice + 7) & ~7;
+
+	for (int first = 0; first < count; first += slice)
+	{
+		int sliceCount = std::min(slice, count - first);
+		pWorkerPool->Submit([this, first, sliceCount, pMatrices, kernel]() {
+			ComposeRange(first, sliceCount, pMatrices, kernel);
+		});
+	}
+	pWorkerPool->Wait();
+}
+
+/***********************************************************
+ *  ComposeRange()
+ *
+ *  This method is used for writing the matrices of a range
+ *  of transforms with the passed in kernel.  A kernel the
+ *  processor lacks falls back to the scalar code.
+ ***********************************************************/
+void TransformBatch::ComposeRange(int first, int count, float* pMatrices, KERNEL kernel) const
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	COMPONENTS in;
+	in.scaleX = &m_scaleX[0];
+	in.scaleY = &m_scaleY[0];
+	in.scaleZ = &m_scaleZ[0];
+	in.rotationX = &m_rotationX[0];
+	in.rotationY = &m_rotationY[0];
+	in.rotationZ = &m_rotationZ[0];
+	in.positionX = &m_positionX[0];
+	in.positionY = &m_positionY[0];
+	in.positionZ = &m_positionZ[0];
+
+	int end = first + count;
+	if (IsKernelSupported(kernel) == false)
+	{
+		kernel = KERNEL_SCALAR;
+	}
+
+	switch (kernel)
+	{
+#if TRANSFORM_BATCH_SIMD
+	case KERNEL_AVX2:
+		ComposeAVX2(in, first, end, pMatrices);
+		break;
+	case KERNEL_SSE:
+		ComposeSSE(in, first, end, pMatrices);
+		break;
+#endif
+	default:
+		ComposeScalar(in, first, end, pMatrices);
+		break;
+	}
+}
+
+/***********************************************************
+ *  GetBestKernel()
+ *
+ *  This method is used for getting the widest kernel the
+ *  processor can run.
+ ***********************************************************/
+TransformBatch::KERNEL TransformBatch::GetBestKernel()
+{
+	if (IsKernelSupported(KERNEL_AVX2) == true)
+	{
+		return(KERNEL_AVX2);
+	}
+	if (IsKernelSupported(KERNEL_SSE) == true)
+	{
+		return(KERNEL_SSE);
+	}
+
+	return(KERNEL_SCALAR);
+}
+
+/***********************************************************
+ *  IsKernelSupported()
+ *
+ *  This method is used for checking whether a kernel was
+ *  built and can run on this processor.  The CPU is only
+ *  queried once.
+ ***********************************************************/
+bool TransformBatch::IsKernelSupported(KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return(true);
+#if TRANSFORM_BATCH_SIMD
+	case KERNEL_SSE:
+		return(true);
+	case KERNEL_AVX2:
+	{
+		static const bool bHasAVX2 = DetectAVX2();
+		return(bHasAVX2);
+	}
+#endif
+	default:
+		return(false);
+	}
+}
+
+/***********************************************************
+ *  GetKernelName()
+ *
+ *  This method is used for getting the name of a kernel
+ *  for reports.
+ ***********************************************************/
+const char* TransformBatch::GetKernelName(KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SSE:
+		return("sse");
+	case KERNEL_AVX2:
+		return("avx2");
+	default:
+		return("scalar");
+	}
+}
+
+/***********************************************************
+ *  Benchmark()
+ *
+ *  This method is used for measuring the cost of building
+ *  model matrices.  The glm path composes five matrices
+ *  per object with SceneGraph::ComposeTransform(), as
+ *  SetTransformations() does.  Each supported kernel and
+ *  the worker pool run the same random transforms, and
+ *  their largest difference from the glm result is
+ *  reported with the time per transform.
+ ***********************************************************/
+void TransformBatch::Benchmark(int transformCount, std::ostream& output)
+{
+	// enough passes for about a million transforms per path
+	int passes = std::max(1, (1 << 20) / transformCount);
+
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<float> scales(0.1f, 4.0f);
+	std::uniform_real_distribution<float> angles(-360.0f, 360.0f);
+	std::uniform_real_distribution<float> positions(-50.0f, 50.0f);
+
+	TransformBatch batch;
+	std::vector<glm::vec3> scaleXYZ(transformCount);
+	std::vector<glm::vec3> rotationDegrees(transformCount);
+	std::vector<glm::vec3> positionXYZ(transformCount);
+	for (int i = 0; i < transformCount; i++)
+	{
+		scaleXYZ[i] = glm::vec3(scales(random), scales(random), scales(random));
+		rotationDegrees[i] = glm::vec3(angles(random), angles(random), angles(random));
+		positionXYZ[i] = glm::vec3(positions(random), positions(random), positions(random));
+		batch.Add(scaleXYZ[i], rotationDegrees[i], positionXYZ[i]);
+	}
+
+	std::vector<float> reference(static_cast<size_t>(transformCount) * 16);
+	std::vector<float> matrices(reference.size());
+	std::chrono::high_resolution_clock::time_point start;
+	std::chrono::duration<double, std::nano> elapsed(0.0);
+	double transforms = static_cast<double>(transformCount) * passes;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (int i = 0; i < transformCount; i++)
+		{
+			glm::mat4 model = SceneGraph::ComposeTransform(scaleXYZ[i], rotationDegrees[i], positionXYZ[i]);
+			memcpy(&reference[static_cast<size_t>(i) * 16], glm::value_ptr(model), sizeof(float) * 16);
+		}
+	}
+	elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	output << "{" << std::endl;
+	output << "  \"transforms\": " << transformCount << "," << std::endl;
+	output << "  \"passes\": " << passes << "," << std::endl;
+	output << "  \"glm_ns_per_transform\": " << elapsed.count() / transforms << "," << std::endl;
+
+	const KERNEL kernels[] = { KERNEL_SCALAR, KERNEL_SSE, KERNEL_AVX2 };
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		if (IsKernelSupported(kernels[k]) == false)
+		{
+			continue;
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+		{
+			batch.ComposeRange(0, transformCount, &matrices[0], kernels[k]);
+		}
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		const char* name = GetKernelName(kernels[k]);
+		output << "  \"" << name << "_ns_per_transform\": " << elapsed.count() / transforms << "," << std::endl;
+		output << "  \"" << name << "_max_error\": " << MaxDifference(reference, matrices) << "," << std::endl;
+	}
+
+	WorkerPool workerPool;
+	start = std::chrono::high_resolution_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		batch.Compose(&matrices[0], &workerPool);
+	}
+	elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	output << "  \"threads\": " << workerPool.GetThreadCount() << "," << std::endl;
+	output << "  \"parallel_kernel\": \"" << GetKernelName(GetBestKernel()) << "\"," << std::endl;
+	output << "  \"parallel_ns_per_transform\": " << elapsed.count() / transforms << "," << std::endl;
+	output << "  \"parallel_max_error\": " << MaxDifference(reference, matrices) << std::endl;
+	output << "}" << std::endl;
+}
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformBatch.h
+// ================
+// build many model matrices at once from scale, rotation and position
+//
+//  The transforms are stored as separate arrays of each component, so
+//  the SSE and AVX2 kernels load four or eight objects per instruction
+//  and write the scale-rotate-translate matrix directly, without the
+//  generic 4x4 products of the glm path.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <ostream>
+#include <vector>
+
+class WorkerPool;
+
+/***********************************************************
+ *  TransformBatch
+ *
+ *  This class holds the scale, Euler angles in degrees and
+ *  position of a list of objects and composes their model
+ *  matrices the way SceneGraph::ComposeTransform() does:
+ *  scale, rotate about Z, Y and X, then translate.  Large
+ *  batches are split across the threads of a WorkerPool.
+ ***********************************************************/
+class TransformBatch
+{
+public:
+	// code paths that can compose the matrices
+	enum KERNEL
+	{
+		KERNEL_SCALAR,
+		KERNEL_SSE,
+		KERNEL_AVX2
+	};
+
+	// constructor
+	TransformBatch();
+
+	// remove every transform, keeping the storage
+	void Clear();
+	// append a transform, returns its index
+	int Add(glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ);
+	int GetCount() const { return static_cast<int>(m_positionX.size()); }
+
+	// write the matrix of every transform, 16 column-major
+	// floats each, using the worker pool for large batches
+	void Compose(float* pMatrices, WorkerPool* pWorkerPool) const;
+	// write the matrices of transforms [first, first + count)
+	// with one kernel
+	void ComposeRange(int first, int count, float* pMatrices, KERNEL kernel) const;
+
+	// fastest kernel this processor supports
+	static KERNEL GetBestKernel();
+	static bool IsKernelSupported(KERNEL kernel);
+	static const char* GetKernelName(KERNEL kernel);
+
+	// time every kernel against the glm path on random
+	// transforms and write the results as JSON
+	static void Benchmark(int transformCount, std::ostream& output);
+
+private:
+	// one array per component, indexed by transform
+	std::vector<float> m_scaleX;
+	std::vector<float> m_scaleY;
+	std::vector<float> m_scaleZ;
+	std::vector<float> m_rotationX;
+	std::vector<float> m_rotationY;
+	std::vector<float> m_rotationZ;
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+};
@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransparencyBuffer.cpp
+// ======================
+// weighted blended order-independent transparency
+//
+//  Blended draws are added into an accumulation target and a revealage
+//  target instead of being blended over each other in draw order, then
+//  one full-screen pass composites their weighted average over the
+//  opaque image.  The result does not depend on the draw order.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransparencyBuffer.h"
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// units the composite samples the targets from; they hold
+	// 2D textures, so the texture arrays on the same units stay
+	const int ACCUMULATION_UNIT = 0;
+	const int REVEALAGE_UNIT = 1;
+}
+
+/***********************************************************
+ *  TransparencyBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransparencyBuffer::TransparencyBuffer()
+{
+	m_program = 0;
+	m_vertexArray = 0;
+	m_accumulationLocation = -1;
+	m_revealageLocation = -1;
+	m_framebuffer = 0;
+	m_accumulationTexture = 0;
+	m_revealageTexture = 0;
+	m_depthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+	m_previousFramebuffer = 0;
+}
+
+/***********************************************************
+ *  ~TransparencyBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TransparencyBuffer::~TransparencyBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking that the context can
+ *  set a blend function per draw buffer, part of GL 4.0.
+ *  The two targets need different ones.
+ ***********************************************************/
+bool TransparencyBuffer::IsSupported()
+{
+	if (GLEW_VERSION_4_0)
+	{
+		return(true);
+	}
+
+	return(GLEW_ARB_draw_buffers_blend);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for taking the composite program
+ *  from the program cache, which prints any build errors.
+ *  The targets are created by the first Begin(), once the
+ *  viewport size is known.
+ ***********************************************************/
+bool TransparencyBuffer::Create(ProgramCache& programCache, const char* vertexFilename, const char* fragmentFilename)
+{
+	Destroy();
+
+	const ProgramCache::SHADER_STAGE stages[] =
+	{
+		{ GL_VERTEX_SHADER, vertexFilename },
+		{ GL_FRAGMENT_SHADER, fragmentFilename }
+	};
+	m_program = programCache.Finish(stages, 2);
+	if (m_program == 0)
+	{
+		return(false);
+	}
+
+	m_accumulationLocation = glGetUniformLocation(m_program, "accumulation");
+	m_revealageLocation = glGetUniformLocation(m_program, "revealage");
+
+	// the full-screen triangle comes from gl_VertexID, but the
+	// core profile still needs a vertex array bound
+	glGenVertexArrays(1, &m_vertexArray);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the program, the vertex
+ *  array and the targets.
+ ***********************************************************/
+void TransparencyBuffer::Destroy()
+{
+	DestroyTargets();
+
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+	}
+	m_program = 0;
+	if (m_vertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+	}
+	m_vertexArray = 0;
+	m_accumulationLocation = -1;
+	m_revealageLocation = -1;
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the framebuffer with
+ *  a half-float accumulation target, a single channel
+ *  revealage target and a depth buffer in the format of
+ *  the scene's, so the depth can be blitted across.
+ ***********************************************************/
+void TransparencyBuffer::CreateTargets(int width, int height)
+{
+	DestroyTargets();
+
+	glGenTextures(1, &m_accumulationTexture);
+	glBindTexture(GL_TEXTURE_2D, m_accumulationTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &m_revealageTexture);
+	glBindTexture(GL_TEXTURE_2D, m_revealageTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulationTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_revealageTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Transparency framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+
+	m_width = width;
+	m_height = height;
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ *
+ *  This method is used for freeing the framebuffer and
+ *  its targets.
+ ***********************************************************/
+void TransparencyBuffer::DestroyTargets()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteTextures(1, &m_accumulationTexture);
+		glDeleteTextures(1, &m_revealageTexture);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+	}
+	m_framebuffer = 0;
+	m_accumulationTexture = 0;
+	m_revealageTexture = 0;
+	m_depthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for redirecting the blended draws.
+ *  The opaque depth is blitted in and tested but not
+ *  written.  Each fragment adds its weighted premultiplied
+ *  color to the accumulation target and multiplies the
+ *  revealage target by (1 - alpha).
+ ***********************************************************/
+void TransparencyBuffer::Begin(int width, int height)
+{
+	if ((width != m_width) || (height != m_height) || (m_framebuffer == 0))
+	{
+		CreateTargets(width, height);
+	}
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(m_previousFramebuffer));
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	const GLfloat accumulationClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat revealageClear[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, accumulationClear);
+	glClearBufferfv(GL_COLOR, 1, revealageClear);
+
+	glEnable(GL_BLEND);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	glDepthMask(GL_FALSE);
+}
+
+/***********************************************************
+ *  Resolve()
+ *
+ *  This method is used for drawing one full-screen
+ *  triangle over the previous framebuffer that divides the
+ *  accumulated color by its weight and blends it with an
+ *  alpha of (1 - revealage).  Pixels no blended draw
+ *  reached are discarded.
+ ***********************************************************/
+void TransparencyBuffer::Resolve()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_previousFramebuffer));
+	glDepthMask(GL_TRUE);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	GLint previousProgram = 0;
+	GLint previousVertexArray = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+
+	glDisable(GL_DEPTH_TEST);
+	glUseProgram(m_program);
+	glActiveTexture(GL_TEXTURE0 + ACCUMULATION_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_accumulationTexture);
+	glActiveTexture(GL_TEXTURE0 + REVEALAGE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_revealageTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(m_accumulationLocation, ACCUMULATION_UNIT);
+	glUniform1i(m_revealageLocation, REVEALAGE_UNIT);
+
+	glBindVertexArray(m_vertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glBindVertexArray(static_cast<GLuint>(previousVertexArray));
+	glUseProgram(static_cast<GLuint>(previousProgram));
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+}
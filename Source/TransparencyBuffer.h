@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransparencyBuffer.h
+// ====================
+// weighted blended order-independent transparency
+//
+//  Blended draws are added into an accumulation target and a revealage
+//  target instead of being blended over each other in draw order, then
+//  one full-screen pass composites their weighted average over the
+//  opaque image.  The result does not depend on the draw order.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ProgramCache.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  TransparencyBuffer
+ *
+ *  This class owns the framebuffer of the accumulation
+ *  targets and the composite program.  The opaque depth is
+ *  copied into the framebuffer so blended fragments behind
+ *  opaque ones are still rejected.  The targets follow the
+ *  size of the viewport.
+ ***********************************************************/
+class TransparencyBuffer
+{
+public:
+	// constructor
+	TransparencyBuffer();
+	// destructor
+	~TransparencyBuffer();
+
+	// true when the context has a blend function per draw buffer
+	static bool IsSupported();
+
+	// take the composite program of its two shader files from
+	// the program cache
+	bool Create(ProgramCache& programCache, const char* vertexFilename, const char* fragmentFilename);
+	// free the program, framebuffer and targets
+	void Destroy();
+
+	// send the following draws into the accumulation targets
+	void Begin(int width, int height);
+	// composite the accumulated draws over the framebuffer
+	// that was bound before Begin()
+	void Resolve();
+
+private:
+	// create or resize the targets
+	void CreateTargets(int width, int height);
+	// free the targets
+	void DestroyTargets();
+
+	// composite program and the vertex array it draws with
+	GLuint m_program;
+	GLuint m_vertexArray;
+	GLint m_accumulationLocation;
+	GLint m_revealageLocation;
+	// framebuffer of the targets
+	GLuint m_framebuffer;
+	// premultiplied color and alpha, summed with weights
+	GLuint m_accumulationTexture;
+	// product of (1 - alpha) over the blended fragments
+	GLuint m_revealageTexture;
+	// copy of the opaque depth
+	GLuint m_depthBuffer;
+	int m_width;
+	int m_height;
+	// framebuffer to composite into
+	GLint m_previousFramebuffer;
+};
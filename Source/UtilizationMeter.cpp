@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+// UtilizationMeter.cpp
+// ====================
+// measure how busy the process keeps the CPU and the GPU
+//
+//  Used by the window loop in MainCode.cpp to compare continuous and
+//  on-demand redraw, where an idle scene should cost next to nothing.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UtilizationMeter.h"
+
+#include <chrono>
+#include <ctime>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+/***********************************************************
+ *  UtilizationMeter()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UtilizationMeter::UtilizationMeter()
+{
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		glGenQueries(1, &m_queries[i].ID);
+		m_queries[i].bPending = false;
+	}
+	m_currentQuery = 0;
+
+	m_startWallSeconds = GetWallSeconds();
+	m_startCpuSeconds = GetProcessSeconds();
+	m_sampleWallSeconds = m_startWallSeconds;
+	m_sampleCpuSeconds = m_startCpuSeconds;
+	m_sampleGpuSeconds = 0.0;
+	m_gpuSeconds = 0.0;
+}
+
+/***********************************************************
+ *  ~UtilizationMeter()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UtilizationMeter::~UtilizationMeter()
+{
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		glDeleteQueries(1, &m_queries[i].ID);
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the timer query of the
+ *  next frame, first reading back the older frame that used
+ *  the same query if it is still pending.
+ ***********************************************************/
+void UtilizationMeter::BeginFrame()
+{
+	TIMER_QUERY& query = m_queries[m_currentQuery];
+	if (query.bPending == true)
+	{
+		ResolveQuery(query, true);
+	}
+	glBeginQuery(GL_TIME_ELAPSED, query.ID);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for ending the frame's timer query
+ *  and collecting the results of earlier frames that are
+ *  ready.  With on-demand redraw the next frame may be
+ *  seconds away, so results are not left waiting for it.
+ ***********************************************************/
+void UtilizationMeter::EndFrame()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	m_queries[m_currentQuery].bPending = true;
+	m_currentQuery = (m_currentQuery + 1) % QUERY_RING_SIZE;
+
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		if (m_queries[i].bPending == true)
+		{
+			ResolveQuery(m_queries[i], false);
+		}
+	}
+}
+
+/***********************************************************
+ *  ResolveQuery()
+ *
+ *  This method is used for adding the elapsed GPU time of
+ *  a timer query to the total.  Without bWait a result
+ *  that is not available yet is left pending.
+ ***********************************************************/
+void UtilizationMeter::ResolveQuery(TIMER_QUERY& query, bool bWait)
+{
+	if (bWait == false)
+	{
+		GLint bAvailable = GL_FALSE;
+		glGetQueryObjectiv(query.ID, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (bAvailable == GL_FALSE)
+		{
+			return;
+		}
+	}
+
+	GLuint64 elapsedNanoseconds = 0;
+	glGetQueryObjectui64v(query.ID, GL_QUERY_RESULT, &elapsedNanoseconds);
+	query.bPending = false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_gpuSeconds += elapsedNanoseconds / 1000000000.0;
+}
+
+/***********************************************************
+ *  GetWallSeconds()
+ *
+ *  This method is used for reading a steady clock, only
+ *  differences of its readings mean anything.
+ ***********************************************************/
+double UtilizationMeter::GetWallSeconds()
+{
+	return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/***********************************************************
+ *  GetProcessSeconds()
+ *
+ *  This method is used for reading the user and kernel
+ *  time of all threads of the process.
+ ***********************************************************/
+double UtilizationMeter::GetProcessSeconds()
+{
+#ifdef _WIN32
+	// clock() is wall time on Windows
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime) == 0)
+	{
+		return(0.0);
+	}
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+	// in units of 100 nanoseconds
+	return((kernel.QuadPart + user.QuadPart) / 10000000.0);
+#else
+	return(static_cast<double>(std::clock()) / CLOCKS_PER_SEC);
+#endif
+}
+
+/***********************************************************
+ *  Compare()
+ *
+ *  This method is used for turning the busy times over a
+ *  stretch of wall time into percentages.
+ ***********************************************************/
+UtilizationMeter::UTILIZATION UtilizationMeter::Compare(double wallSeconds, double cpuSeconds, double gpuSeconds)
+{
+	UTILIZATION utilization = { wallSeconds, 0.0, 0.0 };
+	if (wallSeconds > 0.0)
+	{
+		utilization.cpuPercent = 100.0 * cpuSeconds / wallSeconds;
+		utilization.gpuPercent = 100.0 * gpuSeconds / wallSeconds;
+	}
+	return(utilization);
+}
+
+/***********************************************************
+ *  TakeSample()
+ *
+ *  This method is used for measuring the utilization since
+ *  the previous sample.  It makes no GL calls, so any
+ *  thread can take samples; GPU time still pending shows
+ *  up in a later sample.
+ ***********************************************************/
+UtilizationMeter::UTILIZATION UtilizationMeter::TakeSample()
+{
+	double wallSeconds = GetWallSeconds();
+	double cpuSeconds = GetProcessSeconds();
+	double gpuSeconds = 0.0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		gpuSeconds = m_gpuSeconds;
+	}
+
+	UTILIZATION utilization = Compare(wallSeconds - m_sampleWallSeconds,
+		cpuSeconds - m_sampleCpuSeconds, gpuSeconds - m_sampleGpuSeconds);
+
+	m_sampleWallSeconds = wallSeconds;
+	m_sampleCpuSeconds = cpuSeconds;
+	m_sampleGpuSeconds = gpuSeconds;
+	return(utilization);
+}
+
+/***********************************************************
+ *  GetTotal()
+ *
+ *  This method is used for measuring the utilization since
+ *  the construction.  It waits for the pending timer
+ *  queries, so the GL context must be current.
+ ***********************************************************/
+UtilizationMeter::UTILIZATION UtilizationMeter::GetTotal()
+{
+	for (int i = 0; i < QUERY_RING_SIZE; i++)
+	{
+		if (m_queries[i].bPending == true)
+		{
+			ResolveQuery(m_queries[i], true);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(Compare(GetWallSeconds() - m_startWallSeconds,
+		GetProcessSeconds() - m_startCpuSeconds, m_gpuSeconds));
+}
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// UtilizationMeter.h
+// ==================
+// measure how busy the process keeps the CPU and the GPU
+//
+//  Used by the window loop in MainCode.cpp to compare continuous and
+//  on-demand redraw, where an idle scene should cost next to nothing.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <mutex>
+
+/***********************************************************
+ *  UtilizationMeter
+ *
+ *  This class compares the CPU time of the whole process
+ *  and the GPU time of the rendered frames against the wall
+ *  time.  The GPU time comes from timer queries around each
+ *  frame, read back without waiting when the results are
+ *  ready, so the frames are never stalled for it.
+ ***********************************************************/
+class UtilizationMeter
+{
+public:
+	// busy time over wall time, 100 for one full CPU core or
+	// a GPU that never idles
+	struct UTILIZATION
+	{
+		double seconds;
+		double cpuPercent;
+		double gpuPercent;
+	};
+
+	// constructor
+	UtilizationMeter();
+	// destructor
+	~UtilizationMeter();
+
+	// mark the start and end of one rendered frame, on the
+	// thread that owns the GL context
+	void BeginFrame();
+	void EndFrame();
+
+	// utilization since the previous sample
+	UTILIZATION TakeSample();
+	// utilization since the construction
+	UTILIZATION GetTotal();
+
+private:
+	// number of timer queries kept in flight
+	static const int QUERY_RING_SIZE = 4;
+
+	struct TIMER_QUERY
+	{
+		GLuint ID;
+		bool bPending;
+	};
+
+	// add the query's time to the GPU total, waiting for it
+	// only when bWait is set
+	void ResolveQuery(TIMER_QUERY& query, bool bWait);
+	// seconds since an arbitrary point
+	static double GetWallSeconds();
+	// CPU time used by every thread of the process
+	static double GetProcessSeconds();
+	// utilization between two readings
+	static UTILIZATION Compare(double wallSeconds, double cpuSeconds, double gpuSeconds);
+
+	TIMER_QUERY m_queries[QUERY_RING_SIZE];
+	int m_currentQuery;
+
+	// readings at the construction and at the last sample
+	double m_startWallSeconds;
+	double m_startCpuSeconds;
+	double m_sampleWallSeconds;
+	double m_sampleCpuSeconds;
+	double m_sampleGpuSeconds;
+	// resolved GPU time of all frames
+	double m_gpuSeconds;
+	// guards the GPU total, written by the render thread
+	std::mutex m_mutex;
+};
@@ -14,6 +14,8 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <cmath>
+
 // Declaration of the global variables and defines
 namespace
 {
@@ -21,10 +23,6 @@ namespace
     const int WINDOW_WIDTH = 1000;
     const int WINDOW_HEIGHT = 800;
 
-    // Shader variable names for view and projection matrices
-    const char* g_ViewName = "view";
-    const char* g_ProjectionName = "projection";
-
     // Mouse movement control variables
     float gLastX = WINDOW_WIDTH / 2.0f;  // Last recorded X position of the mouse
     float gLastY = WINDOW_HEIGHT / 2.0f; // Last recorded Y position of the mouse
@@ -33,6 +31,14 @@ namespace
     // Timing variables to control frame time
     float gDeltaTime = 0.0f;  // Time difference between the current and previous frame
     float gLastFrame = 0.0f;  // Time of the last frame
+    // Longest time step the camera moves by, so the first frame after
+    // waiting idle for events does not jump
+    const float g_MaximumDeltaTime = 0.1f;
+
+    // Fixed benchmark camera path - an orbit around the desk
+    const glm::vec3 g_CameraPathCenter = glm::vec3(0.0f, 0.5f, 9.0f);  // Point the camera looks at
+    const float g_CameraPathRadius = 12.0f;                             // Orbit radius around the center
+    const float g_CameraPathHeight = 5.0f;                              // Height of the camera above the center
 }
 
 // Static member initialization
@@ -50,6 +56,8 @@ ViewManager::ViewManager(ShaderManager* pShaderManager)
     s_Instance = this;
     m_pShaderManager = pShaderManager;  // Assign shader manager to class member
     m_pWindow = nullptr;  // Initialize window pointer to nullptr
+    m_view = glm::mat4(1.0f);  // Computed by PrepareSceneView() every frame
+    m_projection = glm::mat4(1.0f);
 
     // Create and initialize camera object with default parameters
     m_pCamera = new Camera();
@@ -60,6 +68,11 @@ ViewManager::ViewManager(ShaderManager* pShaderManager)
     m_pCamera->MovementSpeed = 2.5f;                    // Default camera movement speed
     m_cameraSpeed = 2.5f;                               // Initialize the camera speed for movement
     m_bOrthographicProjection = false;                  // Default to perspective projection
+    m_bFixedCameraPath = false;                         // Camera is controlled by the user
+    m_bRedrawRequested = true;                          // The first frame is always drawn
+    m_offscreenFramebuffer = 0;                         // No offscreen target until headless mode requests one
+    m_offscreenColorBuffer = 0;
+    m_offscreenDepthBuffer = 0;
 }
 
 /***********************************************************
@@ -72,6 +85,13 @@ ViewManager::~ViewManager()
 {
     // Reset the static instance pointer to null
     s_Instance = nullptr;
+    // Release the offscreen framebuffer if headless mode created one
+    if (m_offscreenFramebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &m_offscreenFramebuffer);
+        glDeleteRenderbuffers(1, &m_offscreenColorBuffer);
+        glDeleteRenderbuffers(1, &m_offscreenDepthBuffer);
+    }
     // Release the shader manager and window pointers
     m_pShaderManager = nullptr;
     m_pWindow = nullptr;
@@ -108,42 +128,148 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
     glfwSetCursorPosCallback(window, Mouse_Position_Callback);
     glfwSetScrollCallback(window, Mouse_Scroll_Callback);
     glfwSetKeyCallback(window, Key_Callback);
+    glfwSetWindowRefreshCallback(window, Window_Refresh_Callback);
 
-    // Enable blending for transparency in rendering
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Blending is enabled by the scene manager for the
+    // transparent draws only
 
     // Store the window pointer in the class member for later use
     m_pWindow = window;
     return window;
 }
 
+/***********************************************************
+ *  CreateOffscreenWindow()
+ *
+ *  This method creates an invisible window that only owns an
+ *  OpenGL context.  No input callbacks are installed since
+ *  nothing can be typed into a headless window.
+ ***********************************************************/
+GLFWwindow* ViewManager::CreateOffscreenWindow(const char* windowTitle)
+{
+    // The window is never shown; it only carries the context
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef GLFW_PLATFORM_NULL
+    // On the null platform prefer a surfaceless EGL context
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
+    GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, windowTitle, nullptr, nullptr);
+#ifdef GLFW_PLATFORM_NULL
+    if (window == nullptr)
+    {
+        // Fall back to the OSMesa software rasterizer
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, windowTitle, nullptr, nullptr);
+    }
+#endif
+    if (window == nullptr)
+    {
+        std::cout << "Failed to create offscreen GLFW context" << std::endl;
+        glfwTerminate();
+        return nullptr;
+    }
+
+    // Set the current OpenGL context to the offscreen window
+    glfwMakeContextCurrent(window);
+
+    // Blending is enabled by the scene manager for the
+    // transparent draws only
+
+    m_pWindow = window;
+    return window;
+}
+
+/***********************************************************
+ *  CreateOffscreenFramebuffer()
+ *
+ *  This method creates the framebuffer object that headless
+ *  frames are rendered into and leaves it bound.
+ ***********************************************************/
+bool ViewManager::CreateOffscreenFramebuffer()
+{
+    glGenRenderbuffers(1, &m_offscreenColorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreenColorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    glGenRenderbuffers(1, &m_offscreenDepthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreenDepthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_offscreenFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_offscreenFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_offscreenColorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_offscreenDepthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+        return false;
+    }
+
+    // Render the whole offscreen target
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    return true;
+}
+
+/***********************************************************
+ *  SetCameraPathPose()
+ *
+ *  This method places the camera on the benchmark orbit.  The
+ *  whole path is one revolution spread over frameCount frames.
+ ***********************************************************/
+void ViewManager::SetCameraPathPose(int frameIndex, int frameCount)
+{
+    m_bFixedCameraPath = true;
+
+    float angle = glm::radians(360.0f) * static_cast<float>(frameIndex) / static_cast<float>(frameCount);
+
+    // Orbit around the desk, always looking at its center
+    m_pCamera->Position = g_CameraPathCenter + glm::vec3(
+        g_CameraPathRadius * std::sin(angle),
+        g_CameraPathHeight,
+        g_CameraPathRadius * std::cos(angle));
+    m_pCamera->Front = glm::normalize(g_CameraPathCenter - m_pCamera->Position);
+    m_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
+    RequestRedraw();
+}
+
+/***********************************************************
+ *  RequestRedraw()
+ *
+ *  This method marks the next frame as changed.  Posting an
+ *  empty event ends a glfwWaitEvents() call on the main
+ *  thread, and GLFW allows posting it from any thread.
+ ***********************************************************/
+void ViewManager::RequestRedraw()
+{
+    m_bRedrawRequested = true;
+    glfwPostEmptyEvent();
+}
+
 /***********************************************************
  *  PrepareSceneView()
  *
  *  This method prepares the 3D scene by updating the camera
- *  view and projection matrices, and sending them to the shader.
+ *  view and projection matrices.  The render side sends them
+ *  to the shader with the frame they belong to.
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
     // Calculate the time difference between frames to ensure smooth motion
     float currentFrame = glfwGetTime();
-    gDeltaTime = currentFrame - gLastFrame;
+    gDeltaTime = std::min(currentFrame - gLastFrame, g_MaximumDeltaTime);
     gLastFrame = currentFrame;
 
     // Process user input (keyboard events)
     ProcessKeyboardEvents();
 
     // Get the camera view matrix for rendering the scene from the camera's perspective
-    glm::mat4 view = m_pCamera->GetViewMatrix();
-    // Send the view matrix to the shader for transforming the scene
-    m_pShaderManager->setMat4Value(g_ViewName, view);
+    m_view = m_pCamera->GetViewMatrix();
 
-    // Update and send the projection matrix to the shader
+    // Update the projection matrix
     UpdateProjection();
-
-    // Send the camera position to the shader (useful for lighting calculations)
-    m_pShaderManager->setVec3Value("viewPosition", m_pCamera->Position);
 }
 
 /***********************************************************
@@ -158,7 +284,12 @@ void ViewManager::ProcessKeyboardEvents()
     if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(m_pWindow, true);
 
+    // The benchmark camera path ignores movement keys
+    if (m_bFixedCameraPath)
+        return;
+
     // Adjust the camera's position based on user input (W, A, S, D, Q, E)
+    glm::vec3 previousPosition = m_pCamera->Position;
     float velocity = m_cameraSpeed * gDeltaTime;  // Movement speed depends on time between frames
     if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
         m_pCamera->ProcessKeyboard(FORWARD, velocity);   // Move forward
@@ -172,6 +303,10 @@ void ViewManager::ProcessKeyboardEvents()
         m_pCamera->ProcessKeyboard(UP, velocity);        // Move upward
     if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
         m_pCamera->ProcessKeyboard(DOWN, velocity);      // Move downward
+
+    // A held key sends no events, so keep drawing while it moves the camera
+    if (m_pCamera->Position != previousPosition)
+        RequestRedraw();
 }
 
 /***********************************************************
@@ -202,6 +337,7 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xpos, doubl
 
     // Pass the mouse movement offsets to the camera for updating the view
     s_Instance->m_pCamera->ProcessMouseMovement(xoffset, yoffset);
+    s_Instance->RequestRedraw();
 }
 
 /***********************************************************
@@ -235,15 +371,30 @@ void ViewManager::Key_Callback(GLFWwindow* window, int key, int scancode, int ac
     {
         s_Instance->m_bOrthographicProjection = false;
         s_Instance->UpdateProjection();  // Update the projection matrix
+        s_Instance->RequestRedraw();
     }
     // Switch to orthographic projection when the 'O' key is pressed
     if (key == GLFW_KEY_O && action == GLFW_PRESS)
     {
         s_Instance->m_bOrthographicProjection = true;
         s_Instance->UpdateProjection();  // Update the projection matrix
+        s_Instance->RequestRedraw();
     }
 }
 
+/***********************************************************
+ *  Window_Refresh_Callback()
+ *
+ *  This callback is invoked when the window contents are
+ *  damaged, after it was uncovered or resized.
+ ***********************************************************/
+void ViewManager::Window_Refresh_Callback(GLFWwindow* window)
+{
+    if (s_Instance == nullptr) return;  // Check if the instance is valid
+
+    s_Instance->RequestRedraw();
+}
+
 /***********************************************************
  *  UpdateProjection()
  *
@@ -252,21 +403,16 @@ void ViewManager::Key_Callback(GLFWwindow* window, int key, int scancode, int ac
  ***********************************************************/
 void ViewManager::UpdateProjection()
 {
-    glm::mat4 projection;  // Projection matrix
-
     // Set the projection matrix to orthographic or perspective depending on the current mode
     if (m_bOrthographicProjection)
     {
         // Calculate the aspect ratio and set up the orthographic projection matrix
         float aspect = static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT);
-        projection = glm::ortho(-10.0f * aspect, 10.0f * aspect, -10.0f, 10.0f, 0.1f, 100.0f);
+        m_projection = glm::ortho(-10.0f * aspect, 10.0f * aspect, -10.0f, 10.0f, 0.1f, 100.0f);
     }
     else
     {
         // Set up the perspective projection matrix
-        projection = glm::perspective(glm::radians(m_pCamera->Zoom), static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT), 0.1f, 100.0f);
+        m_projection = glm::perspective(glm::radians(m_pCamera->Zoom), static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT), 0.1f, 100.0f);
     }
-
-    // Send the projection matrix to the shader for use in rendering
-    m_pShaderManager->setMat4Value(g_ProjectionName, projection);
 }
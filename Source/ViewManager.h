@@ -15,6 +15,8 @@
 #include "camera.h"
 #include "GLFW/glfw3.h"
 
+#include <atomic>
+
 class ViewManager
 {
 public:
@@ -44,15 +46,72 @@ public:
      ***********************************************************/
     GLFWwindow* CreateDisplayWindow(const char* windowTitle);
 
+    /***********************************************************
+     *  CreateOffscreenWindow(const char* windowTitle)
+     *
+     *  Creates an invisible GLFW window that only provides an
+     *  OpenGL context for headless rendering.  When GLFW is
+     *  initialized on the null platform the context comes from
+     *  surfaceless EGL or OSMesa, so no display is required.
+     ***********************************************************/
+    GLFWwindow* CreateOffscreenWindow(const char* windowTitle);
+
+    /***********************************************************
+     *  CreateOffscreenFramebuffer()
+     *
+     *  Creates a framebuffer object with color and depth
+     *  attachments matching the window size and binds it as the
+     *  render target.  Must be called after GLEW is initialized.
+     ***********************************************************/
+    bool CreateOffscreenFramebuffer();
+
+    /***********************************************************
+     *  SetCameraPathPose(int frameIndex, int frameCount)
+     *
+     *  Places the camera on a fixed orbit around the desk for
+     *  the given frame so benchmark runs are repeatable.  Once
+     *  called, keyboard movement no longer moves the camera.
+     ***********************************************************/
+    void SetCameraPathPose(int frameIndex, int frameCount);
+
     /***********************************************************
      *  PrepareSceneView()
      *
      *  Prepares the view for rendering the 3D scene by updating
-     *  the camera view and projection matrices, sending them
-     *  to the shader for use in rendering.
+     *  the camera view and projection matrices from the input.
+     *  It makes no GL calls, so it runs on the main thread
+     *  while the render thread draws an earlier frame.
      ***********************************************************/
     void PrepareSceneView();
 
+    /***********************************************************
+     *  GetView(), GetProjection(), GetViewPosition()
+     *
+     *  Return the camera computed by the last call to
+     *  PrepareSceneView(), to be copied into a frame snapshot.
+     ***********************************************************/
+    const glm::mat4& GetView() const { return m_view; }
+    const glm::mat4& GetProjection() const { return m_projection; }
+    const glm::vec3& GetViewPosition() const { return m_pCamera->Position; }
+
+    /***********************************************************
+     *  RequestRedraw()
+     *
+     *  Marks the next frame as changed and wakes the main loop
+     *  if it is waiting for events.  Safe to call from any
+     *  thread, for example by code that changes the scene.
+     ***********************************************************/
+    void RequestRedraw();
+
+    /***********************************************************
+     *  TakeRedrawRequest()
+     *
+     *  Returns true when the camera, the projection or the
+     *  window changed since the last call, and clears the
+     *  request.  The on-demand loop only redraws then.
+     ***********************************************************/
+    bool TakeRedrawRequest() { return m_bRedrawRequested.exchange(false); }
+
     /***********************************************************
      *  Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
      *
@@ -78,6 +137,14 @@ public:
      ***********************************************************/
     static void Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
+    /***********************************************************
+     *  Window_Refresh_Callback(GLFWwindow* window)
+     *
+     *  Static callback function for windows that were uncovered
+     *  or resized, whose contents must be drawn again.
+     ***********************************************************/
+    static void Window_Refresh_Callback(GLFWwindow* window);
+
     /***********************************************************
      *  GetInstance()
      *
@@ -107,13 +174,21 @@ private:
      *  UpdateProjection()
      *
      *  Updates the projection matrix for either orthographic
-     *  or perspective projection, and sends it to the shader.
+     *  or perspective projection.  It is read with the view
+     *  matrix after PrepareSceneView().
      ***********************************************************/
     void UpdateProjection();
 
-    // Pointer to the ShaderManager object, used for sending matrices to shaders
+    // Pointer to the ShaderManager object, unused since the matrices
+    // reach the shaders through the SceneUniforms camera block
     ShaderManager* m_pShaderManager;
 
+    // View matrix computed by PrepareSceneView()
+    glm::mat4 m_view;
+
+    // Projection matrix computed by UpdateProjection()
+    glm::mat4 m_projection;
+
     // Pointer to the active OpenGL display window created by GLFW
     GLFWwindow* m_pWindow;
 
@@ -126,6 +201,17 @@ private:
     // Float value to store the speed at which the camera moves in the 3D scene
     float m_cameraSpeed;
 
+    // Boolean flag set when the camera follows the fixed benchmark path
+    bool m_bFixedCameraPath;
+
+    // Boolean flag set when the next frame differs from the last one
+    std::atomic<bool> m_bRedrawRequested;
+
+    // Offscreen framebuffer and its attachments used in headless mode
+    GLuint m_offscreenFramebuffer;
+    GLuint m_offscreenColorBuffer;
+    GLuint m_offscreenDepthBuffer;
+
     // Static pointer to the singleton instance of the ViewManager class
     static ViewManager* s_Instance;
 };
@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+// WorkerPool.cpp
+// ==============
+// fixed-size pool of worker threads for CPU work off the GL thread
+//
+//  Tasks submitted to the pool must not make any OpenGL calls, since
+//  the GL context is only current on the thread that renders.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "WorkerPool.h"
+
+/***********************************************************
+ *  WorkerPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+WorkerPool::WorkerPool(int threadCount)
+{
+	m_activeTasks = 0;
+	m_bStopping = false;
+
+	if (threadCount <= 0)
+	{
+		threadCount = static_cast<int>(std::thread::hardware_concurrency());
+	}
+	// hardware_concurrency() may report 0 when it cannot tell
+	if (threadCount <= 0)
+	{
+		threadCount = 1;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		m_threads.push_back(std::thread(&WorkerPool::WorkerMain, this));
+	}
+}
+
+/***********************************************************
+ *  ~WorkerPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_taskAvailable.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for queueing a task to be executed
+ *  on the next free worker thread.
+ ***********************************************************/
+void WorkerPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push(std::move(task));
+	}
+	m_taskAvailable.notify_one();
+}
+
+/***********************************************************
+ *  Wait()
+ *
+ *  This method is used for blocking the calling thread
+ *  until the queue is empty and no task is running.
+ ***********************************************************/
+void WorkerPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_tasksFinished.wait(lock, [this]() {
+		return (m_tasks.empty() && (m_activeTasks == 0));
+	});
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is the loop run by every worker thread.  It
+ *  takes tasks from the queue until the pool is stopped.
+ ***********************************************************/
+void WorkerPool::WorkerMain()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskAvailable.wait(lock, [this]() {
+				return (m_bStopping || !m_tasks.empty());
+			});
+			if (m_bStopping && m_tasks.empty())
+			{
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+			m_activeTasks++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeTasks--;
+			if (m_tasks.empty() && (m_activeTasks == 0))
+			{
+				m_tasksFinished.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// WorkerPool.h
+// ============
+// fixed-size pool of worker threads for CPU work off the GL thread
+//
+//  Tasks submitted to the pool must not make any OpenGL calls, since
+//  the GL context is only current on the thread that renders.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  WorkerPool
+ *
+ *  This class owns a set of worker threads that execute
+ *  submitted tasks in first-in first-out order.
+ ***********************************************************/
+class WorkerPool
+{
+public:
+	// constructor - a thread count of 0 uses one thread per core
+	WorkerPool(int threadCount = 0);
+	// destructor
+	~WorkerPool();
+
+	// queue a task for execution on a worker thread
+	void Submit(std::function<void()> task);
+	// block until every submitted task has finished
+	void Wait();
+
+	// number of worker threads in the pool
+	int GetThreadCount() const { return static_cast<int>(m_threads.size()); }
+
+private:
+	// main loop of each worker thread
+	void WorkerMain();
+
+	// worker threads
+	std::vector<std::thread> m_threads;
+	// tasks waiting to be executed
+	std::queue<std::function<void()>> m_tasks;
+	// number of tasks currently executing
+	int m_activeTasks;
+	// set when the pool is being destroyed
+	bool m_bStopping;
+
+	// guards the task queue and counters
+	std::mutex m_mutex;
+	// signalled when a task is queued or the pool stops
+	std::condition_variable m_taskAvailable;
+	// signalled when the last running task finishes
+	std::condition_variable m_tasksFinished;
+};
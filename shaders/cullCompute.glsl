@@ -0,0 +1,111 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// one object of the frame, in instance buffer order
+struct CullObject
+{
+   vec4 boundsMinimum;
+   vec4 boundsMaximum;
+   // draw range of the object's mesh and detail level
+   uint indexCount;
+   uint firstIndex;
+   int baseVertex;
+   // batch whose counter the object adds to
+   uint batch;
+   // first command of the batch in the command buffer
+   uint commandBase;
+   // command the object always writes, or 0xFFFFFFFF to
+   // take the next free command of its batch
+   uint fixedCommand;
+   uint padding0;
+   uint padding1;
+};
+
+// DrawElementsIndirectCommand
+struct DrawCommand
+{
+   uint count;
+   uint instanceCount;
+   uint firstIndex;
+   int baseVertex;
+   uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectBuffer
+{
+   CullObject objects[];
+};
+
+layout(std430, binding = 1) writeonly buffer CommandBuffer
+{
+   DrawCommand commands[];
+};
+
+// visible objects and their indices over the frame, then
+// the visible objects of each batch
+layout(std430, binding = 2) buffer CounterBuffer
+{
+   uint visibleCount;
+   uint visibleIndexCount;
+   uint batchCounts[];
+};
+
+uniform mat4 viewProjection;
+uniform uint objectCount;
+
+// true when the box is not fully outside any frustum plane
+bool IsBoxVisible(vec3 center, vec3 extent)
+{
+   vec4 rows[4];
+   for (int row = 0; row < 4; row++)
+   {
+      rows[row] = vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+   }
+
+   for (int plane = 0; plane < 6; plane++)
+   {
+      // the last row plus or minus one of the other rows
+      vec4 p = (plane % 2 == 0) ? rows[3] + rows[plane / 2] : rows[3] - rows[plane / 2];
+      float distance = dot(p.xyz, center) + p.w;
+      float radius = dot(abs(p.xyz), extent);
+      if (distance + radius < 0.0)
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void main()
+{
+   uint objectIndex = gl_GlobalInvocationID.x;
+   if (objectIndex >= objectCount)
+   {
+      return;
+   }
+
+   CullObject object = objects[objectIndex];
+   vec3 center = (object.boundsMinimum.xyz + object.boundsMaximum.xyz) * 0.5;
+   vec3 extent = (object.boundsMaximum.xyz - object.boundsMinimum.xyz) * 0.5;
+   if (IsBoxVisible(center, extent) == false)
+   {
+      return;
+   }
+
+   atomicAdd(visibleCount, 1u);
+   atomicAdd(visibleIndexCount, object.indexCount);
+   uint slot = atomicAdd(batchCounts[object.batch], 1u);
+   if (object.fixedCommand != 0xFFFFFFFFu)
+   {
+      slot = object.fixedCommand;
+   }
+
+   DrawCommand command;
+   command.count = object.indexCount;
+   command.instanceCount = 1u;
+   command.firstIndex = object.firstIndex;
+   command.baseVertex = object.baseVertex;
+   command.baseInstance = objectIndex;
+   commands[object.commandBase + slot] = command;
+}
@@ -18,69 +18,157 @@ struct LightSource
    
     float focalStrength;
     float specularIntensity;
+    // unused entries of the block are false
+    bool bActive;
+    // atlas offset in xy and size in z, zero size when the
+    // light casts no shadow
+    vec4 shadowTile;
+    // world space to the light's clip space
+    mat4 shadowMatrix;
 };
 
 #define TOTAL_LIGHTS 4
+#define TOTAL_MATERIALS 64
+// must match LightClusters::TILES_X, TILES_Y and SLICES
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+
+layout(std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 viewPosition;
+};
+
+layout(std140) uniform LightBlock
+{
+    LightSource lightSources[TOTAL_LIGHTS];
+};
+
+layout(std140) uniform MaterialBlock
+{
+    Material materials[TOTAL_MATERIALS];
+};
 
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+flat in vec4 fragmentColor;
+flat in int fragmentMaterialIndex;
+// texture array layer, -1 when drawing with the color
+flat in int fragmentTextureLayer;
 
-out vec4 outFragmentColor;
+layout(location = 0) out vec4 outFragmentColor;
+// second target of the weighted blended transparency
+layout(location = 1) out vec4 outRevealage;
 
-uniform bool bUseTexture=false;
 uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
-uniform sampler2D objectTexture;
-uniform vec3 viewPosition;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
-uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
+// depth pre-pass, the color is masked off so nothing is computed
+uniform bool bDepthOnly = false;
+// add a constant per fragment to show the overdraw
+uniform bool bOverdrawView = false;
+// write the weighted color and the revealage of a blended
+// draw instead of the color
+uniform bool bWeightedBlend = false;
+uniform sampler2DArray objectTexture;
+
+// point lights, two texels each: position and range, then
+// color and intensity
+uniform samplerBuffer pointLights;
+// first index and light count of each cluster
+uniform usamplerBuffer clusterGrid;
+// light indices of all clusters back to back
+uniform usamplerBuffer clusterLightIndices;
+uniform int pointLightCount = 0;
+// tile size in pixels, and slice = log(depth) * x + y
+uniform vec2 clusterTileSize = vec2(1.0f);
+uniform vec2 clusterSliceScaleBias = vec2(0.0f);
+
+// shadow maps of the light sources, one tile each
+uniform sampler2DShadow shadowAtlas;
+// taps from the center to the edge of the filter kernel
+uniform int shadowKernelRadius = 1;
 
 // function prototypes
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcPointLights(Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcShadow(LightSource light, vec3 vertexPosition, vec3 lightNormal);
 
 void main()
 {
+   if(bDepthOnly == true)
+   {
+      outFragmentColor = vec4(0.0f);
+      return;
+   }
+   if(bOverdrawView == true)
+   {
+      // additive blending sums this per layer, about ten
+      // layers saturate
+      outFragmentColor = vec4(0.1f, 0.05f, 0.02f, 1.0f);
+      return;
+   }
+
    if(bUseLighting == true)
    {
       // properties
       vec3 lightNormal = normalize(fragmentVertexNormal);
       vec3 viewDirection = normalize(viewPosition - fragmentPosition);
       vec3 phongResult = vec3(0.0f);
+      Material material = materials[fragmentMaterialIndex];
 
       for(int i = 0; i < TOTAL_LIGHTS; i++)
       {
-         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
-      }   
+         if(lightSources[i].bActive == true)
+         {
+            phongResult += CalcLightSource(lightSources[i], material, lightNormal, fragmentPosition, viewDirection);
+         }
+      }
+      if(pointLightCount > 0)
+      {
+         phongResult += CalcPointLights(material, lightNormal, fragmentPosition, viewDirection);
+      }
     
-      if(bUseTexture == true)
+      if(fragmentTextureLayer >= 0)
       {
-         vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         vec4 textureColor = texture(objectTexture, vec3(fragmentTextureCoordinate, fragmentTextureLayer));
          outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
       }
       else
       {
-         outFragmentColor = vec4(phongResult * objectColor.xyz, objectColor.w);
+         outFragmentColor = vec4(phongResult * fragmentColor.xyz, fragmentColor.w);
       }
    }
    else 
    {
-      if(bUseTexture == true)
+      if(fragmentTextureLayer >= 0)
       {
-         outFragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         outFragmentColor = texture(objectTexture, vec3(fragmentTextureCoordinate, fragmentTextureLayer));
       }
       else
       {
-         outFragmentColor = objectColor;
+         outFragmentColor = fragmentColor;
       }
    }
 
   // outFragmentColor = vec4(fragmentTextureCoordinate, 0, 1.0f);
+
+   if(bWeightedBlend == true)
+   {
+      // near and opaque fragments weigh more, so they still
+      // dominate the average without any sorting
+      float alpha = outFragmentColor.a;
+      float weight = clamp(pow(min(1.0f, alpha * 10.0f) + 0.01f, 3.0f) * 1e8f *
+         pow(1.0f - gl_FragCoord.z * 0.9f, 3.0f), 1e-2f, 3e3f);
+      outFragmentColor = vec4(outFragmentColor.rgb * alpha, alpha) * weight;
+      outRevealage = vec4(alpha);
+   }
 }
 
 // calculates the color when using a directional light.
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
 {
    vec3 ambient;
    vec3 diffuse;
@@ -111,7 +199,98 @@ vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, v
    float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), 32.0f);
  
    specular =specularComponent * (light.specularIntensity * material.shininess) * material.specularColor;
+
+   // the shadow takes away the direct light only
+   float shadow = CalcShadow(light, vertexPosition, lightNormal);
   
-   return(ambient + diffuse + specular);
+   return(ambient + (diffuse + specular) * shadow);
    
-}
\ No newline at end of file
+}
+
+// returns how much of the light reaches the fragment, from 0 in
+// full shadow to 1.
+float CalcShadow(LightSource light, vec3 vertexPosition, vec3 lightNormal)
+{
+   if(light.shadowTile.z <= 0.0f)
+   {
+      return(1.0f);
+   }
+
+   // a small push along the normal keeps lit surfaces from
+   // shadowing themselves at grazing angles
+   vec4 clip = light.shadowMatrix * vec4(vertexPosition + lightNormal * 0.02f, 1.0f);
+   if(clip.w <= 0.0f)
+   {
+      return(1.0f);
+   }
+   vec3 ndc = clip.xyz / clip.w;
+   // the light's view only holds the casters, so anything
+   // outside it is lit
+   if(any(greaterThan(abs(ndc), vec3(1.0f))))
+   {
+      return(1.0f);
+   }
+
+   vec2 uv = (ndc.xy * 0.5f + 0.5f) * light.shadowTile.z + light.shadowTile.xy;
+   float depth = ndc.z * 0.5f + 0.5f;
+
+   // keep the taps inside the tile, a texel away from its
+   // edges so the filter does not read the neighbour
+   vec2 texelSize = 1.0f / vec2(textureSize(shadowAtlas, 0));
+   vec2 tileMinimum = light.shadowTile.xy + texelSize;
+   vec2 tileMaximum = light.shadowTile.xy + light.shadowTile.z - texelSize;
+
+   float lit = 0.0f;
+   for(int y = -shadowKernelRadius; y <= shadowKernelRadius; y++)
+   {
+      for(int x = -shadowKernelRadius; x <= shadowKernelRadius; x++)
+      {
+         vec2 tap = clamp(uv + vec2(x, y) * texelSize, tileMinimum, tileMaximum);
+         lit += texture(shadowAtlas, vec3(tap, depth));
+      }
+   }
+   float taps = float((2 * shadowKernelRadius + 1) * (2 * shadowKernelRadius + 1));
+   return(lit / taps);
+}
+
+// adds up the point lights of the fragment's cluster.
+vec3 CalcPointLights(Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   // find the cluster from the pixel and the view-space depth
+   float depth = -(view * vec4(vertexPosition, 1.0f)).z;
+   int slice = int(floor(log(max(depth, 1e-4f)) * clusterSliceScaleBias.x + clusterSliceScaleBias.y));
+   ivec2 tile = ivec2(gl_FragCoord.xy / clusterTileSize);
+   tile = clamp(tile, ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+   slice = clamp(slice, 0, CLUSTER_SLICES - 1);
+   int cluster = (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+
+   uvec2 range = texelFetch(clusterGrid, cluster).xy;
+   vec3 result = vec3(0.0f);
+   for(uint i = 0u; i < range.y; i++)
+   {
+      int light = int(texelFetch(clusterLightIndices, int(range.x + i)).x);
+      vec4 positionRange = texelFetch(pointLights, light * 2);
+      vec4 colorIntensity = texelFetch(pointLights, light * 2 + 1);
+
+      vec3 toLight = positionRange.xyz - vertexPosition;
+      float distance = length(toLight);
+      // smooth falloff that reaches zero at the light's range
+      float ratio = distance / positionRange.w;
+      float falloff = clamp(1.0f - ratio * ratio, 0.0f, 1.0f);
+      falloff *= falloff;
+      if(falloff <= 0.0f)
+      {
+         continue;
+      }
+
+      vec3 lightDirection = toLight / distance;
+      float impact = max(dot(lightNormal, lightDirection), 0.0);
+      vec3 reflectDir = reflect(-lightDirection, lightNormal);
+      float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), 32.0f);
+
+      vec3 lighting = impact * material.diffuseColor + specularComponent * material.specularColor;
+      result += lighting * colorIntensity.rgb * (colorIntensity.a * falloff);
+   }
+
+   return(result);
+}
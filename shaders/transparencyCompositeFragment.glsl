@@ -0,0 +1,23 @@
+#version 330 core
+
+// weighted sum of premultiplied color and alpha
+uniform sampler2D accumulation;
+// product of (1 - alpha) of the blended fragments
+uniform sampler2D revealage;
+
+out vec4 outFragmentColor;
+
+void main()
+{
+   ivec2 pixel = ivec2(gl_FragCoord.xy);
+   float reveal = texelFetch(revealage, pixel, 0).r;
+   // nothing blended covers this pixel
+   if(reveal >= 1.0f)
+   {
+      discard;
+   }
+
+   vec4 sum = texelFetch(accumulation, pixel, 0);
+   vec3 averageColor = sum.rgb / max(sum.a, 1e-5f);
+   outFragmentColor = vec4(averageColor, 1.0f - reveal);
+}
@@ -3,18 +3,64 @@ layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
 
+// per-instance attributes, read when bInstanced is set
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceColor;
+layout (location = 8) in vec2 inInstanceUVscale;
+// material index and texture layer, -1 for no texture
+layout (location = 9) in ivec2 inInstanceIndices;
+// inverse transpose of the model matrix, formed on the CPU
+layout (location = 10) in mat3 inInstanceNormalMatrix;
+
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+flat out vec4 fragmentColor;
+flat out int fragmentMaterialIndex;
+flat out int fragmentTextureLayer;
+
+layout(std140) uniform CameraBlock
+{
+   mat4 view;
+   mat4 projection;
+   mat4 viewProjection;
+   vec3 viewPosition;
+};
 
+// per-draw values, used when bInstanced is not set
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix;
+uniform bool bUseTexture = false;
+uniform vec4 objectColor = vec4(1.0f);
+uniform int objectTextureLayer = 0;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+uniform int materialIndex = 0;
+
+uniform bool bInstanced = false;
 
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
-   fragmentVertexNormal = transpose(inverse(mat3(model))) *  inVertexNormal;
-   fragmentTextureCoordinate = inTextureCoordinate;
-}
\ No newline at end of file
+   mat4 modelMatrix = model;
+   mat3 normalTransform = normalMatrix;
+   vec2 uvScale = UVscale;
+   fragmentColor = objectColor;
+   fragmentMaterialIndex = materialIndex;
+   fragmentTextureLayer = (bUseTexture == true) ? objectTextureLayer : -1;
+
+   if(bInstanced == true)
+   {
+      modelMatrix = inInstanceModel;
+      normalTransform = inInstanceNormalMatrix;
+      uvScale = inInstanceUVscale;
+      fragmentColor = inInstanceColor;
+      fragmentMaterialIndex = inInstanceIndices.x;
+      fragmentTextureLayer = inInstanceIndices.y;
+   }
+
+   // two matrix-vector products per vertex, no matrix products
+   vec4 worldPosition = modelMatrix * vec4(inVertexPosition, 1.0);
+   fragmentPosition = vec3(worldPosition);
+   gl_Position = viewProjection * worldPosition;
+   fragmentVertexNormal = normalTransform * inVertexNormal;
+   fragmentTextureCoordinate = inTextureCoordinate * uvScale;
+}
@@ -0,0 +1,63 @@
+#version 330 core
+// reference variant of vertexShader.glsl that forms the normal matrix
+// and the full transform for every vertex, for --reference-shader runs
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+// per-instance attributes, read when bInstanced is set
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceColor;
+layout (location = 8) in vec2 inInstanceUVscale;
+// material index and texture layer, -1 for no texture
+layout (location = 9) in ivec2 inInstanceIndices;
+// normal matrix, not read by this variant
+layout (location = 10) in mat3 inInstanceNormalMatrix;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out vec4 fragmentColor;
+flat out int fragmentMaterialIndex;
+flat out int fragmentTextureLayer;
+
+layout(std140) uniform CameraBlock
+{
+   mat4 view;
+   mat4 projection;
+   mat4 viewProjection;
+   vec3 viewPosition;
+};
+
+// per-draw values, used when bInstanced is not set
+uniform mat4 model;
+uniform bool bUseTexture = false;
+uniform vec4 objectColor = vec4(1.0f);
+uniform int objectTextureLayer = 0;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+uniform int materialIndex = 0;
+
+uniform bool bInstanced = false;
+
+void main()
+{
+   mat4 modelMatrix = model;
+   vec2 uvScale = UVscale;
+   fragmentColor = objectColor;
+   fragmentMaterialIndex = materialIndex;
+   fragmentTextureLayer = (bUseTexture == true) ? objectTextureLayer : -1;
+
+   if(bInstanced == true)
+   {
+      modelMatrix = inInstanceModel;
+      uvScale = inInstanceUVscale;
+      fragmentColor = inInstanceColor;
+      fragmentMaterialIndex = inInstanceIndices.x;
+      fragmentTextureLayer = inInstanceIndices.y;
+   }
+
+   fragmentPosition = vec3(modelMatrix * vec4(inVertexPosition, 1.0));
+   gl_Position = projection * view * modelMatrix * vec4(inVertexPosition, 1.0f);
+   fragmentVertexNormal = transpose(inverse(mat3(modelMatrix))) *  inVertexNormal;
+   fragmentTextureCoordinate = inTextureCoordinate * uvScale;
+}